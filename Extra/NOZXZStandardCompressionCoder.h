@@ -15,6 +15,11 @@
 
 + (nullable id<NOZEncoder>)encoder;
 + (nullable id<NOZEncoder>)encoderWithDictionaryData:(nullable NSData *)dict;
+/**
+ Encoder that compresses each entry with _workerCount_ zstd worker threads (`0` compresses on the calling thread).
+ Worth it for large entries, small ones are compressed the same as with a single thread.
+ */
++ (nullable id<NOZEncoder>)encoderWithDictionaryData:(nullable NSData *)dict workerCount:(NSUInteger)workerCount;
 + (nullable id<NOZDecoder>)decoder;
 + (nullable id<NOZDecoder>)decoderWithDictionaryData:(nullable NSData *)dict;
 
@@ -23,7 +23,7 @@ static int NOZXZStandardLevelFromNOZCompressionLevel(NOZCompressionLevel level);
 @property (nonatomic, readonly, copy, nonnull) NOZFlushCallback flushCallback;
 - (instancetype)initWithEncoder:(nonnull id<NOZEncoder>)encoder level:(int)level flushCallback:(NOZFlushCallback)callback;
 - (instancetype)init NS_UNAVAILABLE;
-- (BOOL)initializeWithDictionaryData:(NSData *)dictionaryData;
+- (BOOL)initializeWithDictionaryData:(NSData *)dictionaryData workerCount:(NSUInteger)workerCount;
 - (BOOL)encodeBytes:(const Byte*)bytes length:(size_t)length;
 - (BOOL)finalizeEncoding;
 @end
@@ -41,7 +41,8 @@ static int NOZXZStandardLevelFromNOZCompressionLevel(NOZCompressionLevel level);
 
 @interface NOZXZStandardEncoder : NSObject <NOZEncoder>
 @property (nonatomic, readonly, nullable) NSData *dictionaryData;
-- (instancetype)initWithDictionaryData:(nullable NSData *)dict;
+@property (nonatomic, readonly) NSUInteger workerCount;
+- (instancetype)initWithDictionaryData:(nullable NSData *)dict workerCount:(NSUInteger)workerCount;
 - (instancetype)init NS_UNAVAILABLE;
 @end
 
@@ -60,7 +61,12 @@ static int NOZXZStandardLevelFromNOZCompressionLevel(NOZCompressionLevel level);
 
 + (id<NOZEncoder>)encoderWithDictionaryData:(NSData *)dict
 {
-    return [[NOZXZStandardEncoder alloc] initWithDictionaryData:dict];
+    return [self encoderWithDictionaryData:dict workerCount:0];
+}
+
++ (id<NOZEncoder>)encoderWithDictionaryData:(NSData *)dict workerCount:(NSUInteger)workerCount
+{
+    return [[NOZXZStandardEncoder alloc] initWithDictionaryData:dict workerCount:workerCount];
 }
 
 + (id<NOZDecoder>)decoder
@@ -114,20 +120,19 @@ static int NOZXZStandardLevelFromNOZCompressionLevel(NOZCompressionLevel level);
     }
 }
 
-- (BOOL)initializeWithDictionaryData:(NSData *)dictionaryData
+- (BOOL)initializeWithDictionaryData:(NSData *)dictionaryData workerCount:(NSUInteger)workerCount
 {
     if (!_flags.initialized) {
-        size_t initResult = 0;
-        if (dictionaryData.length > 0) {
-            initResult = ZSTD_CCtx_reset(_stream, ZSTD_reset_session_only);
-            if (!ZSTD_isError(initResult)) {
-                initResult = ZSTD_CCtx_setParameter(_stream, ZSTD_c_compressionLevel, _level);
-                if (!ZSTD_isError(initResult)) {
-                    initResult = ZSTD_CCtx_loadDictionary(_stream, dictionaryData.bytes, dictionaryData.length);
-                }
-            }
-        } else {
-            initResult = ZSTD_initCStream(_stream, _level);
+        size_t initResult = ZSTD_CCtx_reset(_stream, ZSTD_reset_session_only);
+        if (!ZSTD_isError(initResult)) {
+            initResult = ZSTD_CCtx_setParameter(_stream, ZSTD_c_compressionLevel, _level);
+        }
+        if (!ZSTD_isError(initResult) && workerCount > 0) {
+            // fails when zstd is built without ZSTD_MULTITHREAD, just compress on the calling thread then
+            (void)ZSTD_CCtx_setParameter(_stream, ZSTD_c_nbWorkers, (int)MIN(workerCount, (NSUInteger)INT_MAX));
+        }
+        if (!ZSTD_isError(initResult) && dictionaryData.length > 0) {
+            initResult = ZSTD_CCtx_loadDictionary(_stream, dictionaryData.bytes, dictionaryData.length);
         }
 
         if (!ZSTD_isError(initResult)) {
@@ -156,14 +161,16 @@ static int NOZXZStandardLevelFromNOZCompressionLevel(NOZCompressionLevel level);
     inBuffer.pos = 0;
 
     while (!_flags.failureEncountered && inBuffer.pos < inBuffer.size) {
-        const size_t compressReturnValue = ZSTD_compressStream(_stream, &_outBuffer, &inBuffer);
+        const size_t compressReturnValue = ZSTD_compressStream2(_stream, &_outBuffer, &inBuffer, ZSTD_e_continue);
         if (ZSTD_isError(compressReturnValue)) {
             _flags.failureEncountered = 1;
             break;
         }
 
-        if (inBuffer.pos < inBuffer.size) {
-            [self flush:NO];
+        // Only write out a full buffer, flushing the stream would end the block (and stall any workers)
+        if (_outBuffer.pos == _outBuffer.size) {
+            _flags.failureEncountered = !_flushCallback(_encoder, self, _outBuffer.dst, _outBuffer.pos);
+            _outBuffer.pos = 0; // reset buffer
         }
     }
 
@@ -176,16 +183,10 @@ static int NOZXZStandardLevelFromNOZCompressionLevel(NOZCompressionLevel level);
         return NO;
     }
 
-    [self flush:YES];
-
-    return !_flags.failureEncountered;
-}
-
-- (void)flush:(BOOL)end
-{
     size_t remainingBytesToFlush = 0;
     do {
-        remainingBytesToFlush = (end) ? ZSTD_endStream(_stream, &_outBuffer) : ZSTD_flushStream(_stream, &_outBuffer);
+        ZSTD_inBuffer inBuffer = { NULL, 0, 0 };
+        remainingBytesToFlush = ZSTD_compressStream2(_stream, &_outBuffer, &inBuffer, ZSTD_e_end);
         if (ZSTD_isError(remainingBytesToFlush)) {
             _flags.failureEncountered = 1;
         } else if (_outBuffer.pos > 0) {
@@ -193,6 +194,8 @@ static int NOZXZStandardLevelFromNOZCompressionLevel(NOZCompressionLevel level);
             _outBuffer.pos = 0; // reset buffer
         }
     } while (!_flags.failureEncountered && remainingBytesToFlush > 0);
+
+    return !_flags.failureEncountered;
 }
 
 @end
@@ -209,10 +212,11 @@ static int NOZXZStandardLevelFromNOZCompressionLevel(NOZCompressionLevel level);
     return kZSTD_DEFAULT_LEVEL - 1; // zero indexed, so subtract 1
 }
 
-- (instancetype)initWithDictionaryData:(NSData *)dict
+- (instancetype)initWithDictionaryData:(NSData *)dict workerCount:(NSUInteger)workerCount
 {
     if (self = [super init]) {
         _dictionaryData = dict;
+        _workerCount = workerCount;
     }
     return self;
 }
@@ -231,7 +235,7 @@ static int NOZXZStandardLevelFromNOZCompressionLevel(NOZCompressionLevel level);
 
 - (BOOL)initializeEncoderContext:(id<NOZEncoderContext>)context
 {
-    return [(NOZXZStandardEncoderContext *)context initializeWithDictionaryData:_dictionaryData];
+    return [(NOZXZStandardEncoderContext *)context initializeWithDictionaryData:_dictionaryData workerCount:_workerCount];
 }
 
 - (BOOL)encodeBytes:(const Byte*)bytes
@@ -372,6 +376,30 @@ static int NOZXZStandardLevelFromNOZCompressionLevel(NOZCompressionLevel level);
     return [(NOZXZStandardDecoderContext *)context finalizeDecoding];
 }
 
+- (BOOL)decodeAllBytes:(const Byte*)bytes
+                length:(size_t)length
+              bitFlags:(UInt16)flags
+            intoBuffer:(Byte*)buffer
+              capacity:(size_t)capacity
+         decodedLength:(size_t *)decodedLength
+{
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (!dctx) {
+        return NO;
+    }
+
+    const size_t decompressReturnValue = (_dictionaryData.length > 0) ?
+        ZSTD_decompress_usingDict(dctx, buffer, capacity, bytes, length, _dictionaryData.bytes, _dictionaryData.length) :
+        ZSTD_decompressDCtx(dctx, buffer, capacity, bytes, length);
+    ZSTD_freeDCtx(dctx);
+    if (ZSTD_isError(decompressReturnValue)) {
+        return NO;
+    }
+
+    *decodedLength = decompressReturnValue;
+    return YES;
+}
+
 @end
 
 static int NOZXZStandardLevelFromNOZCompressionLevel(NOZCompressionLevel level)
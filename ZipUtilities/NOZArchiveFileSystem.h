@@ -0,0 +1,165 @@
+//
+//  NOZArchiveFileSystem.h
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import <ZipUtilities/NOZUnzipper.h>
+
+@class NOZArchiveFileSystemItem;
+@class NOZArchiveFile;
+
+//! The default size of the decompressed blocks cached by `NOZArchiveFileSystem` (64KB)
+static const NSUInteger NOZArchiveFileSystemDefaultBlockSize = 64 * 1024;
+//! The default byte budget of the decompressed block cache of `NOZArchiveFileSystem` (32MB)
+static const NSUInteger NOZArchiveFileSystemDefaultCacheByteLimit = 32 * 1024 * 1024;
+
+/**
+ `NOZArchiveFileSystem` is a read only file system over the entries of an archive.
+
+ Paths are entry names relative to the root of the archive, without a leading `"/"` (the root directory is `""`).
+ Directories are inferred from entry names, so a directory exists if any entry is nested within it even without its own entry.
+
+ File data is decompressed in fixed size blocks that are kept in a least recently used cache bounded by `cacheByteLimit`,
+ so repeated reads of hot files are served from memory without decompressing (or extracting) anything.
+ Reads within large deflated files resume decompressing from the nearest checkpoint of a `NOZCheckpointIndex`
+ that is built the first time the file is read.
+
+ ### Thread Safety
+
+ Once opened, every method (and every `NOZArchiveFile`) can be used concurrently from multiple threads and the block cache is shared between them.
+ Opening and closing must not overlap with any other call.
+ */
+@interface NOZArchiveFileSystem : NSObject
+
+/** The path to the zip archive */
+@property (nonatomic, readonly, nonnull) NSString *zipFilePath;
+/** The number of uncompressed bytes per cached block */
+@property (nonatomic, readonly) NSUInteger blockSize;
+/** The maximum number of decompressed bytes to cache */
+@property (nonatomic, readonly) NSUInteger cacheByteLimit;
+/** The number of decompressed bytes currently cached */
+@property (nonatomic, readonly) NSUInteger cachedByteCount;
+
+/** Initialize with `NOZArchiveFileSystemDefaultBlockSize` and `NOZArchiveFileSystemDefaultCacheByteLimit` */
+- (nonnull instancetype)initWithZipFile:(nonnull NSString *)zipFilePath;
+/** Designated initializer.  `0` for _blockSize_ or _cacheByteLimit_ uses the default. */
+- (nonnull instancetype)initWithZipFile:(nonnull NSString *)zipFilePath
+                              blockSize:(NSUInteger)blockSize
+                         cacheByteLimit:(NSUInteger)cacheByteLimit NS_DESIGNATED_INITIALIZER;
+
+/** Unavailable */
+- (nonnull instancetype)init NS_UNAVAILABLE;
+/** Unavailable */
++ (nonnull instancetype)new NS_UNAVAILABLE;
+
+/**
+ Open the archive and read its central directory.
+ Opened with `NOZUnzipperOpenOptionSharedCentralDirectoryCache`, so file systems over the same archive share its parsed central directory.
+ */
+- (BOOL)openAndReturnError:(out NSError * __nullable * __nullable)error;
+
+/**
+ Close the archive and purge the block cache.
+ Harmless to call redundantly.
+ */
+- (BOOL)closeAndReturnError:(out NSError * __nullable * __nullable)error;
+
+/**
+ Get the item at _path_ (like `stat`).
+ */
+- (nullable NOZArchiveFileSystemItem *)itemAtPath:(nonnull NSString *)path
+                                            error:(out NSError * __nullable * __nullable)error;
+
+/**
+ List the items within the directory at _path_ (not recursive), sorted by name.
+ */
+- (nullable NSArray<NOZArchiveFileSystemItem *> *)contentsOfDirectoryAtPath:(nonnull NSString *)path
+                                                                      error:(out NSError * __nullable * __nullable)error;
+
+/**
+ Open the file at _path_ for reading.
+ */
+- (nullable NOZArchiveFile *)openFileAtPath:(nonnull NSString *)path
+                                      error:(out NSError * __nullable * __nullable)error;
+
+/**
+ Read _length_ bytes at _offset_ of the file at _path_.
+ See `-[NOZArchiveFile readDataOfLength:atOffset:error:]`.
+ */
+- (nullable NSData *)readDataAtPath:(nonnull NSString *)path
+                             offset:(UInt64)offset
+                             length:(NSUInteger)length
+                              error:(out NSError * __nullable * __nullable)error;
+
+/** Evict all cached blocks */
+- (void)purgeCache;
+
+@end
+
+/**
+ An item (file or directory) of a `NOZArchiveFileSystem`.
+ */
+@interface NOZArchiveFileSystemItem : NSObject
+/** The path of the item */
+@property (nonatomic, readonly, nonnull) NSString *path;
+/** The last path component of the item */
+@property (nonatomic, readonly, nonnull) NSString *name;
+/** Whether the item is a directory */
+@property (nonatomic, readonly, getter=isDirectory) BOOL directory;
+/** The (uncompressed) size of the file, `0` for directories */
+@property (nonatomic, readonly) UInt64 size;
+/** The compressed size of the file, `0` for directories */
+@property (nonatomic, readonly) UInt64 compressedSize;
+/** The record backing the item, `nil` for directories that have no entry of their own */
+@property (nonatomic, readonly, nullable) NOZCentralDirectoryRecord *record;
+
+/** Unavailable */
+- (nonnull instancetype)init NS_UNAVAILABLE;
+/** Unavailable */
++ (nonnull instancetype)new NS_UNAVAILABLE;
+@end
+
+/**
+ A file of a `NOZArchiveFileSystem` opened for reading (like a file descriptor, but without a position).
+ */
+@interface NOZArchiveFile : NSObject
+/** The file's item */
+@property (nonatomic, readonly, nonnull) NOZArchiveFileSystemItem *item;
+
+/**
+ Read up to _length_ bytes at _offset_ (like `pread`).
+ Fewer bytes are returned when reading past the end of the file, and empty data is returned at (or beyond) the end of the file.
+ */
+- (nullable NSData *)readDataOfLength:(NSUInteger)length
+                             atOffset:(UInt64)offset
+                                error:(out NSError * __nullable * __nullable)error;
+
+/** Unavailable */
+- (nonnull instancetype)init NS_UNAVAILABLE;
+/** Unavailable */
++ (nonnull instancetype)new NS_UNAVAILABLE;
+@end
@@ -0,0 +1,540 @@
+//
+//  NOZArchiveFileSystem.m
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include <pthread.h>
+
+#import "NOZ_Project.h"
+#import "NOZArchiveFileSystem.h"
+#import "NOZError.h"
+#import "NOZLRUCache.h"
+
+typedef struct _NOZArchiveBlockKeyT
+{
+    UInt64 fileIdentifier;
+    UInt64 blockIndex;
+} NOZArchiveBlockKeyT;
+
+static NSString *noz_normalized_path(NSString *path);
+
+NS_INLINE BOOL noz_item_needs_checkpoint_index(NOZArchiveFileSystemItem *item)
+{
+    // Only large deflated files benefit, everything else is read directly (stored) or quickly decompressed from the start
+    return item.record.compressionMethod == NOZCompressionMethodDeflate && item.size > (UInt64)NOZCheckpointIndexDefaultInterval;
+}
+
+/**
+ The checkpoint index of an item, built once by the first reader that needs it
+ (readers of the same item wait on `_buildMutex` for it, readers of other items don't)
+ */
+@interface NOZArchiveCheckpointIndexEntry : NSObject
+{
+@public
+    pthread_mutex_t _buildMutex;
+    NOZCheckpointIndex *_checkpointIndex;
+}
+@end
+
+@implementation NOZArchiveCheckpointIndexEntry
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        pthread_mutex_init(&_buildMutex, NULL);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_buildMutex);
+}
+
+@end
+
+@interface NOZArchiveFileSystemItem ()
+- (instancetype)initWithPath:(NSString *)path
+                      record:(nullable NOZCentralDirectoryRecord *)record
+                   directory:(BOOL)directory
+              fileIdentifier:(NSUInteger)fileIdentifier;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZArchiveFileSystemItem (/* direct declarations */)
+- (NSUInteger)private_fileIdentifier;
+@end
+
+@interface NOZArchiveFile ()
+- (instancetype)initWithFileSystem:(NOZArchiveFileSystem *)fileSystem item:(NOZArchiveFileSystemItem *)item;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZArchiveFileSystem (/* direct declarations */)
+- (void)private_buildTree;
+- (nullable NOZArchiveFileSystemItem *)private_itemAtPath:(NSString *)path error:(out NSError **)error;
+- (nullable NSData *)private_readDataOfItem:(NOZArchiveFileSystemItem *)item
+                                     offset:(UInt64)offset
+                                     length:(NSUInteger)length
+                                      error:(out NSError **)error;
+- (nullable NSData *)private_blockAtIndex:(UInt64)blockIndex
+                                   ofItem:(NOZArchiveFileSystemItem *)item
+                    readAheadThroughBlock:(UInt64)lastBlockIndex
+                                    error:(out NSError **)error;
+- (nullable NOZCheckpointIndex *)private_checkpointIndexForItem:(NOZArchiveFileSystemItem *)item
+                                                          error:(out NSError **)error;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZArchiveFileSystem
+{
+    NOZUnzipper *_unzipper;
+    NSDictionary<NSString *, NOZArchiveFileSystemItem *> *_items;
+    NSDictionary<NSString *, NSArray<NOZArchiveFileSystemItem *> *> *_directoryContents;
+    NOZLRUCache<NSData *, NSData *> *_blockCache;
+
+    pthread_mutex_t _checkpointIndexMutex; // guards _checkpointIndexes only, indexes are built outside of it
+    NSMutableDictionary<NSNumber *, NOZArchiveCheckpointIndexEntry *> *_checkpointIndexes;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_checkpointIndexMutex);
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithZipFile:(NSString *)zipFilePath
+{
+    return [self initWithZipFile:zipFilePath blockSize:0 cacheByteLimit:0];
+}
+
+- (instancetype)initWithZipFile:(NSString *)zipFilePath
+                      blockSize:(NSUInteger)blockSize
+                 cacheByteLimit:(NSUInteger)cacheByteLimit
+{
+    if (self = [super init]) {
+        _zipFilePath = [zipFilePath copy];
+        _blockSize = (blockSize) ?: NOZArchiveFileSystemDefaultBlockSize;
+        _cacheByteLimit = (cacheByteLimit) ?: NOZArchiveFileSystemDefaultCacheByteLimit;
+        _blockCache = [[NOZLRUCache alloc] initWithTotalCostLimit:_cacheByteLimit];
+        pthread_mutex_init(&_checkpointIndexMutex, NULL);
+        _checkpointIndexes = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (NSUInteger)cachedByteCount
+{
+    return _blockCache.totalCost;
+}
+
+- (BOOL)openAndReturnError:(out NSError **)error
+{
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:_zipFilePath];
+    if (![unzipper openWithOptions:NOZUnzipperOpenOptionSharedCentralDirectoryCache error:error]) {
+        return NO;
+    }
+    if (![unzipper readCentralDirectoryAndReturnError:error]) {
+        [unzipper closeAndReturnError:NULL];
+        return NO;
+    }
+
+    _unzipper = unzipper;
+    [self private_buildTree];
+    return YES;
+}
+
+- (BOOL)closeAndReturnError:(out NSError **)error
+{
+    [self purgeCache];
+    pthread_mutex_lock(&_checkpointIndexMutex);
+    [_checkpointIndexes removeAllObjects];
+    pthread_mutex_unlock(&_checkpointIndexMutex);
+    _items = nil;
+    _directoryContents = nil;
+
+    NOZUnzipper *unzipper = _unzipper;
+    _unzipper = nil;
+    return (unzipper) ? [unzipper closeAndReturnError:error] : YES;
+}
+
+- (NOZArchiveFileSystemItem *)itemAtPath:(NSString *)path error:(out NSError **)error
+{
+    return [self private_itemAtPath:path error:error];
+}
+
+- (NSArray<NOZArchiveFileSystemItem *> *)contentsOfDirectoryAtPath:(NSString *)path error:(out NSError **)error
+{
+    NOZArchiveFileSystemItem *item = [self private_itemAtPath:path error:error];
+    if (!item) {
+        return nil;
+    }
+
+    if (!item.isDirectory) {
+        if (error) {
+            *error = NOZErrorCreate(NOZErrorCodeUnzipArchiveFileSystemItemIsNotDirectory, @{ @"path" : path });
+        }
+        return nil;
+    }
+
+    return _directoryContents[item.path] ?: @[];
+}
+
+- (NOZArchiveFile *)openFileAtPath:(NSString *)path error:(out NSError **)error
+{
+    NOZArchiveFileSystemItem *item = [self private_itemAtPath:path error:error];
+    if (!item) {
+        return nil;
+    }
+
+    if (item.isDirectory) {
+        if (error) {
+            *error = NOZErrorCreate(NOZErrorCodeUnzipArchiveFileSystemItemIsDirectory, @{ @"path" : path });
+        }
+        return nil;
+    }
+
+    return [[NOZArchiveFile alloc] initWithFileSystem:self item:item];
+}
+
+- (NSData *)readDataAtPath:(NSString *)path offset:(UInt64)offset length:(NSUInteger)length error:(out NSError **)error
+{
+    return [[self openFileAtPath:path error:error] readDataOfLength:length atOffset:offset error:error];
+}
+
+- (void)purgeCache
+{
+    [_blockCache removeAllObjects];
+}
+
+#pragma mark Private
+
+- (void)private_buildTree
+{
+    NSMutableDictionary<NSString *, NOZArchiveFileSystemItem *> *items = [[NSMutableDictionary alloc] init];
+    NSMutableDictionary<NSString *, NSMutableArray<NOZArchiveFileSystemItem *> *> *directoryContents = [[NSMutableDictionary alloc] init];
+
+    NOZArchiveFileSystemItem *root = [[NOZArchiveFileSystemItem alloc] initWithPath:@"" record:nil directory:YES fileIdentifier:NSNotFound];
+    items[@""] = root;
+    directoryContents[@""] = [[NSMutableArray alloc] init];
+
+    const NSUInteger recordCount = _unzipper.centralDirectory.recordCount;
+    for (NSUInteger i = 0; i < recordCount; i++) {
+        @autoreleasepool {
+            NOZCentralDirectoryRecord *record = [_unzipper readRecordAtIndex:i error:NULL];
+            NSString *path = noz_normalized_path(record.name);
+            if (!path.length) {
+                continue;
+            }
+
+            NOZArchiveFileSystemItem *item = [[NOZArchiveFileSystemItem alloc] initWithPath:path
+                                                                                     record:record
+                                                                                  directory:record.isDirectory
+                                                                             fileIdentifier:i];
+            NOZArchiveFileSystemItem *existingItem = items[path];
+            if (existingItem) {
+                // Duplicate names resolve to the first record (like indexForRecordWithName:),
+                // but an explicit directory record replaces a directory that was inferred from a nested entry
+                if (existingItem.record || !existingItem.isDirectory || !item.isDirectory) {
+                    continue;
+                }
+                NSMutableArray<NOZArchiveFileSystemItem *> *siblings = directoryContents[path.stringByDeletingLastPathComponent];
+                const NSUInteger siblingIndex = [siblings indexOfObjectIdenticalTo:existingItem];
+                if (siblingIndex != NSNotFound) {
+                    [siblings replaceObjectAtIndex:siblingIndex withObject:item];
+                }
+                items[path] = item;
+                continue;
+            }
+
+            // Add the item along with any missing ancestor directories
+
+            while (item) {
+                items[item.path] = item;
+                if (item.isDirectory && !directoryContents[item.path]) {
+                    directoryContents[item.path] = [[NSMutableArray alloc] init];
+                }
+
+                NSString *parentPath = item.path.stringByDeletingLastPathComponent;
+                [directoryContents[parentPath] addObject:item];
+                if (items[parentPath]) {
+                    break;
+                }
+
+                NOZArchiveFileSystemItem *parent = [[NOZArchiveFileSystemItem alloc] initWithPath:parentPath record:nil directory:YES fileIdentifier:NSNotFound];
+                directoryContents[parentPath] = [[NSMutableArray alloc] initWithObjects:item, nil];
+                item = parent;
+            }
+        }
+    }
+
+    for (NSMutableArray<NOZArchiveFileSystemItem *> *contents in directoryContents.objectEnumerator) {
+        [contents sortUsingComparator:^NSComparisonResult(NOZArchiveFileSystemItem *item1, NOZArchiveFileSystemItem *item2) {
+            return [item1.name compare:item2.name];
+        }];
+    }
+
+    _items = [items copy];
+    _directoryContents = [directoryContents copy];
+}
+
+- (NOZArchiveFileSystemItem *)private_itemAtPath:(NSString *)path error:(out NSError **)error
+{
+    if (!_unzipper) {
+        if (error) {
+            *error = NOZErrorCreate(NOZErrorCodeUnzipMustOpenUnzipperBeforeManipulating, nil);
+        }
+        return nil;
+    }
+
+    NOZArchiveFileSystemItem *item = _items[noz_normalized_path(path)];
+    if (!item && error) {
+        *error = NOZErrorCreate(NOZErrorCodeUnzipArchiveFileSystemNoSuchItem, @{ @"path" : path });
+    }
+    return item;
+}
+
+- (NSData *)private_readDataOfItem:(NOZArchiveFileSystemItem *)item
+                            offset:(UInt64)offset
+                            length:(NSUInteger)length
+                             error:(out NSError **)error
+{
+    if (!_unzipper) {
+        if (error) {
+            *error = NOZErrorCreate(NOZErrorCodeUnzipMustOpenUnzipperBeforeManipulating, nil);
+        }
+        return nil;
+    }
+
+    const UInt64 size = item.size;
+    if (offset >= size || 0 == length) {
+        return [NSData data];
+    }
+
+    const UInt64 end = ((UInt64)length > (size - offset)) ? size : offset + (UInt64)length;
+    const UInt64 firstBlockIndex = offset / _blockSize;
+    const UInt64 lastBlockIndex = (end - 1) / _blockSize;
+
+    NSMutableData *data = [[NSMutableData alloc] initWithCapacity:(NSUInteger)(end - offset)];
+    for (UInt64 blockIndex = firstBlockIndex; blockIndex <= lastBlockIndex; blockIndex++) {
+        NSData *block = [self private_blockAtIndex:blockIndex ofItem:item readAheadThroughBlock:lastBlockIndex error:error];
+        if (!block) {
+            return nil;
+        }
+
+        const UInt64 blockStart = blockIndex * _blockSize;
+        const UInt64 copyStart = MAX(offset, blockStart) - blockStart;
+        const UInt64 copyEnd = MIN(end, blockStart + block.length) - blockStart;
+        [data appendBytes:(const Byte *)block.bytes + copyStart length:(NSUInteger)(copyEnd - copyStart)];
+    }
+
+    return data;
+}
+
+- (NSData *)private_blockAtIndex:(UInt64)blockIndex
+                          ofItem:(NOZArchiveFileSystemItem *)item
+           readAheadThroughBlock:(UInt64)lastBlockIndex
+                           error:(out NSError **)error
+{
+    NOZArchiveBlockKeyT key;
+    key.fileIdentifier = (UInt64)[item private_fileIdentifier];
+    key.blockIndex = blockIndex;
+    NSData *block = [_blockCache objectForKey:[[NSData alloc] initWithBytesNoCopy:&key length:sizeof(key) freeWhenDone:NO]];
+    if (block) {
+        return block;
+    }
+
+    // Decompress from the missing block through the last block being read (decompressing is sequential,
+    // so each miss of a single block would otherwise decompress everything preceding it again)
+
+    NOZCheckpointIndex *checkpointIndex = nil;
+    if (noz_item_needs_checkpoint_index(item)) {
+        checkpointIndex = [self private_checkpointIndexForItem:item error:error];
+        if (!checkpointIndex) {
+            return nil;
+        }
+    }
+
+    const NSUInteger blockSize = _blockSize;
+    const UInt64 size = item.size;
+    const UInt64 start = blockIndex * blockSize;
+    const UInt64 end = MIN(size, (lastBlockIndex + 1) * blockSize);
+    NOZLRUCache<NSData *, NSData *> *blockCache = _blockCache;
+
+    __block NSData *requestedBlock = nil;
+    __block NSMutableData *currentBlock = nil;
+    __block UInt64 currentBlockIndex = blockIndex;
+    void (^finishBlock)(void) = ^{
+        NOZArchiveBlockKeyT blockKey = key;
+        blockKey.blockIndex = currentBlockIndex;
+        [blockCache setObject:currentBlock forKey:[[NSData alloc] initWithBytes:&blockKey length:sizeof(blockKey)] cost:currentBlock.length];
+        if (currentBlockIndex == blockIndex) {
+            requestedBlock = currentBlock;
+        }
+        currentBlock = nil;
+        currentBlockIndex++;
+    };
+
+    const BOOL success = [_unzipper enumerateByteRangesOfRecord:item.record
+                                                          range:NSMakeRange((NSUInteger)start, (NSUInteger)(end - start))
+                                                checkpointIndex:checkpointIndex
+                                                     usingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+        const Byte *cursor = bytes;
+        NSUInteger remaining = byteRange.length;
+        while (remaining > 0) {
+            const UInt64 blockEnd = MIN(size, (currentBlockIndex + 1) * blockSize);
+            if (!currentBlock) {
+                currentBlock = [[NSMutableData alloc] initWithCapacity:(NSUInteger)(blockEnd - currentBlockIndex * blockSize)];
+            }
+            const NSUInteger length = MIN(remaining, (NSUInteger)(blockEnd - currentBlockIndex * blockSize) - currentBlock.length);
+            [currentBlock appendBytes:cursor length:length];
+            cursor += length;
+            remaining -= length;
+            if ((currentBlockIndex * blockSize + currentBlock.length) == blockEnd) {
+                finishBlock();
+            }
+        }
+    }
+                                                          error:error];
+    if (!success) {
+        return nil;
+    }
+
+    if (!requestedBlock) {
+        // the record decompressed to fewer bytes than its size
+        if (error) {
+            *error = NOZErrorCreate(NOZErrorCodeUnzipFailedToDecompressEntry, @{ @"path" : item.path });
+        }
+        return nil;
+    }
+
+    return requestedBlock;
+}
+
+- (NOZCheckpointIndex *)private_checkpointIndexForItem:(NOZArchiveFileSystemItem *)item error:(out NSError **)error
+{
+    // Building decompresses the whole file, so it's done holding only the item's lock:
+    // concurrent readers of the same file wait for it rather than each decompressing it, readers of other files carry on
+
+    NSNumber *key = @([item private_fileIdentifier]);
+    pthread_mutex_lock(&_checkpointIndexMutex);
+    NOZArchiveCheckpointIndexEntry *entry = _checkpointIndexes[key];
+    if (!entry) {
+        entry = [[NOZArchiveCheckpointIndexEntry alloc] init];
+        _checkpointIndexes[key] = entry;
+    }
+    pthread_mutex_unlock(&_checkpointIndexMutex);
+
+    pthread_mutex_lock(&entry->_buildMutex);
+    noz_defer(^{ pthread_mutex_unlock(&entry->_buildMutex); });
+
+    if (!entry->_checkpointIndex) {
+        // a failed build is left for the next reader to retry
+        entry->_checkpointIndex = [_unzipper buildCheckpointIndexForRecord:item.record
+                                                        checkpointInterval:NOZCheckpointIndexDefaultInterval
+                                                             progressBlock:NULL
+                                                                     error:error];
+    }
+    return entry->_checkpointIndex;
+}
+
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZArchiveFileSystemItem
+{
+    NSUInteger _fileIdentifier;
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithPath:(NSString *)path
+                      record:(NOZCentralDirectoryRecord *)record
+                   directory:(BOOL)directory
+              fileIdentifier:(NSUInteger)fileIdentifier
+{
+    if (self = [super init]) {
+        _path = [path copy];
+        _name = path.lastPathComponent;
+        _record = record;
+        _directory = directory;
+        _fileIdentifier = fileIdentifier;
+        if (!directory) {
+            _size = (UInt64)record.uncompressedSize;
+            _compressedSize = (UInt64)record.compressedSize;
+        }
+    }
+    return self;
+}
+
+- (NSUInteger)private_fileIdentifier
+{
+    return _fileIdentifier;
+}
+
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZArchiveFile
+{
+    NOZArchiveFileSystem *_fileSystem;
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithFileSystem:(NOZArchiveFileSystem *)fileSystem item:(NOZArchiveFileSystemItem *)item
+{
+    if (self = [super init]) {
+        _fileSystem = fileSystem;
+        _item = item;
+    }
+    return self;
+}
+
+- (NSData *)readDataOfLength:(NSUInteger)length atOffset:(UInt64)offset error:(out NSError **)error
+{
+    return [_fileSystem private_readDataOfItem:_item offset:offset length:length error:error];
+}
+
+@end
+
+static NSString *noz_normalized_path(NSString *path)
+{
+    path = [path stringByTrimmingCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@"/"]];
+    return ([path isEqualToString:@"."]) ? @"" : path;
+}
@@ -129,6 +129,13 @@ typedef BOOL(^NOZCompressionShouldExcludeFileBlock)(NSString* filePath);
 @property (nonatomic, readonly) SInt64 totalSizeOfUncompressedEntries;
 /** A comment embedded in the resulting zip file */
 @property (nonatomic, copy, nullable) NSString *comment;
+/**
+ The maximum number of entries to compress concurrently.
+ Entries are still written in order, the resulting archive is the same as when compressing serially.
+ Default is `1` (serial).  `0` will use the number of active processors.
+ See `-[NOZZipper addEntries:maxConcurrentEntries:progressBlock:error:]`.
+ */
+@property (nonatomic) NSUInteger maxConcurrentZipCount;
 
 /** Add an object conforming to `NOZZippableEntry` */
 - (void)addEntry:(id<NOZZippableEntry>)entry;
@@ -261,6 +261,10 @@ NOZ_OBJC_DIRECT_MEMBERS
 {
     NSError *error = NOZErrorCreate(NOZErrorCodeCompressNoEntriesToCompress, nil);
     NSArray<id<NOZZippableEntry>> *entries = _request.entries; // deep copy
+    if (_request.maxConcurrentZipCount != 1 && entries.count > 1) {
+        return [self private_addEntriesConcurrently:entries];
+    }
+
     for (id<NOZZippableEntry> entry in entries) {
         @autoreleasepool {
             if (self.isCancelled) {
@@ -292,18 +296,63 @@ NOZ_OBJC_DIRECT_MEMBERS
 
 #pragma mark Helpers
 
-- (NSError *)private_addEntry:(id<NOZZippableEntry>)entry
+- (NSError *)private_validateEntry:(id<NOZZippableEntry>)entry
 {
-    // Start
     if (!entry.name) {
         return NOZErrorCreate(NOZErrorCodeCompressMissingEntryName, @{ @"entry" : entry });
     }
     if (!entry.canBeZipped) {
         return NOZErrorCreate(NOZErrorCodeCompressEntryCannotBeZipped, @{ @"entry" : entry });
     }
+    return nil;
+}
+
+- (NSError *)private_addEntriesConcurrently:(NSArray<id<NOZZippableEntry>> *)entries
+{
+    for (id<NOZZippableEntry> entry in entries) {
+        NSError *error = [self private_validateEntry:entry];
+        if (error) {
+            return error;
+        }
+    }
+
+    if (self.isCancelled) {
+        return kCancelledError;
+    }
 
     NSError *error = nil;
 
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Warc-retain-cycles"
+
+    [_zipper addEntries:entries
+   maxConcurrentEntries:_request.maxConcurrentZipCount
+          progressBlock:^(SInt64 totalBytesToWrite, SInt64 bytesWritten, SInt64 bytesThisPass, BOOL *abort) {
+              // calls are serialized by the zipper
+              [self private_didCompressBytes:bytesThisPass];
+              if (self.isCancelled) {
+                  *abort = YES;
+              }
+          }
+                  error:&error];
+
+#pragma clang diagnostic pop
+
+    if (error) {
+        return NOZErrorCreate(NOZErrorCodeCompressFailedToAppendEntryToZip, @{ NSUnderlyingErrorKey : error });
+    }
+
+    return nil;
+}
+
+- (NSError *)private_addEntry:(id<NOZZippableEntry>)entry
+{
+    // Start
+    NSError *error = [self private_validateEntry:entry];
+    if (error) {
+        return error;
+    }
+
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Warc-retain-cycles"
 
@@ -416,6 +465,7 @@ NOZ_OBJC_DIRECT_MEMBERS
     if (self = [super init]) {
         _destinationPath = [path copy];
         _mutableEntries = [[NSMutableArray alloc] init];
+        _maxConcurrentZipCount = 1;
     }
     return self;
 }
@@ -425,6 +475,7 @@ NOZ_OBJC_DIRECT_MEMBERS
     NOZCompressRequest *copy = [[[self class] allocWithZone:zone] initWithDestinationPath:self.destinationPath];
     copy.destinationPath = self.destinationPath;
     copy.comment = self.comment;
+    copy.maxConcurrentZipCount = self.maxConcurrentZipCount;
     copy->_mutableEntries = [self.entries mutableCopy];
     return copy;
 }
@@ -124,3 +124,16 @@ typedef BOOL(^NOZFlushCallback)(id __nonnull coder,
                                 id __nonnull context,
                                 const Byte* __nonnull bufferToFlush,
                                 size_t length);
+
+/**
+ Create a deflate encoder that splits the data of each entry into blocks of _blockSize_ bytes and compresses
+ up to _maxConcurrentBlocks_ of them concurrently.
+ Each block is primed with the 32KB of input preceding it, so the output remains a single valid deflate stream
+ with a ratio close to that of the default encoder.  Memory use is bounded by roughly `blockSize * maxConcurrentBlocks`.
+ Entries that fit in a single block are compressed as one stream, just like with the default encoder.
+ Register it for `NOZCompressionMethodDeflate` with `NOZCompressionLibrary` to speed up compressing large entries.
+ @param blockSize The number of bytes per block, clamped between 64KB and 64MB.  128KB to 1MB is a good range.
+ @param maxConcurrentBlocks The maximum number of blocks to compress concurrently.  `0` will use the number of active processors.
+ */
+FOUNDATION_EXTERN id<NOZEncoder> __nonnull NOZDeflateEncoderWithConcurrentBlocks(size_t blockSize,
+                                                                                 NSUInteger maxConcurrentBlocks);
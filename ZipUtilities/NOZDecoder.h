@@ -84,4 +84,25 @@
  */
 - (BOOL)finalizeDecoderContext:(nonnull id<NOZDecoderContext>)context;
 
+@optional
+
+/**
+ Decode all the compressed bytes of an entry at once, straight into _buffer_.
+ Implementing this lets an entry whose compressed bytes are all in memory be decoded without a context,
+ flushes or intermediate buffers (see `-[NOZUnzipper readDataFromRecord:progressBlock:error:]`).
+ @param bytes all of the compressed bytes of the entry
+ @param length the length of _bytes_
+ @param flags the bit flags of the entry
+ @param buffer the buffer to decode into
+ @param capacity the size of _buffer_, which is the uncompressed size of the entry
+ @param decodedLength the number of bytes that were decoded into _buffer_
+ @return `NO` if the bytes could not be completely decoded within _capacity_ (the entry is then decoded through a context instead)
+ */
+- (BOOL)decodeAllBytes:(nonnull const Byte*)bytes
+                length:(size_t)length
+              bitFlags:(UInt16)flags
+            intoBuffer:(nonnull Byte*)buffer
+              capacity:(size_t)capacity
+         decodedLength:(nonnull size_t *)decodedLength;
+
 @end
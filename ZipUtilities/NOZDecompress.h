@@ -130,6 +130,19 @@ typedef void(^NOZDecompressCompletionBlock)(NOZDecompressOperation * op,
 @property (nonatomic, copy, readonly, nullable) NSString *destinationDirectoryPath;
 /** The source zip archive to decompress */
 @property (nonatomic, copy, readonly) NSString *sourceFilePath;
+/**
+ The maximum number of entries to unzip concurrently.
+ Entries are scheduled largest (compressed size) first.
+ Default is `1` (serial).  `0` will use the number of active processors.
+ When greater than `1`, `NOZDecompressDelegate` overwrite checks can be called from multiple threads.
+ */
+@property (nonatomic) NSUInteger maxConcurrentUnzipCount;
+/**
+ Trust the archive and skip validating the checksum of stored entries, which are then copied by the kernel straight from the archive to their files.
+ Applies to stored entries only (they are copied without decoding), entries of any other method are still validated as they are decoded.
+ Default is `NO`.  See `NOZUnzipperSaveRecordOptionSkipChecksumValidation`.
+ */
+@property (nonatomic) BOOL skipsChecksumValidation;
 
 /**
  Designated initializer
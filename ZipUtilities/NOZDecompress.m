@@ -25,6 +25,9 @@
 //  SOFTWARE.
 //
 
+#include <pthread.h>
+#include <stdatomic.h>
+
 #import "NOZ_Project.h"
 #import "NOZDecompress.h"
 #import "NOZUnzipper.h"
@@ -40,6 +43,13 @@ typedef NS_ENUM(NSUInteger, NOZDecompressStep)
     NOZDecompressStepClose,
 };
 
+typedef NS_ENUM(UInt8, NOZDecompressEntryState)
+{
+    NOZDecompressEntryStatePending = 0,
+    NOZDecompressEntryStatePartial,     // started writing, but did not complete
+    NOZDecompressEntryStateCompleted,
+};
+
 #define kCancelledError NOZErrorCreate(NOZErrorCodeDecompressCancelled, nil)
 
 NOZ_OBJC_DIRECT_MEMBERS
@@ -79,6 +89,8 @@ NOZ_OBJC_DIRECT_MEMBERS
     SInt64 _expectedUncompressedSize;
     SInt64 _bytesUncompressed;
     NSMutableArray<NSString *> *_entryPaths;
+    NSMutableArray<NSString *> *_partialEntryPaths;
+    pthread_mutex_t _progressMutex;
 
     struct {
         BOOL delegateUpdatesProgress:1;
@@ -92,6 +104,11 @@ NOZ_OBJC_DIRECT_MEMBERS
     abort();
 }
 
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_progressMutex);
+}
+
 - (id<NOZDecompressDelegate>)delegate
 {
     return _weakDelegate;
@@ -111,6 +128,7 @@ NOZ_OBJC_DIRECT_MEMBERS
         }
         _weakDelegate = delegate;
         _request = [request copy];
+        pthread_mutex_init(&_progressMutex, NULL);
         _flags.delegateUpdatesProgress = !![delegate respondsToSelector:@selector(decompressOperation:didUpdateProgress:)];
         _flags.delegateHasOverwriteCheck = !![delegate respondsToSelector:@selector(shouldDecompressOperation:overwriteFileAtPath:)];
     }
@@ -207,8 +225,8 @@ NOZ_OBJC_DIRECT_MEMBERS
 
         // cleanup anything necessary
         [self private_closeFile];
-        for (NSString *filePath in _entryPaths) {
-            [fm removeItemAtPath:filePath error:NULL];
+        for (NSString *filePath in [_entryPaths arrayByAddingObjectsFromArray:_partialEntryPaths]) {
+            [fm removeItemAtPath:[_sanitizedDestinationDirectoryPath stringByAppendingPathComponent:filePath] error:NULL];
         }
     } else {
         result.didSucceed = YES;
@@ -234,7 +252,7 @@ NOZ_OBJC_DIRECT_MEMBERS
 
     NSError *error = nil;
     _unzipper = [[NOZUnzipper alloc] initWithZipFile:_request.sourceFilePath];
-    if (![_unzipper openAndReturnError:&error]) {
+    if (![_unzipper openWithOptions:NOZUnzipperOpenOptionSequentialAccess error:&error]) {
         return NOZErrorCreate(NOZErrorCodeDecompressFailedToOpenZipArchive, @{ NSUnderlyingErrorKey : error });
     }
 
@@ -264,13 +282,14 @@ NOZ_OBJC_DIRECT_MEMBERS
     _expectedUncompressedSize = _unzipper.centralDirectory.totalUncompressedSize;
 
     _entryPaths = [[NSMutableArray alloc] initWithCapacity:_expectedEntryCount];
+    _partialEntryPaths = [[NSMutableArray alloc] init];
 
     return nil;
 }
 
 - (NSError *)private_unzipAllEntries
 {
-    __block NSError *stackError = nil;
+    NSMutableArray<NOZCentralDirectoryRecord *> *records = [[NSMutableArray alloc] initWithCapacity:_expectedEntryCount];
     [_unzipper enumerateManifestEntriesUsingBlock:^(NOZCentralDirectoryRecord * __nonnull record,
                                                     NSUInteger index,
                                                     BOOL * __nonnull stop) {
@@ -280,48 +299,179 @@ NOZ_OBJC_DIRECT_MEMBERS
             return;
         }
 
-        BOOL overwrite = NO;
-        if (self->_flags.delegateHasOverwriteCheck) {
-            overwrite = [self.delegate shouldDecompressOperation:self
-                                             overwriteFileAtPath:[self->_sanitizedDestinationDirectoryPath stringByAppendingPathComponent:record.name]];
+        [records addObject:record];
+    }];
+
+    // Extract in the order the entries are stored, a single forward pass over the archive
+    NSArray<NOZCentralDirectoryRecord *> *plannedRecords = [_unzipper planSequentialReadOfRecords:records error:NULL];
+    if (plannedRecords) {
+        [records setArray:plannedRecords];
+    }
+
+    NSUInteger maxConcurrentUnzipCount = _request.maxConcurrentUnzipCount;
+    if (0 == maxConcurrentUnzipCount) {
+        maxConcurrentUnzipCount = [NSProcessInfo processInfo].activeProcessorCount;
+    }
+    maxConcurrentUnzipCount = MIN(maxConcurrentUnzipCount, records.count);
+
+    NSError *error = nil;
+    if (maxConcurrentUnzipCount > 1) {
+        error = [self private_unzipRecordsConcurrently:records maxConcurrentUnzipCount:maxConcurrentUnzipCount];
+    } else {
+        error = [self private_unzipRecordsSerially:records];
+    }
+
+    if (!error) {
+        // There can be ignored bytes
+        [self updateProgress:1.f forStep:NOZDecompressStepUnzip];
+    }
+
+    return error;
+}
+
+- (NSError *)private_unzipRecordsSerially:(NSArray<NOZCentralDirectoryRecord *> *)records
+{
+    for (NOZCentralDirectoryRecord *record in records) {
+        BOOL didStartWriting = NO;
+        NSError *error = [self private_unzipRecord:record shouldStop:NULL didStartWriting:&didStartWriting];
+        if (error) {
+            if (didStartWriting) {
+                [_partialEntryPaths addObject:record.name];
+            }
+            return error;
+        }
+        [_entryPaths addObject:record.name];
+    }
+
+    return nil;
+}
+
+- (NSError *)private_unzipRecordsConcurrently:(NSArray<NOZCentralDirectoryRecord *> *)records
+                      maxConcurrentUnzipCount:(NSUInteger)maxConcurrentUnzipCount
+{
+    const NSUInteger recordCount = records.count;
+    NSUInteger *schedule = malloc(recordCount * sizeof(NSUInteger));
+    SInt64 *compressedSizes = malloc(recordCount * sizeof(SInt64));
+    NOZDecompressEntryState *states = calloc(recordCount, sizeof(NOZDecompressEntryState));
+    noz_defer(^{
+        free(schedule);
+        free(compressedSizes);
+        free(states);
+    });
+
+    if (!schedule || !compressedSizes || !states) {
+        return [self private_unzipRecordsSerially:records];
+    }
+
+    // Schedule the largest entries first so the long running entries don't end up trailing at the end
+
+    for (NSUInteger i = 0; i < recordCount; i++) {
+        schedule[i] = i;
+        compressedSizes[i] = records[i].compressedSize;
+    }
+    qsort_b(schedule, recordCount, sizeof(NSUInteger), ^int(const void *lhs, const void *rhs) {
+        const NSUInteger lhsIndex = *(const NSUInteger *)lhs;
+        const NSUInteger rhsIndex = *(const NSUInteger *)rhs;
+        if (compressedSizes[lhsIndex] != compressedSizes[rhsIndex]) {
+            return (compressedSizes[lhsIndex] > compressedSizes[rhsIndex]) ? -1 : 1;
         }
+        return (lhsIndex < rhsIndex) ? -1 : 1;
+    });
+
+    atomic_size_t nextScheduleIndex;
+    atomic_bool shouldStop;
+    atomic_init(&nextScheduleIndex, 0);
+    atomic_init(&shouldStop, false);
+    atomic_size_t *nextScheduleIndexPtr = &nextScheduleIndex;
+    atomic_bool *shouldStopPtr = &shouldStop;
+
+    __block NSError *firstError = nil;
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    dispatch_apply(maxConcurrentUnzipCount, queue, ^(size_t worker) {
+        while (!atomic_load(shouldStopPtr)) {
+            const size_t scheduleIndex = atomic_fetch_add(nextScheduleIndexPtr, 1);
+            if (scheduleIndex >= recordCount) {
+                break;
+            }
 
-        NSError *innerError = nil;
-        [self->_unzipper saveRecord:record
-                        toDirectory:self->_sanitizedDestinationDirectoryPath
-                            options:(overwrite) ? NOZUnzipperSaveRecordOptionOverwriteExisting : NOZUnzipperSaveRecordOptionsNone
-                      progressBlock:^(int64_t totalBytes,
-                                      int64_t bytesComplete,
-                                      int64_t byteWrittenThisPass,
-                                      BOOL *abort) {
-                          if (self.isCancelled) {
-                              stackError = kCancelledError;
-                              *abort = YES;
-                          } else {
-                              [self private_didDecompressBytes:byteWrittenThisPass];
-                          }
-                      }
-                              error:&innerError];
-
-        if (!stackError) {
-            if (innerError) {
-                stackError = innerError;
-            } else if (self.isCancelled) {
-                stackError = kCancelledError;
+            const NSUInteger recordIndex = schedule[scheduleIndex];
+            BOOL didStartWriting = NO;
+            NSError *error = nil;
+            @autoreleasepool {
+                error = [self private_unzipRecord:records[recordIndex]
+                                       shouldStop:shouldStopPtr
+                                  didStartWriting:&didStartWriting];
+            }
+
+            if (error) {
+                states[recordIndex] = (didStartWriting) ? NOZDecompressEntryStatePartial : NOZDecompressEntryStatePending;
+                pthread_mutex_lock(&self->_progressMutex);
+                if (!firstError) {
+                    firstError = error;
+                }
+                pthread_mutex_unlock(&self->_progressMutex);
+                atomic_store(shouldStopPtr, true);
+            } else {
+                states[recordIndex] = NOZDecompressEntryStateCompleted;
             }
         }
+    });
+
+    // Keep the entry paths in archive order
 
-        if (stackError) {
-            *stop = YES;
-        } else {
-            [self->_entryPaths addObject:record.name];
+    for (NSUInteger i = 0; i < recordCount; i++) {
+        if (NOZDecompressEntryStateCompleted == states[i]) {
+            [_entryPaths addObject:records[i].name];
+        } else if (NOZDecompressEntryStatePartial == states[i]) {
+            [_partialEntryPaths addObject:records[i].name];
         }
+    }
 
-    }];
+    return firstError;
+}
+
+- (NSError *)private_unzipRecord:(NOZCentralDirectoryRecord *)record
+                      shouldStop:(atomic_bool *)shouldStop
+                 didStartWriting:(out BOOL *)didStartWriting
+{
+    BOOL overwrite = NO;
+    if (_flags.delegateHasOverwriteCheck) {
+        overwrite = [self.delegate shouldDecompressOperation:self
+                                         overwriteFileAtPath:[_sanitizedDestinationDirectoryPath stringByAppendingPathComponent:record.name]];
+    }
+
+    NOZUnzipperSaveRecordOptions options = (overwrite) ? NOZUnzipperSaveRecordOptionOverwriteExisting : NOZUnzipperSaveRecordOptionsNone;
+    if (_request.skipsChecksumValidation) {
+        options |= NOZUnzipperSaveRecordOptionSkipChecksumValidation;
+    }
+
+    __block NSError *stackError = nil;
+    NSError *innerError = nil;
+    [_unzipper saveRecord:record
+              toDirectory:_sanitizedDestinationDirectoryPath
+                  options:options
+            progressBlock:^(int64_t totalBytes,
+                            int64_t bytesComplete,
+                            int64_t byteWrittenThisPass,
+                            BOOL *abort) {
+                *didStartWriting = YES;
+                if (self.isCancelled) {
+                    stackError = kCancelledError;
+                    *abort = YES;
+                } else if (shouldStop && atomic_load(shouldStop)) {
+                    *abort = YES;
+                } else {
+                    [self private_didDecompressBytes:byteWrittenThisPass];
+                }
+            }
+                    error:&innerError];
 
     if (!stackError) {
-        // There can be ignored bytes
-        [self updateProgress:1.f forStep:NOZDecompressStepUnzip];
+        if (innerError) {
+            stackError = innerError;
+        } else if (self.isCancelled) {
+            stackError = kCancelledError;
+        }
     }
 
     return stackError;
@@ -341,6 +491,9 @@ NOZ_OBJC_DIRECT_MEMBERS
 
 - (void)private_didDecompressBytes:(SInt64)bytes
 {
+    pthread_mutex_lock(&_progressMutex);
+    noz_defer(^{ pthread_mutex_unlock(&self->_progressMutex); });
+
     _bytesUncompressed += bytes;
     float progress = 1.f;
     if (_bytesUncompressed < 0.f) {
@@ -360,6 +513,7 @@ NOZ_OBJC_DIRECT_MEMBERS
 {
     if (self = [super init]) {
         _sourceFilePath = [path copy];
+        _maxConcurrentUnzipCount = 1;
     }
     return self;
 }
@@ -377,6 +531,8 @@ NOZ_OBJC_DIRECT_MEMBERS
 {
     NOZDecompressRequest *request = [[NOZDecompressRequest alloc] initWithSourceFilePath:_sourceFilePath];
     request->_destinationDirectoryPath = _destinationDirectoryPath;
+    request->_maxConcurrentUnzipCount = _maxConcurrentUnzipCount;
+    request->_skipsChecksumValidation = _skipsChecksumValidation;
     return request;
 }
 
@@ -39,6 +39,28 @@
 
 static UInt16 NOZCompressionLevelToDeflateLevel(NOZCompressionLevel level);
 
+// Blocks compressed concurrently are primed with this much of the input preceding them (the DEFLATE window)
+static const size_t kNOZDeflateDictionarySize = 32 * 1024;
+static const size_t kNOZDeflateMinBlockSize = 2 * kNOZDeflateDictionarySize;
+static const size_t kNOZDeflateMaxBlockSize = 64 * 1024 * 1024;
+
+/**
+ A block of input compressed on its own, see `NOZDeflateEncoderWithConcurrentBlocks`
+ */
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZDeflateBlock : NSObject
+@property (nonatomic, readonly) dispatch_semaphore_t finishedSemaphore;
+@property (nonatomic, readonly) const Byte *output;
+@property (nonatomic, readonly) size_t outputLength;
+@property (nonatomic, readonly) BOOL succeeded;
+@property (nonatomic, readonly) BOOL outputWasText;
+- (instancetype)initWithInput:(NSData *)input
+                   dictionary:(nullable NSData *)dictionary
+                      isFinal:(BOOL)isFinal
+                        level:(int)level;
+- (void)compress;
+@end
+
 @interface NOZDeflateEncoderContext : NSObject <NOZEncoderContext>
 @property (nonatomic) BOOL encodedDataWasText;
 @end
@@ -53,6 +75,25 @@ NOZ_OBJC_DIRECT_MEMBERS
 @property (nonatomic, readonly) Byte *compressedDataBuffer;
 @property (nonatomic, readonly) size_t compressedDataBufferSize;
 @property (nonatomic) size_t compressedDataPosition;
+
+// Only when compressing blocks concurrently
+@property (nonatomic) size_t blockSize;
+@property (nonatomic) NSUInteger maxConcurrentBlocks;
+@property (nonatomic, nullable) NSMutableData *blockInput;
+@property (nonatomic, nullable) NSData *blockDictionary;
+@property (nonatomic, nullable) NSMutableArray<NOZDeflateBlock *> *pendingBlocks;
+@property (nonatomic) BOOL blocksWereText;
+@end
+
+@interface NOZDeflateEncoder ()
+- (instancetype)initWithBlockSize:(size_t)blockSize maxConcurrentBlocks:(NSUInteger)maxConcurrentBlocks;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZDeflateEncoder (/* direct declarations */)
+- (BOOL)private_appendBytes:(const Byte*)bytes length:(size_t)length toBlocksOfContext:(NOZDeflateEncoderContext *)context;
+- (BOOL)private_submitBlockOfContext:(NOZDeflateEncoderContext *)context isFinal:(BOOL)isFinal;
+- (BOOL)private_writeOldestBlockOfContext:(NOZDeflateEncoderContext *)context discard:(BOOL)discard;
 @end
 
 NOZ_OBJC_DIRECT_MEMBERS
@@ -100,6 +141,19 @@ NOZ_OBJC_DIRECT_MEMBERS
 
 NOZ_OBJC_DIRECT_MEMBERS
 @implementation NOZDeflateEncoder
+{
+    size_t _blockSize;
+    NSUInteger _maxConcurrentBlocks;
+}
+
+- (instancetype)initWithBlockSize:(size_t)blockSize maxConcurrentBlocks:(NSUInteger)maxConcurrentBlocks
+{
+    if (self = [super init]) {
+        _blockSize = MIN(MAX(blockSize, kNOZDeflateMinBlockSize), kNOZDeflateMaxBlockSize);
+        _maxConcurrentBlocks = (maxConcurrentBlocks > 0) ? maxConcurrentBlocks : [NSProcessInfo processInfo].activeProcessorCount;
+    }
+    return self;
+}
 
 - (NSUInteger)numberOfCompressionLevels
 {
@@ -134,11 +188,21 @@ NOZ_OBJC_DIRECT_MEMBERS
     NOZDeflateEncoderContext *context = [[NOZDeflateEncoderContext alloc] init];
     context.flushCallback = callback;
     context.compressionLevel = NOZCompressionLevelToDeflateLevel(level);
+    context.blockSize = _blockSize;
+    context.maxConcurrentBlocks = _maxConcurrentBlocks;
     return context;
 }
 
 - (BOOL)initializeEncoderContext:(NOZDeflateEncoderContext *)context
 {
+    if (context.blockSize > 0) {
+        context.blockInput = [[NSMutableData alloc] initWithCapacity:context.blockSize];
+        context.blockDictionary = nil;
+        context.pendingBlocks = [[NSMutableArray alloc] init];
+        context.blocksWereText = YES;
+        return YES;
+    }
+
     if (Z_OK != deflateInit2(context.zStream,
                              context.compressionLevel,
                              Z_DEFLATED,
@@ -156,6 +220,10 @@ NOZ_OBJC_DIRECT_MEMBERS
              length:(size_t)length
             context:(NOZDeflateEncoderContext *)context
 {
+    if (context.blockSize > 0) {
+        return [self private_appendBytes:bytes length:length toBlocksOfContext:context];
+    }
+
     if (!context.zStreamOpen) {
         return NO;
     }
@@ -195,6 +263,24 @@ NOZ_OBJC_DIRECT_MEMBERS
 
 - (BOOL)finalizeEncoderContext:(NOZDeflateEncoderContext *)context
 {
+    if (context.blockSize > 0) {
+        if (!context.blockInput) {
+            return NO;
+        }
+
+        BOOL success = [self private_submitBlockOfContext:context isFinal:YES];
+        while (context.pendingBlocks.count > 0) {
+            // always wait for every block, even once failed
+            success = [self private_writeOldestBlockOfContext:context discard:!success] && success;
+        }
+
+        context.encodedDataWasText = success && context.blocksWereText;
+        context.blockInput = nil;
+        context.blockDictionary = nil;
+        context.flushCallback = NULL;
+        return success;
+    }
+
     if (!context.zStreamOpen) {
         return NO;
     }
@@ -249,8 +335,184 @@ NOZ_OBJC_DIRECT_MEMBERS
     return success;
 }
 
+#pragma mark Blocks
+
+- (BOOL)private_appendBytes:(const Byte*)bytes length:(size_t)length toBlocksOfContext:(NOZDeflateEncoderContext *)context
+{
+    if (!context.blockInput) {
+        return NO;
+    }
+
+    while (length > 0) {
+        NSMutableData *blockInput = context.blockInput;
+        const size_t byteCount = MIN(length, context.blockSize - blockInput.length);
+        [blockInput appendBytes:bytes length:byteCount];
+        bytes += byteCount;
+        length -= byteCount;
+
+        // the last block is only submitted on finalize, so an input of a single block is compressed as one stream
+        if (blockInput.length == context.blockSize && length > 0) {
+            if (![self private_submitBlockOfContext:context isFinal:NO]) {
+                return NO;
+            }
+        }
+    }
+
+    return YES;
+}
+
+- (BOOL)private_submitBlockOfContext:(NOZDeflateEncoderContext *)context isFinal:(BOOL)isFinal
+{
+    NSData *input = context.blockInput;
+    NOZDeflateBlock *block = [[NOZDeflateBlock alloc] initWithInput:input
+                                                         dictionary:context.blockDictionary
+                                                            isFinal:isFinal
+                                                              level:context.compressionLevel];
+    if (!isFinal) {
+        // a full block is always larger than the dictionary
+        context.blockDictionary = [input subdataWithRange:NSMakeRange(input.length - kNOZDeflateDictionarySize, kNOZDeflateDictionarySize)];
+        context.blockInput = [[NSMutableData alloc] initWithCapacity:context.blockSize];
+    }
+
+    [context.pendingBlocks addObject:block];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        @autoreleasepool {
+            [block compress];
+        }
+        dispatch_semaphore_signal(block.finishedSemaphore);
+    });
+
+    // Write the oldest blocks while the newer ones compress, which bounds the memory to maxConcurrentBlocks blocks
+    while (context.pendingBlocks.count > context.maxConcurrentBlocks) {
+        if (![self private_writeOldestBlockOfContext:context discard:NO]) {
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+- (BOOL)private_writeOldestBlockOfContext:(NOZDeflateEncoderContext *)context discard:(BOOL)discard
+{
+    NOZDeflateBlock *block = context.pendingBlocks.firstObject;
+    [context.pendingBlocks removeObjectAtIndex:0];
+    dispatch_semaphore_wait(block.finishedSemaphore, DISPATCH_TIME_FOREVER);
+
+    if (discard || !block.succeeded) {
+        return NO;
+    }
+
+    if (!block.outputWasText) {
+        context.blocksWereText = NO;
+    }
+
+    return (0 == block.outputLength) || context.flushCallback(self, context, block.output, block.outputLength);
+}
+
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZDeflateBlock
+{
+    NSData *_input;
+    NSData *_dictionary;
+    BOOL _isFinal;
+    int _level;
+    Byte *_outputBuffer;
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithInput:(NSData *)input
+                   dictionary:(NSData *)dictionary
+                      isFinal:(BOOL)isFinal
+                        level:(int)level
+{
+    if (self = [super init]) {
+        _input = input;
+        _dictionary = dictionary;
+        _isFinal = isFinal;
+        _level = level;
+        _finishedSemaphore = dispatch_semaphore_create(0);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_outputBuffer);
+}
+
+- (const Byte *)output
+{
+    return _outputBuffer;
+}
+
+- (void)compress
+{
+    z_stream zStream;
+    memset(&zStream, 0, sizeof(zStream));
+    if (Z_OK != deflateInit2(&zStream, _level, Z_DEFLATED, -MAX_WBITS, 8 /* default memory level */, Z_DEFAULT_STRATEGY)) {
+        return;
+    }
+
+    if (_dictionary && Z_OK != deflateSetDictionary(&zStream, _dictionary.bytes, (uInt)_dictionary.length)) {
+        deflateEnd(&zStream);
+        return;
+    }
+
+    // Non-final blocks end with a sync flush (an empty stored block) so they end on a byte boundary and can be joined,
+    // only the final block ends the stream
+    const int flush = (_isFinal) ? Z_FINISH : Z_SYNC_FLUSH;
+    size_t capacity = deflateBound(&zStream, (uLong)_input.length) + 16;
+    _outputBuffer = malloc(capacity);
+    zStream.next_in = (Bytef *)_input.bytes;
+    zStream.avail_in = (uInt)_input.length;
+    zStream.next_out = _outputBuffer;
+    zStream.avail_out = (uInt)capacity;
+
+    while (_outputBuffer) {
+        const int err = deflate(&zStream, flush);
+        if (Z_STREAM_ERROR == err) {
+            break;
+        }
+
+        if ((_isFinal) ? (Z_STREAM_END == err) : (0 == zStream.avail_in && zStream.avail_out > 0)) {
+            _succeeded = YES;
+            break;
+        }
+
+        // out of room (unexpected given the bound)
+        const size_t used = capacity - zStream.avail_out;
+        capacity *= 2;
+        Byte *outputBuffer = realloc(_outputBuffer, capacity);
+        if (!outputBuffer) {
+            break;
+        }
+        _outputBuffer = outputBuffer;
+        zStream.next_out = _outputBuffer + used;
+        zStream.avail_out = (uInt)(capacity - used);
+    }
+
+    _outputLength = capacity - zStream.avail_out;
+    _outputWasText = (zStream.data_type == Z_ASCII);
+    deflateEnd(&zStream);
+
+    _input = nil;
+    _dictionary = nil;
+}
+
 @end
 
+id<NOZEncoder> NOZDeflateEncoderWithConcurrentBlocks(size_t blockSize, NSUInteger maxConcurrentBlocks)
+{
+    return [[NOZDeflateEncoder alloc] initWithBlockSize:blockSize maxConcurrentBlocks:maxConcurrentBlocks];
+}
+
 #pragma mark - Deflate Decoder
 
 @interface NOZDeflateDecoderContext : NSObject <NOZDecoderContext>
@@ -426,6 +688,47 @@ NOZ_OBJC_DIRECT_MEMBERS
     return YES;
 }
 
+- (BOOL)decodeAllBytes:(const Byte*)bytes
+                length:(size_t)length
+              bitFlags:(UInt16)flags
+            intoBuffer:(Byte*)buffer
+              capacity:(size_t)capacity
+         decodedLength:(size_t *)decodedLength
+{
+    z_stream zStream;
+    bzero(&zStream, sizeof(zStream));
+    if (Z_OK != inflateInit2(&zStream, -MAX_WBITS)) {
+        return NO;
+    }
+
+    // zlib's lengths are 32 bits, so the input and output are provided in pieces of at most UINT32_MAX
+
+    zStream.next_in = (Byte*)bytes;
+    zStream.next_out = buffer;
+    size_t remainingInput = length;
+    size_t remainingOutput = capacity;
+    int zErr = Z_OK;
+    do {
+        if (0 == zStream.avail_in && remainingInput > 0) {
+            zStream.avail_in = (uInt)MIN(remainingInput, (size_t)UINT32_MAX);
+            remainingInput -= zStream.avail_in;
+        }
+        if (0 == zStream.avail_out && remainingOutput > 0) {
+            zStream.avail_out = (uInt)MIN(remainingOutput, (size_t)UINT32_MAX);
+            remainingOutput -= zStream.avail_out;
+        }
+        const BOOL isLastPiece = (0 == remainingInput && 0 == remainingOutput);
+        zErr = inflate(&zStream, (isLastPiece) ? Z_FINISH : Z_NO_FLUSH);
+        if (Z_BUF_ERROR == zErr && ((0 == zStream.avail_in && 0 == remainingInput) || (0 == zStream.avail_out && 0 == remainingOutput))) {
+            break; // truncated input or not enough room for the output
+        }
+    } while (Z_OK == zErr || Z_BUF_ERROR == zErr);
+
+    *decodedLength = (size_t)zStream.total_out;
+    inflateEnd(&zStream);
+    return Z_STREAM_END == zErr;
+}
+
 @end
 
 static UInt16 NOZCompressionLevelToDeflateLevel(NOZCompressionLevel level)
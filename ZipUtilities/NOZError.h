@@ -116,7 +116,7 @@ typedef NS_ENUM(NSInteger, NOZErrorCode)
     NOZErrorCodeZipFailedToWriteZip,
     /** Zipper couldn't open a new entry */
     NOZErrorCodeZipCannotOpenNewEntry,
-    /** Zipper doesn't support 64-bit file sizes */
+    /** Zipper couldn't store the 64-bit sizes of an entry (only when `NOZ_SINGLE_PASS_ZIP` is `0` and the entry is much larger than its `sizeInBytes`) */
     NOZErrorCodeZipDoesNotSupportZip64,
     /** Zipper doesn't support a particular compression method */
     NOZErrorCodeZipDoesNotSupportCompressionMethod,
@@ -159,6 +159,20 @@ typedef NS_ENUM(NSInteger, NOZErrorCode)
     NOZErrorCodeUnzipChecksumMissmatch,
     /** An entry failed to be decompressed */
     NOZErrorCodeUnzipFailedToDecompressEntry,
+    /** Stream unzipper couldn't locate the data descriptor following an entry's data */
+    NOZErrorCodeUnzipCannotLocateDataDescriptor,
+    /** Unzipper was provided a checkpoint index that was not built for the record being read */
+    NOZErrorCodeUnzipCheckpointIndexDoesNotMatchRecord,
+    /** Archive file system has no item at the given path */
+    NOZErrorCodeUnzipArchiveFileSystemNoSuchItem,
+    /** Archive file system item is a directory, but a file was expected */
+    NOZErrorCodeUnzipArchiveFileSystemItemIsDirectory,
+    /** Archive file system item is a file, but a directory was expected */
+    NOZErrorCodeUnzipArchiveFileSystemItemIsNotDirectory,
+    /** A random access source failed to provide its length or the bytes that were requested */
+    NOZErrorCodeUnzipCannotReadRandomAccessSource,
+    /** Stream unzipper found an entry's data followed by a data descriptor without a signature, which it cannot delimit */
+    NOZErrorCodeUnzipDataDescriptorWithoutSignatureNotSupported,
 };
 
 //! Is the given _code_ within the specified _page_
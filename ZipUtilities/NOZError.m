@@ -83,6 +83,13 @@ NSString *NOZErrorCodeToString(NOZErrorCode code)
             SWITCH_CASE(NOZErrorCodeUnzipCannotDecompressFileEntry);
             SWITCH_CASE(NOZErrorCodeUnzipChecksumMissmatch);
             SWITCH_CASE(NOZErrorCodeUnzipFailedToDecompressEntry);
+            SWITCH_CASE(NOZErrorCodeUnzipCannotLocateDataDescriptor);
+            SWITCH_CASE(NOZErrorCodeUnzipCheckpointIndexDoesNotMatchRecord);
+            SWITCH_CASE(NOZErrorCodeUnzipArchiveFileSystemNoSuchItem);
+            SWITCH_CASE(NOZErrorCodeUnzipArchiveFileSystemItemIsDirectory);
+            SWITCH_CASE(NOZErrorCodeUnzipArchiveFileSystemItemIsNotDirectory);
+            SWITCH_CASE(NOZErrorCodeUnzipCannotReadRandomAccessSource);
+            SWITCH_CASE(NOZErrorCodeUnzipDataDescriptorWithoutSignatureNotSupported);
     }
 
 #undef SWITCH_CASE
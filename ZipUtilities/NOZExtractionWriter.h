@@ -0,0 +1,94 @@
+//
+//  NOZExtractionWriter.h
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "NOZUtils.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class NOZExtractionFile;
+
+/**
+ Writes extracted files beneath a destination directory with as few system calls as possible.
+
+ Files are opened relative to a descriptor of the destination directory (no path resolution from the root of the file system),
+ intermediate directories are created once and remembered, large files are preallocated,
+ data is coalesced into large writes and modification dates are set through the open descriptor.
+
+ Thread safe, files can be written concurrently.
+ */
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZExtractionWriter : NSObject
+
+@property (nonatomic, readonly, copy) NSString *destinationDirectoryPath;
+
+/** Creates _destinationDirectoryPath_ if needed, `nil` if it cannot be opened */
+- (nullable instancetype)initWithDestinationDirectoryPath:(NSString *)destinationDirectoryPath
+                                                    error:(out NSError **)error;
+
+/**
+ Create the file at _relativePath_ (creating intermediate directories).
+ Without _overwrite_, fails with `EEXIST` if the file exists.
+ @param expectedSize the size the file will be once written, used to preallocate it
+ */
+- (nullable NOZExtractionFile *)createFileAtRelativePath:(NSString *)relativePath
+                                            expectedSize:(UInt64)expectedSize
+                                               overwrite:(BOOL)overwrite
+                                                   error:(out NSError **)error;
+
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZExtractionFile : NSObject
+
+@property (nonatomic, readonly) UInt64 bytesWritten;
+
+- (BOOL)appendBytes:(const void *)bytes length:(size_t)length;
+
+/**
+ Append _length_ bytes of _sourceFileDescriptor_ starting at _offset_ (the descriptor's file offset is left untouched).
+ The kernel copies the bytes itself where it can (`copy_file_range` or `sendfile` on Linux), otherwise they are read and written.
+ */
+- (BOOL)appendContentsOfFileDescriptor:(int)sourceFileDescriptor offset:(off_t)offset length:(UInt64)length;
+
+/**
+ Flush, set the modification date (if any) and close the file.
+ A file that had nothing written to it is removed (unless _keepIfEmpty_).
+ */
+- (BOOL)closeWithModificationDate:(nullable NSDate *)modificationDate keepIfEmpty:(BOOL)keepIfEmpty;
+
+@end
+
+/**
+ Copy up to _length_ bytes of _sourceFileDescriptor_ starting at _offset_ to _destinationFileDescriptor_ (at its file offset) in the kernel,
+ advancing _offset_ and reducing _length_ by what was copied.
+ Copies what it can with `copy_file_range` or `sendfile` on Linux and nothing elsewhere, the rest is up to the caller to read and write.
+ */
+FOUNDATION_EXTERN void noz_kernel_copy(int sourceFileDescriptor, off_t *offset, int destinationFileDescriptor, UInt64 *length);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,458 @@
+//
+//  NOZExtractionWriter.m
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
+
+#import "NOZ_Project.h"
+#import "NOZExtractionWriter.h"
+
+// Data is coalesced into writes of this size
+static const size_t kNOZExtractionWriteChunkSize = 256 * 1024;
+
+// Files smaller than this are written in a single write anyway, preallocating them would only add a system call
+static const UInt64 kNOZExtractionPreallocationThreshold = 256 * 1024;
+
+static BOOL noz_write_all(int fd, const Byte *bytes, size_t length);
+static void noz_preallocate(int fd, UInt64 size);
+
+@interface NOZExtractionFile ()
+- (instancetype)initWithFileDescriptor:(int)fd
+                   directoryDescriptor:(int)directoryDescriptor
+                          relativePath:(NSString *)relativePath
+                          expectedSize:(UInt64)expectedSize
+                                writer:(NOZExtractionWriter *)writer;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZExtractionWriter (/* direct declarations */)
+- (BOOL)private_createDirectoriesForRelativePath:(NSString *)relativeDirectoryPath error:(out NSError **)error;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZExtractionFile (/* direct declarations */)
+- (BOOL)private_flush;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZExtractionWriter
+{
+    int _directoryDescriptor;
+    pthread_mutex_t _mutex;
+    NSMutableSet<NSString *> *_createdDirectories; // relative to the destination directory
+}
+
+- (void)dealloc
+{
+    if (_directoryDescriptor >= 0) {
+        close(_directoryDescriptor);
+    }
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithDestinationDirectoryPath:(NSString *)destinationDirectoryPath error:(out NSError **)error
+{
+    if (self = [super init]) {
+        _directoryDescriptor = -1;
+        pthread_mutex_init(&_mutex, NULL);
+        _destinationDirectoryPath = [destinationDirectoryPath copy];
+        _createdDirectories = [[NSMutableSet alloc] init];
+
+        if (![[NSFileManager defaultManager] createDirectoryAtPath:destinationDirectoryPath withIntermediateDirectories:YES attributes:nil error:NULL]) {
+            if (error) {
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EACCES userInfo:nil];
+            }
+            return nil;
+        }
+
+        _directoryDescriptor = open(destinationDirectoryPath.fileSystemRepresentation, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (_directoryDescriptor < 0) {
+            if (error) {
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            }
+            return nil;
+        }
+    }
+    return self;
+}
+
+- (NOZExtractionFile *)createFileAtRelativePath:(NSString *)relativePath
+                                   expectedSize:(UInt64)expectedSize
+                                      overwrite:(BOOL)overwrite
+                                          error:(out NSError **)error
+{
+    if (![self private_createDirectoriesForRelativePath:relativePath.stringByDeletingLastPathComponent error:error]) {
+        return nil;
+    }
+
+    const int flags = O_WRONLY | O_CREAT | O_CLOEXEC | ((overwrite) ? O_TRUNC : O_EXCL);
+    int fd = openat(_directoryDescriptor, relativePath.fileSystemRepresentation, flags, 0644);
+    if (fd < 0 && ENOENT == errno) {
+        // a remembered directory was removed from under us, forget what was created and try again
+        pthread_mutex_lock(&_mutex);
+        [_createdDirectories removeAllObjects];
+        pthread_mutex_unlock(&_mutex);
+        if (![self private_createDirectoriesForRelativePath:relativePath.stringByDeletingLastPathComponent error:error]) {
+            return nil;
+        }
+        fd = openat(_directoryDescriptor, relativePath.fileSystemRepresentation, flags, 0644);
+    }
+    if (fd < 0) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        }
+        return nil;
+    }
+
+    if (expectedSize >= kNOZExtractionPreallocationThreshold) {
+        noz_preallocate(fd, expectedSize);
+    }
+
+    return [[NOZExtractionFile alloc] initWithFileDescriptor:fd
+                                         directoryDescriptor:_directoryDescriptor
+                                                relativePath:relativePath
+                                                expectedSize:expectedSize
+                                                      writer:self];
+}
+
+#pragma mark Private
+
+- (BOOL)private_createDirectoriesForRelativePath:(NSString *)relativeDirectoryPath error:(out NSError **)error
+{
+    if (!relativeDirectoryPath.length) {
+        return YES;
+    }
+
+    pthread_mutex_lock(&_mutex);
+    noz_defer(^{ pthread_mutex_unlock(&self->_mutex); });
+
+    if ([_createdDirectories containsObject:relativeDirectoryPath]) {
+        return YES;
+    }
+
+    // Create each missing ancestor once, an existing directory is as good as a created one
+
+    NSString *path = nil;
+    for (NSString *component in relativeDirectoryPath.pathComponents) {
+        path = (path) ? [path stringByAppendingPathComponent:component] : component;
+        if ([_createdDirectories containsObject:path]) {
+            continue;
+        }
+        if (0 != mkdirat(_directoryDescriptor, path.fileSystemRepresentation, 0755) && errno != EEXIST) {
+            if (error) {
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            }
+            return NO;
+        }
+        [_createdDirectories addObject:path];
+    }
+
+    return YES;
+}
+
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZExtractionFile
+{
+    int _fd;
+    int _directoryDescriptor; // not owned, kept valid by _writer
+    NOZExtractionWriter *_writer;
+    NSString *_relativePath;
+    Byte *_buffer;
+    size_t _bufferCapacity;
+    size_t _bufferLength;
+    BOOL _failed;
+}
+
+- (void)dealloc
+{
+    if (_fd >= 0) {
+        close(_fd);
+    }
+    free(_buffer);
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithFileDescriptor:(int)fd
+                   directoryDescriptor:(int)directoryDescriptor
+                          relativePath:(NSString *)relativePath
+                          expectedSize:(UInt64)expectedSize
+                                writer:(NOZExtractionWriter *)writer
+{
+    if (self = [super init]) {
+        _fd = fd;
+        _directoryDescriptor = directoryDescriptor;
+        _writer = writer;
+        _relativePath = [relativePath copy];
+
+        // small files get a buffer of their own size so that they are written with a single write
+        _bufferCapacity = (size_t)MAX(MIN(expectedSize, (UInt64)kNOZExtractionWriteChunkSize), (UInt64)1);
+    }
+    return self;
+}
+
+- (BOOL)appendBytes:(const void *)bytes length:(size_t)length
+{
+    if (_failed) {
+        return NO;
+    }
+
+    const Byte *cursor = bytes;
+    while (length > 0) {
+        if (0 == _bufferLength && length >= _bufferCapacity) {
+            // nothing buffered and a full chunk to write, skip the copy
+            const size_t chunkLength = length - (length % _bufferCapacity);
+            if (!noz_write_all(_fd, cursor, chunkLength)) {
+                _failed = YES;
+                return NO;
+            }
+            _bytesWritten += chunkLength;
+            cursor += chunkLength;
+            length -= chunkLength;
+            continue;
+        }
+
+        if (!_buffer) {
+            _buffer = malloc(_bufferCapacity);
+            if (!_buffer) {
+                _failed = YES;
+                return NO;
+            }
+        }
+
+        const size_t copyLength = MIN(length, _bufferCapacity - _bufferLength);
+        memcpy(_buffer + _bufferLength, cursor, copyLength);
+        _bufferLength += copyLength;
+        cursor += copyLength;
+        length -= copyLength;
+
+        if (_bufferLength == _bufferCapacity) {
+            if (!noz_write_all(_fd, _buffer, _bufferLength)) {
+                _failed = YES;
+                return NO;
+            }
+            _bytesWritten += _bufferLength;
+            _bufferLength = 0;
+        }
+    }
+
+    return YES;
+}
+
+- (BOOL)appendContentsOfFileDescriptor:(int)sourceFileDescriptor offset:(off_t)offset length:(UInt64)length
+{
+    if (_failed || ![self private_flush]) {
+        return NO;
+    }
+
+    const UInt64 totalLength = length;
+    noz_kernel_copy(sourceFileDescriptor, &offset, _fd, &length);
+
+    // Whatever the kernel didn't copy is read and written
+
+    while (length > 0) {
+        if (!_buffer) {
+            _buffer = malloc(_bufferCapacity);
+            if (!_buffer) {
+                _failed = YES;
+                return NO;
+            }
+        }
+        const size_t chunkLength = (size_t)MIN(length, (UInt64)_bufferCapacity);
+        const ssize_t bytesRead = pread(sourceFileDescriptor, _buffer, chunkLength, offset);
+        if (bytesRead < 0 && EINTR == errno) {
+            continue;
+        }
+        if (bytesRead <= 0 || !noz_write_all(_fd, _buffer, (size_t)bytesRead)) {
+            _failed = YES;
+            return NO;
+        }
+        offset += bytesRead;
+        length -= (UInt64)bytesRead;
+    }
+
+    _bytesWritten += totalLength;
+    return YES;
+}
+
+- (BOOL)private_flush
+{
+    if (_bufferLength > 0) {
+        if (!noz_write_all(_fd, _buffer, _bufferLength)) {
+            _failed = YES;
+            return NO;
+        }
+        _bytesWritten += _bufferLength;
+        _bufferLength = 0;
+    }
+    return YES;
+}
+
+- (BOOL)closeWithModificationDate:(NSDate *)modificationDate keepIfEmpty:(BOOL)keepIfEmpty
+{
+    if (_fd < 0) {
+        return !_failed;
+    }
+
+    if (!_failed) {
+        (void)[self private_flush];
+    }
+
+    if (!_failed && modificationDate) {
+        const NSTimeInterval timeInterval = modificationDate.timeIntervalSince1970;
+        if (@available(macOS 10.13, iOS 11.0, tvOS 11.0, watchOS 4.0, *)) {
+            struct timespec times[2];
+            times[0].tv_sec = 0;
+            times[0].tv_nsec = UTIME_OMIT; // leave the access time be
+            times[1].tv_sec = (time_t)timeInterval;
+            times[1].tv_nsec = 0;
+            (void)futimens(_fd, times);
+        } else {
+            struct timeval times[2];
+            gettimeofday(&times[0], NULL);
+            times[1].tv_sec = (time_t)timeInterval;
+            times[1].tv_usec = 0;
+            (void)futimes(_fd, times);
+        }
+    }
+
+    if (0 != close(_fd)) {
+        _failed = YES;
+    }
+    _fd = -1;
+    free(_buffer);
+    _buffer = NULL;
+
+    if (0 == _bytesWritten && !keepIfEmpty) {
+        (void)unlinkat(_directoryDescriptor, _relativePath.fileSystemRepresentation, 0);
+    }
+
+    return !_failed;
+}
+
+@end
+
+static BOOL noz_write_all(int fd, const Byte *bytes, size_t length)
+{
+    while (length > 0) {
+        const ssize_t bytesWritten = write(fd, bytes, length);
+        if (bytesWritten < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return NO;
+        }
+        bytes += bytesWritten;
+        length -= (size_t)bytesWritten;
+    }
+    return YES;
+}
+
+void noz_kernel_copy(int sourceFileDescriptor, off_t *offset, int destinationFileDescriptor, UInt64 *length)
+{
+    // Copies as much as the kernel will (advancing _offset_ and reducing _length_),
+    // stopping at the first error since the caller falls back to reading and writing
+
+#if defined(__linux__)
+    // cap each call below what a single read or write can transfer
+    static const UInt64 kMaxCopyLength = 0x7ffff000;
+# if defined(SYS_copy_file_range)
+    while (*length > 0) {
+        loff_t sourceOffset = (loff_t)*offset;
+        const ssize_t copied = (ssize_t)syscall(SYS_copy_file_range, sourceFileDescriptor, &sourceOffset, destinationFileDescriptor, NULL, (size_t)MIN(*length, kMaxCopyLength), 0);
+        if (copied < 0 && EINTR == errno) {
+            continue;
+        }
+        if (copied <= 0) {
+            break; // not supported between these files (or an actual error)
+        }
+        *offset += copied;
+        *length -= (UInt64)copied;
+    }
+# endif
+    while (*length > 0) {
+        off_t sourceOffset = *offset;
+        const ssize_t copied = sendfile(destinationFileDescriptor, sourceFileDescriptor, &sourceOffset, (size_t)MIN(*length, kMaxCopyLength));
+        if (copied < 0 && EINTR == errno) {
+            continue;
+        }
+        if (copied <= 0) {
+            break;
+        }
+        *offset += copied;
+        *length -= (UInt64)copied;
+    }
+#else
+    // Darwin's sendfile only writes to sockets and fcopyfile only copies whole files
+    (void)sourceFileDescriptor;
+    (void)offset;
+    (void)destinationFileDescriptor;
+    (void)length;
+#endif
+}
+
+static void noz_preallocate(int fd, UInt64 size)
+{
+    // Best effort: reserving the space upfront keeps large files contiguous (without changing their size)
+
+#if defined(__APPLE__)
+    fstore_t store;
+    bzero(&store, sizeof(store));
+    store.fst_flags = F_ALLOCATECONTIG;
+    store.fst_posmode = F_PEOFPOSMODE;
+    store.fst_offset = 0;
+    store.fst_length = (off_t)size;
+    if (-1 == fcntl(fd, F_PREALLOCATE, &store)) {
+        store.fst_flags = F_ALLOCATEALL;
+        (void)fcntl(fd, F_PREALLOCATE, &store);
+    }
+#elif defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    (void)fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)size);
+#else
+    (void)fd;
+    (void)size;
+#endif
+}
@@ -0,0 +1,55 @@
+//
+//  NOZLRUCache.h
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "NOZUtils.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A thread safe cache that evicts its least recently used objects once their combined cost exceeds `totalCostLimit`.
+ Unlike `NSCache`, eviction is deterministic (strictly least recently used first and only when over the limit).
+ */
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZLRUCache<KeyType, ObjectType> : NSObject
+
+@property (nonatomic) NSUInteger totalCostLimit;
+@property (nonatomic, readonly) NSUInteger totalCost;
+@property (nonatomic, readonly) NSUInteger count;
+
+- (instancetype)initWithTotalCostLimit:(NSUInteger)totalCostLimit;
+
+/** Get the object for _key_, making it the most recently used */
+- (nullable ObjectType)objectForKey:(KeyType)key;
+/** Set the object for _key_ (replacing any existing object), an object costing more than `totalCostLimit` is not cached */
+- (void)setObject:(ObjectType)object forKey:(KeyType)key cost:(NSUInteger)cost;
+- (void)removeAllObjects;
+
+@end
+
+NS_ASSUME_NONNULL_END
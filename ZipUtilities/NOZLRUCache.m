@@ -0,0 +1,218 @@
+//
+//  NOZLRUCache.m
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include <pthread.h>
+
+#import "NOZ_Project.h"
+#import "NOZLRUCache.h"
+
+@interface NOZLRUCacheEntry : NSObject
+{
+@public
+    id<NSCopying> _key;
+    id _object;
+    NSUInteger _cost;
+    NOZLRUCacheEntry *_next; // less recently used
+    __unsafe_unretained NOZLRUCacheEntry *_previous; // more recently used
+}
+@end
+
+@implementation NOZLRUCacheEntry
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZLRUCache (/* direct declarations */)
+- (void)private_unlinkEntry:(NOZLRUCacheEntry *)entry;
+- (void)private_pushEntryToFront:(NOZLRUCacheEntry *)entry;
+- (void)private_evictToCostLimit;
+- (void)private_removeAllEntries;
+@end
+
+@implementation NOZLRUCache
+{
+    pthread_mutex_t _mutex;
+    NSMutableDictionary *_entries;
+    NOZLRUCacheEntry *_head; // most recently used
+    __unsafe_unretained NOZLRUCacheEntry *_tail; // least recently used
+    NSUInteger _totalCost;
+    NSUInteger _totalCostLimit;
+}
+
+- (void)dealloc
+{
+    [self private_removeAllEntries];
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithTotalCostLimit:(NSUInteger)totalCostLimit
+{
+    if (self = [super init]) {
+        pthread_mutex_init(&_mutex, NULL);
+        _entries = [[NSMutableDictionary alloc] init];
+        _totalCostLimit = totalCostLimit;
+    }
+    return self;
+}
+
+- (NSUInteger)totalCostLimit
+{
+    pthread_mutex_lock(&_mutex);
+    noz_defer(^{ pthread_mutex_unlock(&self->_mutex); });
+    return _totalCostLimit;
+}
+
+- (void)setTotalCostLimit:(NSUInteger)totalCostLimit
+{
+    pthread_mutex_lock(&_mutex);
+    noz_defer(^{ pthread_mutex_unlock(&self->_mutex); });
+    _totalCostLimit = totalCostLimit;
+    [self private_evictToCostLimit];
+}
+
+- (NSUInteger)totalCost
+{
+    pthread_mutex_lock(&_mutex);
+    noz_defer(^{ pthread_mutex_unlock(&self->_mutex); });
+    return _totalCost;
+}
+
+- (NSUInteger)count
+{
+    pthread_mutex_lock(&_mutex);
+    noz_defer(^{ pthread_mutex_unlock(&self->_mutex); });
+    return _entries.count;
+}
+
+- (id)objectForKey:(id)key
+{
+    pthread_mutex_lock(&_mutex);
+    noz_defer(^{ pthread_mutex_unlock(&self->_mutex); });
+
+    NOZLRUCacheEntry *entry = _entries[key];
+    if (!entry) {
+        return nil;
+    }
+
+    if (entry != _head) {
+        [self private_unlinkEntry:entry];
+        [self private_pushEntryToFront:entry];
+    }
+    return entry->_object;
+}
+
+- (void)setObject:(id)object forKey:(id)key cost:(NSUInteger)cost
+{
+    NOZLRUCacheEntry *entry = [[NOZLRUCacheEntry alloc] init];
+    entry->_key = [key copyWithZone:NULL];
+    entry->_object = object;
+    entry->_cost = cost;
+
+    pthread_mutex_lock(&_mutex);
+    noz_defer(^{ pthread_mutex_unlock(&self->_mutex); });
+
+    NOZLRUCacheEntry *existingEntry = _entries[entry->_key];
+    if (existingEntry) {
+        [self private_unlinkEntry:existingEntry];
+        [_entries removeObjectForKey:existingEntry->_key];
+        _totalCost -= existingEntry->_cost;
+    }
+
+    if (cost > _totalCostLimit) {
+        return;
+    }
+
+    _entries[entry->_key] = entry;
+    [self private_pushEntryToFront:entry];
+    _totalCost += cost;
+    [self private_evictToCostLimit];
+}
+
+- (void)removeAllObjects
+{
+    pthread_mutex_lock(&_mutex);
+    noz_defer(^{ pthread_mutex_unlock(&self->_mutex); });
+    [self private_removeAllEntries];
+}
+
+#pragma mark Private
+
+- (void)private_unlinkEntry:(NOZLRUCacheEntry *)entry
+{
+    if (entry->_previous) {
+        entry->_previous->_next = entry->_next;
+    } else {
+        _head = entry->_next;
+    }
+    if (entry->_next) {
+        entry->_next->_previous = entry->_previous;
+    } else {
+        _tail = entry->_previous;
+    }
+    entry->_next = nil;
+    entry->_previous = nil;
+}
+
+- (void)private_pushEntryToFront:(NOZLRUCacheEntry *)entry
+{
+    entry->_next = _head;
+    if (_head) {
+        _head->_previous = entry;
+    } else {
+        _tail = entry;
+    }
+    _head = entry;
+}
+
+- (void)private_evictToCostLimit
+{
+    // caller holds the mutex
+    while (_totalCost > _totalCostLimit && _tail) {
+        NOZLRUCacheEntry *entry = _tail;
+        [self private_unlinkEntry:entry];
+        [_entries removeObjectForKey:entry->_key];
+        _totalCost -= entry->_cost;
+    }
+}
+
+- (void)private_removeAllEntries
+{
+    // unlink one at a time, releasing a long list all at once would recurse through every entry
+    while (_tail) {
+        NOZLRUCacheEntry *entry = _tail;
+        [self private_unlinkEntry:entry];
+    }
+    [_entries removeAllObjects];
+    _totalCost = 0;
+}
+
+@end
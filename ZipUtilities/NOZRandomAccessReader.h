@@ -0,0 +1,54 @@
+//
+//  NOZRandomAccessReader.h
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "NOZRandomAccessSource.h"
+#import "NOZUtils.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Reads from a `NOZRandomAccessSource` on behalf of `NOZUnzipper`.
+ Reads smaller than the source's `preferredReadLength` read a whole window of that length instead,
+ and the few most recently read windows serve the reads that follow (which are mostly adjacent when unzipping).
+ Thread safe.
+ */
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZRandomAccessReader : NSObject
+
+@property (nonatomic, readonly) id<NOZRandomAccessSource> source;
+@property (nonatomic, readonly) SInt64 length;
+
+- (instancetype)initWithSource:(id<NOZRandomAccessSource>)source length:(SInt64)length;
+
+/** Read exactly _length_ bytes at _offset_, the source's error is provided on failure */
+- (BOOL)readBytes:(void *)buffer length:(size_t)length offset:(off_t)offset error:(out NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
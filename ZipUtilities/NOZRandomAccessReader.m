@@ -0,0 +1,150 @@
+//
+//  NOZRandomAccessReader.m
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include <pthread.h>
+
+#import "NOZ_Project.h"
+#import "NOZError.h"
+#import "NOZRandomAccessReader.h"
+
+// Enough for the local file header and data of the record being read while the next one is started
+static const NSUInteger kNOZRandomAccessReaderMaxWindowCount = 4;
+
+@interface NOZRandomAccessReaderWindow : NSObject
+{
+@public
+    off_t _offset;
+    NSData *_data;
+}
+@end
+
+@implementation NOZRandomAccessReaderWindow
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZRandomAccessReader
+{
+    size_t _windowLength;
+    pthread_mutex_t _mutex;
+    NSMutableArray<NOZRandomAccessReaderWindow *> *_windows; // most recently used first
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithSource:(id<NOZRandomAccessSource>)source length:(SInt64)length
+{
+    if (self = [super init]) {
+        _source = source;
+        _length = length;
+        if ([source respondsToSelector:@selector(preferredReadLength)]) {
+            _windowLength = (size_t)[source preferredReadLength];
+        }
+        pthread_mutex_init(&_mutex, NULL);
+        _windows = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (BOOL)readBytes:(void *)buffer length:(size_t)length offset:(off_t)offset error:(out NSError **)error
+{
+    if (offset < 0 || (SInt64)length > _length || (SInt64)offset > (_length - (SInt64)length)) {
+        if (error) {
+            *error = NOZErrorCreate(NOZErrorCodeUnzipCannotReadRandomAccessSource, @{ @"offset" : @(offset), @"length" : @(length) });
+        }
+        return NO;
+    }
+
+    if (length >= _windowLength) {
+        return [self private_readFromSource:buffer length:length offset:offset error:error];
+    }
+
+    pthread_mutex_lock(&_mutex);
+    for (NSUInteger i = 0; i < _windows.count; i++) {
+        NOZRandomAccessReaderWindow *window = _windows[i];
+        if (offset >= window->_offset && (offset + (off_t)length) <= (window->_offset + (off_t)window->_data.length)) {
+            if (i > 0) {
+                [_windows removeObjectAtIndex:i];
+                [_windows insertObject:window atIndex:0];
+            }
+            memcpy(buffer, (const Byte *)window->_data.bytes + (offset - window->_offset), length);
+            pthread_mutex_unlock(&_mutex);
+            return YES;
+        }
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    // Not locked while reading, concurrent misses of the same window just read it twice
+
+    const size_t windowLength = (size_t)MIN((SInt64)_windowLength, _length - (SInt64)offset);
+    NSMutableData *data = [NSMutableData dataWithLength:windowLength];
+    if (!data) {
+        if (error) {
+            *error = NOZErrorCreate(NOZErrorCodeUnzipCannotReadRandomAccessSource, nil);
+        }
+        return NO;
+    }
+    if (![self private_readFromSource:data.mutableBytes length:windowLength offset:offset error:error]) {
+        return NO;
+    }
+    memcpy(buffer, data.bytes, length);
+
+    NOZRandomAccessReaderWindow *window = [[NOZRandomAccessReaderWindow alloc] init];
+    window->_offset = offset;
+    window->_data = data;
+
+    pthread_mutex_lock(&_mutex);
+    [_windows insertObject:window atIndex:0];
+    if (_windows.count > kNOZRandomAccessReaderMaxWindowCount) {
+        [_windows removeLastObject];
+    }
+    pthread_mutex_unlock(&_mutex);
+
+    return YES;
+}
+
+- (BOOL)private_readFromSource:(void *)buffer length:(size_t)length offset:(off_t)offset error:(out NSError **)error
+{
+    NSError *sourceError = nil;
+    if ([_source readAtOffset:(UInt64)offset length:length intoBuffer:buffer error:&sourceError]) {
+        return YES;
+    }
+    if (error) {
+        *error = sourceError ?: NOZErrorCreate(NOZErrorCodeUnzipCannotReadRandomAccessSource, nil);
+    }
+    return NO;
+}
+
+@end
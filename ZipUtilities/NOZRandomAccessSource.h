@@ -0,0 +1,138 @@
+//
+//  NOZRandomAccessSource.h
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ The bytes of an archive that `NOZUnzipper` reads from with positional reads.
+ See `-[NOZUnzipper initWithRandomAccessSource:]`.
+
+ Implementations must support concurrent reads (records of an unzipper can be read concurrently).
+ */
+@protocol NOZRandomAccessSource <NSObject>
+
+/**
+ The length of the source in bytes.
+ Called once each time an unzipper of the source is opened, a negative length fails opening.
+ */
+- (SInt64)lengthAndReturnError:(out NSError * __nullable * __nullable)error;
+
+/**
+ Read exactly _length_ bytes starting at _offset_ into _buffer_.
+ Reading fewer bytes is a failure.
+ */
+- (BOOL)readAtOffset:(UInt64)offset
+              length:(NSUInteger)length
+          intoBuffer:(nonnull void *)buffer
+               error:(out NSError * __nullable * __nullable)error;
+
+@optional
+
+/**
+ The minimum number of bytes to read at once.
+ Smaller reads are expanded to this length and the surplus is kept for the reads that follow,
+ coalescing the many small adjacent reads of unzipping (local file header, then the data that follows it) into few large ones.
+ Sources with an expensive cost per read (such as a request to a server) should provide a large length.
+ Not implementing this method (or returning `0`) reads exactly what is needed.
+ */
+- (NSUInteger)preferredReadLength;
+
+@end
+
+/**
+ A source reading from a file descriptor.
+ The descriptor must stay open for as long as the source is used.
+ An unzipper reads a file descriptor source through a duplicate of the descriptor,
+ so all `NOZUnzipperOpenOptions` (such as memory mapping) apply to it as they do to an archive opened by path.
+ */
+@interface NOZFileDescriptorSource : NSObject <NOZRandomAccessSource>
+
+/** The file descriptor */
+@property (nonatomic, readonly) int fileDescriptor;
+
+/** Designated initializer */
+- (nonnull instancetype)initWithFileDescriptor:(int)fileDescriptor NS_DESIGNATED_INITIALIZER;
+
+/** Unavailable */
+- (nonnull instancetype)init NS_UNAVAILABLE;
+/** Unavailable */
++ (nonnull instancetype)new NS_UNAVAILABLE;
+
+@end
+
+/**
+ A source reading from an archive in memory.
+ */
+@interface NOZDataSource : NSObject <NOZRandomAccessSource>
+
+/** The archive */
+@property (nonatomic, readonly, nonnull) NSData *data;
+
+/** Designated initializer */
+- (nonnull instancetype)initWithData:(nonnull NSData *)data NS_DESIGNATED_INITIALIZER;
+
+/** Unavailable */
+- (nonnull instancetype)init NS_UNAVAILABLE;
+/** Unavailable */
++ (nonnull instancetype)new NS_UNAVAILABLE;
+
+@end
+
+//! The default `preferredReadLength` of `NOZHTTPRangeSource` (256KB)
+static const NSUInteger NOZHTTPRangeSourceDefaultPreferredReadLength = 256 * 1024;
+
+/**
+ A source reading from a URL with HTTP range requests (`Range: bytes=first-last`),
+ such as an archive in object storage that can then be listed (and have single entries read) without being downloaded.
+
+ The length is determined with a request for the first byte of the resource (from the `Content-Range` of the response).
+ Each read is a synchronous request, so an unzipper of an HTTP source must not be used from the delegate queue of its `session`.
+ */
+@interface NOZHTTPRangeSource : NSObject <NOZRandomAccessSource>
+
+/** The URL of the archive */
+@property (nonatomic, readonly, nonnull) NSURL *URL;
+/** The session the range requests are made with */
+@property (nonatomic, readonly, nonnull) NSURLSession *session;
+/** The minimum number of bytes per request.  Default is `NOZHTTPRangeSourceDefaultPreferredReadLength`. */
+@property (nonatomic) NSUInteger preferredReadLength;
+/** The number of requests made so far */
+@property (nonatomic, readonly) NSUInteger requestCount;
+
+/**
+ Designated initializer
+ @param URL the URL of the archive
+ @param session the session to make requests with, `nil` for `[NSURLSession sharedSession]`
+ */
+- (nonnull instancetype)initWithURL:(nonnull NSURL *)URL session:(nullable NSURLSession *)session NS_DESIGNATED_INITIALIZER;
+
+/** Unavailable */
+- (nonnull instancetype)init NS_UNAVAILABLE;
+/** Unavailable */
++ (nonnull instancetype)new NS_UNAVAILABLE;
+
+@end
@@ -0,0 +1,272 @@
+//
+//  NOZRandomAccessSource.m
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#import "NOZ_Project.h"
+#import "NOZError.h"
+#import "NOZRandomAccessSource.h"
+
+static NSError *noz_source_error(NSDictionary *userInfo, NSError *underlyingError);
+
+@implementation NOZFileDescriptorSource
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithFileDescriptor:(int)fileDescriptor
+{
+    if (self = [super init]) {
+        _fileDescriptor = fileDescriptor;
+    }
+    return self;
+}
+
+- (SInt64)lengthAndReturnError:(out NSError **)error
+{
+    struct stat fileStat;
+    if (0 != fstat(_fileDescriptor, &fileStat)) {
+        if (error) {
+            *error = noz_source_error(nil, [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil]);
+        }
+        return -1;
+    }
+    return (SInt64)fileStat.st_size;
+}
+
+- (BOOL)readAtOffset:(UInt64)offset length:(NSUInteger)length intoBuffer:(void *)buffer error:(out NSError **)error
+{
+    Byte *cursor = (Byte *)buffer;
+    while (length > 0) {
+        const ssize_t bytesRead = pread(_fileDescriptor, cursor, length, (off_t)offset);
+        if (bytesRead < 0 && EINTR == errno) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            if (error) {
+                *error = noz_source_error(nil, (bytesRead < 0) ? [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil] : nil);
+            }
+            return NO;
+        }
+        cursor += bytesRead;
+        length -= (NSUInteger)bytesRead;
+        offset += (UInt64)bytesRead;
+    }
+    return YES;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p, fd=%d>", NSStringFromClass([self class]), self, _fileDescriptor];
+}
+
+@end
+
+@implementation NOZDataSource
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithData:(NSData *)data
+{
+    if (self = [super init]) {
+        _data = [data copy];
+    }
+    return self;
+}
+
+- (SInt64)lengthAndReturnError:(out NSError **)error
+{
+    return (SInt64)_data.length;
+}
+
+- (BOOL)readAtOffset:(UInt64)offset length:(NSUInteger)length intoBuffer:(void *)buffer error:(out NSError **)error
+{
+    if (offset > (UInt64)_data.length || (UInt64)length > ((UInt64)_data.length - offset)) {
+        if (error) {
+            *error = noz_source_error(nil, nil);
+        }
+        return NO;
+    }
+    [_data getBytes:buffer range:NSMakeRange((NSUInteger)offset, length)];
+    return YES;
+}
+
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZHTTPRangeSource (/* direct declarations */)
+- (nullable NSData *)private_dataInRangeFrom:(UInt64)firstByte
+                                          to:(UInt64)lastByte
+                                    response:(out NSHTTPURLResponse **)responseOut
+                                       error:(out NSError **)error;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZHTTPRangeSource
+{
+    atomic_size_t _requestCount;
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithURL:(NSURL *)URL session:(NSURLSession *)session
+{
+    if (self = [super init]) {
+        _URL = [URL copy];
+        _session = session ?: [NSURLSession sharedSession];
+        _preferredReadLength = NOZHTTPRangeSourceDefaultPreferredReadLength;
+        atomic_init(&_requestCount, 0);
+    }
+    return self;
+}
+
+- (NSUInteger)requestCount
+{
+    return atomic_load(&_requestCount);
+}
+
+- (SInt64)lengthAndReturnError:(out NSError **)error
+{
+    // Ask for the first byte, the total length is in the Content-Range of the response ("bytes 0-0/length")
+
+    NSHTTPURLResponse *response = nil;
+    if (![self private_dataInRangeFrom:0 to:0 response:&response error:error]) {
+        return -1;
+    }
+
+    NSString *contentRange = nil;
+    for (NSString *field in response.allHeaderFields) {
+        if (NSOrderedSame == [field caseInsensitiveCompare:@"Content-Range"]) {
+            contentRange = response.allHeaderFields[field];
+            break;
+        }
+    }
+
+    const NSRange slashRange = [contentRange rangeOfString:@"/" options:NSBackwardsSearch];
+    NSString *lengthString = (slashRange.location != NSNotFound) ? [contentRange substringFromIndex:NSMaxRange(slashRange)] : nil;
+    NSScanner *scanner = (lengthString) ? [NSScanner scannerWithString:lengthString] : nil;
+    long long length = -1;
+    if (!scanner || ![scanner scanLongLong:&length] || !scanner.isAtEnd || length < 0) {
+        if (error) {
+            *error = noz_source_error(@{ @"URL" : _URL, @"Content-Range" : contentRange ?: [NSNull null] }, nil);
+        }
+        return -1;
+    }
+
+    return (SInt64)length;
+}
+
+- (BOOL)readAtOffset:(UInt64)offset length:(NSUInteger)length intoBuffer:(void *)buffer error:(out NSError **)error
+{
+    if (0 == length) {
+        return YES;
+    }
+
+    NSData *data = [self private_dataInRangeFrom:offset to:offset + length - 1 response:NULL error:error];
+    if (!data) {
+        return NO;
+    }
+    if (data.length != length) {
+        if (error) {
+            *error = noz_source_error(@{ @"URL" : _URL, @"offset" : @(offset), @"length" : @(length), @"receivedLength" : @(data.length) }, nil);
+        }
+        return NO;
+    }
+
+    [data getBytes:buffer length:length];
+    return YES;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p, URL=%@>", NSStringFromClass([self class]), self, _URL];
+}
+
+#pragma mark Private
+
+- (NSData *)private_dataInRangeFrom:(UInt64)firstByte
+                                 to:(UInt64)lastByte
+                           response:(out NSHTTPURLResponse **)responseOut
+                              error:(out NSError **)error
+{
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:_URL];
+    [request setValue:[NSString stringWithFormat:@"bytes=%llu-%llu", firstByte, lastByte] forHTTPHeaderField:@"Range"];
+
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block NSData *data = nil;
+    __block NSURLResponse *response = nil;
+    __block NSError *requestError = nil;
+    NSURLSessionDataTask *task = [_session dataTaskWithRequest:request
+                                             completionHandler:^(NSData *taskData, NSURLResponse *taskResponse, NSError *taskError) {
+        data = taskData;
+        response = taskResponse;
+        requestError = taskError;
+        dispatch_semaphore_signal(semaphore);
+    }];
+    atomic_fetch_add(&_requestCount, 1);
+    [task resume];
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+
+    // Only a partial content response has the requested range (a server ignoring the range responds with everything)
+
+    NSHTTPURLResponse *HTTPResponse = [response isKindOfClass:[NSHTTPURLResponse class]] ? (NSHTTPURLResponse *)response : nil;
+    if (!data || 206 != HTTPResponse.statusCode) {
+        if (error) {
+            *error = noz_source_error(@{ @"URL" : _URL, @"statusCode" : @(HTTPResponse.statusCode) }, requestError);
+        }
+        return nil;
+    }
+
+    if (responseOut) {
+        *responseOut = HTTPResponse;
+    }
+    return data;
+}
+
+@end
+
+static NSError *noz_source_error(NSDictionary *userInfo, NSError *underlyingError)
+{
+    NSMutableDictionary *errorInfo = [NSMutableDictionary dictionaryWithDictionary:userInfo ?: @{}];
+    if (underlyingError) {
+        errorInfo[NSUnderlyingErrorKey] = underlyingError;
+    }
+    return NOZErrorCreate(NOZErrorCodeUnzipCannotReadRandomAccessSource, errorInfo);
+}
@@ -145,4 +145,20 @@ NOZ_OBJC_DIRECT_MEMBERS
     return YES;
 }
 
+- (BOOL)decodeAllBytes:(const Byte*)bytes
+                length:(size_t)length
+              bitFlags:(UInt16)flags
+            intoBuffer:(Byte*)buffer
+              capacity:(size_t)capacity
+         decodedLength:(size_t *)decodedLength
+{
+    if (length > capacity) {
+        return NO;
+    }
+
+    memcpy(buffer, bytes, length);
+    *decodedLength = length;
+    return YES;
+}
+
 @end
@@ -0,0 +1,59 @@
+//
+//  NOZSpillBuffer.h
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "NOZUtils.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Accumulates bytes in memory up to a limit, beyond which they spill over to a temporary file
+ (unlinked as soon as it is created so it never outlives the buffer).
+
+ Not thread safe.
+ */
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZSpillBuffer : NSObject
+
+@property (nonatomic, readonly) UInt64 length;
+@property (nonatomic, readonly) BOOL didSpill;
+
+- (instancetype)initWithMemoryLimit:(size_t)memoryLimit
+             temporaryDirectoryPath:(NSString *)temporaryDirectoryPath NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+- (BOOL)appendBytes:(const void *)bytes length:(size_t)length;
+
+/** Enumerate the buffered bytes in order, spilled bytes are read back in large chunks.  Stops when _block_ returns `NO`. */
+- (BOOL)enumerateBytesUsingBlock:(BOOL (NS_NOESCAPE ^)(const Byte *bytes, size_t length))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
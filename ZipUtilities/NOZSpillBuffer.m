@@ -0,0 +1,184 @@
+//
+//  NOZSpillBuffer.m
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#import "NOZ_Project.h"
+#import "NOZSpillBuffer.h"
+
+// Once spilled, appended bytes are coalesced into writes (and read back) in chunks of this size
+static const size_t kNOZSpillChunkSize = 1024 * 1024;
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZSpillBuffer (/* direct declarations */)
+- (BOOL)private_spill;
+- (BOOL)private_writePendingBytes;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZSpillBuffer
+{
+    size_t _memoryLimit;
+    NSString *_temporaryDirectoryPath;
+    NSMutableData *_data; // all the bytes until spilled, then the bytes pending a write
+    int _fileDescriptor;
+    BOOL _failed;
+}
+
+- (void)dealloc
+{
+    if (_fileDescriptor >= 0) {
+        close(_fileDescriptor);
+    }
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithMemoryLimit:(size_t)memoryLimit temporaryDirectoryPath:(NSString *)temporaryDirectoryPath
+{
+    if (self = [super init]) {
+        _memoryLimit = memoryLimit;
+        _temporaryDirectoryPath = [temporaryDirectoryPath copy];
+        _data = [[NSMutableData alloc] init];
+        _fileDescriptor = -1;
+    }
+    return self;
+}
+
+- (BOOL)didSpill
+{
+    return _fileDescriptor >= 0;
+}
+
+- (BOOL)appendBytes:(const void *)bytes length:(size_t)length
+{
+    if (_failed) {
+        return NO;
+    }
+
+    if (_fileDescriptor < 0 && (_data.length + length) > _memoryLimit && ![self private_spill]) {
+        _failed = YES;
+        return NO;
+    }
+
+    [_data appendBytes:bytes length:length];
+    _length += length;
+
+    if (_fileDescriptor >= 0 && _data.length >= kNOZSpillChunkSize && ![self private_writePendingBytes]) {
+        _failed = YES;
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)enumerateBytesUsingBlock:(BOOL (NS_NOESCAPE ^)(const Byte *bytes, size_t length))block
+{
+    if (_failed) {
+        return NO;
+    }
+
+    if (_fileDescriptor < 0) {
+        return (0 == _data.length) || block(_data.bytes, _data.length);
+    }
+
+    if (![self private_writePendingBytes]) {
+        _failed = YES;
+        return NO;
+    }
+
+    Byte *buffer = malloc(kNOZSpillChunkSize);
+    if (!buffer) {
+        return NO;
+    }
+    noz_defer(^{ free(buffer); });
+
+    off_t offset = 0;
+    while ((UInt64)offset < _length) {
+        const size_t chunkSize = (size_t)MIN((UInt64)kNOZSpillChunkSize, _length - (UInt64)offset);
+        const ssize_t bytesRead = pread(_fileDescriptor, buffer, chunkSize, offset);
+        if (bytesRead < 0 && EINTR == errno) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            return NO;
+        }
+        if (!block(buffer, (size_t)bytesRead)) {
+            return NO;
+        }
+        offset += bytesRead;
+    }
+
+    return YES;
+}
+
+#pragma mark Private
+
+- (BOOL)private_spill
+{
+    NSString *template = [_temporaryDirectoryPath stringByAppendingPathComponent:@"noz.spill.XXXXXX"];
+    char *path = strdup(template.fileSystemRepresentation);
+    if (!path) {
+        return NO;
+    }
+    noz_defer(^{ free(path); });
+
+    _fileDescriptor = mkstemp(path);
+    if (_fileDescriptor < 0) {
+        return NO;
+    }
+    unlink(path);
+    fcntl(_fileDescriptor, F_SETFD, FD_CLOEXEC);
+
+    return [self private_writePendingBytes];
+}
+
+- (BOOL)private_writePendingBytes
+{
+    const Byte *bytes = _data.bytes;
+    size_t remaining = _data.length;
+    while (remaining > 0) {
+        const ssize_t bytesWritten = write(_fileDescriptor, bytes, remaining);
+        if (bytesWritten < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return NO;
+        }
+        bytes += bytesWritten;
+        remaining -= (size_t)bytesWritten;
+    }
+    _data.length = 0;
+    return YES;
+}
+
+@end
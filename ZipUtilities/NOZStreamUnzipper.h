@@ -0,0 +1,167 @@
+//
+//  NOZStreamUnzipper.h
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import <ZipUtilities/NOZUnzipper.h>
+#import <ZipUtilities/NOZUtils.h>
+#import <ZipUtilities/NOZZipEntry.h>
+
+@class NOZStreamUnzipperEntry;
+
+/**
+ `NOZStreamUnzipper` unzips an archive in a single forward pass over an `NSInputStream`.
+
+ Unlike `NOZUnzipper`, the archive does not need to be seekable (or even complete) so entries
+ can be extracted from a pipe or network stream as the archive is received.
+ The local file header of each entry is read in order and the central directory is never read.
+
+ Entries with `NOZFlagBitsFileMetadataInDescriptor` set have their sizes and checksum in a data descriptor
+ following their data.  Such entries are delimited by locating the data descriptor's signature and matching
+ its compressed size with the number of bytes that preceded it, so data descriptors without a signature are not supported.
+ When the decoder reaches the end of an entry's compressed data (such as with deflate) and no data descriptor signature follows,
+ reading the entry fails with `NOZErrorCodeUnzipDataDescriptorWithoutSignatureNotSupported`.
+ Otherwise (such as for stored entries) it fails with `NOZErrorCodeUnzipCannotLocateDataDescriptor` once the stream ends.
+
+ Uses the globally registered compression decoders.  See `NOZDecoderForCompressionMethod` and `NOZUpdateCompressionMethodDecoder` in `NOZCompression.h`.
+
+ ### Thread Safety
+
+ `NOZStreamUnzipper` is not thread safe, it must be used from one thread at a time.
+
+ ### Example
+
+    - (BOOL)unzipStream:(NSInputStream *)stream error:(out NSError **)error
+    {
+        NOZStreamUnzipper *unzipper = [[NOZStreamUnzipper alloc] initWithInputStream:stream];
+        if (![unzipper openAndReturnError:error]) {
+            return NO;
+        }
+
+        NSError *readError = nil;
+        NOZStreamUnzipperEntry *entry = nil;
+        while ((entry = [unzipper readNextEntryAndReturnError:&readError]) != nil) {
+            NSOutputStream *outputStream = [self outputStreamForEntryName:entry.name];
+            [outputStream open];
+            const BOOL success = [unzipper enumerateByteRangesOfEntry:entry
+                                                        progressBlock:NULL
+                                                           usingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+                *stop = ((NSInteger)byteRange.length != [outputStream write:bytes maxLength:byteRange.length]);
+            }
+                                                                error:error];
+            [outputStream close];
+            if (!success) {
+                return NO;
+            }
+        }
+
+        if (readError) {
+            if (error) {
+                *error = readError;
+            }
+            return NO;
+        }
+
+        return [unzipper closeAndReturnError:error];
+    }
+ */
+@interface NOZStreamUnzipper : NSObject
+
+/** The stream being unzipped */
+@property (nonatomic, readonly, nonnull) NSInputStream *inputStream;
+
+/** Designated initializer */
+- (nonnull instancetype)initWithInputStream:(nonnull NSInputStream *)inputStream NS_DESIGNATED_INITIALIZER;
+
+/** Unavailable */
+- (nonnull instancetype)init NS_UNAVAILABLE;
+/** Unavailable */
++ (nonnull instancetype)new NS_UNAVAILABLE;
+
+/**
+ Open the unzipper (and the input stream if it is not already open).
+ */
+- (BOOL)openAndReturnError:(out NSError * __nullable * __nullable)error;
+
+/**
+ Close the unzipper (and the input stream).
+ */
+- (BOOL)closeAndReturnError:(out NSError * __nullable * __nullable)error;
+
+/**
+ Read the local file header of the next entry.
+ If the data of the previous entry was not enumerated, it is skipped over (without being decompressed).
+ @return the next entry or `nil`.  Once the end of the entries is reached (the central directory or the end of the stream), `nil` is returned without an _error_.
+ */
+- (nullable NOZStreamUnzipperEntry *)readNextEntryAndReturnError:(out NSError * __nullable * __nullable)error;
+
+/**
+ Stream the data of _entry_ to _block_ as it is read from the input stream.
+ _entry_ must be the entry that was last returned by `readNextEntryAndReturnError:` and can only be enumerated once.
+ The _totalBytes_ provided to _progressBlock_ are `-1` when the compressed size is in a data descriptor.
+ */
+- (BOOL)enumerateByteRangesOfEntry:(nonnull NOZStreamUnzipperEntry *)entry
+                     progressBlock:(nullable NOZProgressBlock)progressBlock
+                        usingBlock:(nonnull NOZUnzipByteRangeEnumerationBlock)block
+                             error:(out NSError * __nullable * __nullable)error;
+
+/**
+ Read the data of _entry_ as `NSData`.
+ See `enumerateByteRangesOfEntry:progressBlock:usingBlock:error:`.
+ */
+- (nullable NSData *)readDataFromEntry:(nonnull NOZStreamUnzipperEntry *)entry
+                         progressBlock:(nullable NOZProgressBlock)progressBlock
+                                 error:(out NSError * __nullable * __nullable)error;
+
+@end
+
+/**
+ An entry populated from a local file header read by `NOZStreamUnzipper`.
+ */
+@interface NOZStreamUnzipperEntry : NSObject <NOZZipEntry>
+/** name of entry */
+@property (nonatomic, readonly, nonnull) NSString *name;
+/** comment for entry, always `nil` since comments are only in the central directory */
+@property (nonatomic, readonly, nullable) NSString *comment;
+/** compression method for entry */
+@property (nonatomic, readonly) NOZCompressionMethod compressionMethod;
+/** compression level for entry (best guess when unzipping) */
+@property (nonatomic, readonly) NOZCompressionLevel compressionLevel;
+/** modification date of the entry */
+@property (nonatomic, readonly, nullable) NSDate *timestamp;
+/** The sizes and checksum are in a data descriptor following the entry's data, see `NOZFlagBitsFileMetadataInDescriptor` */
+@property (nonatomic, readonly) BOOL hasDataDescriptor;
+/** compressed size of entry, `-1` until the data has been read if the entry `hasDataDescriptor` */
+@property (nonatomic, readonly) SInt64 compressedSize;
+/** uncompressed size of entry, `-1` until the data has been read if the entry `hasDataDescriptor` */
+@property (nonatomic, readonly) SInt64 uncompressedSize;
+
+/** Unavailable */
+- (nonnull instancetype)init NS_UNAVAILABLE;
+/** Unavailable */
++ (nonnull instancetype)new NS_UNAVAILABLE;
+@end
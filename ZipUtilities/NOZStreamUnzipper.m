@@ -0,0 +1,735 @@
+//
+//  NOZStreamUnzipper.m
+//  ZipUtilities
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Nolan O'Brien
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#import "NOZ_Project.h"
+#import "NOZCompressionLibrary.h"
+#import "NOZError.h"
+#import "NOZStreamUnzipper.h"
+#import "NOZUtils_Project.h"
+
+#define NOZStringEncodingDOSLatinUS CFStringConvertEncodingToNSStringEncoding(kCFStringEncodingDOSLatinUS)
+
+// A candidate data descriptor is only matched once the bytes for the largest (ZIP64) data descriptor
+// and the signature of the record that follows it have been buffered.
+static const size_t kNOZDataDescriptorSize = 4 + 4 + 4 + 4;
+static const size_t kNOZZip64DataDescriptorSize = 4 + 4 + 8 + 8;
+static const size_t kNOZDataDescriptorLookAhead = kNOZZip64DataDescriptorSize + 4;
+
+typedef struct _NOZStreamBufferT
+{
+    Byte *bytes;
+    size_t capacity;
+    size_t start; // first unconsumed byte
+    size_t end; // exclusive
+    BOOL reachedEndOfStream;
+} NOZStreamBufferT;
+
+typedef struct _NOZStreamUnzipStateT
+{
+    UInt32 crc32;
+    UInt64 bytesDecompressed;
+} NOZStreamUnzipStateT;
+
+static BOOL noz_stream_buffer_fill(NOZStreamBufferT *buffer, NSInputStream *stream, size_t length);
+static size_t noz_match_data_descriptor(const Byte *bytes, size_t length, BOOL reachedEndOfStream, UInt64 dataLength, BOOL zip64);
+
+NS_INLINE size_t noz_stream_buffer_length(const NOZStreamBufferT *buffer)
+{
+    return buffer->end - buffer->start;
+}
+
+@interface NOZStreamUnzipperEntry ()
+- (nullable instancetype)initWithLocalFileHeader:(const Byte *)header length:(size_t)length;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZStreamUnzipperEntry (/* direct declarations */)
+- (NOZFileEntryT *)private_internalEntry;
+- (BOOL)private_hasZip64LocalExtraField;
+- (void)private_setSizesFromDataDescriptor:(const NOZLocalFileDescriptorT *)fileDescriptor;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZStreamUnzipper (/* direct declarations */)
+- (BOOL)private_readDataOfEntry:(NOZStreamUnzipperEntry *)entry
+                  progressBlock:(nullable NOZProgressBlock)progressBlock
+                     usingBlock:(nullable NOZUnzipByteRangeEnumerationBlock)block
+                          error:(out NSError **)error;
+- (BOOL)private_readCompressedBytesOfEntry:(NOZStreamUnzipperEntry *)entry
+                                   decoder:(nullable id<NOZDecoder>)decoder
+                                   context:(nullable id<NOZDecoderContext>)context
+                             progressBlock:(nullable NOZProgressBlock)progressBlock
+                                     error:(out NSError **)error;
+- (BOOL)private_readCompressedBytesUntilDataDescriptorOfEntry:(NOZStreamUnzipperEntry *)entry
+                                                      decoder:(nullable id<NOZDecoder>)decoder
+                                                      context:(nullable id<NOZDecoderContext>)context
+                                                progressBlock:(nullable NOZProgressBlock)progressBlock
+                                                        error:(out NSError **)error;
+- (NSError *)private_readError;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZStreamUnzipper
+{
+    NOZStreamBufferT _buffer;
+    NOZStreamUnzipperEntry *_currentEntry;
+    BOOL _currentEntryDataWasRead;
+    BOOL _isOpen;
+    BOOL _reachedEndOfEntries;
+}
+
+- (void)dealloc
+{
+    [self closeAndReturnError:NULL];
+}
+
+- (instancetype)initWithInputStream:(NSInputStream *)inputStream
+{
+    if (self = [super init]) {
+        _inputStream = inputStream;
+    }
+    return self;
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (BOOL)openAndReturnError:(out NSError **)error
+{
+    if (_isOpen) {
+        return YES;
+    }
+
+    if (NSStreamStatusNotOpen == _inputStream.streamStatus) {
+        [_inputStream open];
+    }
+    if (NSStreamStatusError == _inputStream.streamStatus || NSStreamStatusClosed == _inputStream.streamStatus) {
+        if (error) {
+            *error = NOZErrorCreate(NOZErrorCodeUnzipCannotOpenZip, _inputStream.streamError ? @{ NSUnderlyingErrorKey : _inputStream.streamError } : nil);
+        }
+        return NO;
+    }
+
+    _buffer.capacity = NOZBufferSize() * 4;
+    _buffer.bytes = malloc(_buffer.capacity);
+    _buffer.start = _buffer.end = 0;
+    _buffer.reachedEndOfStream = NO;
+    _isOpen = YES;
+    _reachedEndOfEntries = NO;
+    return YES;
+}
+
+- (BOOL)closeAndReturnError:(out NSError **)error
+{
+    if (!_isOpen) {
+        return YES;
+    }
+
+    [_inputStream close];
+    free(_buffer.bytes);
+    _buffer.bytes = NULL;
+    _buffer.capacity = _buffer.start = _buffer.end = 0;
+    _currentEntry = nil;
+    _isOpen = NO;
+    return YES;
+}
+
+- (NOZStreamUnzipperEntry *)readNextEntryAndReturnError:(out NSError * __autoreleasing *)error
+{
+    __block NSError *stackError = nil;
+    noz_defer(^{
+        if (stackError && error) {
+            *error = stackError;
+        }
+    });
+
+    if (!_isOpen) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipMustOpenUnzipperBeforeManipulating, nil);
+        return nil;
+    }
+
+    if (_currentEntry && !_currentEntryDataWasRead) {
+        if (![self private_readDataOfEntry:_currentEntry progressBlock:NULL usingBlock:NULL error:&stackError]) {
+            return nil;
+        }
+    }
+    _currentEntry = nil;
+
+    if (_reachedEndOfEntries) {
+        return nil;
+    }
+
+    if (!noz_stream_buffer_fill(&_buffer, _inputStream, 4)) {
+        if (0 == noz_stream_buffer_length(&_buffer) && _buffer.reachedEndOfStream) {
+            _reachedEndOfEntries = YES;
+        } else {
+            stackError = [self private_readError];
+        }
+        return nil;
+    }
+
+    const UInt32 signature = NOZReadLittleEndian32(_buffer.bytes + _buffer.start);
+    if (NOZMagicNumberLocalFileHeader != signature) {
+        if (NOZMagicNumberCentralDirectoryFileRecord == signature ||
+            NOZMagicNumberZip64EndOfCentralDirectoryRecord == signature ||
+            NOZMagicNumberEndOfCentralDirectoryRecord == signature) {
+            _reachedEndOfEntries = YES;
+        } else {
+            stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, nil);
+        }
+        return nil;
+    }
+
+    if (!noz_stream_buffer_fill(&_buffer, _inputStream, NOZLocalFileHeaderFixedSize)) {
+        stackError = [self private_readError];
+        return nil;
+    }
+
+    const Byte *header = _buffer.bytes + _buffer.start;
+    const size_t headerSize = NOZLocalFileHeaderFixedSize + NOZReadLittleEndian16(header + 26) + NOZReadLittleEndian16(header + 28);
+    if (!noz_stream_buffer_fill(&_buffer, _inputStream, headerSize)) {
+        stackError = [self private_readError];
+        return nil;
+    }
+
+    NOZStreamUnzipperEntry *entry = [[NOZStreamUnzipperEntry alloc] initWithLocalFileHeader:_buffer.bytes + _buffer.start
+                                                                                      length:headerSize];
+    if (!entry) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, nil);
+        return nil;
+    }
+    _buffer.start += headerSize;
+
+    // the entry's data must still be consumed (or skipped) before the next entry can be read
+    _currentEntry = entry;
+    _currentEntryDataWasRead = NO;
+
+    const NOZLocalFileHeaderT *fileHeader = &entry.private_internalEntry->fileHeader;
+    if ((fileHeader->bitFlag & NOZFlagBitsEncrypted)) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipDecompressionEncryptionNotSupported, @{ @"name" : entry.name });
+        return nil;
+    }
+    if ((fileHeader->versionForExtraction & 0x00ff) > (NOZVersionForZip64Extraction & 0x00ff)) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipUnsupportedRecordVersion, @{ @"name" : entry.name });
+        return nil;
+    }
+
+    return entry;
+}
+
+- (BOOL)enumerateByteRangesOfEntry:(NOZStreamUnzipperEntry *)entry
+                     progressBlock:(NOZProgressBlock)progressBlock
+                        usingBlock:(NOZUnzipByteRangeEnumerationBlock)block
+                             error:(out NSError **)error
+{
+    return [self private_readDataOfEntry:entry
+                           progressBlock:progressBlock
+                              usingBlock:block
+                                   error:error];
+}
+
+- (NSData *)readDataFromEntry:(NOZStreamUnzipperEntry *)entry
+                progressBlock:(NOZProgressBlock)progressBlock
+                        error:(out NSError **)error
+{
+    __block NSMutableData *data = nil;
+    if (![self enumerateByteRangesOfEntry:entry
+                            progressBlock:progressBlock
+                               usingBlock:^(const void * __nonnull bytes,
+                                            NSRange byteRange,
+                                            BOOL * __nonnull stop) {
+                                   if (!data) {
+                                       data = [NSMutableData dataWithCapacity:MAX(byteRange.length, (NSUInteger)MAX(entry.uncompressedSize, 0))];
+                                   }
+                                   [data appendBytes:bytes length:byteRange.length];
+                               }
+                                    error:error]) {
+        return nil;
+    }
+
+    return data ?: [NSData data];
+}
+
+#pragma mark Private
+
+- (BOOL)private_readDataOfEntry:(NOZStreamUnzipperEntry *)entry
+                  progressBlock:(NOZProgressBlock)progressBlock
+                     usingBlock:(NOZUnzipByteRangeEnumerationBlock)block
+                          error:(out NSError * __autoreleasing *)error
+{
+    __block NSError *stackError = nil;
+    noz_defer(^{
+        if (stackError && error) {
+            *error = stackError;
+        }
+    });
+
+    if (!_isOpen) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipMustOpenUnzipperBeforeManipulating, nil);
+        return NO;
+    }
+
+    if (entry != _currentEntry || _currentEntryDataWasRead) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, @{ @"name" : entry.name });
+        return NO;
+    }
+    _currentEntryDataWasRead = YES;
+
+    const NOZFileEntryT *internalEntry = entry.private_internalEntry;
+
+    // Without a block, the data is skipped over without being decoded
+    id<NOZDecoder> decoder = nil;
+    id<NOZDecoderContext> decoderContext = nil;
+    NOZStreamUnzipStateT state = { 0, 0 };
+    if (block) {
+        decoder = [[NOZCompressionLibrary sharedInstance] decoderForMethod:internalEntry->fileHeader.compressionMethod];
+        if (!decoder) {
+            stackError = NOZErrorCreate(NOZErrorCodeUnzipDecompressionMethodNotSupported, nil);
+            return NO;
+        }
+
+        NOZStreamUnzipStateT *statePtr = &state;
+        NOZFlushCallback flushCallback = ^BOOL(id coder,
+                                               id context,
+                                               const Byte* bufferToFlush,
+                                               size_t length) {
+            if (decoder != coder) {
+                return NO;
+            }
+
+            statePtr->crc32 = (UInt32)crc32(statePtr->crc32, bufferToFlush, (UInt32)length);
+            statePtr->bytesDecompressed += length;
+
+            BOOL stop = NO;
+            block(bufferToFlush, NSMakeRange((NSUInteger)(statePtr->bytesDecompressed - length), (NSUInteger)length), &stop);
+            return !stop;
+        };
+        decoderContext = [decoder createContextForDecodingWithBitFlags:internalEntry->fileHeader.bitFlag
+                                                         flushCallback:flushCallback];
+        if (!decoderContext) {
+            stackError = NOZErrorCreate(NOZErrorCodeUnzipDecompressionMethodNotSupported, nil);
+            return NO;
+        }
+
+        if (![decoder initializeDecoderContext:decoderContext]) {
+            stackError = NOZErrorCreate(NOZErrorCodeUnzipFailedToDecompressEntry, nil);
+            return NO;
+        }
+    }
+
+    BOOL success;
+    if (entry.hasDataDescriptor) {
+        success = [self private_readCompressedBytesUntilDataDescriptorOfEntry:entry
+                                                                      decoder:decoder
+                                                                      context:decoderContext
+                                                                progressBlock:progressBlock
+                                                                        error:&stackError];
+    } else {
+        success = [self private_readCompressedBytesOfEntry:entry
+                                                   decoder:decoder
+                                                   context:decoderContext
+                                             progressBlock:progressBlock
+                                                     error:&stackError];
+    }
+
+    if (!decoder) {
+        return success;
+    }
+
+    if (success) {
+        while (!decoderContext.hasFinished) {
+            if (![decoder decodeBytes:NULL length:0 context:decoderContext]) {
+                success = NO;
+                break;
+            }
+        }
+    }
+
+    if (![decoder finalizeDecoderContext:decoderContext] || !success) {
+        if (!stackError) {
+            stackError = NOZErrorCreate(NOZErrorCodeUnzipFailedToDecompressEntry, nil);
+        }
+        return NO;
+    }
+
+    if (state.crc32 != internalEntry->fileDescriptor.crc32 || state.bytesDecompressed != internalEntry->fileDescriptor.uncompressedSize) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipChecksumMissmatch, nil);
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)private_readCompressedBytesOfEntry:(NOZStreamUnzipperEntry *)entry
+                                   decoder:(id<NOZDecoder>)decoder
+                                   context:(id<NOZDecoderContext>)context
+                             progressBlock:(NOZProgressBlock)progressBlock
+                                     error:(out NSError **)error
+{
+    const SInt64 compressedBytesTotal = (SInt64)entry.private_internalEntry->fileDescriptor.compressedSize;
+    SInt64 compressedBytesLeft = compressedBytesTotal;
+
+    while (compressedBytesLeft > 0) {
+        if (0 == noz_stream_buffer_length(&_buffer) && !noz_stream_buffer_fill(&_buffer, _inputStream, 1)) {
+            *error = [self private_readError];
+            return NO;
+        }
+
+        size_t length = noz_stream_buffer_length(&_buffer);
+        if ((SInt64)length > compressedBytesLeft) {
+            length = (size_t)compressedBytesLeft;
+        }
+
+        if (decoder && ![decoder decodeBytes:_buffer.bytes + _buffer.start length:length context:context]) {
+            return NO;
+        }
+        _buffer.start += length;
+        compressedBytesLeft -= (SInt64)length;
+
+        if (progressBlock) {
+            BOOL stop = NO;
+            progressBlock(compressedBytesTotal, compressedBytesTotal - compressedBytesLeft, (SInt64)length, &stop);
+            if (stop) {
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ECANCELED userInfo:nil];
+                return NO;
+            }
+        }
+    }
+
+    return YES;
+}
+
+- (BOOL)private_readCompressedBytesUntilDataDescriptorOfEntry:(NOZStreamUnzipperEntry *)entry
+                                                      decoder:(id<NOZDecoder>)decoder
+                                                      context:(id<NOZDecoderContext>)context
+                                                progressBlock:(NOZProgressBlock)progressBlock
+                                                        error:(out NSError **)error
+{
+    // The compressed size is unknown until the data descriptor is found.
+    // Bytes are only passed along once no data descriptor can start at them.
+
+    const BOOL zip64 = entry.private_hasZip64LocalExtraField;
+    UInt64 compressedBytesRead = 0;
+
+    while (YES) {
+        const BOOL reachedEndOfStream = _buffer.reachedEndOfStream;
+        const Byte *bytes = _buffer.bytes + _buffer.start;
+        const size_t length = noz_stream_buffer_length(&_buffer);
+
+        size_t searchLength = 0;
+        if (reachedEndOfStream) {
+            searchLength = (length >= kNOZDataDescriptorSize) ? (length - kNOZDataDescriptorSize + 1) : 0;
+        } else {
+            searchLength = (length >= kNOZDataDescriptorLookAhead) ? (length - kNOZDataDescriptorLookAhead + 1) : 0;
+        }
+
+        size_t dataLength = searchLength;
+        size_t descriptorSize = 0;
+        const Byte *candidate = bytes;
+        while ((candidate = memchr(candidate, 'P', searchLength - (size_t)(candidate - bytes))) != NULL) {
+            if (NOZMagicNumberDataDescriptor == NOZReadLittleEndian32(candidate)) {
+                const size_t offset = (size_t)(candidate - bytes);
+                descriptorSize = noz_match_data_descriptor(candidate, length - offset, reachedEndOfStream, compressedBytesRead + offset, zip64);
+                if (descriptorSize > 0) {
+                    dataLength = offset;
+                    break;
+                }
+            }
+            candidate++;
+        }
+
+        if (dataLength > 0 && context.hasFinished) {
+            // the compressed data already ended without a data descriptor signature following it
+            *error = NOZErrorCreate(NOZErrorCodeUnzipDataDescriptorWithoutSignatureNotSupported, @{ @"name" : entry.name });
+            return NO;
+        }
+
+        if (dataLength > 0) {
+            if (decoder && ![decoder decodeBytes:bytes length:dataLength context:context]) {
+                return NO;
+            }
+            _buffer.start += dataLength;
+            compressedBytesRead += dataLength;
+
+            if (progressBlock) {
+                BOOL stop = NO;
+                progressBlock(-1, (SInt64)compressedBytesRead, (SInt64)dataLength, &stop);
+                if (stop) {
+                    *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ECANCELED userInfo:nil];
+                    return NO;
+                }
+            }
+        }
+
+        if (descriptorSize > 0) {
+            const Byte *descriptor = _buffer.bytes + _buffer.start;
+            NOZLocalFileDescriptorT fileDescriptor;
+            fileDescriptor.crc32 = NOZReadLittleEndian32(descriptor + 4);
+            if (kNOZZip64DataDescriptorSize == descriptorSize) {
+                fileDescriptor.compressedSize = NOZReadLittleEndian64(descriptor + 8);
+                fileDescriptor.uncompressedSize = NOZReadLittleEndian64(descriptor + 16);
+            } else {
+                fileDescriptor.compressedSize = NOZReadLittleEndian32(descriptor + 8);
+                fileDescriptor.uncompressedSize = NOZReadLittleEndian32(descriptor + 12);
+            }
+            [entry private_setSizesFromDataDescriptor:&fileDescriptor];
+            _buffer.start += descriptorSize;
+            return YES;
+        }
+
+        if (reachedEndOfStream) {
+            *error = NOZErrorCreate(NOZErrorCodeUnzipCannotLocateDataDescriptor, @{ @"name" : entry.name });
+            return NO;
+        }
+
+        if (!noz_stream_buffer_fill(&_buffer, _inputStream, noz_stream_buffer_length(&_buffer) + 1) && !_buffer.reachedEndOfStream) {
+            *error = [self private_readError];
+            return NO;
+        }
+    }
+}
+
+- (NSError *)private_readError
+{
+    NSError *streamError = _inputStream.streamError;
+    return NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, streamError ? @{ NSUnderlyingErrorKey : streamError } : nil);
+}
+
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZStreamUnzipperEntry
+{
+    NOZFileEntryT _entry;
+    BOOL _hasZip64LocalExtraField;
+    BOOL _sizesAreKnown;
+}
+
+- (void)dealloc
+{
+    NOZFileEntryClean(&_entry);
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithLocalFileHeader:(const Byte *)header length:(size_t)length
+{
+    if (self = [super init]) {
+        NOZFileEntryInit(&_entry);
+
+        _entry.fileHeader.versionForExtraction = NOZReadLittleEndian16(header + 4);
+        _entry.fileHeader.bitFlag = NOZReadLittleEndian16(header + 6);
+        _entry.fileHeader.compressionMethod = NOZReadLittleEndian16(header + 8);
+        _entry.fileHeader.dosTime = NOZReadLittleEndian16(header + 10);
+        _entry.fileHeader.dosDate = NOZReadLittleEndian16(header + 12);
+        _entry.fileDescriptor.crc32 = NOZReadLittleEndian32(header + 14);
+        _entry.fileDescriptor.compressedSize = NOZReadLittleEndian32(header + 18);
+        _entry.fileDescriptor.uncompressedSize = NOZReadLittleEndian32(header + 22);
+        _entry.fileHeader.nameSize = NOZReadLittleEndian16(header + 26);
+        _entry.fileHeader.extraFieldSize = NOZReadLittleEndian16(header + 28);
+
+        if (0 == _entry.fileHeader.nameSize || length < (NOZLocalFileHeaderFixedSize + _entry.fileHeader.nameSize + _entry.fileHeader.extraFieldSize)) {
+            return nil;
+        }
+
+        const Byte *nameBytes = header + NOZLocalFileHeaderFixedSize;
+        _entry.name = malloc(_entry.fileHeader.nameSize);
+        memcpy((Byte *)_entry.name, nameBytes, _entry.fileHeader.nameSize);
+        _entry.ownsName = YES;
+
+        // ZIP64 extended information extra field, the local file header always has both sizes when present
+        const Byte *extraField = nameBytes + _entry.fileHeader.nameSize;
+        const size_t extraFieldSize = _entry.fileHeader.extraFieldSize;
+        size_t position = 0;
+        while ((position + 4) <= extraFieldSize) {
+            const UInt16 fieldID = NOZReadLittleEndian16(extraField + position);
+            const size_t fieldSize = NOZReadLittleEndian16(extraField + position + 2);
+            position += 4;
+            if ((position + fieldSize) > extraFieldSize) {
+                break;
+            }
+            if (NOZExtraFieldIDZip64 == fieldID && fieldSize >= 16) {
+                _entry.fileDescriptor.uncompressedSize = NOZReadLittleEndian64(extraField + position);
+                _entry.fileDescriptor.compressedSize = NOZReadLittleEndian64(extraField + position + 8);
+                _hasZip64LocalExtraField = YES;
+                break;
+            }
+            position += fieldSize;
+        }
+
+        _sizesAreKnown = !self.hasDataDescriptor;
+        if (_sizesAreKnown && !_hasZip64LocalExtraField &&
+            (NOZZip64Sentinel32 == _entry.fileDescriptor.compressedSize || NOZZip64Sentinel32 == _entry.fileDescriptor.uncompressedSize)) {
+            return nil; // ZIP64 sizes without the ZIP64 extra field
+        }
+    }
+    return self;
+}
+
+- (NOZFileEntryT *)private_internalEntry
+{
+    return &_entry;
+}
+
+- (BOOL)private_hasZip64LocalExtraField
+{
+    return _hasZip64LocalExtraField;
+}
+
+- (void)private_setSizesFromDataDescriptor:(const NOZLocalFileDescriptorT *)fileDescriptor
+{
+    _entry.fileDescriptor = *fileDescriptor;
+    _sizesAreKnown = YES;
+}
+
+- (NSString *)name
+{
+    return [[NSString alloc] initWithBytes:_entry.name
+                                    length:_entry.fileHeader.nameSize
+                                  encoding:(_entry.fileHeader.bitFlag & NOZFlagBitsUTF8EncodedStrings) ? NSUTF8StringEncoding : NOZStringEncodingDOSLatinUS];
+}
+
+- (NSString *)comment
+{
+    return nil;
+}
+
+- (NOZCompressionMethod)compressionMethod
+{
+    return _entry.fileHeader.compressionMethod;
+}
+
+- (NOZCompressionLevel)compressionLevel
+{
+    return NOZCompressionLevelForFileHeader(&_entry.fileHeader);
+}
+
+- (NSDate *)timestamp
+{
+    return noz_NSDate_from_dos_date(_entry.fileHeader.dosDate, _entry.fileHeader.dosTime);
+}
+
+- (BOOL)hasDataDescriptor
+{
+    return (_entry.fileHeader.bitFlag & NOZFlagBitsFileMetadataInDescriptor) != 0;
+}
+
+- (SInt64)compressedSize
+{
+    return (_sizesAreKnown) ? (SInt64)_entry.fileDescriptor.compressedSize : -1;
+}
+
+- (SInt64)uncompressedSize
+{
+    return (_sizesAreKnown) ? (SInt64)_entry.fileDescriptor.uncompressedSize : -1;
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    // immutable, other than the sizes being populated from the data descriptor by the owning unzipper
+    return self;
+}
+
+@end
+
+static BOOL noz_stream_buffer_fill(NOZStreamBufferT *buffer, NSInputStream *stream, size_t length)
+{
+    while (noz_stream_buffer_length(buffer) < length) {
+        if (buffer->reachedEndOfStream) {
+            return NO;
+        }
+
+        // move the unconsumed bytes to the front
+        if (buffer->start > 0) {
+            memmove(buffer->bytes, buffer->bytes + buffer->start, noz_stream_buffer_length(buffer));
+            buffer->end -= buffer->start;
+            buffer->start = 0;
+        }
+
+        if (buffer->capacity < length) {
+            const size_t capacity = length + NOZBufferSize();
+            Byte *bytes = realloc(buffer->bytes, capacity);
+            if (!bytes) {
+                return NO;
+            }
+            buffer->bytes = bytes;
+            buffer->capacity = capacity;
+        }
+
+        const NSInteger bytesRead = [stream read:buffer->bytes + buffer->end maxLength:buffer->capacity - buffer->end];
+        if (bytesRead < 0) {
+            return NO;
+        } else if (0 == bytesRead) {
+            buffer->reachedEndOfStream = YES;
+            return NO;
+        }
+        buffer->end += (size_t)bytesRead;
+    }
+
+    return YES;
+}
+
+NS_INLINE BOOL noz_is_record_signature(const Byte *bytes)
+{
+    const UInt32 signature = NOZReadLittleEndian32(bytes);
+    return NOZMagicNumberLocalFileHeader == signature ||
+           NOZMagicNumberCentralDirectoryFileRecord == signature ||
+           NOZMagicNumberZip64EndOfCentralDirectoryRecord == signature ||
+           NOZMagicNumberEndOfCentralDirectoryRecord == signature;
+}
+
+static size_t noz_match_data_descriptor(const Byte *bytes, size_t length, BOOL reachedEndOfStream, UInt64 dataLength, BOOL zip64)
+{
+    // The compressed size must match the bytes preceding the data descriptor and the data descriptor
+    // must be followed by another record (or the end of the stream).
+    // Data descriptors have 8 byte sizes when the local file header has a ZIP64 extra field,
+    // but writers (including NOZZipper) also use them when an entry outgrows 32 bits without one,
+    // so both are considered unless ZIP64 is known.
+
+    if (!zip64 && dataLength < NOZZip64Sentinel32 && length >= kNOZDataDescriptorSize && NOZReadLittleEndian32(bytes + 8) == dataLength) {
+        if ((length >= kNOZDataDescriptorSize + 4 && noz_is_record_signature(bytes + kNOZDataDescriptorSize)) ||
+            (reachedEndOfStream && length == kNOZDataDescriptorSize)) {
+            return kNOZDataDescriptorSize;
+        }
+    }
+
+    if (length >= kNOZZip64DataDescriptorSize && NOZReadLittleEndian64(bytes + 8) == dataLength) {
+        if ((length >= kNOZDataDescriptorLookAhead && noz_is_record_signature(bytes + kNOZZip64DataDescriptorSize)) ||
+            (reachedEndOfStream && length == kNOZZip64DataDescriptorSize)) {
+            return kNOZZip64DataDescriptorSize;
+        }
+    }
+
+    return 0;
+}
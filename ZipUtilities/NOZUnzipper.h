@@ -27,12 +27,14 @@
 
 #import <Foundation/Foundation.h>
 
+#import <ZipUtilities/NOZRandomAccessSource.h>
 #import <ZipUtilities/NOZUtils.h>
 #import <ZipUtilities/NOZZipEntry.h>
 
 @class NOZGlobalInfo;
 @class NOZCentralDirectory;
 @class NOZCentralDirectoryRecord;
+@class NOZCheckpointIndex;
 
 //! Callback when enumerating Central Directory Record.  Set _stop_ to `YES` to end the enumeration early.
 typedef void(^NOZUnzipRecordEnumerationBlock)(NOZCentralDirectoryRecord * __nonnull record,
@@ -52,6 +54,43 @@ typedef NS_OPTIONS(NSInteger, NOZUnzipperSaveRecordOptions)
     NOZUnzipperSaveRecordOptionOverwriteExisting,
     /** If the output file would have intermediate directories, ignore them and write the file directly to the output directory. */
     NOZUnzipperSaveRecordOptionIgnoreIntermediatePath,
+    /**
+     Trust the archive and don't compute the checksum of stored records (`NOZCompressionMethodNone`) while saving them,
+     so they can be copied by the kernel without passing through memory.
+     Applies to stored records only (they are copied without decoding), records of any other method are still validated as they are decoded.
+     */
+    NOZUnzipperSaveRecordOptionSkipChecksumValidation = 1 << 2,
+};
+
+typedef NS_OPTIONS(NSInteger, NOZUnzipperOpenOptions)
+{
+    /** No options */
+    NOZUnzipperOpenOptionsNone = 0,
+    /**
+     Memory map the archive instead of reading it through the file.
+     The central directory and local file headers are parsed directly from the mapping, compressed entries are decoded straight from the mapping and `NOZCompressionMethodNone` entries are enumerated with pointers into the mapping (no copies).
+     If the archive cannot be mapped, the unzipper falls back to reading from the file.
+     */
+    NOZUnzipperOpenOptionMemoryMap = 1 << 0,
+    /**
+     Share the central directory through `[NOZCentralDirectoryCache sharedCache]`.
+     If the archive's central directory is already cached, opening skips locating the end of central directory record
+     and `readCentralDirectoryAndReturnError:` returns the cached (immutable) central directory without parsing.
+     Otherwise, the central directory is added to the cache once it has been read.
+     Cached central directories are keyed by the archive's device, inode, size and modification time.
+     */
+    NOZUnzipperOpenOptionSharedCentralDirectoryCache = 1 << 1,
+    /**
+     Hint that the records will be read in full and in archive order (such as extracting the entire archive).
+     The kernel is advised to read ahead aggressively over the entries' data.
+     */
+    NOZUnzipperOpenOptionSequentialAccess = 1 << 2,
+    /**
+     Hint that the archive is read in a single pass and won't be read again soon.
+     Data that has been decompressed is dropped from the page cache behind the read
+     so that streaming a large archive doesn't evict other (hot) files from the page cache.
+     */
+    NOZUnzipperOpenOptionNoCacheRetention = 1 << 3,
 };
 
 /**
@@ -59,6 +98,12 @@ typedef NS_OPTIONS(NSInteger, NOZUnzipperSaveRecordOptions)
 
  Uses the globally registered compression encoders.  See `NOZDecoderForCompressionMethod` and `NOZUpdateCompressionMethodDecoder` in `NOZCompression.h`.
 
+ ### Thread Safety
+
+ Once opened and the central directory has been read, `enumerateByteRangesOfRecord:progressBlock:usingBlock:error:`, `readDataFromRecord:progressBlock:error:`, `saveRecord:toDirectory:options:progressBlock:error:` and `validateRecord:progressBlock:error:` can be called concurrently from multiple threads.
+ Each call keeps its own decode state and reads the archive with positional reads.
+ Opening, reading the central directory and closing must not overlap with any other call.
+
  ### Example
 
  Here's a completely contrived example for unzipping with the `NOZUnzipper`.
@@ -174,14 +219,26 @@ typedef NS_OPTIONS(NSInteger, NOZUnzipperSaveRecordOptions)
  */
 @interface NOZUnzipper : NSObject
 
-/** The path to the zip archive */
+/** The path to the zip archive.  The `description` of the `randomAccessSource` when unzipping one. */
 @property (nonatomic, readonly, nonnull) NSString *zipFilePath;
+/** The source of the archive, `nil` when unzipping the file at `zipFilePath` */
+@property (nonatomic, readonly, nullable) id<NOZRandomAccessSource> randomAccessSource;
 /** The central directory object.  `nil` if it hasn't been parsed (or failed to be read). */
 @property (nonatomic, readonly, nullable) NOZCentralDirectory *centralDirectory;
+/** Whether the open archive is memory mapped.  See `NOZUnzipperOpenOptionMemoryMap`. */
+@property (nonatomic, readonly, getter=isMemoryMapped) BOOL memoryMapped;
 
 /** Designated initializer */
 - (nonnull instancetype)initWithZipFile:(nonnull NSString *)zipFilePath;
 
+/**
+ Designated initializer for unzipping an archive that isn't a local file (such as an archive in memory or on a server).
+ `NOZUnzipperOpenOptions` only apply to `NOZFileDescriptorSource` sources, which are read through a duplicate of their descriptor.
+ Other sources are only read through `NOZRandomAccessSource` reads, coalesced into reads of the source's `preferredReadLength`.
+ See `NOZRandomAccessSource.h`.
+ */
+- (nonnull instancetype)initWithRandomAccessSource:(nonnull id<NOZRandomAccessSource>)randomAccessSource;
+
 /** Unavailable */
 - (nonnull instancetype)init NS_UNAVAILABLE;
 /** Unavailable */
@@ -194,6 +251,13 @@ typedef NS_OPTIONS(NSInteger, NOZUnzipperSaveRecordOptions)
  */
 - (BOOL)openAndReturnError:(out NSError * __nullable * __nullable)error;
 
+/**
+ Open the zip archive with _options_.
+ Same as `openAndReturnError:` when _options_ is `NOZUnzipperOpenOptionsNone`.
+ */
+- (BOOL)openWithOptions:(NOZUnzipperOpenOptions)options
+                  error:(out NSError * __nullable * __nullable)error;
+
 /**
  Close the open archive.
  Harmless to call redundantly.
@@ -207,17 +271,39 @@ typedef NS_OPTIONS(NSInteger, NOZUnzipperSaveRecordOptions)
  */
 - (nullable NOZCentralDirectory *)readCentralDirectoryAndReturnError:(out NSError * __nullable * __nullable)error;
 
+/**
+ Read the central directory using a sidecar index file at _indexPath_.
+ If the index was written for this exact archive (same size, modification time and end of central directory records),
+ the pre-parsed central directory and name lookup table are mapped from the index instead of being parsed from the archive.
+ Otherwise, the central directory is read like `readCentralDirectoryAndReturnError:` and the index is (re)written.
+ Failing to write the index does not fail reading the central directory.
+
+ The index is a cache in the host's native layout and should live alongside other caches, it is not portable between machines.
+ */
+- (nullable NOZCentralDirectory *)readCentralDirectoryWithIndexAtPath:(nonnull NSString *)indexPath
+                                                                error:(out NSError * __nullable * __nullable)error;
+
 /**
  Read a central directory record at a specific _index_.
+ Records are created on demand from the central directory, so each call returns a new record object.
  */
 - (nullable NOZCentralDirectoryRecord *)readRecordAtIndex:(NSUInteger)index
                                                     error:(out NSError * __nullable * __nullable)error;
 
 /**
  Find the index for a record matching the _name_ provided.  `NSNotFound` if no match was found.
+ Lookups use a hash index of the record names built when the central directory is read.
  */
 - (NSUInteger)indexForRecordWithName:(nonnull NSString *)name;
 
+/**
+ Find the index for a record whose raw name bytes (as stored in the archive, no string decoding) match _nameBytes_.
+ `NSNotFound` if no match was found.
+ Does not create any `NSString` objects.
+ */
+- (NSUInteger)indexForRecordWithNameBytes:(nonnull const void *)nameBytes
+                                   length:(NSUInteger)length;
+
 /**
  Enumerate all the records.
  */
@@ -233,12 +319,60 @@ typedef NS_OPTIONS(NSInteger, NOZUnzipperSaveRecordOptions)
 
 /**
  Stream a record's data to _block_.
+ When memory mapped, the _bytes_ of a `NOZCompressionMethodNone` record point directly into the mapping and are only valid for the duration of _block_.
  */
 - (BOOL)enumerateByteRangesOfRecord:(nonnull NOZCentralDirectoryRecord *)record
                       progressBlock:(nullable NOZProgressBlock)progressBlock
                          usingBlock:(nonnull NOZUnzipByteRangeEnumerationBlock)block
                               error:(out NSError *__autoreleasing  __nullable * __nullable)error;
 
+/**
+ Plan reading _records_ in a single forward pass over the archive.
+ The central directory's order need not match the order of the entries in the archive (such as archives that were appended to),
+ so the returned records are sorted by the position of their local file headers.
+ Every local file header is resolved by one sequential sweep and the result is kept on the record,
+ so reading the returned records doesn't read their local file headers again.
+ Like reading the central directory, must not overlap with any other call.
+ */
+- (nullable NSArray<NOZCentralDirectoryRecord *> *)planSequentialReadOfRecords:(nonnull NSArray<NOZCentralDirectoryRecord *> *)records
+                                                                         error:(out NSError * __nullable * __nullable)error;
+
+/**
+ Build a checkpoint index for random access reads within _record_ (see `NOZCheckpointIndex`).
+ The entire record is decompressed (and its checksum validated) once to build the index.
+ @param record The record to index.  Must be `NOZCompressionMethodDeflate` or `NOZCompressionMethodNone` (which needs no checkpoints).
+ @param checkpointInterval The minimum number of uncompressed bytes between checkpoints.  `0` for `NOZCheckpointIndexDefaultInterval`.
+ */
+- (nullable NOZCheckpointIndex *)buildCheckpointIndexForRecord:(nonnull NOZCentralDirectoryRecord *)record
+                                            checkpointInterval:(SInt64)checkpointInterval
+                                                 progressBlock:(nullable NOZProgressBlock)progressBlock
+                                                         error:(out NSError *__autoreleasing  __nullable * __nullable)error;
+
+/**
+ Stream the uncompressed bytes of a record within _range_ to _block_.
+ The _byteRange_ provided to _block_ is relative to the start of the record's uncompressed data.
+ _range_ is clamped to the end of the record, but must start within it.
+
+ `NOZCompressionMethodNone` records are read directly.
+ `NOZCompressionMethodDeflate` records are decompressed from the nearest checkpoint preceding _range_ in _checkpointIndex_.
+ Otherwise (or without a _checkpointIndex_), the record is decompressed from the start.
+ Since only part of the record is decompressed, the record's checksum cannot be validated.
+ */
+- (BOOL)enumerateByteRangesOfRecord:(nonnull NOZCentralDirectoryRecord *)record
+                              range:(NSRange)range
+                    checkpointIndex:(nullable NOZCheckpointIndex *)checkpointIndex
+                         usingBlock:(nonnull NOZUnzipByteRangeEnumerationBlock)block
+                              error:(out NSError *__autoreleasing  __nullable * __nullable)error;
+
+/**
+ Read the uncompressed bytes of a record within _range_ as NSData.
+ See `enumerateByteRangesOfRecord:range:checkpointIndex:usingBlock:error:`.
+ */
+- (nullable NSData *)readDataFromRecord:(nonnull NOZCentralDirectoryRecord *)record
+                                  range:(NSRange)range
+                        checkpointIndex:(nullable NOZCheckpointIndex *)checkpointIndex
+                                  error:(out NSError *__autoreleasing  __nullable * __nullable)error;
+
 /**
  Save a record to disk.
  */
@@ -255,6 +389,17 @@ typedef NS_OPTIONS(NSInteger, NOZUnzipperSaveRecordOptions)
          progressBlock:(nullable NOZProgressBlock)progressBlock
                  error:(out NSError *__autoreleasing __nullable * __nullable)error;
 
+/**
+ Write the compressed bytes of a record, exactly as they are stored in the archive, to _fileDescriptor_ (at its file offset).
+ Nothing is decoded, so the checksum is not validated.
+ The kernel copies the bytes where it can (`copy_file_range` or `sendfile` on Linux), otherwise they are read and written in large chunks.
+ See `-[NOZZipper addCompressedRecord:fromUnzipper:progressBlock:error:]` for copying records between archives.
+ */
+- (BOOL)writeCompressedBytesOfRecord:(nonnull NOZCentralDirectoryRecord *)record
+                    toFileDescriptor:(int)fileDescriptor
+                       progressBlock:(nullable NOZProgressBlock)progressBlock
+                               error:(out NSError *__autoreleasing __nullable * __nullable)error;
+
 /**
  *DEPRECATED*: See `saveRecord:toDirectory:options:progressBlock:error:`
  */
@@ -270,6 +415,7 @@ typedef NS_OPTIONS(NSInteger, NOZUnzipperSaveRecordOptions)
 
 /**
  A central directory record is a zip entry populated with all the pertinent central directory info.
+ Records are created on demand and retain the `NOZCentralDirectory` they were read from.
  */
 @interface NOZCentralDirectoryRecord : NSObject <NOZZipEntry>
 /** name of record */
@@ -302,10 +448,13 @@ typedef NS_OPTIONS(NSInteger, NOZUnzipperSaveRecordOptions)
 - (BOOL)isMacOSXAttribute;
 /** Record is a `".DS_Store"` file for Mac OS X. */
 - (BOOL)isMacOSXDSStore;
+/** Record is a directory (name ends with `"/"`). */
+- (BOOL)isDirectory;
 @end
 
 /**
  The central directory houses all the records for entries in the zip as well as global info.
+ The records are stored compactly (in flat arrays with all names in a single buffer) rather than as objects.
  */
 @interface NOZCentralDirectory : NSObject
 /** A global comment for the entire archive */
@@ -324,3 +473,68 @@ typedef NS_OPTIONS(NSInteger, NOZUnzipperSaveRecordOptions)
 - (nonnull instancetype)initWithKnownFileSize:(SInt64)fileSize NS_DESIGNATED_INITIALIZER;
 @end
 
+/**
+ `NOZCentralDirectoryCache` is a process wide, thread safe cache of parsed central directories.
+ See `NOZUnzipperOpenOptionSharedCentralDirectoryCache`.
+
+ Central directories are evicted least recently used first once their combined memory cost exceeds `totalCostLimit`.
+ A central directory that is evicted stays alive for as long as any unzipper (or record) still references it.
+ */
+@interface NOZCentralDirectoryCache : NSObject
+
+/** The shared cache */
++ (nonnull NOZCentralDirectoryCache *)sharedCache;
+
+/** The memory budget (in bytes) for cached central directories.  Default is 64MB.  A central directory costing more than the limit is never cached. */
+@property (nonatomic) NSUInteger totalCostLimit;
+/** The combined memory cost (in bytes) of the cached central directories */
+@property (nonatomic, readonly) NSUInteger totalCost;
+/** The number of cached central directories */
+@property (nonatomic, readonly) NSUInteger count;
+
+/** Evict all cached central directories */
+- (void)removeAllCentralDirectories;
+
+/** Unavailable */
+- (nonnull instancetype)init NS_UNAVAILABLE;
+/** Unavailable */
++ (nonnull instancetype)new NS_UNAVAILABLE;
+
+@end
+
+//! The default minimum number of uncompressed bytes between checkpoints of a `NOZCheckpointIndex` (8MB)
+static const SInt64 NOZCheckpointIndexDefaultInterval = 8 * 1024 * 1024;
+
+/**
+ A checkpoint index permits reading from the middle of a compressed record without decompressing everything preceding it.
+
+ For deflated records, each checkpoint is a deflate block boundary along with the preceding 32KB of
+ uncompressed data (the deflate window) needed to resume decompressing from there.
+ A checkpoint costs up to 32KB of memory, so the checkpoint interval trades memory for the amount of data
+ decompressed and discarded on each random access read (on average half the interval).
+
+ Build one with `-[NOZUnzipper buildCheckpointIndexForRecord:checkpointInterval:progressBlock:error:]`.
+ An index can be persisted with `dataRepresentation` and restored with `initWithDataRepresentation:` to avoid rebuilding it.
+ */
+@interface NOZCheckpointIndex : NSObject
+/** The minimum number of uncompressed bytes between checkpoints */
+@property (nonatomic, readonly) SInt64 checkpointInterval;
+/** The number of checkpoints */
+@property (nonatomic, readonly) NSUInteger checkpointCount;
+/** The compressed size of the indexed record */
+@property (nonatomic, readonly) SInt64 compressedSize;
+/** The uncompressed size of the indexed record */
+@property (nonatomic, readonly) SInt64 uncompressedSize;
+/** The CRC32 of the indexed record */
+@property (nonatomic, readonly) UInt32 crc32;
+
+/** Serialize the index (for persisting) */
+- (nonnull NSData *)dataRepresentation;
+/** Restore a serialized index, `nil` if _data_ is not a valid index */
+- (nullable instancetype)initWithDataRepresentation:(nonnull NSData *)data;
+
+/** Unavailable */
+- (nonnull instancetype)init NS_UNAVAILABLE;
+/** Unavailable */
++ (nonnull instancetype)new NS_UNAVAILABLE;
+@end
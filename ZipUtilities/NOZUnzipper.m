@@ -25,71 +25,366 @@
 //  SOFTWARE.
 //
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #import "NOZ_Project.h"
 #import "NOZCompressionLibrary.h"
 #import "NOZError.h"
-#import "NOZUnzipper.h"
+#import "NOZExtractionWriter.h"
+#import "NOZLRUCache.h"
+#import "NOZRandomAccessReader.h"
+#import "NOZUnzipper_Project.h"
 #import "NOZUtils_Project.h"
 
-static BOOL noz_fread_value(FILE *file, Byte* value, const UInt8 byteCount);
+#include "zlib.h"
+
+typedef struct _NOZUnzipperSourceT
+{
+    int fileDescriptor;
+    __unsafe_unretained NOZRandomAccessReader *reader; // reads instead of the file descriptor when unzipping a random access source (kept alive by the unzipper)
+    off_t length;
+    const Byte *mappedBytes; // non-NULL when the archive is memory mapped
+
+    // The tail of the archive (that has the EOCD record) is read once when opening.
+    // Reads within it (and within the central directory of small archives) are served from memory.
+    const Byte *tailBytes; // NULL when memory mapped
+    off_t tailOffset;
+    size_t tailLength;
+} NOZUnzipperSourceT;
+
+static BOOL noz_pread_fully(int fd, void *buffer, size_t length, off_t offset);
+static BOOL noz_source_is_open(const NOZUnzipperSourceT *source);
+static BOOL noz_source_read(const NOZUnzipperSourceT *source, void *buffer, size_t length, off_t offset, NSError **error);
+static const Byte *noz_source_bytes(const NOZUnzipperSourceT *source, off_t offset, size_t length, Byte *scratchBuffer);
+static const Byte *noz_source_read_bytes(const NOZUnzipperSourceT *source, off_t offset, size_t length, Byte *scratchBuffer, NSError **error);
+static NSDictionary *noz_source_error_user_info(NSError *sourceError);
+static NSError *noz_read_error_with_source_error(NSError *error, NSError *sourceError);
+
+static const size_t kNOZMappedChunkSize = 1024 * 1024;
+
+// The local file headers of records read in a sequential sweep are read in windows of up to this size,
+// so headers of neighboring (small) entries are resolved together.
+// A window only extends through the last header it covers, a lone header is read on its own.
+static const size_t kNOZLocalFileHeaderSweepWindowSize = 64 * 1024;
+
+// How many bytes to read before dropping them from the page cache (see NOZUnzipperOpenOptionNoCacheRetention)
+static const off_t kNOZDropBehindInterval = 1024 * 1024;
+
+// Unmapped entries up to this compressed size are read whole so they can be decoded in one shot
+static const UInt64 kNOZOneShotMaxUnmappedCompressedSize = 4 * 1024 * 1024;
+
+// The best ratio DEFLATE can achieve, uncompressed sizes beyond this ratio aren't trusted for allocating upfront
+static const UInt64 kNOZMaxTrustedCompressionRatio = 1032;
+
+typedef NS_ENUM(NSInteger, NOZAccessAdvice)
+{
+    NOZAccessAdviceSequential,
+    NOZAccessAdviceWillNeed,
+    NOZAccessAdviceDontNeed,
+};
+
+static void noz_source_advise(const NOZUnzipperSourceT *source, off_t offset, off_t length, NOZAccessAdvice advice);
+static off_t noz_offset_to_compressed_data(const NOZFileEntryT *entry, const Byte *localFileHeader, off_t localFileHeaderOffset, off_t archiveLength);
+static NSUInteger noz_trusted_uncompressed_capacity(const NOZFileEntryT *entry, UInt64 limit);
+
+typedef struct _NOZUnzipStateT
+{
+    off_t offsetToFirstByte;
+    UInt32 crc32;
+    UInt64 bytesDecompressed;
+
+    const NOZFileEntryT *entry;
+} NOZUnzipStateT;
+
+static BOOL noz_flush_decompressed_bytes(NOZUnzipStateT *state, const Byte *buffer, size_t length, NOZUnzipByteRangeEnumerationBlock block);
+static BOOL noz_read_zip64_extra_field(NOZFileEntryT *entry, const Byte *extraField, size_t extraFieldSize);
+
+static const size_t kNOZDeflateWindowSize = 32 * 1024;
+
+typedef struct _NOZCheckpointT
+{
+    UInt64 uncompressedOffset;
+    UInt64 compressedOffset; // the first whole byte following the block boundary, relative to the start of the compressed data
+    UInt8 bitCount; // the number of bits of the byte preceding compressedOffset that belong to the following block
+    UInt32 windowLength; // the uncompressed bytes preceding the checkpoint, up to kNOZDeflateWindowSize
+    size_t windowOffset; // offset of the window in the checkpoint index's windows buffer
+} NOZCheckpointT;
+
+// provides the compressed bytes of a record at _offset_, either from memory or copied to _scratchBuffer_
+typedef const Byte * __nullable (^NOZCompressedBytesBlock)(UInt64 offset, size_t length, Byte * __nonnull scratchBuffer);
+
+static void noz_append_window(NSMutableData *windows, const Byte *window, size_t availableOut, size_t windowLength);
+
+typedef struct _NOZNameIndexSlotT
+{
+    UInt32 hash;
+    UInt32 recordIndex; // index + 1, 0 is an empty slot
+} NOZNameIndexSlotT;
+
+typedef NS_OPTIONS(UInt8, NOZRecordAttributeFlags)
+{
+    NOZRecordAttributeFlagZeroLength        = 1 << 0,
+    NOZRecordAttributeFlagMacOSXAttribute   = 1 << 1,
+    NOZRecordAttributeFlagMacOSXDSStore     = 1 << 2,
+    NOZRecordAttributeFlagDirectory         = 1 << 3,
+};
+
+// Every column of NOZCentralDirectoryColumnsT (type and name), in the order they are stored in an index file
+#define NOZ_CENTRAL_DIRECTORY_COLUMNS(COLUMN) \
+    COLUMN(UInt64, localFileHeaderOffsets) \
+    COLUMN(UInt64, compressedSizes) \
+    COLUMN(UInt64, uncompressedSizes) \
+    COLUMN(size_t, nameOffsets) \
+    COLUMN(UInt32, crc32s) \
+    COLUMN(UInt32, externalFileAttributes) \
+    COLUMN(UInt16, versionsMadeBy) \
+    COLUMN(UInt16, versionsForExtraction) \
+    COLUMN(UInt16, bitFlags) \
+    COLUMN(UInt16, compressionMethods) \
+    COLUMN(UInt16, dosTimes) \
+    COLUMN(UInt16, dosDates) \
+    COLUMN(UInt16, internalFileAttributes) \
+    COLUMN(UInt16, fileStartDiskNumbers) \
+    COLUMN(UInt16, extraFieldSizes) \
+    COLUMN(UInt16, nameSizes) \
+    COLUMN(UInt16, commentSizes) \
+    COLUMN(NOZRecordAttributeFlags, attributeFlags)
+
+typedef struct _NOZCentralDirectoryColumnsT
+{
+    NSUInteger count;
+    NSUInteger capacity;
+
+    // one element per record
+#define NOZ_DECLARE_COLUMN(type, column) type *column;
+    NOZ_CENTRAL_DIRECTORY_COLUMNS(NOZ_DECLARE_COLUMN)
+#undef NOZ_DECLARE_COLUMN
+
+    // every name is NUL terminated and followed by its NUL terminated comment, all packed in one buffer
+    Byte *strings;
+    size_t stringsLength;
+} NOZCentralDirectoryColumnsT;
+
+// Identifies the exact archive (and central directory) that an index file was written for
+typedef struct _NOZCentralDirectoryIndexKeyT
+{
+    UInt64 archiveSize;
+    SInt64 modificationTimeSeconds;
+    SInt64 modificationTimeNanoseconds;
+    UInt64 endOfCentralDirectoryRecordPosition;
+    UInt32 endOfCentralDirectoryChecksum;
+} NOZCentralDirectoryIndexKeyT;
+
+// Identifies an archive in the shared central directory cache
+typedef struct _NOZCentralDirectoryCacheKeyT
+{
+    UInt64 device;
+    UInt64 inode;
+    UInt64 archiveSize;
+    SInt64 modificationTimeSeconds;
+    SInt64 modificationTimeNanoseconds;
+} NOZCentralDirectoryCacheKeyT;
+
+// An index file is the header followed by each column, the packed strings and the name index slots,
+// each padded to 8 bytes so the file can be mapped and used in place.
+// Values are in host byte order, the magic number doubles as a byte order check.
+// The end of central directory records are always read from the archive, so they are not part of the index.
+typedef struct _NOZCentralDirectoryIndexHeaderT
+{
+    UInt32 magicNumber;
+    UInt16 version;
+    UInt16 wordSize; // sizeof(size_t)
+    NOZCentralDirectoryIndexKeyT key;
+    UInt64 lastCentralDirectoryRecordEndPosition;
+    SInt64 totalUncompressedSize;
+    UInt64 recordCount;
+    UInt64 stringsLength;
+    UInt64 nameIndexSlotCount;
+} NOZCentralDirectoryIndexHeaderT;
+
+static const UInt32 kNOZCentralDirectoryIndexMagicNumber = 0x4e4f5a49; // "NOZI"
+static const UInt16 kNOZCentralDirectoryIndexVersion = 1;
+
+NS_INLINE size_t noz_index_align(size_t length)
+{
+    return (length + 7) & ~(size_t)7;
+}
+
+NS_INLINE BOOL noz_index_keys_equal(const NOZCentralDirectoryIndexKeyT *key1, const NOZCentralDirectoryIndexKeyT *key2)
+{
+    return key1->archiveSize == key2->archiveSize &&
+           key1->modificationTimeSeconds == key2->modificationTimeSeconds &&
+           key1->modificationTimeNanoseconds == key2->modificationTimeNanoseconds &&
+           key1->endOfCentralDirectoryRecordPosition == key2->endOfCentralDirectoryRecordPosition &&
+           key1->endOfCentralDirectoryChecksum == key2->endOfCentralDirectoryChecksum;
+}
+
+NS_INLINE size_t noz_index_length(const NOZCentralDirectoryIndexHeaderT *header)
+{
+    const size_t count = (size_t)header->recordCount;
+    size_t length = noz_index_align(sizeof(NOZCentralDirectoryIndexHeaderT));
+#define NOZ_COLUMN_LENGTH(type, column) length += noz_index_align(count * sizeof(type));
+    NOZ_CENTRAL_DIRECTORY_COLUMNS(NOZ_COLUMN_LENGTH)
+#undef NOZ_COLUMN_LENGTH
+    length += noz_index_align((size_t)header->stringsLength);
+    length += noz_index_align((size_t)header->nameIndexSlotCount * sizeof(NOZNameIndexSlotT));
+    return length;
+}
+
+static BOOL noz_columns_reserve(NOZCentralDirectoryColumnsT *columns, NSUInteger capacity);
+static void noz_columns_free(NOZCentralDirectoryColumnsT *columns);
+static void noz_columns_load_entry(const NOZCentralDirectoryColumnsT *columns, NSUInteger index, NOZFileEntryT *entry);
+static BOOL noz_write_fully(int fd, const void *buffer, size_t length);
+static NOZRecordAttributeFlags noz_record_attribute_flags(const Byte *name, size_t nameSize, UInt64 compressedSize);
+
+typedef NS_ENUM(NSInteger, NOZNameEncodingFilter)
+{
+    NOZNameEncodingFilterAny = 0,
+    NOZNameEncodingFilterUTF8,
+    NOZNameEncodingFilterDOSLatinUS,
+};
+
+NS_INLINE UInt32 noz_name_hash(const Byte *bytes, size_t length)
+{
+    // FNV-1a
+    UInt32 hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+NS_INLINE BOOL noz_record_name_matches(const NOZCentralDirectoryColumnsT *columns, NSUInteger index, const Byte *nameBytes, size_t length, NOZNameEncodingFilter filter)
+{
+    if (columns->nameSizes[index] != length || 0 != memcmp(columns->strings + columns->nameOffsets[index], nameBytes, length)) {
+        return NO;
+    }
 
-#define PRIVATE_READ(file, value) noz_fread_value(file, (Byte *)&value, sizeof(value))
+    const BOOL isUTF8 = (columns->bitFlags[index] & NOZFlagBitsUTF8EncodedStrings) != 0;
+    switch (filter) {
+        case NOZNameEncodingFilterUTF8:
+            return isUTF8;
+        case NOZNameEncodingFilterDOSLatinUS:
+            return !isUTF8;
+        case NOZNameEncodingFilterAny:
+        default:
+            return YES;
+    }
+}
 
 #define NOZStringEncodingDOSLatinUS CFStringConvertEncodingToNSStringEncoding(kCFStringEncodingDOSLatinUS)
 
 NOZ_OBJC_DIRECT_MEMBERS
 @interface NOZCentralDirectoryRecord (/* direct declarations */)
-- (NOZFileEntryT *)private_internalEntry;
 - (NOZErrorCode)private_validate;
-- (BOOL)private_isOwnedByCentralDirectory:(NOZCentralDirectory *)cd;
 - (NSString *)private_nameNoCopy;
+- (void)private_setAttributeFlags:(NOZRecordAttributeFlags)flags;
+- (off_t)private_offsetToCompressedData;
+- (void)private_setOffsetToCompressedData:(off_t)offset;
 @end
 
 NOZ_OBJC_DIRECT_MEMBERS
 @interface NOZCentralDirectory (/* direct declarations */)
-- (NSArray<NOZCentralDirectoryRecord *> *)private_internalRecords;
-- (BOOL)private_readEndOfCentralDirectoryRecordAtPosition:(off_t)eocdPos inFile:(FILE*)file;
-- (BOOL)private_readCentralDirectoryEntriesWithFile:(FILE*)file;
-- (NOZCentralDirectoryRecord *)private_readCentralDirectoryEntryAtCurrentPositionWithFile:(FILE*)file;
+- (BOOL)private_readEndOfCentralDirectoryRecordAtPosition:(off_t)eocdPos source:(const NOZUnzipperSourceT *)source;
+- (BOOL)private_readZip64EndOfCentralDirectoryRecordWithLocatorAtPosition:(off_t)locatorPos source:(const NOZUnzipperSourceT *)source;
+- (BOOL)private_readCentralDirectoryEntriesWithSource:(const NOZUnzipperSourceT *)source;
+- (BOOL)private_appendCentralDirectoryEntryFromBytes:(const Byte *)bytes
+                                              length:(size_t)length
+                                          recordSize:(out size_t *)recordSizeOut;
 - (BOOL)private_validateCentralDirectoryAndReturnError:(NSError **)error;
 - (NOZCentralDirectoryRecord *)private_recordAtIndex:(NSUInteger)index;
 - (NSUInteger)private_indexForRecordWithName:(NSString *)name;
+- (NSUInteger)private_indexForRecordWithNameBytes:(const Byte *)nameBytes
+                                           length:(size_t)length
+                                           filter:(NOZNameEncodingFilter)filter;
+- (void)private_buildNameIndex;
+- (UInt32)private_endOfCentralDirectoryChecksumWithSource:(const NOZUnzipperSourceT *)source;
+- (BOOL)private_readIndexAtPath:(NSString *)indexPath key:(const NOZCentralDirectoryIndexKeyT *)key;
+- (BOOL)private_writeIndexToPath:(NSString *)indexPath key:(const NOZCentralDirectoryIndexKeyT *)key;
+- (off_t)private_centralDirectoryStartPosition;
+- (off_t)private_endOfCentralDirectoryRecordPosition;
+- (NSUInteger)private_memoryCost;
+@end
+
+@interface NOZCentralDirectoryCache ()
+- (instancetype)initInternal;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZCentralDirectoryCache (/* direct declarations */)
+- (nullable NOZCentralDirectory *)private_centralDirectoryForKey:(const NOZCentralDirectoryCacheKeyT *)key;
+- (void)private_setCentralDirectory:(NOZCentralDirectory *)cd forKey:(const NOZCentralDirectoryCacheKeyT *)key;
+@end
+
+@interface NOZCheckpointIndex ()
+- (instancetype)initWithEntry:(const NOZFileEntryT *)entry checkpointInterval:(SInt64)checkpointInterval;
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZCheckpointIndex (/* direct declarations */)
+- (BOOL)private_matchesEntry:(const NOZFileEntryT *)entry;
+- (BOOL)private_indexDeflatedBytes:(NOZCompressedBytesBlock)bytesBlock
+                     progressBlock:(nullable NOZProgressBlock)progressBlock
+                             error:(out NSError **)error;
+- (BOOL)private_inflateRange:(NSRange)range
+             compressedBytes:(NOZCompressedBytesBlock)bytesBlock
+                  usingBlock:(NOZUnzipByteRangeEnumerationBlock)block
+                       error:(out NSError **)error;
 @end
 
 NOZ_OBJC_DIRECT_MEMBERS
 @implementation NOZUnzipper
 {
     NSString *_standardizedFilePath;
-    id<NOZDecoder> _currentDecoder;
-    id<NOZDecoderContext> _currentDecoderContext;
+    NOZRandomAccessReader *_randomAccessReader;
 
+    // Immutable once opened.
+    // All per record decode state lives on the stack of the decoding call (see NOZUnzipStateT)
+    // and all reads are positional, so records can be read concurrently.
     struct {
-        FILE* file;
+        NOZUnzipperSourceT source;
 
         off_t endOfCentralDirectorySignaturePosition;
-        off_t endOfFilePosition;
-    } _internal;
-
-    struct {
-        off_t offsetToFirstByte;
-        UInt32 crc32;
-        size_t bytesDecompressed;
 
-        NOZFileEntryT *entry;
+        BOOL usesSharedCentralDirectoryCache;
+        BOOL sequentialAccess;
+        BOOL dropsCacheBehindReads;
+        NOZCentralDirectoryCacheKeyT centralDirectoryCacheKey;
+    } _internal;
 
-        BOOL isUnzipping:YES;
-    } _currentUnzipping;
+    // Reused across saved records so that their destination directory is opened (and its subdirectories created) once
+    pthread_mutex_t _extractionWriterMutex;
+    NOZExtractionWriter *_extractionWriter;
 }
 
 -(void)dealloc
 {
     [self closeAndReturnError:NULL];
+    pthread_mutex_destroy(&_extractionWriterMutex);
 }
 
 - (instancetype)initWithZipFile:(NSString *)zipFilePath
 {
     if (self = [super init]) {
         _zipFilePath = [zipFilePath copy];
+        _internal.source.fileDescriptor = -1;
+        pthread_mutex_init(&_extractionWriterMutex, NULL);
+    }
+    return self;
+}
+
+- (instancetype)initWithRandomAccessSource:(id<NOZRandomAccessSource>)randomAccessSource
+{
+    if (self = [super init]) {
+        _randomAccessSource = randomAccessSource;
+        _zipFilePath = [randomAccessSource description];
+        _internal.source.fileDescriptor = -1;
+        pthread_mutex_init(&_extractionWriterMutex, NULL);
     }
     return self;
 }
@@ -101,25 +396,86 @@ NOZ_OBJC_DIRECT_MEMBERS
 }
 
 - (BOOL)openAndReturnError:(out NSError **)error
+{
+    return [self openWithOptions:NOZUnzipperOpenOptionsNone error:error];
+}
+
+- (BOOL)openWithOptions:(NOZUnzipperOpenOptions)options error:(out NSError **)error
 {
     NSError *stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotOpenZip, @{ @"zipFilePath" : [self zipFilePath] ?: [NSNull null] });
-    _standardizedFilePath = [self.zipFilePath stringByStandardizingPath];
-    if (_standardizedFilePath.UTF8String) {
-        _internal.file = fopen(_standardizedFilePath.UTF8String, "r");
-        if (_internal.file) {
-            if (0 == fseeko(_internal.file, 0, SEEK_END)) {
-                _internal.endOfFilePosition = ftello(_internal.file);
-            } else {
-                _internal.endOfFilePosition = (off_t)[[[NSFileManager defaultManager] attributesOfItemAtPath:_standardizedFilePath error:nil] fileSize];
+    if (_randomAccessSource) {
+        if (![_randomAccessSource isKindOfClass:[NOZFileDescriptorSource class]]) {
+            return [self private_openRandomAccessSourceAndReturnError:error];
+        }
+        // read through our own descriptor, just like an archive opened by path
+        _internal.source.fileDescriptor = fcntl([(NOZFileDescriptorSource *)_randomAccessSource fileDescriptor], F_DUPFD_CLOEXEC, 0);
+    } else {
+        _standardizedFilePath = [self.zipFilePath stringByStandardizingPath];
+        if (_standardizedFilePath.UTF8String) {
+            _internal.source.fileDescriptor = open(_standardizedFilePath.UTF8String, O_RDONLY);
+        }
+    }
+
+    if (_internal.source.fileDescriptor >= 0) {
+        struct stat fileStat;
+        if (0 == fstat(_internal.source.fileDescriptor, &fileStat)) {
+            _internal.source.length = fileStat.st_size;
+            if ((options & NOZUnzipperOpenOptionSharedCentralDirectoryCache) != 0) {
+                _internal.usesSharedCentralDirectoryCache = YES;
+                bzero(&_internal.centralDirectoryCacheKey, sizeof(_internal.centralDirectoryCacheKey));
+                _internal.centralDirectoryCacheKey.device = (UInt64)fileStat.st_dev;
+                _internal.centralDirectoryCacheKey.inode = (UInt64)fileStat.st_ino;
+                _internal.centralDirectoryCacheKey.archiveSize = (UInt64)fileStat.st_size;
+#if defined(__APPLE__)
+                _internal.centralDirectoryCacheKey.modificationTimeSeconds = (SInt64)fileStat.st_mtimespec.tv_sec;
+                _internal.centralDirectoryCacheKey.modificationTimeNanoseconds = (SInt64)fileStat.st_mtimespec.tv_nsec;
+#else
+                _internal.centralDirectoryCacheKey.modificationTimeSeconds = (SInt64)fileStat.st_mtim.tv_sec;
+                _internal.centralDirectoryCacheKey.modificationTimeNanoseconds = (SInt64)fileStat.st_mtim.tv_nsec;
+#endif
+            }
+        } else if (_standardizedFilePath) {
+            _internal.source.length = (off_t)[[[NSFileManager defaultManager] attributesOfItemAtPath:_standardizedFilePath error:nil] fileSize];
+        } else {
+            // a provided file descriptor has no path to fall back to, identify it by its source
+            NSError *statError = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            const int fileDescriptor = [(NOZFileDescriptorSource *)_randomAccessSource fileDescriptor];
+            [self closeAndReturnError:NULL];
+            if (error) {
+                *error = NOZErrorCreate(NOZErrorCodeUnzipCannotOpenZip, @{ @"zipFilePath" : self.zipFilePath,
+                                                                           @"fileDescriptor" : @(fileDescriptor),
+                                                                           NSUnderlyingErrorKey : statError });
             }
-            _internal.endOfCentralDirectorySignaturePosition = [self private_locateSignature:NOZMagicNumberEndOfCentralDirectoryRecord];
-            if (_internal.endOfCentralDirectorySignaturePosition) {
+            return NO;
+        }
+        _internal.sequentialAccess = ((options & NOZUnzipperOpenOptionSequentialAccess) != 0);
+        _internal.dropsCacheBehindReads = ((options & NOZUnzipperOpenOptionNoCacheRetention) != 0);
+#if defined(__APPLE__)
+        if (_internal.dropsCacheBehindReads) {
+            // Darwin has no advice for dropping a range from the cache, but the descriptor is ours alone so nothing it reads needs caching
+            (void)fcntl(_internal.source.fileDescriptor, F_NOCACHE, 1);
+        }
+#endif
+        if ((options & NOZUnzipperOpenOptionMemoryMap) != 0) {
+            [self private_mapArchive];
+        }
+        if (_internal.usesSharedCentralDirectoryCache) {
+            NOZCentralDirectory *cachedCD = [[NOZCentralDirectoryCache sharedCache] private_centralDirectoryForKey:&_internal.centralDirectoryCacheKey];
+            if (cachedCD) {
+                // the archive was already parsed, no need to locate its end of central directory record
+                _internal.endOfCentralDirectorySignaturePosition = [cachedCD private_endOfCentralDirectoryRecordPosition];
+                _centralDirectory = cachedCD;
+                [self private_adviseDataAccess];
                 return YES;
-            } else {
-                [self closeAndReturnError:NULL];
-                stackError = NOZErrorCreate(NOZErrorCodeUnzipInvalidZipFile, @{ @"zipFilePath" : self.zipFilePath });
             }
         }
+        _internal.endOfCentralDirectorySignaturePosition = [self private_readTailAndLocateEndOfCentralDirectorySignature];
+        if (_internal.endOfCentralDirectorySignaturePosition) {
+            return YES;
+        } else {
+            [self closeAndReturnError:NULL];
+            stackError = NOZErrorCreate(NOZErrorCodeUnzipInvalidZipFile, @{ @"zipFilePath" : self.zipFilePath });
+        }
     }
 
     if (error) {
@@ -128,17 +484,84 @@ NOZ_OBJC_DIRECT_MEMBERS
     return NO;
 }
 
+- (BOOL)private_openRandomAccessSourceAndReturnError:(out NSError **)error
+{
+    // Nothing to map or advise, every read goes through the source (coalesced by the reader)
+
+    NSError *sourceError = nil;
+    const SInt64 length = [_randomAccessSource lengthAndReturnError:&sourceError];
+    if (length < 0) {
+        if (error) {
+            NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithObject:self.zipFilePath forKey:@"zipFilePath"];
+            if (sourceError) {
+                userInfo[NSUnderlyingErrorKey] = sourceError;
+            }
+            *error = NOZErrorCreate(NOZErrorCodeUnzipCannotOpenZip, userInfo);
+        }
+        return NO;
+    }
+
+    _randomAccessReader = [[NOZRandomAccessReader alloc] initWithSource:_randomAccessSource length:length];
+    _internal.source.reader = _randomAccessReader;
+    _internal.source.length = (off_t)length;
+
+    _internal.endOfCentralDirectorySignaturePosition = [self private_readTailAndLocateEndOfCentralDirectorySignature];
+    if (!_internal.endOfCentralDirectorySignaturePosition) {
+        [self closeAndReturnError:NULL];
+        if (error) {
+            *error = NOZErrorCreate(NOZErrorCodeUnzipInvalidZipFile, @{ @"zipFilePath" : self.zipFilePath });
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
 - (BOOL)closeAndReturnError:(out NSError **)error
 {
     _centralDirectory = nil;
-    if (_internal.file) {
-        fclose(_internal.file);
-        _internal.file = NULL;
+    if (_internal.source.mappedBytes) {
+        munmap((void *)_internal.source.mappedBytes, (size_t)_internal.source.length);
+        _internal.source.mappedBytes = NULL;
+    }
+    if (_internal.source.tailBytes) {
+        free((void *)_internal.source.tailBytes);
+        _internal.source.tailBytes = NULL;
     }
+    _internal.source.tailOffset = 0;
+    _internal.source.tailLength = 0;
+    if (_internal.source.fileDescriptor >= 0) {
+        close(_internal.source.fileDescriptor);
+        _internal.source.fileDescriptor = -1;
+    }
+    _internal.source.length = 0;
+    _internal.usesSharedCentralDirectoryCache = NO;
+    _internal.sequentialAccess = NO;
+    _internal.dropsCacheBehindReads = NO;
+    _internal.source.reader = nil;
+    _randomAccessReader = nil;
+    pthread_mutex_lock(&_extractionWriterMutex);
+    _extractionWriter = nil;
+    pthread_mutex_unlock(&_extractionWriterMutex);
     return YES;
 }
 
+- (BOOL)isMemoryMapped
+{
+    return _internal.source.mappedBytes != NULL;
+}
+
 - (NOZCentralDirectory *)readCentralDirectoryAndReturnError:(out NSError * __autoreleasing * )error
+{
+    return [self private_readCentralDirectoryWithIndexAtPath:nil error:error];
+}
+
+- (NOZCentralDirectory *)readCentralDirectoryWithIndexAtPath:(NSString *)indexPath error:(out NSError **)error
+{
+    return [self private_readCentralDirectoryWithIndexAtPath:indexPath error:error];
+}
+
+- (NOZCentralDirectory *)private_readCentralDirectoryWithIndexAtPath:(NSString *)indexPath error:(out NSError * __autoreleasing * )error
 {
     __block NSError *stackError = nil;
     noz_defer(^{
@@ -147,20 +570,52 @@ NOZ_OBJC_DIRECT_MEMBERS
         }
     });
 
-    if (!_internal.file || !_internal.endOfCentralDirectorySignaturePosition) {
+    if (!noz_source_is_open(&_internal.source) || !_internal.endOfCentralDirectorySignaturePosition) {
         stackError = NOZErrorCreate(NOZErrorCodeUnzipMustOpenUnzipperBeforeManipulating, nil);
         return nil;
     }
 
-    NOZCentralDirectory *cd = [[NOZCentralDirectory alloc] initWithKnownFileSize:_internal.endOfFilePosition];
+    if (_internal.usesSharedCentralDirectoryCache) {
+        NOZCentralDirectory *cachedCD = [[NOZCentralDirectoryCache sharedCache] private_centralDirectoryForKey:&_internal.centralDirectoryCacheKey];
+        if (cachedCD) {
+            _centralDirectory = cachedCD;
+            [self private_adviseDataAccess];
+            return cachedCD;
+        }
+    }
+
+    NOZCentralDirectory *cd = [[NOZCentralDirectory alloc] initWithKnownFileSize:_internal.source.length];
 
     @autoreleasepool {
-        if (![cd private_readEndOfCentralDirectoryRecordAtPosition:_internal.endOfCentralDirectorySignaturePosition inFile:_internal.file]) {
+        if (![cd private_readEndOfCentralDirectoryRecordAtPosition:_internal.endOfCentralDirectorySignaturePosition source:&_internal.source]) {
             stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadCentralDirectory, nil);
             return nil;
         }
 
-        if (![cd private_readCentralDirectoryEntriesWithFile:_internal.file]) {
+        // An index written for this exact archive replaces parsing the central directory
+
+        NOZCentralDirectoryIndexKeyT indexKey;
+        bzero(&indexKey, sizeof(indexKey));
+        BOOL hasIndexKey = NO;
+        if (indexPath) {
+            struct stat fileStat;
+            if (0 == fstat(_internal.source.fileDescriptor, &fileStat)) {
+                indexKey.archiveSize = (UInt64)fileStat.st_size;
+#if defined(__APPLE__)
+                indexKey.modificationTimeSeconds = (SInt64)fileStat.st_mtimespec.tv_sec;
+                indexKey.modificationTimeNanoseconds = (SInt64)fileStat.st_mtimespec.tv_nsec;
+#else
+                indexKey.modificationTimeSeconds = (SInt64)fileStat.st_mtim.tv_sec;
+                indexKey.modificationTimeNanoseconds = (SInt64)fileStat.st_mtim.tv_nsec;
+#endif
+                indexKey.endOfCentralDirectoryRecordPosition = (UInt64)_internal.endOfCentralDirectorySignaturePosition;
+                indexKey.endOfCentralDirectoryChecksum = [cd private_endOfCentralDirectoryChecksumWithSource:&_internal.source];
+                hasIndexKey = YES;
+            }
+        }
+
+        const BOOL readIndex = hasIndexKey && [cd private_readIndexAtPath:indexPath key:&indexKey];
+        if (!readIndex && ![cd private_readCentralDirectoryEntriesWithSource:&_internal.source]) {
             stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadCentralDirectory, nil);
             return nil;
         }
@@ -168,9 +623,19 @@ NOZ_OBJC_DIRECT_MEMBERS
         if (![cd private_validateCentralDirectoryAndReturnError:&stackError]) {
             return nil;
         }
+
+        if (hasIndexKey && !readIndex) {
+            // best effort, failing to write the index doesn't fail reading the central directory
+            (void)[cd private_writeIndexToPath:indexPath key:&indexKey];
+        }
+    }
+
+    if (_internal.usesSharedCentralDirectoryCache) {
+        [[NOZCentralDirectoryCache sharedCache] private_setCentralDirectory:cd forKey:&_internal.centralDirectoryCacheKey];
     }
 
     _centralDirectory = cd;
+    [self private_adviseDataAccess];
     return cd;
 }
 
@@ -190,9 +655,27 @@ NOZ_OBJC_DIRECT_MEMBERS
     return (_centralDirectory) ? [_centralDirectory private_indexForRecordWithName:name] : NSNotFound;
 }
 
+- (NSUInteger)indexForRecordWithNameBytes:(const void *)nameBytes length:(NSUInteger)length
+{
+    if (!_centralDirectory || !nameBytes) {
+        return NSNotFound;
+    }
+    return [_centralDirectory private_indexForRecordWithNameBytes:nameBytes
+                                                           length:length
+                                                           filter:NOZNameEncodingFilterAny];
+}
+
 - (void)enumerateManifestEntriesUsingBlock:(NOZUnzipRecordEnumerationBlock NS_NOESCAPE)block
 {
-    [[_centralDirectory private_internalRecords] enumerateObjectsUsingBlock:block];
+    // Records are created on demand (one at a time) from the central directory's columns
+
+    const NSUInteger count = _centralDirectory.recordCount;
+    BOOL stop = NO;
+    for (NSUInteger i = 0; i < count && !stop; i++) {
+        @autoreleasepool {
+            block([_centralDirectory private_recordAtIndex:i], i, &stop);
+        }
+    }
 }
 
 - (BOOL)enumerateByteRangesOfRecord:(NOZCentralDirectoryRecord *)record
@@ -208,7 +691,7 @@ NOZ_OBJC_DIRECT_MEMBERS
     });
 
     @autoreleasepool {
-        if (!_internal.file) {
+        if (!noz_source_is_open(&_internal.source)) {
             stackError = NOZErrorCreate(NOZErrorCodeUnzipMustOpenUnzipperBeforeManipulating, nil);
             return NO;
         }
@@ -218,8 +701,10 @@ NOZ_OBJC_DIRECT_MEMBERS
             return NO;
         }
 
-        if (![self private_locateCompressedDataOfRecord:record]) {
-            stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, nil);
+        NSError *sourceError = nil;
+        const off_t offsetToFirstByte = [self private_locateCompressedDataOfRecord:record sourceError:&sourceError];
+        if (offsetToFirstByte < 0) {
+            stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, noz_source_error_user_info(sourceError));
             return NO;
         }
 
@@ -231,57 +716,48 @@ NOZ_OBJC_DIRECT_MEMBERS
             }
         } while (0);
 
-        _currentUnzipping.isUnzipping = YES;
-        noz_defer(^{ self->_currentUnzipping.isUnzipping = NO; });
+        NOZUnzipStateT state = { 0 };
+        state.offsetToFirstByte = offsetToFirstByte;
+        state.entry = record.private_internalEntry;
 
-        _currentUnzipping.offsetToFirstByte = ftello(_internal.file);
-        if (_currentUnzipping.offsetToFirstByte == -1) {
-            stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, nil);
+        id<NOZDecoder> decoder = [[NOZCompressionLibrary sharedInstance] decoderForMethod:state.entry->fileHeader.compressionMethod];
+        if (!decoder) {
+            stackError = NOZErrorCreate(NOZErrorCodeUnzipDecompressionMethodNotSupported, nil);
             return NO;
         }
 
-        _currentUnzipping.crc32 = 0;
-
-        __unsafe_unretained typeof(self) rawSelf = self;
+        NOZUnzipStateT *statePtr = &state;
         NOZFlushCallback flushCallback = ^BOOL(id coder,
                                                id context,
                                                const Byte* bufferToFlush,
                                                size_t length) {
-            if (rawSelf->_currentDecoder != coder) {
+            if (decoder != coder) {
                 return NO;
             }
 
-            return [rawSelf private_flushDecompressedBytes:bufferToFlush
-                                                    length:length
-                                                     block:block];
+            return noz_flush_decompressed_bytes(statePtr, bufferToFlush, length, block);
         };
-        _currentDecoder = [[NOZCompressionLibrary sharedInstance] decoderForMethod:[record private_internalEntry]->fileHeader.compressionMethod];
-        _currentDecoderContext = [_currentDecoder createContextForDecodingWithBitFlags:[record private_internalEntry]->fileHeader.bitFlag
-                                                                         flushCallback:flushCallback];
-
-        noz_defer(^{
-            self->_currentDecoder = nil;
-            self->_currentDecoderContext = nil;
-        });
-
-        if (!_currentDecoder || !_currentDecoderContext) {
+        id<NOZDecoderContext> decoderContext = [decoder createContextForDecodingWithBitFlags:state.entry->fileHeader.bitFlag
+                                                                               flushCallback:flushCallback];
+        if (!decoderContext) {
             stackError = NOZErrorCreate(NOZErrorCodeUnzipDecompressionMethodNotSupported, nil);
             return NO;
         }
-        
-        if (![_currentDecoder initializeDecoderContext:_currentDecoderContext]) {
+
+        if (![decoder initializeDecoderContext:decoderContext]) {
             stackError = NOZErrorCreate(NOZErrorCodeUnzipFailedToDecompressEntry, nil);
             return NO;
         }
-        
-        _currentUnzipping.entry = record.private_internalEntry;
-        noz_defer(^{ self->_currentUnzipping.entry = NULL; });
-        
-        if (![self private_deflateWithProgressBlock:progressBlock usingBlock:block error:&stackError]) {
+
+        if (![self private_decodeWithState:&state
+                                   decoder:decoder
+                                   context:decoderContext
+                             progressBlock:progressBlock
+                                     error:&stackError]) {
             return NO;
         }
-        
-        if (![_currentDecoder finalizeDecoderContext:_currentDecoderContext]) {
+
+        if (![decoder finalizeDecoderContext:decoderContext]) {
             stackError = NOZErrorCreate(NOZErrorCodeUnzipFailedToDecompressEntry, nil);
             return NO;
         }
@@ -294,15 +770,191 @@ NOZ_OBJC_DIRECT_MEMBERS
                  progressBlock:(NOZProgressBlock)progressBlock
                          error:(out NSError **)error
 {
-    __block NSMutableData *data = nil;
+    // Decoding in one shot straight into the final buffer is preferred, decoding through a context is the fallback
+
+    NSError *oneShotError = nil;
+    NSData *oneShotData = [self private_readDataInOneShotFromRecord:record progressBlock:progressBlock error:&oneShotError];
+    if (oneShotData || oneShotError) {
+        if (oneShotError && error) {
+            *error = oneShotError;
+        }
+        return oneShotData;
+    }
+
+    const NOZFileEntryT *entry = [record private_isOwnedByCentralDirectory:_centralDirectory] ? record.private_internalEntry : NULL;
+    __block NSMutableData *data = [NSMutableData dataWithCapacity:(entry) ? noz_trusted_uncompressed_capacity(entry, entry->fileDescriptor.uncompressedSize) : 0];
     if (![self enumerateByteRangesOfRecord:record
                              progressBlock:progressBlock
                                 usingBlock:^(const void * __nonnull bytes,
                                              NSRange byteRange,
                                              BOOL * __nonnull stop) {
-                                    if (!data) {
-                                        data = [NSMutableData dataWithCapacity:byteRange.length];
-                                    }
+                                    [data appendBytes:bytes length:byteRange.length];
+                                }
+                                     error:error]) {
+        data = nil;
+    }
+
+    return data;
+}
+
+- (NOZCheckpointIndex *)buildCheckpointIndexForRecord:(NOZCentralDirectoryRecord *)record
+                                   checkpointInterval:(SInt64)checkpointInterval
+                                        progressBlock:(NOZProgressBlock)progressBlock
+                                                error:(out NSError * __autoreleasing *)error
+{
+    __block NSError *stackError = nil;
+    noz_defer(^{
+        if (error && stackError) {
+            *error = stackError;
+        }
+    });
+
+    const off_t offsetToFirstByte = [self private_prepareToReadRecord:record error:&stackError];
+    if (offsetToFirstByte < 0) {
+        return nil;
+    }
+
+    const NOZFileEntryT *entry = record.private_internalEntry;
+    if (entry->fileHeader.compressionMethod != NOZCompressionMethodNone && entry->fileHeader.compressionMethod != NOZCompressionMethodDeflate) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipDecompressionMethodNotSupported, nil);
+        return nil;
+    }
+
+    NOZCheckpointIndex *checkpointIndex = [[NOZCheckpointIndex alloc] initWithEntry:entry
+                                                                 checkpointInterval:(checkpointInterval > 0) ? checkpointInterval : NOZCheckpointIndexDefaultInterval];
+    if (entry->fileHeader.compressionMethod == NOZCompressionMethodNone) {
+        return checkpointIndex; // stored records are read directly, no checkpoints needed
+    }
+
+    NSError *sourceError = nil;
+    @autoreleasepool {
+        if (![checkpointIndex private_indexDeflatedBytes:[self private_compressedBytesBlockWithOffsetToFirstByte:offsetToFirstByte sourceError:&sourceError]
+                                           progressBlock:progressBlock
+                                                   error:&stackError]) {
+            stackError = noz_read_error_with_source_error(stackError, sourceError);
+            return nil;
+        }
+    }
+
+    return checkpointIndex;
+}
+
+- (BOOL)enumerateByteRangesOfRecord:(NOZCentralDirectoryRecord *)record
+                              range:(NSRange)range
+                    checkpointIndex:(NOZCheckpointIndex *)checkpointIndex
+                         usingBlock:(NOZUnzipByteRangeEnumerationBlock)block
+                              error:(out NSError * __autoreleasing *)error
+{
+    __block NSError *stackError = nil;
+    noz_defer(^{
+        if (error && stackError) {
+            *error = stackError;
+        }
+    });
+
+    const off_t offsetToFirstByte = [self private_prepareToReadRecord:record error:&stackError];
+    if (offsetToFirstByte < 0) {
+        return NO;
+    }
+
+    const NOZFileEntryT *entry = record.private_internalEntry;
+    const UInt64 uncompressedSize = entry->fileDescriptor.uncompressedSize;
+    if ((UInt64)range.location > uncompressedSize) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipIndexOutOfBounds, nil);
+        return NO;
+    }
+    range.length = (NSUInteger)MIN((UInt64)range.length, uncompressedSize - (UInt64)range.location);
+    if (0 == range.length) {
+        return YES;
+    }
+
+    if (checkpointIndex && ![checkpointIndex private_matchesEntry:entry]) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipCheckpointIndexDoesNotMatchRecord, nil);
+        return NO;
+    }
+
+    @autoreleasepool {
+
+        if (entry->fileHeader.compressionMethod == NOZCompressionMethodNone) {
+
+            // Stored, read the range directly
+
+            if (entry->fileDescriptor.compressedSize != uncompressedSize) {
+                stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, nil);
+                return NO;
+            }
+
+            const size_t pageSize = NOZBufferSize();
+            Byte buffer[pageSize];
+            const size_t chunkSize = (_internal.source.mappedBytes) ? kNOZMappedChunkSize : sizeof(buffer);
+            NSUInteger position = range.location;
+            BOOL stop = NO;
+            while (!stop && position < NSMaxRange(range)) {
+                const size_t length = MIN(chunkSize, (size_t)(NSMaxRange(range) - position));
+                NSError *sourceError = nil;
+                const Byte *bytes = noz_source_read_bytes(&_internal.source, offsetToFirstByte + (off_t)position, length, buffer, &sourceError);
+                if (!bytes) {
+                    stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, noz_source_error_user_info(sourceError));
+                    return NO;
+                }
+                block(bytes, NSMakeRange(position, length), &stop);
+                position += length;
+            }
+            return YES;
+        }
+
+        if (entry->fileHeader.compressionMethod == NOZCompressionMethodDeflate && checkpointIndex) {
+            NSError *sourceError = nil;
+            if (![checkpointIndex private_inflateRange:range
+                                       compressedBytes:[self private_compressedBytesBlockWithOffsetToFirstByte:offsetToFirstByte sourceError:&sourceError]
+                                            usingBlock:block
+                                                 error:&stackError]) {
+                stackError = noz_read_error_with_source_error(stackError, sourceError);
+                return NO;
+            }
+            return YES;
+        }
+
+        // No checkpoints, decode from the start and only provide the bytes within range
+
+        __block BOOL reachedEndOfRange = NO;
+        __block BOOL stoppedEarly = NO;
+        const BOOL success = [self enumerateByteRangesOfRecord:record
+                                                 progressBlock:NULL
+                                                    usingBlock:^(const void * __nonnull bytes,
+                                                                 NSRange byteRange,
+                                                                 BOOL * __nonnull stop) {
+            const NSRange intersection = NSIntersectionRange(byteRange, range);
+            if (intersection.length > 0) {
+                block((const Byte *)bytes + (intersection.location - byteRange.location), intersection, &stoppedEarly);
+            }
+            if (NSMaxRange(byteRange) >= NSMaxRange(range)) {
+                reachedEndOfRange = YES;
+            }
+            *stop = reachedEndOfRange || stoppedEarly;
+        }
+                                                         error:&stackError];
+        if (!success && (reachedEndOfRange || stoppedEarly)) {
+            stackError = nil; // decoding was stopped after the range was read
+            return YES;
+        }
+        return success;
+    }
+}
+
+- (NSData *)readDataFromRecord:(NOZCentralDirectoryRecord *)record
+                         range:(NSRange)range
+               checkpointIndex:(NOZCheckpointIndex *)checkpointIndex
+                         error:(out NSError **)error
+{
+    const NOZFileEntryT *entry = [record private_isOwnedByCentralDirectory:_centralDirectory] ? record.private_internalEntry : NULL;
+    __block NSMutableData *data = [NSMutableData dataWithCapacity:(entry) ? noz_trusted_uncompressed_capacity(entry, range.length) : 0];
+    if (![self enumerateByteRangesOfRecord:record
+                                     range:range
+                           checkpointIndex:checkpointIndex
+                                usingBlock:^(const void * __nonnull bytes,
+                                             NSRange byteRange,
+                                             BOOL * __nonnull stop) {
                                     [data appendBytes:bytes length:byteRange.length];
                                 }
                                      error:error]) {
@@ -342,7 +994,6 @@ NOZ_OBJC_DIRECT_MEMBERS
     const BOOL overwrite = (options & NOZUnzipperSaveRecordOptionOverwriteExisting) != 0;
     const BOOL followIntermediatePaths = !(options & NOZUnzipperSaveRecordOptionIgnoreIntermediatePath);
 
-    NSFileManager *fm = [NSFileManager defaultManager];
     NSString *destinationFile = nil;
     if (followIntermediatePaths) {
         destinationFile = [[destinationRootDirectory stringByAppendingPathComponent:[record private_nameNoCopy]] stringByStandardizingPath];
@@ -350,65 +1001,259 @@ NOZ_OBJC_DIRECT_MEMBERS
         destinationFile = [[destinationRootDirectory stringByAppendingPathComponent:[record private_nameNoCopy].lastPathComponent] stringByStandardizingPath];
     }
 
-    if (![destinationFile hasPrefix:destinationRootDirectory]) {
+    NSString *rootPrefix = [destinationRootDirectory hasSuffix:@"/"] ? destinationRootDirectory : [destinationRootDirectory stringByAppendingString:@"/"];
+    if (![destinationFile hasPrefix:rootPrefix] || destinationFile.length <= rootPrefix.length) {
         stackError = [NSError errorWithDomain:NSPOSIXErrorDomain code:EBADF userInfo:nil];
         return NO;
     }
 
-    if (![fm createDirectoryAtPath:[destinationFile stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:error]) {
-        stackError = [NSError errorWithDomain:NSPOSIXErrorDomain code:EACCES userInfo:nil];
-        return NO;
-    }
-
-    if (!overwrite && [fm fileExistsAtPath:destinationFile]) {
-        stackError = [NSError errorWithDomain:NSPOSIXErrorDomain code:EEXIST userInfo:nil];
-        return NO;
+    NSString *relativePath = [destinationFile substringFromIndex:rootPrefix.length];
+    const UInt64 expectedSize = (record.uncompressedSize > 0) ? (UInt64)record.uncompressedSize : 0;
+    NOZExtractionFile *file = nil;
+    for (NSUInteger attempt = 0; !file && attempt < 2; attempt++) {
+        NOZExtractionWriter *writer = [self private_extractionWriterForDirectory:destinationRootDirectory
+                                                                      discarding:(attempt > 0)
+                                                                           error:&stackError];
+        if (!writer) {
+            return NO;
+        }
+        file = [writer createFileAtRelativePath:relativePath expectedSize:expectedSize overwrite:overwrite error:&stackError];
+        if (!file && !([stackError.domain isEqualToString:NSPOSIXErrorDomain] && stackError.code == ENOENT)) {
+            return NO;
+        }
+        // ENOENT: the destination directory was removed since the writer opened it, start over with a new writer
     }
-
-    FILE *file = fopen(destinationFile.UTF8String, "w+");
     if (!file) {
-        stackError = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
         return NO;
     }
+    stackError = nil;
 
     NSDate *fileDate = noz_NSDate_from_dos_date(record.private_internalEntry->fileHeader.dosDate,
                                                 record.private_internalEntry->fileHeader.dosTime);
 
-    noz_defer(^{
-        off_t offset = ftello(file);
-        fclose(file);
-        if (offset == 0) {
-            [[NSFileManager defaultManager] removeItemAtPath:destinationFile error:NULL];
-        } else if (fileDate) {
-            [[NSFileManager defaultManager] setAttributes:@{ NSFileModificationDate : fileDate }
-                                             ofItemAtPath:destinationFile
-                                                    error:NULL];
+    if (record.private_internalEntry->fileHeader.compressionMethod == NOZCompressionMethodNone) {
+        // Stored, no need to go through a decoder
+        const BOOL validatesChecksum = (options & NOZUnzipperSaveRecordOptionSkipChecksumValidation) == 0;
+        const BOOL copied = [self private_copyStoredRecord:record
+                                                    toFile:file
+                                         validatesChecksum:validatesChecksum
+                                             progressBlock:progressBlock
+                                                     error:&stackError];
+        if (![file closeWithModificationDate:fileDate keepIfEmpty:NO] && copied) {
+            stackError = [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
+            return NO;
         }
-    });
+        return copied;
+    }
 
-    if (![self enumerateByteRangesOfRecord:record
-                             progressBlock:progressBlock
-                                usingBlock:^(const void * __nonnull bytes,
-                                             NSRange byteRange,
-                                             BOOL * __nonnull stop) {
-                                    if (fwrite(bytes, 1, byteRange.length, file) != byteRange.length) {
-                                        *stop = YES;
-                                    } else {
-#if DEBUG
-                                        if ((byteRange.length + byteRange.location) == self->_currentUnzipping.entry->fileDescriptor.uncompressedSize) {
-                                            fflush(file);
-                                        }
-#endif
-                                    }
-                                }
-                                     error:error]) {
+    __block BOOL writeFailed = NO;
+    const BOOL success = [self enumerateByteRangesOfRecord:record
+                                             progressBlock:progressBlock
+                                                usingBlock:^(const void * __nonnull bytes,
+                                                             NSRange byteRange,
+                                                             BOOL * __nonnull stop) {
+                                                    if (![file appendBytes:bytes length:byteRange.length]) {
+                                                        writeFailed = YES;
+                                                        *stop = YES;
+                                                    }
+                                                }
+                                                     error:error];
+    if (![file closeWithModificationDate:fileDate keepIfEmpty:NO] && success) {
+        writeFailed = YES;
+    }
+    if (!success) {
+        return NO;
+    }
+    if (writeFailed) {
+        stackError = [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
         return NO;
     }
 
     return YES;
 }
 
-- (BOOL)validateRecord:(NOZCentralDirectoryRecord *)record
+- (BOOL)private_copyStoredRecord:(NOZCentralDirectoryRecord *)record
+                          toFile:(NOZExtractionFile *)file
+               validatesChecksum:(BOOL)validatesChecksum
+                   progressBlock:(NOZProgressBlock)progressBlock
+                           error:(out NSError **)error
+{
+    __block NSError *stackError = nil;
+    noz_defer(^{
+        if (error && stackError) {
+            *error = stackError;
+        }
+    });
+
+    const off_t offsetToFirstByte = [self private_prepareToReadRecord:record error:&stackError];
+    if (offsetToFirstByte < 0) {
+        return NO;
+    }
+
+    const NOZFileEntryT *entry = record.private_internalEntry;
+    const UInt64 size = entry->fileDescriptor.compressedSize;
+    if (size != entry->fileDescriptor.uncompressedSize || size > (UInt64)(_internal.source.length - offsetToFirstByte)) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, nil);
+        return NO;
+    }
+
+    // Without a checksum to compute, the bytes don't need to be seen at all: the kernel copies them from the archive.
+    // Otherwise they are read (straight from the mapping when memory mapped) and written in large chunks.
+
+    const BOOL isMapped = (_internal.source.mappedBytes != NULL);
+    const BOOL readsBytes = validatesChecksum || isMapped || _internal.source.fileDescriptor < 0;
+    __block Byte *buffer = NULL;
+    noz_defer(^{ free(buffer); });
+    if (readsBytes && !isMapped) {
+        buffer = malloc(kNOZMappedChunkSize);
+        if (!buffer) {
+            stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, nil);
+            return NO;
+        }
+    }
+
+    UInt32 crc = (UInt32)crc32(0, NULL, 0);
+    UInt64 copiedSize = 0;
+    while (copiedSize < size) {
+        const size_t length = (size_t)MIN(size - copiedSize, (UInt64)kNOZMappedChunkSize);
+        const off_t offset = offsetToFirstByte + (off_t)copiedSize;
+
+        BOOL appended = NO;
+        if (readsBytes) {
+            NSError *sourceError = nil;
+            const Byte *bytes = noz_source_read_bytes(&_internal.source, offset, length, buffer, &sourceError);
+            if (!bytes) {
+                stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, noz_source_error_user_info(sourceError));
+                return NO;
+            }
+            if (validatesChecksum) {
+                crc = (UInt32)crc32(crc, bytes, (uInt)length);
+            }
+            appended = [file appendBytes:bytes length:length];
+        } else {
+            appended = [file appendContentsOfFileDescriptor:_internal.source.fileDescriptor offset:offset length:length];
+        }
+        if (!appended) {
+            stackError = [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
+            return NO;
+        }
+        copiedSize += length;
+
+        if (_internal.dropsCacheBehindReads) {
+            noz_source_advise(&_internal.source, offset, (off_t)length, NOZAccessAdviceDontNeed);
+        }
+
+        if (progressBlock) {
+            BOOL stop = NO;
+            progressBlock((SInt64)size, (SInt64)copiedSize, (SInt64)length, &stop);
+            if (stop) {
+                stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotDecompressFileEntry, nil);
+                return NO;
+            }
+        }
+    }
+
+    if (validatesChecksum && crc != entry->fileDescriptor.crc32) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipChecksumMissmatch, nil);
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)writeCompressedBytesOfRecord:(NOZCentralDirectoryRecord *)record
+                    toFileDescriptor:(int)fileDescriptor
+                       progressBlock:(NOZProgressBlock)progressBlock
+                               error:(out NSError **)error
+{
+    __block NSError *stackError = nil;
+    noz_defer(^{
+        if (error && stackError) {
+            *error = stackError;
+        }
+    });
+
+    const off_t offsetToFirstByte = [self private_prepareToReadRecord:record error:&stackError];
+    if (offsetToFirstByte < 0) {
+        return NO;
+    }
+
+    const UInt64 size = record.private_internalEntry->fileDescriptor.compressedSize;
+    if (size > (UInt64)(_internal.source.length - offsetToFirstByte)) {
+        stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, nil);
+        return NO;
+    }
+
+    // The kernel copies the bytes from the archive where it can.
+    // Otherwise they are read (straight from the mapping when memory mapped) and written in large chunks.
+
+    const BOOL isMapped = (_internal.source.mappedBytes != NULL);
+    const BOOL kernelCopies = !isMapped && _internal.source.fileDescriptor >= 0;
+    __block Byte *buffer = NULL;
+    noz_defer(^{ free(buffer); });
+
+    UInt64 copiedSize = 0;
+    while (copiedSize < size) {
+        const size_t length = (size_t)MIN(size - copiedSize, (UInt64)kNOZMappedChunkSize);
+        const off_t chunkOffset = offsetToFirstByte + (off_t)copiedSize;
+        off_t offset = chunkOffset;
+        UInt64 remainingLength = length;
+
+        if (kernelCopies) {
+            noz_kernel_copy(_internal.source.fileDescriptor, &offset, fileDescriptor, &remainingLength);
+        }
+        if (remainingLength > 0) {
+            if (!isMapped && !buffer) {
+                buffer = malloc(kNOZMappedChunkSize);
+                if (!buffer) {
+                    stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, nil);
+                    return NO;
+                }
+            }
+            NSError *sourceError = nil;
+            const Byte *bytes = noz_source_read_bytes(&_internal.source, offset, (size_t)remainingLength, buffer, &sourceError);
+            if (!bytes) {
+                stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, noz_source_error_user_info(sourceError));
+                return NO;
+            }
+            if (!noz_write_fully(fileDescriptor, bytes, (size_t)remainingLength)) {
+                stackError = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+                return NO;
+            }
+        }
+        copiedSize += length;
+
+        if (_internal.dropsCacheBehindReads) {
+            noz_source_advise(&_internal.source, chunkOffset, (off_t)length, NOZAccessAdviceDontNeed);
+        }
+
+        if (progressBlock) {
+            BOOL stop = NO;
+            progressBlock((SInt64)size, (SInt64)copiedSize, (SInt64)length, &stop);
+            if (stop) {
+                stackError = NOZErrorCreate(NOZErrorCodeUnzipCannotDecompressFileEntry, nil);
+                return NO;
+            }
+        }
+    }
+
+    return YES;
+}
+
+- (NOZExtractionWriter *)private_extractionWriterForDirectory:(NSString *)destinationRootDirectory
+                                                   discarding:(BOOL)discardExistingWriter
+                                                        error:(out NSError **)error
+{
+    pthread_mutex_lock(&_extractionWriterMutex);
+    noz_defer(^{ pthread_mutex_unlock(&self->_extractionWriterMutex); });
+
+    if (discardExistingWriter || ![_extractionWriter.destinationDirectoryPath isEqualToString:destinationRootDirectory]) {
+        _extractionWriter = [[NOZExtractionWriter alloc] initWithDestinationDirectoryPath:destinationRootDirectory error:error];
+    }
+    return _extractionWriter;
+}
+
+- (BOOL)validateRecord:(NOZCentralDirectoryRecord *)record
          progressBlock:(NOZProgressBlock)progressBlock
                  error:(out NSError **)error
 {
@@ -422,138 +1267,312 @@ NOZ_OBJC_DIRECT_MEMBERS
                                        error:error];
 }
 
-- (BOOL)private_flushDecompressedBytes:(const Byte *)buffer
-                                length:(size_t)length
-                                 block:(NOZUnzipByteRangeEnumerationBlock)block
+- (void)private_adviseDataAccess
 {
-    _currentUnzipping.crc32 = (UInt32)crc32(_currentUnzipping.crc32, buffer, (UInt32)length);
-    _currentUnzipping.bytesDecompressed += length;
+    if (_internal.sequentialAccess) {
+        // the entries' data precedes the central directory
+        noz_source_advise(&_internal.source, 0, [_centralDirectory private_centralDirectoryStartPosition], NOZAccessAdviceSequential);
+    }
+}
 
-    BOOL abort = NO;
-    block(buffer, NSMakeRange((NSUInteger)(_currentUnzipping.bytesDecompressed - length), (NSUInteger)length), &abort);
+- (void)private_mapArchive
+{
+    const off_t length = _internal.source.length;
+    if (length <= 0 || (UInt64)length > (UInt64)SIZE_MAX) {
+        return;
+    }
 
-    return !abort;
+    // Failing to map is not fatal, we'll just fall back to reading from the file descriptor
+
+    void *bytes = mmap(NULL, (size_t)length, PROT_READ, MAP_FILE | MAP_SHARED, _internal.source.fileDescriptor, 0);
+    if (bytes != MAP_FAILED) {
+        _internal.source.mappedBytes = bytes;
+    }
 }
 
-- (off_t)private_locateSignature:(UInt32)signature
+- (off_t)private_readTailAndLocateEndOfCentralDirectorySignature
 {
-    Byte sig[4];
+    // One read of the tail covers the EOCD record with the max global comment size,
+    // as well as the ZIP64 locator that precedes the EOCD record (for all but the longest comments)
 
-#if __BIG_ENDIAN__
-    sig[0] = ((Byte*)(&signature))[3];
-    sig[1] = ((Byte*)(&signature))[2];
-    sig[2] = ((Byte*)(&signature))[1];
-    sig[3] = ((Byte*)(&signature))[0];
-#else
-    sig[0] = ((Byte*)(&signature))[0];
-    sig[1] = ((Byte*)(&signature))[1];
-    sig[2] = ((Byte*)(&signature))[2];
-    sig[3] = ((Byte*)(&signature))[3];
-#endif
+    const off_t maxTailLength = UINT16_MAX /* max global comment size */ + (off_t)NOZEndOfCentralDirectoryRecordFixedSize + (off_t)NOZZip64EndOfCentralDirectoryLocatorFixedSize;
+    const size_t tailLength = (size_t)MIN(_internal.source.length, maxTailLength);
+    const off_t tailOffset = _internal.source.length - (off_t)tailLength;
+    if (tailLength < NOZEndOfCentralDirectoryRecordFixedSize) {
+        return 0;
+    }
 
-    const size_t pageSize = NOZBufferSize();
-    Byte buffer[pageSize];
-    size_t bytesRead = 0;
-    size_t maxBytes = UINT16_MAX /* max global comment size */ + 22 /* End of Central Directory Record size */;
+    if (!_internal.source.mappedBytes) {
+        Byte *tailBytes = malloc(tailLength);
+        if (!tailBytes || !noz_source_read(&_internal.source, tailBytes, tailLength, tailOffset, NULL)) {
+            free(tailBytes);
+            return 0;
+        }
+        _internal.source.tailBytes = tailBytes;
+        _internal.source.tailOffset = tailOffset;
+        _internal.source.tailLength = tailLength;
+    }
+
+    const Byte *tail = noz_source_bytes(&_internal.source, tailOffset, tailLength, NULL);
+    if (!tail) {
+        return 0;
+    }
 
-    if (0 != fseeko(_internal.file, 0, SEEK_END)) {
+    const Byte *signature = NOZFindEndOfCentralDirectoryRecord(tail, tailLength);
+    if (!signature) {
         return 0;
     }
 
-    size_t fileSize = (size_t)ftello(_internal.file);
-    if (maxBytes > fileSize) {
-        maxBytes = fileSize;
+    return tailOffset + (off_t)(signature - tail);
+}
+
+- (off_t)private_locateCompressedDataOfRecord:(NOZCentralDirectoryRecord *)record sourceError:(out NSError **)sourceError
+{
+    NOZFileEntryT *entry = record.private_internalEntry;
+    if (!entry) {
+        return -1;
+    }
+
+    const off_t resolvedOffset = [record private_offsetToCompressedData];
+    if (resolvedOffset > 0) {
+        return resolvedOffset;
+    }
+
+    const off_t localFileHeaderOffset = (off_t)entry->centralDirectoryRecord.localFileHeaderOffsetFromStartOfDisk;
+    Byte buffer[NOZLocalFileHeaderFixedSize];
+    const Byte *bytes = noz_source_read_bytes(&_internal.source, localFileHeaderOffset, sizeof(buffer), buffer, sourceError);
+    if (!bytes) {
+        return -1;
     }
 
-    while (bytesRead < maxBytes) {
-        size_t sizeToRead = sizeof(buffer);
-        if (sizeToRead > (maxBytes - bytesRead)) {
-            sizeToRead = maxBytes - bytesRead;
+    return noz_offset_to_compressed_data(entry, bytes, localFileHeaderOffset, _internal.source.length);
+}
+
+- (NSArray<NOZCentralDirectoryRecord *> *)planSequentialReadOfRecords:(NSArray<NOZCentralDirectoryRecord *> *)records
+                                                                error:(out NSError **)error
+{
+    if (!noz_source_is_open(&_internal.source) || !_centralDirectory) {
+        if (error) {
+            *error = NOZErrorCreate(NOZErrorCodeUnzipMustOpenUnzipperBeforeManipulating, nil);
         }
-        if (sizeToRead < 4) {
-            return 0;
+        return nil;
+    }
+
+    NSArray<NOZCentralDirectoryRecord *> *sortedRecords = [records sortedArrayWithOptions:NSSortStable
+                                                                          usingComparator:^NSComparisonResult(NOZCentralDirectoryRecord *record1, NOZCentralDirectoryRecord *record2) {
+        const UInt64 offset1 = record1.private_internalEntry->centralDirectoryRecord.localFileHeaderOffsetFromStartOfDisk;
+        const UInt64 offset2 = record2.private_internalEntry->centralDirectoryRecord.localFileHeaderOffsetFromStartOfDisk;
+        if (offset1 == offset2) {
+            return NSOrderedSame;
         }
+        return (offset1 < offset2) ? NSOrderedAscending : NSOrderedDescending;
+    }];
 
-        off_t position = (off_t)fileSize - (off_t)bytesRead - (off_t)sizeToRead;
-        if (0 != fseeko(_internal.file, position, SEEK_SET)) {
-            return 0;
+    // Resolve every local file header in a single forward sweep.
+    // Records whose header can't be resolved are left as is and will fail when read (just like without a plan).
+
+    __block Byte *window = NULL;
+    noz_defer(^{ free(window); });
+    off_t windowOffset = 0;
+    size_t windowLength = 0;
+
+    const NSUInteger recordCount = sortedRecords.count;
+    for (NSUInteger recordIndex = 0; recordIndex < recordCount; recordIndex++) {
+        NOZCentralDirectoryRecord *record = sortedRecords[recordIndex];
+        if (![record private_isOwnedByCentralDirectory:_centralDirectory] || [record private_offsetToCompressedData] > 0) {
+            continue;
         }
 
-        if (sizeToRead != fread(buffer, 1, sizeToRead, _internal.file)) {
-            return 0;
+        const NOZFileEntryT *entry = record.private_internalEntry;
+        const off_t localFileHeaderOffset = (off_t)entry->centralDirectoryRecord.localFileHeaderOffsetFromStartOfDisk;
+        if (localFileHeaderOffset < 0 || (localFileHeaderOffset + (off_t)NOZLocalFileHeaderFixedSize) > _internal.source.length) {
+            continue;
         }
 
-        const size_t bytesToRead = sizeToRead - 3;
-        for (off_t i = (off_t)(bytesToRead - 1); i >= 0; i--) {
-            if (buffer[i + 3] == sig[3]) {
-                if (buffer[i + 2] == sig[2]) {
-                    if (buffer[i + 1] == sig[1]) {
-                        if (buffer[i + 0] == sig[0]) {
-                            return (off_t)(position + i);
-                        }
+        const Byte *bytes = noz_source_bytes(&_internal.source, localFileHeaderOffset, NOZLocalFileHeaderFixedSize, NULL);
+        if (!bytes) {
+            if (localFileHeaderOffset < windowOffset || (localFileHeaderOffset + (off_t)NOZLocalFileHeaderFixedSize) > (windowOffset + (off_t)windowLength)) {
+                if (!window) {
+                    window = malloc(kNOZLocalFileHeaderSweepWindowSize);
+                    if (!window) {
+                        break;
                     }
                 }
+                windowOffset = localFileHeaderOffset;
+                windowLength = [self private_sweepWindowLengthForRecords:sortedRecords
+                                                              startIndex:recordIndex
+                                                            windowOffset:windowOffset];
+                if (!noz_source_bytes(&_internal.source, windowOffset, windowLength, window)) {
+                    windowLength = 0;
+                    continue;
+                }
             }
+            bytes = window + (localFileHeaderOffset - windowOffset);
         }
 
-        bytesRead += bytesToRead;
+        const off_t offsetToCompressedData = noz_offset_to_compressed_data(entry, bytes, localFileHeaderOffset, _internal.source.length);
+        if (offsetToCompressedData > 0) {
+            [record private_setOffsetToCompressedData:offsetToCompressedData];
+        }
     }
 
-    return 0;
+    return sortedRecords;
 }
 
-- (BOOL)private_locateCompressedDataOfRecord:(NOZCentralDirectoryRecord *)record
+- (size_t)private_sweepWindowLengthForRecords:(NSArray<NOZCentralDirectoryRecord *> *)sortedRecords
+                                    startIndex:(NSUInteger)startIndex
+                                  windowOffset:(off_t)windowOffset
 {
-    NOZFileEntryT *entry = record.private_internalEntry;
-    if (!entry) {
-        return NO;
+    // Through the fixed part of the last planned header within reach of the window (all that's needed to resolve a header)
+
+    const off_t windowLimit = windowOffset + (off_t)MIN((off_t)kNOZLocalFileHeaderSweepWindowSize, _internal.source.length - windowOffset);
+    off_t windowEnd = windowOffset + (off_t)NOZLocalFileHeaderFixedSize;
+    for (NSUInteger i = startIndex + 1; i < sortedRecords.count; i++) {
+        NOZCentralDirectoryRecord *record = sortedRecords[i];
+        if (![record private_isOwnedByCentralDirectory:_centralDirectory]) {
+            continue;
+        }
+        const off_t headerEnd = (off_t)record.private_internalEntry->centralDirectoryRecord.localFileHeaderOffsetFromStartOfDisk + (off_t)NOZLocalFileHeaderFixedSize;
+        if (headerEnd > windowLimit) {
+            break;
+        }
+        windowEnd = MAX(windowEnd, headerEnd);
     }
+    return (size_t)(windowEnd - windowOffset);
+}
 
-    if (0 != fseeko(_internal.file, entry->centralDirectoryRecord.localFileHeaderOffsetFromStartOfDisk, SEEK_SET)) {
-        return NO;
+- (NSData *)private_readDataInOneShotFromRecord:(NOZCentralDirectoryRecord *)record
+                                  progressBlock:(NOZProgressBlock)progressBlock
+                                          error:(out NSError **)error
+{
+    // Returns nil without an error whenever the record can't be decoded in one shot (to be decoded through a context instead)
+
+    const off_t offsetToFirstByte = [self private_prepareToReadRecord:record error:NULL];
+    if (offsetToFirstByte < 0) {
+        return nil;
     }
 
-    UInt32 signature = 0;
-    if (!PRIVATE_READ(_internal.file, signature) || signature != NOZMagicNumberLocalFileHeader) {
-        return NO;
+    const NOZFileEntryT *entry = record.private_internalEntry;
+    const UInt64 compressedSize = entry->fileDescriptor.compressedSize;
+    const UInt64 uncompressedSize = entry->fileDescriptor.uncompressedSize;
+    if (0 == uncompressedSize || noz_trusted_uncompressed_capacity(entry, uncompressedSize) != uncompressedSize) {
+        return nil;
+    }
+    if (compressedSize > (UInt64)SIZE_MAX || (!_internal.source.mappedBytes && compressedSize > kNOZOneShotMaxUnmappedCompressedSize)) {
+        return nil;
     }
 
-    UInt16 nameSize, extraFieldSize;
+    id<NOZDecoder> decoder = [[NOZCompressionLibrary sharedInstance] decoderForMethod:entry->fileHeader.compressionMethod];
+    if (![decoder respondsToSelector:@selector(decodeAllBytes:length:bitFlags:intoBuffer:capacity:decodedLength:)]) {
+        return nil;
+    }
 
-    off_t seek =    2 + // versionForExtraction
-                    2 + // bitFlag
-                    2 + // compressionMethod
-                    2 + // dosTime
-                    2 + // dosDate
-                    4 + // crc32
-                    4 + // compressed size
-                    4 + // decompressed size
-                    0;
+    __block Byte *scratchBuffer = NULL;
+    noz_defer(^{ free(scratchBuffer); });
+    const Byte *compressedBytes = noz_source_bytes(&_internal.source, offsetToFirstByte, (size_t)compressedSize, NULL);
+    if (!compressedBytes) {
+        scratchBuffer = malloc(MAX((size_t)compressedSize, (size_t)1));
+        compressedBytes = (scratchBuffer) ? noz_source_bytes(&_internal.source, offsetToFirstByte, (size_t)compressedSize, scratchBuffer) : NULL;
+        if (!compressedBytes) {
+            return nil;
+        }
+    }
 
-    if (0 != fseeko(_internal.file, seek, SEEK_CUR)) {
-        return NO;
+    Byte *buffer = malloc((size_t)uncompressedSize);
+    if (!buffer) {
+        return nil;
     }
 
-    if (!PRIVATE_READ(_internal.file, nameSize) ||
-        !PRIVATE_READ(_internal.file, extraFieldSize)) {
-        return NO;
+    size_t decodedLength = 0;
+    const BOOL decoded = [decoder decodeAllBytes:compressedBytes
+                                          length:(size_t)compressedSize
+                                        bitFlags:entry->fileHeader.bitFlag
+                                      intoBuffer:buffer
+                                        capacity:(size_t)uncompressedSize
+                                   decodedLength:&decodedLength];
+    if (_internal.dropsCacheBehindReads) {
+        noz_source_advise(&_internal.source, offsetToFirstByte, (off_t)compressedSize, NOZAccessAdviceDontNeed);
+    }
+    if (!decoded || decodedLength != uncompressedSize) {
+        free(buffer);
+        return nil;
     }
 
-    if (entry->fileHeader.nameSize != nameSize) {
-        return NO;
+    uLong crc = crc32(0, NULL, 0);
+    for (size_t position = 0; position < decodedLength; ) {
+        const uInt length = (uInt)MIN(decodedLength - position, (size_t)UINT32_MAX);
+        crc = crc32(crc, buffer + position, length);
+        position += length;
     }
 
-    seek = extraFieldSize + nameSize;
-    if (0 != fseeko(_internal.file, seek, SEEK_CUR)) {
-        return NO;
+    NOZErrorCode code = 0;
+    if ((UInt32)crc != entry->fileDescriptor.crc32) {
+        code = NOZErrorCodeUnzipChecksumMissmatch;
+    } else if (progressBlock) {
+        BOOL stop = NO;
+        progressBlock((SInt64)compressedSize, (SInt64)compressedSize, (SInt64)compressedSize, &stop);
+        if (stop) {
+            code = NOZErrorCodeUnzipCannotDecompressFileEntry;
+        }
+    }
+    if (0 != code) {
+        free(buffer);
+        if (error) {
+            *error = NOZErrorCreate(code, nil);
+        }
+        return nil;
     }
 
-    return YES;
+    return [NSData dataWithBytesNoCopy:buffer length:decodedLength freeWhenDone:YES];
+}
+
+- (off_t)private_prepareToReadRecord:(NOZCentralDirectoryRecord *)record error:(out NSError **)error
+{
+    NOZErrorCode code = 0;
+    NSDictionary *userInfo = nil;
+    NSError *sourceError = nil;
+    off_t offsetToFirstByte = -1;
+    if (!noz_source_is_open(&_internal.source)) {
+        code = NOZErrorCodeUnzipMustOpenUnzipperBeforeManipulating;
+    } else if (![record private_isOwnedByCentralDirectory:_centralDirectory]) {
+        code = NOZErrorCodeUnzipCannotReadFileEntry;
+    } else if ((offsetToFirstByte = [self private_locateCompressedDataOfRecord:record sourceError:&sourceError]) < 0) {
+        code = NOZErrorCodeUnzipCannotReadFileEntry;
+        userInfo = noz_source_error_user_info(sourceError);
+    } else {
+        code = [record private_validate];
+    }
+
+    if (0 != code) {
+        if (error) {
+            *error = NOZErrorCreate(code, userInfo);
+        }
+        return -1;
+    }
+
+    return offsetToFirstByte;
 }
 
-- (BOOL)private_deflateWithProgressBlock:(NOZProgressBlock)progressBlock
-                              usingBlock:(NOZUnzipByteRangeEnumerationBlock)block
-                                   error:(out NSError * __autoreleasing *)error
+- (NOZCompressedBytesBlock)private_compressedBytesBlockWithOffsetToFirstByte:(off_t)offsetToFirstByte
+                                                                 sourceError:(NSError * __strong *)sourceError
+{
+    // the error of a failed read is stored in _sourceError_, which must outlive the block
+    const NOZUnzipperSourceT *source = &_internal.source;
+    return ^const Byte *(UInt64 offset, size_t length, Byte *scratchBuffer) {
+        NSError *readError = nil;
+        const Byte *bytes = noz_source_read_bytes(source, offsetToFirstByte + (off_t)offset, length, scratchBuffer, &readError);
+        if (!bytes) {
+            *sourceError = readError;
+        }
+        return bytes;
+    };
+}
+
+- (BOOL)private_decodeWithState:(NOZUnzipStateT *)state
+                        decoder:(id<NOZDecoder>)decoder
+                        context:(id<NOZDecoderContext>)context
+                  progressBlock:(NOZProgressBlock)progressBlock
+                          error:(out NSError * __autoreleasing *)error
 {
     __block BOOL success = YES;
     noz_defer(^{
@@ -562,29 +1581,57 @@ NOZ_OBJC_DIRECT_MEMBERS
         }
     });
 
+    // When memory mapped, the decoder is fed directly from the mapping (no intermediate copy).
+    // For stored entries, this means the bytes provided to the enumeration block point into the mapping.
+
+    const BOOL isMapped = (_internal.source.mappedBytes != NULL);
     const size_t pageSize = NOZBufferSize();
     Byte compressedBuffer[pageSize];
-    size_t compressedBufferSize = sizeof(compressedBuffer);
+    size_t compressedBufferSize = isMapped ? kNOZMappedChunkSize : sizeof(compressedBuffer);
 
     BOOL stop = NO;
-    const SInt64 compressedBytesTotal = _currentUnzipping.entry->fileDescriptor.compressedSize;
+    const SInt64 compressedBytesTotal = (SInt64)state->entry->fileDescriptor.compressedSize;
     SInt64 compressedBytesLeft = compressedBytesTotal;
+    __block off_t offset = state->offsetToFirstByte;
+
+    // One pass reads drop what they've read from the page cache as they go
+    const BOOL dropsCacheBehindReads = _internal.dropsCacheBehindReads;
+    __block off_t droppedOffset = offset;
+    const NOZUnzipperSourceT *source = &_internal.source;
+    noz_defer(^{
+        if (dropsCacheBehindReads && offset > droppedOffset) {
+            noz_source_advise(source, droppedOffset, offset - droppedOffset, NOZAccessAdviceDontNeed);
+        }
+    });
 
-    while (!stop && !_currentDecoderContext.hasFinished) {
+    while (!stop && !context.hasFinished) {
 
-        if ((size_t)compressedBytesLeft < compressedBufferSize) {
+        if (compressedBytesLeft < (SInt64)compressedBufferSize) {
             compressedBufferSize = (size_t)compressedBytesLeft;
         }
 
-        if (compressedBufferSize != fread(compressedBuffer, 1, compressedBufferSize, _internal.file)) {
-            success = NO;
-            return NO;
+        const Byte *compressedBytes = compressedBuffer;
+        if (compressedBufferSize > 0) {
+            NSError *sourceError = nil;
+            compressedBytes = noz_source_read_bytes(&_internal.source, offset, compressedBufferSize, compressedBuffer, &sourceError);
+            if (!compressedBytes) {
+                success = NO;
+                if (error) {
+                    *error = NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, noz_source_error_user_info(sourceError));
+                }
+                return NO;
+            }
         }
         compressedBytesLeft -= compressedBufferSize;
+        offset += (off_t)compressedBufferSize;
+        if (dropsCacheBehindReads && (offset - droppedOffset) >= kNOZDropBehindInterval) {
+            noz_source_advise(source, droppedOffset, offset - droppedOffset, NOZAccessAdviceDontNeed);
+            droppedOffset = offset;
+        }
 
-        const BOOL decoded = [_currentDecoder decodeBytes:compressedBuffer
-                                                   length:compressedBufferSize
-                                                  context:_currentDecoderContext];
+        const BOOL decoded = [decoder decodeBytes:compressedBytes
+                                           length:compressedBufferSize
+                                          context:context];
         if (!decoded) {
             success = NO;
             return NO;
@@ -608,7 +1655,7 @@ NOZ_OBJC_DIRECT_MEMBERS
         return NO;
     }
 
-    if (_currentUnzipping.crc32 != _currentUnzipping.entry->fileDescriptor.crc32) {
+    if (state->crc32 != state->entry->fileDescriptor.crc32) {
         success = NO;
         if (error) {
             *error = NOZErrorCreate(NOZErrorCodeUnzipChecksumMissmatch, nil);
@@ -626,14 +1673,28 @@ NOZ_OBJC_DIRECT_MEMBERS
 @implementation NOZCentralDirectory
 {
     off_t _endOfCentralDirectoryRecordPosition;
+    off_t _centralDirectoryEndPosition; // the EOCD record, or the ZIP64 EOCD record when present
     NOZEndOfCentralDirectoryRecordT _endOfCentralDirectoryRecord;
 
-    NSArray<NOZCentralDirectoryRecord *> *_records;
+    NOZCentralDirectoryColumnsT _columns;
     off_t _lastCentralDirectoryRecordEndPosition; // exclusive
+
+    NOZNameIndexSlotT *_nameIndexSlots; // open addressed hash table of raw name bytes to record index
+    size_t _nameIndexMask;
+
+    // when read from an index file, the columns and name index point into its mapping (not owned)
+    void *_mappedIndexBytes;
+    size_t _mappedIndexLength;
 }
 
 - (void)dealloc
 {
+    if (_mappedIndexBytes) {
+        munmap(_mappedIndexBytes, _mappedIndexLength);
+    } else {
+        free(_nameIndexSlots);
+        noz_columns_free(&_columns);
+    }
 }
 
 - (instancetype)init
@@ -652,37 +1713,34 @@ NOZ_OBJC_DIRECT_MEMBERS
 
 - (NSUInteger)recordCount
 {
-    return _records.count;
+    return _columns.count;
 }
 
-- (BOOL)private_readEndOfCentralDirectoryRecordAtPosition:(off_t)eocdPos inFile:(FILE*)file
+- (BOOL)private_readEndOfCentralDirectoryRecordAtPosition:(off_t)eocdPos source:(const NOZUnzipperSourceT *)source
 {
-    if (!file) {
+    if (!source || !noz_source_is_open(source)) {
         return NO;
     }
 
-    if (fseeko(file, eocdPos, SEEK_SET) != 0) {
+    Byte scratchBuffer[NOZEndOfCentralDirectoryRecordFixedSize];
+    const Byte *buffer = noz_source_bytes(source, eocdPos, sizeof(scratchBuffer), scratchBuffer);
+    if (!buffer) {
         return NO;
     }
 
-    UInt32 signature = 0;
-    if (!PRIVATE_READ(file, signature) || NOZMagicNumberEndOfCentralDirectoryRecord != signature) {
+    if (NOZMagicNumberEndOfCentralDirectoryRecord != NOZReadLittleEndian32(buffer)) {
         return NO;
     }
 
-    if (!PRIVATE_READ(file, _endOfCentralDirectoryRecord.diskNumber) ||
-        !PRIVATE_READ(file, _endOfCentralDirectoryRecord.startDiskNumber) ||
-        !PRIVATE_READ(file, _endOfCentralDirectoryRecord.recordCountForDisk) ||
-        !PRIVATE_READ(file, _endOfCentralDirectoryRecord.totalRecordCount) ||
-        !PRIVATE_READ(file, _endOfCentralDirectoryRecord.centralDirectorySize) ||
-        !PRIVATE_READ(file, _endOfCentralDirectoryRecord.archiveStartToCentralDirectoryStartOffset) ||
-        !PRIVATE_READ(file, _endOfCentralDirectoryRecord.commentSize)) {
-        return NO;
-    }
+    NOZReadEndOfCentralDirectoryRecord(buffer, &_endOfCentralDirectoryRecord);
 
     if (_endOfCentralDirectoryRecord.commentSize) {
         unsigned char* commentBuffer = malloc(_endOfCentralDirectoryRecord.commentSize + 1);
-        if (_endOfCentralDirectoryRecord.commentSize == fread(commentBuffer, 1, _endOfCentralDirectoryRecord.commentSize, file)) {
+        const Byte *commentBytes = noz_source_bytes(source, eocdPos + (off_t)sizeof(scratchBuffer), _endOfCentralDirectoryRecord.commentSize, commentBuffer);
+        if (commentBytes) {
+            if (commentBytes != commentBuffer) {
+                memcpy(commentBuffer, commentBytes, _endOfCentralDirectoryRecord.commentSize);
+            }
             commentBuffer[_endOfCentralDirectoryRecord.commentSize] = '\0';
 
             // There is no flag to check for the encoding format of the global comment...
@@ -704,121 +1762,495 @@ NOZ_OBJC_DIRECT_MEMBERS
         }
     }
 
+    // A ZIP64 archive has a ZIP64 end of central directory locator immediately preceding the end of central directory record
+
+    _centralDirectoryEndPosition = eocdPos;
+    if (eocdPos >= (off_t)NOZZip64EndOfCentralDirectoryLocatorFixedSize) {
+        if (![self private_readZip64EndOfCentralDirectoryRecordWithLocatorAtPosition:eocdPos - (off_t)NOZZip64EndOfCentralDirectoryLocatorFixedSize
+                                                                               source:source]) {
+            return NO;
+        }
+    }
+
     _endOfCentralDirectoryRecordPosition = eocdPos;
     return YES;
 }
 
-- (BOOL)private_readCentralDirectoryEntriesWithFile:(FILE *)file
+- (BOOL)private_readZip64EndOfCentralDirectoryRecordWithLocatorAtPosition:(off_t)locatorPos source:(const NOZUnzipperSourceT *)source
 {
-    if (!file || !_endOfCentralDirectoryRecordPosition) {
-        return NO;
+    Byte locatorScratchBuffer[NOZZip64EndOfCentralDirectoryLocatorFixedSize];
+    const Byte *locatorBytes = noz_source_bytes(source, locatorPos, sizeof(locatorScratchBuffer), locatorScratchBuffer);
+    NOZZip64EndOfCentralDirectoryLocatorT locator;
+    if (!locatorBytes || !NOZReadZip64EndOfCentralDirectoryLocator(locatorBytes, &locator)) {
+        return YES; // not ZIP64
+    }
+
+    if (locator.recordDiskNumber != 0 || locator.totalDiskCount > 1) {
+        _endOfCentralDirectoryRecord.diskNumber = MAX(locator.recordDiskNumber, 1);
+        return YES; // multiple disks, will fail validation
     }
 
-    if (0 != fseeko(file, _endOfCentralDirectoryRecord.archiveStartToCentralDirectoryStartOffset, SEEK_SET)) {
+    const UInt64 zip64RecordOffset = locator.recordOffset;
+
+    if (zip64RecordOffset > (UInt64)locatorPos || ((off_t)zip64RecordOffset + (off_t)NOZZip64EndOfCentralDirectoryRecordFixedSize) > locatorPos) {
         return NO;
     }
 
-    NSMutableArray<NOZCentralDirectoryRecord *> *records = [NSMutableArray arrayWithCapacity:_endOfCentralDirectoryRecord.totalRecordCount];
-    while (_endOfCentralDirectoryRecordPosition > ftello(file)) {
-        NOZCentralDirectoryRecord *record = [self private_readCentralDirectoryEntryAtCurrentPositionWithFile:file];
-        if (record) {
-            [records addObject:record];
-        } else {
-            break;
-        }
+    Byte recordScratchBuffer[NOZZip64EndOfCentralDirectoryRecordFixedSize];
+    const Byte *record = noz_source_bytes(source, (off_t)zip64RecordOffset, sizeof(recordScratchBuffer), recordScratchBuffer);
+    if (!record || !NOZReadZip64EndOfCentralDirectoryRecord(record, &_endOfCentralDirectoryRecord)) {
+        return NO;
     }
 
-    _records = [records copy];
+    _centralDirectoryEndPosition = (off_t)zip64RecordOffset;
     return YES;
 }
 
-- (NOZCentralDirectoryRecord *)private_readCentralDirectoryEntryAtCurrentPositionWithFile:(FILE *)file
+- (BOOL)private_readCentralDirectoryEntriesWithSource:(const NOZUnzipperSourceT *)source
 {
-    UInt32 signature = 0;
-    if (!PRIVATE_READ(file, signature) || signature != NOZMagicNumberCentralDirectoryFileRecord) {
-        return nil;
+    if (!source || !noz_source_is_open(source) || !_endOfCentralDirectoryRecordPosition) {
+        return NO;
     }
 
-    NOZCentralDirectoryRecord *record = [[NOZCentralDirectoryRecord alloc] initWithOwner:self];
-    NOZFileEntryT* entry = record.private_internalEntry;
-
-    if (!PRIVATE_READ(file, entry->centralDirectoryRecord.versionMadeBy) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.fileHeader->versionForExtraction) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.fileHeader->bitFlag) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.fileHeader->compressionMethod) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.fileHeader->dosTime) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.fileHeader->dosDate) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.fileHeader->fileDescriptor->crc32) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.fileHeader->fileDescriptor->compressedSize) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.fileHeader->fileDescriptor->uncompressedSize) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.fileHeader->nameSize) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.fileHeader->extraFieldSize) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.commentSize) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.fileStartDiskNumber) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.internalFileAttributes) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.externalFileAttributes) ||
-        !PRIVATE_READ(file, entry->centralDirectoryRecord.localFileHeaderOffsetFromStartOfDisk) ||
-        entry->centralDirectoryRecord.fileHeader->nameSize == 0) {
-        return nil;
+    // Read the entire central directory with a single positional read (or directly from the mapping) and parse the records from memory
+
+    if (_endOfCentralDirectoryRecord.centralDirectorySize > (UInt64)_centralDirectoryEndPosition ||
+        _endOfCentralDirectoryRecord.archiveStartToCentralDirectoryStartOffset > (UInt64)_centralDirectoryEndPosition) {
+        return NO;
     }
 
-    entry->name = malloc(entry->centralDirectoryRecord.fileHeader->nameSize + 1);
-    ((Byte*)entry->name)[entry->centralDirectoryRecord.fileHeader->nameSize] = '\0';
-    entry->ownsName = YES;
-    if (entry->centralDirectoryRecord.fileHeader->nameSize != fread((Byte*)entry->name, 1, entry->centralDirectoryRecord.fileHeader->nameSize, file)) {
-        return nil;
+    const off_t centralDirectoryStart = (off_t)_endOfCentralDirectoryRecord.archiveStartToCentralDirectoryStartOffset;
+    const size_t centralDirectorySize = (size_t)_endOfCentralDirectoryRecord.centralDirectorySize;
+    if (0 == centralDirectorySize || (centralDirectoryStart + (off_t)centralDirectorySize) > _centralDirectoryEndPosition) {
+        return NO;
     }
 
-    if (entry->centralDirectoryRecord.fileHeader->extraFieldSize > 0) {
-        if (0 != fseeko(file, entry->centralDirectoryRecord.fileHeader->extraFieldSize, SEEK_CUR)) {
-            return nil;
+    // Have the kernel read the whole central directory at once (rather than as faulted or read in readahead sized pieces)
+    noz_source_advise(source, centralDirectoryStart, (off_t)centralDirectorySize, NOZAccessAdviceWillNeed);
+
+    // Without a scratch buffer, only bytes already in memory (mapping or tail) are returned
+    __block Byte *scratchBuffer = NULL;
+    noz_defer(^{ free(scratchBuffer); });
+    const Byte *buffer = noz_source_bytes(source, centralDirectoryStart, centralDirectorySize, NULL);
+    if (!buffer) {
+        scratchBuffer = malloc(centralDirectorySize);
+        if (!scratchBuffer) {
+            return NO;
+        }
+        buffer = noz_source_bytes(source, centralDirectoryStart, centralDirectorySize, scratchBuffer);
+        if (!buffer) {
+            return NO;
         }
     }
 
-    if (entry->centralDirectoryRecord.commentSize > 0) {
-        entry->comment = malloc(entry->centralDirectoryRecord.commentSize + 1);
-        ((Byte*)entry->comment)[entry->centralDirectoryRecord.commentSize] = '\0';
-        entry->ownsComment = YES;
-        if (entry->centralDirectoryRecord.commentSize != fread((Byte*)entry->comment, 1, entry->centralDirectoryRecord.commentSize, file)) {
-            return nil;
-        }
+    // Records are parsed into flat columns (no object per record).
+    // The names and comments of all records take less space than the central directory they are read from.
+
+    noz_columns_free(&_columns);
+    const UInt64 maxRecordCount = centralDirectorySize / NOZCentralDirectoryFileRecordFixedSize;
+    if (!noz_columns_reserve(&_columns, (NSUInteger)MAX(MIN(_endOfCentralDirectoryRecord.totalRecordCount, maxRecordCount), 1))) {
+        return NO;
+    }
+    _columns.strings = malloc(centralDirectorySize);
+    if (!_columns.strings) {
+        return NO;
     }
 
-    _totalUncompressedSize += record.uncompressedSize;
-    _lastCentralDirectoryRecordEndPosition = ftello(file);
-    return record;
-}
+    size_t position = 0;
+    while (position < centralDirectorySize) {
+        if (_columns.count == _columns.capacity && !noz_columns_reserve(&_columns, _columns.capacity * 2)) {
+            return NO;
+        }
 
-- (NOZCentralDirectoryRecord *)private_recordAtIndex:(NSUInteger)index
-{
-    return [_records objectAtIndex:index];
-}
+        size_t recordSize = 0;
+        if (![self private_appendCentralDirectoryEntryFromBytes:buffer + position
+                                                         length:centralDirectorySize - position
+                                                     recordSize:&recordSize]) {
+            break;
+        }
+        position += recordSize;
+        _lastCentralDirectoryRecordEndPosition = centralDirectoryStart + (off_t)position;
+    }
 
-- (NSUInteger)private_indexForRecordWithName:(NSString *)name
-{
-    __block NSUInteger index = NSNotFound;
-    [_records enumerateObjectsUsingBlock:^(NOZCentralDirectoryRecord *record, NSUInteger idx, BOOL *stop) {
-        if ([name isEqualToString:[record private_nameNoCopy]]) {
-            index = idx;
-            *stop = YES;
+    if (_columns.stringsLength > 0 && _columns.stringsLength < centralDirectorySize) {
+        Byte *strings = realloc(_columns.strings, _columns.stringsLength);
+        if (strings) {
+            _columns.strings = strings;
         }
-    }];
-    return index;
-}
+    }
 
-- (NSArray<NOZCentralDirectoryRecord *> *)private_internalRecords
-{
-    return _records;
+    [self private_buildNameIndex];
+    return YES;
 }
 
-- (BOOL)private_validateCentralDirectoryAndReturnError:(NSError * __autoreleasing *)error
+- (BOOL)private_appendCentralDirectoryEntryFromBytes:(const Byte *)bytes
+                                              length:(size_t)length
+                                          recordSize:(out size_t *)recordSizeOut
 {
-    __block NOZErrorCode code = 0;
-    __block NSDictionary *userInfo = nil;
-    noz_defer(^{
-        if (code && error) {
-            *error = NOZErrorCreate(code, userInfo);
-        }
+    if (length < NOZCentralDirectoryFileRecordFixedSize || NOZReadLittleEndian32(bytes) != NOZMagicNumberCentralDirectoryFileRecord) {
+        return NO;
+    }
+
+    // only the sizes and offset can be replaced by the ZIP64 extra field, parse them into an entry on the stack
+
+    NOZFileEntryT entry;
+    NOZFileEntryInit(&entry);
+    NOZCentralDirectoryFileRecordT *cdRecord = &entry.centralDirectoryRecord;
+    cdRecord->fileHeader->fileDescriptor->compressedSize = NOZReadLittleEndian32(bytes + 20);
+    cdRecord->fileHeader->fileDescriptor->uncompressedSize = NOZReadLittleEndian32(bytes + 24);
+    cdRecord->localFileHeaderOffsetFromStartOfDisk = NOZReadLittleEndian32(bytes + 42);
+
+    const size_t nameSize = NOZReadLittleEndian16(bytes + 28);
+    const size_t extraFieldSize = NOZReadLittleEndian16(bytes + 30);
+    const size_t commentSize = NOZReadLittleEndian16(bytes + 32);
+    const size_t recordSize = NOZCentralDirectoryFileRecordFixedSize + nameSize + extraFieldSize + commentSize;
+    if (0 == nameSize || recordSize > length) {
+        return NO;
+    }
+
+    const Byte *nameBytes = bytes + NOZCentralDirectoryFileRecordFixedSize;
+    if (extraFieldSize > 0 && !noz_read_zip64_extra_field(&entry, nameBytes + nameSize, extraFieldSize)) {
+        return NO;
+    }
+
+    const NSUInteger index = _columns.count;
+    _columns.versionsMadeBy[index] = NOZReadLittleEndian16(bytes + 4);
+    _columns.versionsForExtraction[index] = NOZReadLittleEndian16(bytes + 6);
+    _columns.bitFlags[index] = NOZReadLittleEndian16(bytes + 8);
+    _columns.compressionMethods[index] = NOZReadLittleEndian16(bytes + 10);
+    _columns.dosTimes[index] = NOZReadLittleEndian16(bytes + 12);
+    _columns.dosDates[index] = NOZReadLittleEndian16(bytes + 14);
+    _columns.crc32s[index] = NOZReadLittleEndian32(bytes + 16);
+    _columns.compressedSizes[index] = entry.fileDescriptor.compressedSize;
+    _columns.uncompressedSizes[index] = entry.fileDescriptor.uncompressedSize;
+    _columns.nameSizes[index] = (UInt16)nameSize;
+    _columns.extraFieldSizes[index] = (UInt16)extraFieldSize;
+    _columns.commentSizes[index] = (UInt16)commentSize;
+    _columns.fileStartDiskNumbers[index] = NOZReadLittleEndian16(bytes + 34);
+    _columns.internalFileAttributes[index] = NOZReadLittleEndian16(bytes + 36);
+    _columns.externalFileAttributes[index] = NOZReadLittleEndian32(bytes + 38);
+    _columns.localFileHeaderOffsets[index] = entry.centralDirectoryRecord.localFileHeaderOffsetFromStartOfDisk;
+    _columns.attributeFlags[index] = noz_record_attribute_flags(nameBytes, nameSize, entry.fileDescriptor.compressedSize);
+
+    Byte *strings = _columns.strings + _columns.stringsLength;
+    memcpy(strings, nameBytes, nameSize);
+    strings[nameSize] = '\0';
+    memcpy(strings + nameSize + 1, nameBytes + nameSize + extraFieldSize, commentSize);
+    strings[nameSize + 1 + commentSize] = '\0';
+    _columns.nameOffsets[index] = _columns.stringsLength;
+    _columns.stringsLength += nameSize + 1 + commentSize + 1;
+    _columns.count++;
+
+    _totalUncompressedSize += (SInt64)entry.fileDescriptor.uncompressedSize;
+    *recordSizeOut = recordSize;
+    return YES;
+}
+
+- (NOZCentralDirectoryRecord *)private_recordAtIndex:(NSUInteger)index
+{
+    if (index >= _columns.count) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:[NSString stringWithFormat:@"index %tu beyond bounds [0 .. %tu]", index, _columns.count]
+                                     userInfo:nil];
+    }
+
+    NOZCentralDirectoryRecord *record = [[NOZCentralDirectoryRecord alloc] initWithOwner:self];
+    noz_columns_load_entry(&_columns, index, record.private_internalEntry);
+    [record private_setAttributeFlags:_columns.attributeFlags[index]];
+    return record;
+}
+
+- (NSUInteger)private_indexForRecordWithName:(NSString *)name
+{
+    const char *utf8Name = name.UTF8String;
+    if (!utf8Name) {
+        return NSNotFound;
+    }
+
+    const size_t utf8Length = strlen(utf8Name);
+    BOOL isASCII = YES;
+    for (size_t i = 0; i < utf8Length && isASCII; i++) {
+        isASCII = (((const Byte *)utf8Name)[i] < 0x80);
+    }
+
+    // ASCII is encoded identically in UTF8 and DOS Latin US, so any record can match.
+    // Otherwise, the name's bytes differ per encoding and must be matched against records of that encoding.
+
+    NSUInteger index = [self private_indexForRecordWithNameBytes:(const Byte *)utf8Name
+                                                          length:utf8Length
+                                                          filter:(isASCII) ? NOZNameEncodingFilterAny : NOZNameEncodingFilterUTF8];
+    if (!isASCII) {
+        NSData *dosLatinUSName = [name dataUsingEncoding:NOZStringEncodingDOSLatinUS allowLossyConversion:NO];
+        if (dosLatinUSName) {
+            const NSUInteger dosLatinUSIndex = [self private_indexForRecordWithNameBytes:dosLatinUSName.bytes
+                                                                                  length:dosLatinUSName.length
+                                                                                  filter:NOZNameEncodingFilterDOSLatinUS];
+            index = MIN(index, dosLatinUSIndex);
+        }
+    }
+
+    return index;
+}
+
+- (NSUInteger)private_indexForRecordWithNameBytes:(const Byte *)nameBytes
+                                           length:(size_t)length
+                                           filter:(NOZNameEncodingFilter)filter
+{
+    NSUInteger index = NSNotFound;
+    if (!_nameIndexSlots) {
+        for (NSUInteger i = 0; i < _columns.count; i++) {
+            if (noz_record_name_matches(&_columns, i, nameBytes, length, filter)) {
+                index = i;
+                break;
+            }
+        }
+        return index;
+    }
+
+    // Duplicate names are permitted in an archive, so walk the entire probe sequence and keep the lowest index
+
+    const UInt32 hash = noz_name_hash(nameBytes, length);
+    for (size_t slot = hash & _nameIndexMask; _nameIndexSlots[slot].recordIndex != 0; slot = (slot + 1) & _nameIndexMask) {
+        if (_nameIndexSlots[slot].hash == hash) {
+            const NSUInteger recordIndex = _nameIndexSlots[slot].recordIndex - 1;
+            if (recordIndex < index && noz_record_name_matches(&_columns, recordIndex, nameBytes, length, filter)) {
+                index = recordIndex;
+            }
+        }
+    }
+
+    return index;
+}
+
+- (void)private_buildNameIndex
+{
+    free(_nameIndexSlots);
+    _nameIndexSlots = NULL;
+    _nameIndexMask = 0;
+
+    const NSUInteger count = _columns.count;
+    if (0 == count || count >= UINT32_MAX) {
+        return;
+    }
+
+    // Keep the load factor at or below 50% so probe sequences stay short
+
+    size_t capacity = 16;
+    while (capacity < (count * 2)) {
+        capacity <<= 1;
+    }
+
+    NOZNameIndexSlotT *slots = calloc(capacity, sizeof(NOZNameIndexSlotT));
+    if (!slots) {
+        return; // fall back to linear lookups
+    }
+
+    const size_t mask = capacity - 1;
+    for (NSUInteger i = 0; i < count; i++) {
+        const UInt32 hash = noz_name_hash(_columns.strings + _columns.nameOffsets[i], _columns.nameSizes[i]);
+        size_t slot = hash & mask;
+        while (slots[slot].recordIndex != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot].hash = hash;
+        slots[slot].recordIndex = (UInt32)i + 1;
+    }
+
+    _nameIndexSlots = slots;
+    _nameIndexMask = mask;
+}
+
+- (UInt32)private_endOfCentralDirectoryChecksumWithSource:(const NOZUnzipperSourceT *)source
+{
+    // Covers the (ZIP64) end of central directory records, which locate and size the central directory, through the end of the archive
+
+    const off_t start = _centralDirectoryEndPosition;
+    const size_t length = (size_t)(source->length - start);
+    __block Byte *scratchBuffer = NULL;
+    noz_defer(^{ free(scratchBuffer); });
+    const Byte *bytes = noz_source_bytes(source, start, length, NULL);
+    if (!bytes) {
+        scratchBuffer = malloc(length);
+        bytes = (scratchBuffer) ? noz_source_bytes(source, start, length, scratchBuffer) : NULL;
+        if (!bytes) {
+            return 0;
+        }
+    }
+
+    return (UInt32)crc32(0, bytes, (UInt32)length);
+}
+
+- (BOOL)private_readIndexAtPath:(NSString *)indexPath key:(const NOZCentralDirectoryIndexKeyT *)key
+{
+    const int fd = open(indexPath.fileSystemRepresentation, O_RDONLY);
+    if (fd < 0) {
+        return NO;
+    }
+    noz_defer(^{ close(fd); }); // the mapping outlives the file descriptor
+
+    struct stat indexStat;
+    if (0 != fstat(fd, &indexStat) || indexStat.st_size < (off_t)sizeof(NOZCentralDirectoryIndexHeaderT)) {
+        return NO;
+    }
+
+    const size_t indexLength = (size_t)indexStat.st_size;
+    void *indexBytes = mmap(NULL, indexLength, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == indexBytes) {
+        return NO;
+    }
+    __block BOOL success = NO;
+    noz_defer(^{
+        if (!success) {
+            munmap(indexBytes, indexLength);
+        }
+    });
+
+    const NOZCentralDirectoryIndexHeaderT *header = indexBytes;
+    if (header->magicNumber != kNOZCentralDirectoryIndexMagicNumber ||
+        header->version != kNOZCentralDirectoryIndexVersion ||
+        header->wordSize != sizeof(size_t) ||
+        !noz_index_keys_equal(&header->key, key) ||
+        0 == header->recordCount ||
+        header->recordCount >= UINT32_MAX ||
+        (header->nameIndexSlotCount & (header->nameIndexSlotCount - 1)) != 0 ||
+        indexLength != noz_index_length(header)) {
+        return NO;
+    }
+
+    NOZCentralDirectoryColumnsT columns;
+    bzero(&columns, sizeof(columns));
+    columns.count = (NSUInteger)header->recordCount;
+    columns.capacity = columns.count;
+    columns.stringsLength = (size_t)header->stringsLength;
+
+    Byte *cursor = (Byte *)indexBytes + noz_index_align(sizeof(NOZCentralDirectoryIndexHeaderT));
+#define NOZ_MAP_COLUMN(type, column) \
+    columns.column = (type *)cursor; \
+    cursor += noz_index_align(columns.count * sizeof(type));
+    NOZ_CENTRAL_DIRECTORY_COLUMNS(NOZ_MAP_COLUMN)
+#undef NOZ_MAP_COLUMN
+    columns.strings = cursor;
+    cursor += noz_index_align(columns.stringsLength);
+    NOZNameIndexSlotT *nameIndexSlots = (header->nameIndexSlotCount > 0) ? (NOZNameIndexSlotT *)cursor : NULL;
+
+    // Bounds check everything that is later used as an offset (cheap compared to parsing)
+
+    for (NSUInteger i = 0; i < columns.count; i++) {
+        if (columns.nameOffsets[i] > columns.stringsLength ||
+            (columns.stringsLength - columns.nameOffsets[i]) < ((size_t)columns.nameSizes[i] + (size_t)columns.commentSizes[i] + 2)) {
+            return NO;
+        }
+    }
+    BOOL hasEmptySlot = (0 == header->nameIndexSlotCount);
+    for (size_t i = 0; i < header->nameIndexSlotCount; i++) {
+        if (nameIndexSlots[i].recordIndex > columns.count) {
+            return NO;
+        }
+        hasEmptySlot = hasEmptySlot || (0 == nameIndexSlots[i].recordIndex);
+    }
+    if (!hasEmptySlot) {
+        return NO; // probing would never terminate
+    }
+
+    _lastCentralDirectoryRecordEndPosition = (off_t)header->lastCentralDirectoryRecordEndPosition;
+    _totalUncompressedSize = header->totalUncompressedSize;
+
+    free(_nameIndexSlots);
+    noz_columns_free(&_columns);
+    _columns = columns;
+    _nameIndexSlots = nameIndexSlots;
+    _nameIndexMask = (header->nameIndexSlotCount > 0) ? (size_t)header->nameIndexSlotCount - 1 : 0;
+    _mappedIndexBytes = indexBytes;
+    _mappedIndexLength = indexLength;
+    success = YES;
+    return YES;
+}
+
+- (BOOL)private_writeIndexToPath:(NSString *)indexPath key:(const NOZCentralDirectoryIndexKeyT *)key
+{
+    NOZCentralDirectoryIndexHeaderT header;
+    bzero(&header, sizeof(header));
+    header.magicNumber = kNOZCentralDirectoryIndexMagicNumber;
+    header.version = kNOZCentralDirectoryIndexVersion;
+    header.wordSize = sizeof(size_t);
+    header.key = *key;
+    header.lastCentralDirectoryRecordEndPosition = (UInt64)_lastCentralDirectoryRecordEndPosition;
+    header.totalUncompressedSize = _totalUncompressedSize;
+    header.recordCount = _columns.count;
+    header.stringsLength = _columns.stringsLength;
+    header.nameIndexSlotCount = (_nameIndexSlots) ? _nameIndexMask + 1 : 0;
+
+    // Write to a temporary file and move it into place so readers never see a partial index
+
+    NSString *temporaryPath = [indexPath stringByAppendingFormat:@".%@.tmp", [NSUUID UUID].UUIDString];
+    const int fd = open(temporaryPath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return NO;
+    }
+
+    static const Byte padding[8] = { 0 };
+    __block BOOL success = YES;
+    void (^writeSection)(const void *, size_t) = ^(const void *bytes, size_t length) {
+        if (success && length > 0) {
+            success = noz_write_fully(fd, bytes, length) && noz_write_fully(fd, padding, noz_index_align(length) - length);
+        }
+    };
+
+    writeSection(&header, sizeof(header));
+#define NOZ_WRITE_COLUMN(type, column) writeSection(_columns.column, _columns.count * sizeof(type));
+    NOZ_CENTRAL_DIRECTORY_COLUMNS(NOZ_WRITE_COLUMN)
+#undef NOZ_WRITE_COLUMN
+    writeSection(_columns.strings, _columns.stringsLength);
+    writeSection(_nameIndexSlots, (size_t)header.nameIndexSlotCount * sizeof(NOZNameIndexSlotT));
+
+    if (0 != close(fd)) {
+        success = NO;
+    }
+    if (success) {
+        success = (0 == rename(temporaryPath.fileSystemRepresentation, indexPath.fileSystemRepresentation));
+    }
+    if (!success) {
+        unlink(temporaryPath.fileSystemRepresentation);
+    }
+
+    return success;
+}
+
+- (off_t)private_centralDirectoryStartPosition
+{
+    return (off_t)_endOfCentralDirectoryRecord.archiveStartToCentralDirectoryStartOffset;
+}
+
+- (off_t)private_endOfCentralDirectoryRecordPosition
+{
+    return _endOfCentralDirectoryRecordPosition;
+}
+
+- (NSUInteger)private_memoryCost
+{
+    if (_mappedIndexBytes) {
+        return (NSUInteger)_mappedIndexLength;
+    }
+
+#define NOZ_COLUMN_SIZE(type, column) + sizeof(type)
+    const size_t bytesPerRecord = 0 NOZ_CENTRAL_DIRECTORY_COLUMNS(NOZ_COLUMN_SIZE);
+#undef NOZ_COLUMN_SIZE
+
+    size_t cost = (size_t)_columns.capacity * bytesPerRecord + _columns.stringsLength;
+    if (_nameIndexSlots) {
+        cost += (_nameIndexMask + 1) * sizeof(NOZNameIndexSlotT);
+    }
+    return (NSUInteger)cost;
+}
+
+- (BOOL)private_validateCentralDirectoryAndReturnError:(NSError * __autoreleasing *)error
+{
+    __block NOZErrorCode code = 0;
+    __block NSDictionary *userInfo = nil;
+    noz_defer(^{
+        if (code && error) {
+            *error = NOZErrorCreate(code, userInfo);
+        }
     });
 
     if (_endOfCentralDirectoryRecord.diskNumber != 0) {
@@ -826,18 +2258,18 @@ NOZ_OBJC_DIRECT_MEMBERS
         return NO;
     }
 
-    if (0 == _records.count) {
+    if (0 == _columns.count) {
         code = NOZErrorCodeUnzipCouldNotReadCentralDirectoryRecord;
         return NO;
     }
 
-    if (_records.count != _endOfCentralDirectoryRecord.totalRecordCount) {
+    if (_columns.count != _endOfCentralDirectoryRecord.totalRecordCount) {
         code = NOZErrorCodeUnzipCentralDirectoryRecordCountsDoNotAlign;
-        userInfo = @{ @"expectedCount" : @(_endOfCentralDirectoryRecord.totalRecordCount), @"actualCount" : @(_records.count) };
+        userInfo = @{ @"expectedCount" : @(_endOfCentralDirectoryRecord.totalRecordCount), @"actualCount" : @(_columns.count) };
         return NO;
     }
 
-    if (_endOfCentralDirectoryRecordPosition != _lastCentralDirectoryRecordEndPosition) {
+    if (_centralDirectoryEndPosition != _lastCentralDirectoryRecordEndPosition) {
         code = NOZErrorCodeUnzipCentralDirectoryRecordsDoNotCompleteWithEOCDRecord;
         return NO;
     }
@@ -847,11 +2279,84 @@ NOZ_OBJC_DIRECT_MEMBERS
 
 @end
 
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZCentralDirectoryCache
+{
+    NOZLRUCache<NSData *, NOZCentralDirectory *> *_cache;
+}
+
++ (NOZCentralDirectoryCache *)sharedCache
+{
+    static NOZCentralDirectoryCache *sCache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sCache = [[NOZCentralDirectoryCache alloc] initInternal];
+    });
+    return sCache;
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initInternal
+{
+    if (self = [super init]) {
+        _cache = [[NOZLRUCache alloc] initWithTotalCostLimit:64 * 1024 * 1024];
+    }
+    return self;
+}
+
+- (NSUInteger)totalCostLimit
+{
+    return _cache.totalCostLimit;
+}
+
+- (void)setTotalCostLimit:(NSUInteger)totalCostLimit
+{
+    _cache.totalCostLimit = totalCostLimit;
+}
+
+- (NSUInteger)totalCost
+{
+    return _cache.totalCost;
+}
+
+- (NSUInteger)count
+{
+    return _cache.count;
+}
+
+- (void)removeAllCentralDirectories
+{
+    [_cache removeAllObjects];
+}
+
+#pragma mark Private
+
+- (NOZCentralDirectory *)private_centralDirectoryForKey:(const NOZCentralDirectoryCacheKeyT *)key
+{
+    NSData *keyData = [[NSData alloc] initWithBytesNoCopy:(void *)key length:sizeof(NOZCentralDirectoryCacheKeyT) freeWhenDone:NO];
+    return [_cache objectForKey:keyData];
+}
+
+- (void)private_setCentralDirectory:(NOZCentralDirectory *)cd forKey:(const NOZCentralDirectoryCacheKeyT *)key
+{
+    NSData *keyData = [[NSData alloc] initWithBytes:key length:sizeof(NOZCentralDirectoryCacheKeyT)];
+    [_cache setObject:cd forKey:keyData cost:[cd private_memoryCost]];
+}
+
+@end
+
 NOZ_OBJC_DIRECT_MEMBERS
 @implementation NOZCentralDirectoryRecord
 {
     NOZFileEntryT _entry;
-    __unsafe_unretained NOZCentralDirectory *_owner;
+    NOZCentralDirectory *_owner; // strong, since the entry's name and comment can point into the owner's storage
+    NOZRecordAttributeFlags _attributeFlags;
+    off_t _offsetToCompressedData; // resolved from the local file header, 0 until resolved
 }
 
 - (void)dealloc
@@ -864,6 +2369,7 @@ NOZ_OBJC_DIRECT_MEMBERS
     if (self = [super init]) {
         NOZFileEntryInit(&_entry);
         _owner = cd;
+        _attributeFlags = noz_record_attribute_flags(NULL, 0, 0);
     }
     return self;
 }
@@ -901,28 +2407,7 @@ NOZ_OBJC_DIRECT_MEMBERS
 
 - (NOZCompressionLevel)compressionLevel
 {
-    switch (_entry.fileHeader.compressionMethod) {
-        case NOZCompressionMethodDeflate:
-        {
-            const NOZDeflateFlagBits deflateFlags = NOZExtractDeflateFlagBits(_entry.fileHeader.bitFlag);
-            if ((deflateFlags & NOZDeflateFlagBitsSuperFast) == NOZDeflateFlagBitsSuperFast) {
-                return NOZCompressionLevelMin;
-            } else if ((deflateFlags & NOZDeflateFlagBitsFast) == NOZDeflateFlagBitsFast) {
-                return (2.f / 9.f);
-            } else if ((deflateFlags & NOZDeflateFlagBitsMax) == NOZDeflateFlagBitsMax) {
-                return NOZCompressionLevelMax;
-            }
-            break;
-        }
-
-        // Insert any other customizations by the compression method here
-
-        // Default
-        default:
-            break;
-    }
-
-    return NOZCompressionLevelDefault;
+    return NOZCompressionLevelForFileHeader(&_entry.fileHeader);
 }
 
 - (NOZCompressionMethod)compressionMethod
@@ -932,17 +2417,19 @@ NOZ_OBJC_DIRECT_MEMBERS
 
 - (SInt64)compressedSize
 {
-    return _entry.fileDescriptor.compressedSize;
+    return (SInt64)_entry.fileDescriptor.compressedSize;
 }
 
 - (SInt64)uncompressedSize
 {
-    return _entry.fileDescriptor.uncompressedSize;
+    return (SInt64)_entry.fileDescriptor.uncompressedSize;
 }
 
 - (id)copyWithZone:(NSZone *)zone
 {
-    NOZCentralDirectoryRecord *record = [[[self class] allocWithZone:zone] init];
+    NOZCentralDirectoryRecord *record = [[[self class] allocWithZone:zone] initWithOwner:_owner];
+    record->_attributeFlags = _attributeFlags;
+    record->_offsetToCompressedData = _offsetToCompressedData;
     record->_entry.fileDescriptor = _entry.fileDescriptor;
     record->_entry.fileHeader = _entry.fileHeader;
     record->_entry.centralDirectoryRecord = _entry.centralDirectoryRecord;
@@ -980,13 +2467,28 @@ NOZ_OBJC_DIRECT_MEMBERS
     return &_entry;
 }
 
+- (void)private_setAttributeFlags:(NOZRecordAttributeFlags)flags
+{
+    _attributeFlags = flags;
+}
+
+- (off_t)private_offsetToCompressedData
+{
+    return _offsetToCompressedData;
+}
+
+- (void)private_setOffsetToCompressedData:(off_t)offset
+{
+    _offsetToCompressedData = offset;
+}
+
 - (NOZErrorCode)private_validate
 {
     if (self.isZeroLength || self.isMacOSXAttribute || self.isMacOSXDSStore) {
         return 0;
     }
 
-    if ((_entry.centralDirectoryRecord.fileHeader->versionForExtraction & 0x00ff) > (NOZVersionForExtraction & 0x00ff)) {
+    if ((_entry.centralDirectoryRecord.fileHeader->versionForExtraction & 0x00ff) > (NOZVersionForZip64Extraction & 0x00ff)) {
         return NOZErrorCodeUnzipUnsupportedRecordVersion;
     }
     if ((_entry.centralDirectoryRecord.fileHeader->bitFlag & NOZFlagBitsEncrypted)) {
@@ -1002,40 +2504,775 @@ NOZ_OBJC_DIRECT_MEMBERS
 
 - (BOOL)isZeroLength
 {
-    return (_entry.centralDirectoryRecord.fileHeader->fileDescriptor->compressedSize == 0);
+    return (_attributeFlags & NOZRecordAttributeFlagZeroLength) != 0;
 }
 
 - (BOOL)isMacOSXAttribute
 {
-    NSArray<NSString *> *components = [[self private_nameNoCopy] pathComponents];
-    if ([components containsObject:@"__MACOSX"]) {
-        return YES;
-    }
-    return NO;
+    return (_attributeFlags & NOZRecordAttributeFlagMacOSXAttribute) != 0;
 }
 
 - (BOOL)isMacOSXDSStore
 {
-    if ([[self private_nameNoCopy].lastPathComponent isEqualToString:@".DS_Store"]) {
-        return YES;
+    return (_attributeFlags & NOZRecordAttributeFlagMacOSXDSStore) != 0;
+}
+
+- (BOOL)isDirectory
+{
+    return (_attributeFlags & NOZRecordAttributeFlagDirectory) != 0;
+}
+
+@end
+
+static const UInt32 kNOZCheckpointIndexMagicNumber = 0x50434f4e; // "NOCP"
+static const UInt16 kNOZCheckpointIndexVersion = 1;
+static const size_t kNOZCheckpointIndexHeaderSize = 4 + 2 + 8 + 8 + 8 + 4 + 8;
+static const size_t kNOZCheckpointHeaderSize = 8 + 8 + 1 + 4;
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZCheckpointIndex
+{
+    NOZCheckpointT *_checkpoints;
+    NSUInteger _checkpointCapacity;
+    NSMutableData *_windows;
+}
+
+- (void)dealloc
+{
+    free(_checkpoints);
+}
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithEntry:(const NOZFileEntryT *)entry checkpointInterval:(SInt64)checkpointInterval
+{
+    if (self = [super init]) {
+        _checkpointInterval = checkpointInterval;
+        _compressedSize = (SInt64)entry->fileDescriptor.compressedSize;
+        _uncompressedSize = (SInt64)entry->fileDescriptor.uncompressedSize;
+        _crc32 = entry->fileDescriptor.crc32;
+        _windows = [[NSMutableData alloc] init];
     }
-    return NO;
+    return self;
+}
+
+- (instancetype)initWithDataRepresentation:(NSData *)data
+{
+    const Byte *bytes = data.bytes;
+    const size_t length = data.length;
+    if (length < kNOZCheckpointIndexHeaderSize ||
+        NOZReadLittleEndian32(bytes) != kNOZCheckpointIndexMagicNumber ||
+        NOZReadLittleEndian16(bytes + 4) != kNOZCheckpointIndexVersion) {
+        return nil;
+    }
+
+    if (self = [super init]) {
+        _checkpointInterval = (SInt64)NOZReadLittleEndian64(bytes + 6);
+        _compressedSize = (SInt64)NOZReadLittleEndian64(bytes + 14);
+        _uncompressedSize = (SInt64)NOZReadLittleEndian64(bytes + 22);
+        _crc32 = NOZReadLittleEndian32(bytes + 30);
+        const UInt64 checkpointCount = NOZReadLittleEndian64(bytes + 34);
+        if (checkpointCount > ((length - kNOZCheckpointIndexHeaderSize) / kNOZCheckpointHeaderSize)) {
+            return nil;
+        }
+
+        _windows = [[NSMutableData alloc] init];
+        if (checkpointCount > 0) {
+            _checkpoints = malloc((size_t)checkpointCount * sizeof(NOZCheckpointT));
+            if (!_checkpoints) {
+                return nil;
+            }
+            _checkpointCapacity = (NSUInteger)checkpointCount;
+        }
+
+        size_t position = kNOZCheckpointIndexHeaderSize;
+        for (UInt64 i = 0; i < checkpointCount; i++) {
+            if ((position + kNOZCheckpointHeaderSize) > length) {
+                return nil;
+            }
+
+            NOZCheckpointT checkpoint;
+            checkpoint.uncompressedOffset = NOZReadLittleEndian64(bytes + position);
+            checkpoint.compressedOffset = NOZReadLittleEndian64(bytes + position + 8);
+            checkpoint.bitCount = bytes[position + 16];
+            checkpoint.windowLength = NOZReadLittleEndian32(bytes + position + 17);
+            checkpoint.windowOffset = _windows.length;
+            position += kNOZCheckpointHeaderSize;
+
+            if (checkpoint.bitCount > 7 ||
+                checkpoint.windowLength > kNOZDeflateWindowSize ||
+                checkpoint.uncompressedOffset > (UInt64)_uncompressedSize ||
+                checkpoint.compressedOffset > (UInt64)_compressedSize ||
+                (checkpoint.bitCount > 0 && 0 == checkpoint.compressedOffset) ||
+                (i > 0 && checkpoint.uncompressedOffset < _checkpoints[i - 1].uncompressedOffset) ||
+                (position + checkpoint.windowLength) > length) {
+                return nil;
+            }
+
+            [_windows appendBytes:bytes + position length:checkpoint.windowLength];
+            position += checkpoint.windowLength;
+            _checkpoints[_checkpointCount++] = checkpoint;
+        }
+    }
+    return self;
+}
+
+- (NSData *)dataRepresentation
+{
+    NSMutableData *data = [NSMutableData dataWithLength:kNOZCheckpointIndexHeaderSize];
+    Byte *header = data.mutableBytes;
+    NOZWriteLittleEndian32(header, kNOZCheckpointIndexMagicNumber);
+    NOZWriteLittleEndian16(header + 4, kNOZCheckpointIndexVersion);
+    NOZWriteLittleEndian64(header + 6, (UInt64)_checkpointInterval);
+    NOZWriteLittleEndian64(header + 14, (UInt64)_compressedSize);
+    NOZWriteLittleEndian64(header + 22, (UInt64)_uncompressedSize);
+    NOZWriteLittleEndian32(header + 30, _crc32);
+    NOZWriteLittleEndian64(header + 34, (UInt64)_checkpointCount);
+
+    for (NSUInteger i = 0; i < _checkpointCount; i++) {
+        const NOZCheckpointT *checkpoint = &_checkpoints[i];
+        Byte checkpointHeader[kNOZCheckpointHeaderSize];
+        NOZWriteLittleEndian64(checkpointHeader, checkpoint->uncompressedOffset);
+        NOZWriteLittleEndian64(checkpointHeader + 8, checkpoint->compressedOffset);
+        checkpointHeader[16] = checkpoint->bitCount;
+        NOZWriteLittleEndian32(checkpointHeader + 17, checkpoint->windowLength);
+        [data appendBytes:checkpointHeader length:sizeof(checkpointHeader)];
+        [data appendBytes:(const Byte *)_windows.bytes + checkpoint->windowOffset length:checkpoint->windowLength];
+    }
+
+    return data;
+}
+
+#pragma mark Internal
+
+- (BOOL)private_matchesEntry:(const NOZFileEntryT *)entry
+{
+    return _compressedSize == (SInt64)entry->fileDescriptor.compressedSize &&
+           _uncompressedSize == (SInt64)entry->fileDescriptor.uncompressedSize &&
+           _crc32 == entry->fileDescriptor.crc32;
+}
+
+- (BOOL)private_indexDeflatedBytes:(NOZCompressedBytesBlock)bytesBlock
+                     progressBlock:(NOZProgressBlock)progressBlock
+                             error:(out NSError **)error
+{
+    // Inflate the entire record one deflate block at a time (Z_BLOCK),
+    // adding a checkpoint at the first block boundary after each interval.
+    // The output buffer is the 32KB deflate window, used circularly.
+
+    __block NOZErrorCode code = 0;
+    noz_defer(^{
+        if (code && error) {
+            *error = NOZErrorCreate(code, nil);
+        }
+    });
+
+    z_stream zStream;
+    bzero(&zStream, sizeof(zStream));
+    if (Z_OK != inflateInit2(&zStream, -MAX_WBITS)) {
+        code = NOZErrorCodeUnzipFailedToDecompressEntry;
+        return NO;
+    }
+    z_stream *zStreamPtr = &zStream;
+    noz_defer(^{ inflateEnd(zStreamPtr); });
+
+    Byte *window = malloc(kNOZDeflateWindowSize);
+    if (!window) {
+        code = NOZErrorCodeUnzipFailedToDecompressEntry;
+        return NO;
+    }
+    noz_defer(^{ free(window); });
+
+    const size_t pageSize = NOZBufferSize();
+    Byte compressedBuffer[pageSize];
+    const UInt64 compressedSize = (UInt64)_compressedSize;
+    UInt64 compressedOffset = 0; // of the next bytes to provide to zlib
+    UInt64 totalIn = 0;
+    UInt64 totalOut = 0;
+    UInt64 lastCheckpointOut = 0;
+    UInt32 crc = (UInt32)crc32(0, NULL, 0);
+    int zErr = Z_OK;
+
+    do {
+        if (0 == zStream.avail_in) {
+            const size_t length = (size_t)MIN((UInt64)sizeof(compressedBuffer), compressedSize - compressedOffset);
+            if (0 == length) {
+                code = NOZErrorCodeUnzipCannotDecompressFileEntry; // ran out of data before the end of the deflate stream
+                return NO;
+            }
+            const Byte *compressedBytes = bytesBlock(compressedOffset, length, compressedBuffer);
+            if (!compressedBytes) {
+                code = NOZErrorCodeUnzipCannotReadFileEntry;
+                return NO;
+            }
+            zStream.next_in = (Byte *)compressedBytes;
+            zStream.avail_in = (uInt)length;
+            compressedOffset += length;
+        }
+
+        const UInt64 previousTotalIn = totalIn;
+        do {
+            if (0 == zStream.avail_out) {
+                zStream.next_out = window;
+                zStream.avail_out = (uInt)kNOZDeflateWindowSize;
+            }
+
+            Byte *output = zStream.next_out;
+            totalIn += zStream.avail_in;
+            totalOut += zStream.avail_out;
+            zErr = inflate(&zStream, Z_BLOCK);
+            totalIn -= zStream.avail_in;
+            totalOut -= zStream.avail_out;
+            crc = (UInt32)crc32(crc, output, (uInt)(zStream.next_out - output));
+
+            if (Z_NEED_DICT == zErr || Z_DATA_ERROR == zErr || Z_MEM_ERROR == zErr) {
+                code = NOZErrorCodeUnzipCannotDecompressFileEntry;
+                return NO;
+            }
+            if (Z_STREAM_END == zErr) {
+                break;
+            }
+
+            // data_type has bit 7 set at a block boundary and bit 6 set if that was the last block
+            const BOOL isAtBlockBoundary = (zStream.data_type & 128) && !(zStream.data_type & 64);
+            if (isAtBlockBoundary && totalOut > lastCheckpointOut && (totalOut - lastCheckpointOut) >= (UInt64)_checkpointInterval) {
+                if (![self private_addCheckpointWithUncompressedOffset:totalOut
+                                                      compressedOffset:totalIn
+                                                              bitCount:(UInt8)(zStream.data_type & 7)
+                                                                window:window
+                                                          availableOut:zStream.avail_out]) {
+                    code = NOZErrorCodeUnzipFailedToDecompressEntry;
+                    return NO;
+                }
+                lastCheckpointOut = totalOut;
+            }
+        } while (zStream.avail_in != 0);
+
+        if (progressBlock) {
+            BOOL stop = NO;
+            progressBlock((SInt64)compressedSize, (SInt64)totalIn, (SInt64)(totalIn - previousTotalIn), &stop);
+            if (stop) {
+                code = NOZErrorCodeUnzipFailedToDecompressEntry;
+                return NO;
+            }
+        }
+    } while (Z_STREAM_END != zErr);
+
+    if (crc != _crc32 || totalOut != (UInt64)_uncompressedSize) {
+        code = NOZErrorCodeUnzipChecksumMissmatch;
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)private_addCheckpointWithUncompressedOffset:(UInt64)uncompressedOffset
+                                   compressedOffset:(UInt64)compressedOffset
+                                           bitCount:(UInt8)bitCount
+                                             window:(const Byte *)window
+                                       availableOut:(size_t)availableOut
+{
+    if (_checkpointCount == _checkpointCapacity) {
+        const NSUInteger capacity = MAX(_checkpointCapacity * 2, (NSUInteger)16);
+        NOZCheckpointT *checkpoints = realloc(_checkpoints, capacity * sizeof(NOZCheckpointT));
+        if (!checkpoints) {
+            return NO;
+        }
+        _checkpoints = checkpoints;
+        _checkpointCapacity = capacity;
+    }
+
+    NOZCheckpointT *checkpoint = &_checkpoints[_checkpointCount];
+    checkpoint->uncompressedOffset = uncompressedOffset;
+    checkpoint->compressedOffset = compressedOffset;
+    checkpoint->bitCount = bitCount;
+    checkpoint->windowLength = (UInt32)MIN(uncompressedOffset, (UInt64)kNOZDeflateWindowSize);
+    checkpoint->windowOffset = _windows.length;
+    noz_append_window(_windows, window, availableOut, checkpoint->windowLength);
+    _checkpointCount++;
+    return YES;
+}
+
+- (BOOL)private_inflateRange:(NSRange)range
+             compressedBytes:(NOZCompressedBytesBlock)bytesBlock
+                  usingBlock:(NOZUnzipByteRangeEnumerationBlock)block
+                       error:(out NSError **)error
+{
+    __block NOZErrorCode code = 0;
+    noz_defer(^{
+        if (code && error) {
+            *error = NOZErrorCreate(code, nil);
+        }
+    });
+
+    // Find the last checkpoint at or before the start of the range (the start of the record if there is none)
+
+    NOZCheckpointT checkpoint = { 0 };
+    NSUInteger low = 0;
+    NSUInteger high = _checkpointCount;
+    while (low < high) {
+        const NSUInteger mid = low + ((high - low) / 2);
+        if (_checkpoints[mid].uncompressedOffset <= (UInt64)range.location) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low > 0) {
+        checkpoint = _checkpoints[low - 1];
+    }
+
+    z_stream zStream;
+    bzero(&zStream, sizeof(zStream));
+    if (Z_OK != inflateInit2(&zStream, -MAX_WBITS)) {
+        code = NOZErrorCodeUnzipFailedToDecompressEntry;
+        return NO;
+    }
+    z_stream *zStreamPtr = &zStream;
+    noz_defer(^{ inflateEnd(zStreamPtr); });
+
+    const size_t pageSize = NOZBufferSize();
+    Byte compressedBuffer[pageSize];
+    if (checkpoint.bitCount > 0) {
+        const Byte *partialByte = bytesBlock(checkpoint.compressedOffset - 1, 1, compressedBuffer);
+        if (!partialByte) {
+            code = NOZErrorCodeUnzipCannotReadFileEntry;
+            return NO;
+        }
+        if (checkpoint.bitCount > 7 || Z_OK != inflatePrime(&zStream, checkpoint.bitCount, partialByte[0] >> (8 - checkpoint.bitCount))) {
+            code = NOZErrorCodeUnzipCannotDecompressFileEntry; // a corrupt (or mismatched) checkpoint index
+            return NO;
+        }
+    }
+    if (checkpoint.windowLength > 0) {
+        if ((UInt64)checkpoint.windowOffset + (UInt64)checkpoint.windowLength > (UInt64)_windows.length ||
+            Z_OK != inflateSetDictionary(&zStream, (const Byte *)_windows.bytes + checkpoint.windowOffset, checkpoint.windowLength)) {
+            code = NOZErrorCodeUnzipCannotDecompressFileEntry;
+            return NO;
+        }
+    }
+
+    Byte *output = malloc(kNOZDeflateWindowSize);
+    if (!output) {
+        code = NOZErrorCodeUnzipFailedToDecompressEntry;
+        return NO;
+    }
+    noz_defer(^{ free(output); });
+
+    const UInt64 compressedSize = (UInt64)_compressedSize;
+    const UInt64 rangeEnd = (UInt64)NSMaxRange(range);
+    UInt64 compressedOffset = checkpoint.compressedOffset;
+    UInt64 position = checkpoint.uncompressedOffset;
+    BOOL stop = NO;
+    int zErr = Z_OK;
+
+    while (!stop && position < rangeEnd) {
+        if (0 == zStream.avail_in) {
+            const size_t length = (size_t)MIN((UInt64)sizeof(compressedBuffer), compressedSize - compressedOffset);
+            if (0 == length) {
+                code = NOZErrorCodeUnzipCannotDecompressFileEntry;
+                return NO;
+            }
+            const Byte *compressedBytes = bytesBlock(compressedOffset, length, compressedBuffer);
+            if (!compressedBytes) {
+                code = NOZErrorCodeUnzipCannotReadFileEntry;
+                return NO;
+            }
+            zStream.next_in = (Byte *)compressedBytes;
+            zStream.avail_in = (uInt)length;
+            compressedOffset += length;
+        }
+
+        zStream.next_out = output;
+        zStream.avail_out = (uInt)kNOZDeflateWindowSize;
+        zErr = inflate(&zStream, Z_NO_FLUSH);
+        if (Z_NEED_DICT == zErr || Z_DATA_ERROR == zErr || Z_MEM_ERROR == zErr) {
+            code = NOZErrorCodeUnzipCannotDecompressFileEntry;
+            return NO;
+        }
+
+        // provide only the part of the output that is within range
+
+        const UInt64 produced = kNOZDeflateWindowSize - zStream.avail_out;
+        const UInt64 start = MAX(position, (UInt64)range.location);
+        const UInt64 end = MIN(position + produced, rangeEnd);
+        if (end > start) {
+            block(output + (start - position), NSMakeRange((NSUInteger)start, (NSUInteger)(end - start)), &stop);
+        }
+        position += produced;
+
+        if (Z_STREAM_END == zErr && position < rangeEnd) {
+            code = NOZErrorCodeUnzipCannotDecompressFileEntry;
+            return NO;
+        }
+    }
+
+    return YES;
 }
 
 @end
 
-static BOOL noz_fread_value(FILE *file, Byte* value, const UInt8 byteCount)
+static BOOL noz_columns_reserve(NOZCentralDirectoryColumnsT *columns, NSUInteger capacity)
+{
+#define NOZ_RESERVE_COLUMN(type, column) \
+    do { \
+        void *reallocated = realloc(columns->column, capacity * sizeof(type)); \
+        if (!reallocated) { \
+            return NO; \
+        } \
+        columns->column = reallocated; \
+    } while (0);
+
+    NOZ_CENTRAL_DIRECTORY_COLUMNS(NOZ_RESERVE_COLUMN)
+
+#undef NOZ_RESERVE_COLUMN
+
+    columns->capacity = capacity;
+    return YES;
+}
+
+static void noz_columns_free(NOZCentralDirectoryColumnsT *columns)
+{
+#define NOZ_FREE_COLUMN(type, column) free(columns->column);
+    NOZ_CENTRAL_DIRECTORY_COLUMNS(NOZ_FREE_COLUMN)
+#undef NOZ_FREE_COLUMN
+    free(columns->strings);
+    bzero(columns, sizeof(NOZCentralDirectoryColumnsT));
+}
+
+static void noz_columns_load_entry(const NOZCentralDirectoryColumnsT *columns, NSUInteger index, NOZFileEntryT *entry)
+{
+    NOZFileEntryClean(entry);
+    NOZFileEntryInit(entry);
+
+    NOZCentralDirectoryFileRecordT *cdRecord = &entry->centralDirectoryRecord;
+    cdRecord->versionMadeBy = columns->versionsMadeBy[index];
+    cdRecord->fileHeader->versionForExtraction = columns->versionsForExtraction[index];
+    cdRecord->fileHeader->bitFlag = columns->bitFlags[index];
+    cdRecord->fileHeader->compressionMethod = columns->compressionMethods[index];
+    cdRecord->fileHeader->dosTime = columns->dosTimes[index];
+    cdRecord->fileHeader->dosDate = columns->dosDates[index];
+    cdRecord->fileHeader->fileDescriptor->crc32 = columns->crc32s[index];
+    cdRecord->fileHeader->fileDescriptor->compressedSize = columns->compressedSizes[index];
+    cdRecord->fileHeader->fileDescriptor->uncompressedSize = columns->uncompressedSizes[index];
+    cdRecord->fileHeader->nameSize = columns->nameSizes[index];
+    cdRecord->fileHeader->extraFieldSize = columns->extraFieldSizes[index];
+    cdRecord->commentSize = columns->commentSizes[index];
+    cdRecord->fileStartDiskNumber = columns->fileStartDiskNumbers[index];
+    cdRecord->internalFileAttributes = columns->internalFileAttributes[index];
+    cdRecord->externalFileAttributes = columns->externalFileAttributes[index];
+    cdRecord->localFileHeaderOffsetFromStartOfDisk = columns->localFileHeaderOffsets[index];
+
+    // point into the packed strings (not owned)
+    entry->name = columns->strings + columns->nameOffsets[index];
+    if (cdRecord->commentSize > 0) {
+        entry->comment = entry->name + cdRecord->fileHeader->nameSize + 1;
+    }
+}
+
+static NOZRecordAttributeFlags noz_record_attribute_flags(const Byte *name, size_t nameSize, UInt64 compressedSize)
+{
+    NOZRecordAttributeFlags flags = 0;
+    if (0 == compressedSize) {
+        flags |= NOZRecordAttributeFlagZeroLength;
+    }
+    if (nameSize > 0 && '/' == name[nameSize - 1]) {
+        flags |= NOZRecordAttributeFlagDirectory;
+    }
+
+    // Split the name on "/" once, matching `pathComponents` and `lastPathComponent` (trailing "/" is ignored)
+
+    static const char kMacOSXAttributeComponent[] = "__MACOSX";
+    static const char kMacOSXDSStoreComponent[] = ".DS_Store";
+    size_t componentStart = 0;
+    for (size_t i = 0; i <= nameSize; i++) {
+        if (i < nameSize && '/' != name[i]) {
+            continue;
+        }
+
+        const size_t componentLength = i - componentStart;
+        if (componentLength == (sizeof(kMacOSXAttributeComponent) - 1) && 0 == memcmp(name + componentStart, kMacOSXAttributeComponent, componentLength)) {
+            flags |= NOZRecordAttributeFlagMacOSXAttribute;
+        }
+        if (componentLength > 0) {
+            const BOOL isLastComponent = (i >= nameSize - 1);
+            if (isLastComponent && componentLength == (sizeof(kMacOSXDSStoreComponent) - 1) && 0 == memcmp(name + componentStart, kMacOSXDSStoreComponent, componentLength)) {
+                flags |= NOZRecordAttributeFlagMacOSXDSStore;
+            }
+        }
+        componentStart = i + 1;
+    }
+
+    return flags;
+}
+
+static void noz_append_window(NSMutableData *windows, const Byte *window, size_t availableOut, size_t windowLength)
+{
+    // _window_ is circular: the most recent output ends at (kNOZDeflateWindowSize - availableOut),
+    // preceded by the output wrapping around from the end of the window
+
+    const size_t end = kNOZDeflateWindowSize - availableOut;
+    if (windowLength <= end) {
+        [windows appendBytes:window + end - windowLength length:windowLength];
+    } else {
+        const size_t wrappedLength = windowLength - end;
+        [windows appendBytes:window + kNOZDeflateWindowSize - wrappedLength length:wrappedLength];
+        [windows appendBytes:window length:end];
+    }
+}
+
+static BOOL noz_write_fully(int fd, const void *buffer, size_t length)
+{
+    const Byte *bytes = buffer;
+    while (length > 0) {
+        const ssize_t bytesWritten = write(fd, bytes, length);
+        if (bytesWritten < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return NO;
+        }
+        bytes += bytesWritten;
+        length -= (size_t)bytesWritten;
+    }
+    return YES;
+}
+
+static NSUInteger noz_trusted_uncompressed_capacity(const NOZFileEntryT *entry, UInt64 limit)
+{
+    // The sizes of an archive can't be trusted, an entry claiming to decompress to much more than it could
+    // gets a capacity it could decompress to (and grows from there) rather than an allocation of whatever it claims
+
+    const UInt64 compressedSize = entry->fileDescriptor.compressedSize;
+    UInt64 capacity = MIN(limit, entry->fileDescriptor.uncompressedSize);
+    if (NOZCompressionMethodNone == entry->fileHeader.compressionMethod) {
+        capacity = MIN(capacity, compressedSize);
+    } else if (compressedSize <= (UINT64_MAX / kNOZMaxTrustedCompressionRatio)) {
+        capacity = MIN(capacity, compressedSize * kNOZMaxTrustedCompressionRatio);
+    }
+    return (NSUInteger)MIN(capacity, (UInt64)NSUIntegerMax);
+}
+
+static BOOL noz_source_is_open(const NOZUnzipperSourceT *source)
+{
+    return source->fileDescriptor >= 0 || source->reader != nil;
+}
+
+static NSDictionary *noz_source_error_user_info(NSError *sourceError)
+{
+    // Failed reads of a random access source provide the source's error, file descriptor reads have nothing to add
+    return (sourceError) ? @{ NSUnderlyingErrorKey : sourceError } : nil;
+}
+
+static NSError *noz_read_error_with_source_error(NSError *error, NSError *sourceError)
+{
+    if (!sourceError || ![error.domain isEqualToString:NOZErrorDomain] || error.code != NOZErrorCodeUnzipCannotReadFileEntry || error.userInfo[NSUnderlyingErrorKey]) {
+        return error;
+    }
+    return NOZErrorCreate(NOZErrorCodeUnzipCannotReadFileEntry, noz_source_error_user_info(sourceError));
+}
+
+static BOOL noz_source_read(const NOZUnzipperSourceT *source, void *buffer, size_t length, off_t offset, NSError **error)
+{
+    if (source->reader) {
+        return [source->reader readBytes:buffer length:length offset:offset error:error];
+    }
+    return noz_pread_fully(source->fileDescriptor, buffer, length, offset);
+}
+
+static BOOL noz_pread_fully(int fd, void *buffer, size_t length, off_t offset)
+{
+    Byte *cursor = (Byte *)buffer;
+    while (length > 0) {
+        const ssize_t bytesRead = pread(fd, cursor, length, offset);
+        if (bytesRead < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return NO;
+        } else if (0 == bytesRead) {
+            return NO;
+        }
+        cursor += bytesRead;
+        length -= (size_t)bytesRead;
+        offset += (off_t)bytesRead;
+    }
+    return YES;
+}
+
+static off_t noz_offset_to_compressed_data(const NOZFileEntryT *entry, const Byte *localFileHeader, off_t localFileHeaderOffset, off_t archiveLength)
+{
+    if (NOZReadLittleEndian32(localFileHeader) != NOZMagicNumberLocalFileHeader) {
+        return -1;
+    }
+
+    const UInt16 nameSize = NOZReadLittleEndian16(localFileHeader + 26);
+    const UInt16 extraFieldSize = NOZReadLittleEndian16(localFileHeader + 28);
+    if (entry->fileHeader.nameSize != nameSize) {
+        return -1;
+    }
+
+    const off_t offsetToFirstByte = localFileHeaderOffset + (off_t)NOZLocalFileHeaderFixedSize + nameSize + extraFieldSize;
+    if (entry->fileDescriptor.compressedSize > (UInt64)archiveLength || (offsetToFirstByte + (off_t)entry->fileDescriptor.compressedSize) > archiveLength) {
+        return -1;
+    }
+
+    return offsetToFirstByte;
+}
+
+static void noz_source_advise(const NOZUnzipperSourceT *source, off_t offset, off_t length, NOZAccessAdvice advice)
 {
-    for (size_t i = 0; i < byteCount; i++) {
+    // Hints only, failures are ignored
+
+    if (offset < 0 || length <= 0 || offset >= source->length) {
+        return;
+    }
+    length = MIN(length, source->length - offset);
+
+    if (source->mappedBytes) {
+        const off_t pageMask = (off_t)getpagesize() - 1;
+        const off_t start = offset & ~pageMask;
+        int madvice = MADV_NORMAL;
+        switch (advice) {
+            case NOZAccessAdviceSequential:
+                madvice = MADV_SEQUENTIAL;
+                break;
+            case NOZAccessAdviceWillNeed:
+                madvice = MADV_WILLNEED;
+                break;
+            case NOZAccessAdviceDontNeed:
+                madvice = MADV_DONTNEED;
+                break;
+        }
+        (void)madvise((void *)(source->mappedBytes + start), (size_t)(offset + length - start), madvice);
+        return;
+    }
+
+    if (source->fileDescriptor < 0) {
+        return; // random access source
+    }
 
-#if __BIG_ENDIAN__
-        size_t bytesRead = fread(value + (byteCount - 1 - i), 1, 1, file);
+#if defined(__APPLE__)
+    switch (advice) {
+        case NOZAccessAdviceSequential:
+            (void)fcntl(source->fileDescriptor, F_RDAHEAD, 1);
+            break;
+        case NOZAccessAdviceWillNeed: {
+            struct radvisory radvisory;
+            radvisory.ra_offset = offset;
+            radvisory.ra_count = (int)MIN(length, (off_t)INT_MAX);
+            (void)fcntl(source->fileDescriptor, F_RDADVISE, &radvisory);
+            break;
+        }
+        case NOZAccessAdviceDontNeed:
+            break; // no range based equivalent, F_NOCACHE is set on open instead
+    }
 #else
-        size_t bytesRead = fread(value + i, 1, 1, file);
+    int fadvice = POSIX_FADV_NORMAL;
+    switch (advice) {
+        case NOZAccessAdviceSequential:
+            fadvice = POSIX_FADV_SEQUENTIAL;
+            break;
+        case NOZAccessAdviceWillNeed:
+            fadvice = POSIX_FADV_WILLNEED;
+            break;
+        case NOZAccessAdviceDontNeed:
+            fadvice = POSIX_FADV_DONTNEED;
+            break;
+    }
+    (void)posix_fadvise(source->fileDescriptor, offset, length, fadvice);
 #endif
-        if (bytesRead != 1) {
-            return NO;
+}
+
+static const Byte *noz_source_bytes(const NOZUnzipperSourceT *source, off_t offset, size_t length, Byte *scratchBuffer)
+{
+    return noz_source_read_bytes(source, offset, length, scratchBuffer, NULL);
+}
+
+static const Byte *noz_source_read_bytes(const NOZUnzipperSourceT *source, off_t offset, size_t length, Byte *scratchBuffer, NSError **error)
+{
+    if (offset < 0 || (offset + (off_t)length) > source->length) {
+        return NULL;
+    }
+
+    if (source->mappedBytes) {
+        return source->mappedBytes + offset;
+    }
+
+    if (source->tailBytes && offset >= source->tailOffset && (offset + (off_t)length) <= (source->tailOffset + (off_t)source->tailLength)) {
+        return source->tailBytes + (offset - source->tailOffset);
+    }
+
+    if (!scratchBuffer || !noz_source_read(source, scratchBuffer, length, offset, error)) {
+        return NULL;
+    }
+
+    return scratchBuffer;
+}
+
+static BOOL noz_flush_decompressed_bytes(NOZUnzipStateT *state, const Byte *buffer, size_t length, NOZUnzipByteRangeEnumerationBlock block)
+{
+    state->crc32 = (UInt32)crc32(state->crc32, buffer, (UInt32)length);
+    state->bytesDecompressed += length;
+
+    BOOL abort = NO;
+    block(buffer, NSMakeRange((NSUInteger)(state->bytesDecompressed - length), (NSUInteger)length), &abort);
+
+    return !abort;
+}
+
+static BOOL noz_read_zip64_extra_field(NOZFileEntryT *entry, const Byte *extraField, size_t extraFieldSize)
+{
+    NOZCentralDirectoryFileRecordT *record = &entry->centralDirectoryRecord;
+    NOZLocalFileDescriptorT *fileDescriptor = record->fileHeader->fileDescriptor;
+
+    size_t position = 0;
+    while ((position + 4) <= extraFieldSize) {
+        const UInt16 fieldID = NOZReadLittleEndian16(extraField + position);
+        const size_t fieldSize = NOZReadLittleEndian16(extraField + position + 2);
+        position += 4;
+        if ((position + fieldSize) > extraFieldSize) {
+            break; // malformed extra field, ignore the remainder
         }
+
+        if (NOZExtraFieldIDZip64 == fieldID) {
+
+            // Only the values that overflowed their record field are present, and always in this order
+
+            const Byte *field = extraField + position;
+            size_t fieldPosition = 0;
+            if (NOZZip64Sentinel32 == fileDescriptor->uncompressedSize) {
+                if ((fieldPosition + 8) > fieldSize) {
+                    return NO;
+                }
+                fileDescriptor->uncompressedSize = NOZReadLittleEndian64(field + fieldPosition);
+                fieldPosition += 8;
+            }
+            if (NOZZip64Sentinel32 == fileDescriptor->compressedSize) {
+                if ((fieldPosition + 8) > fieldSize) {
+                    return NO;
+                }
+                fileDescriptor->compressedSize = NOZReadLittleEndian64(field + fieldPosition);
+                fieldPosition += 8;
+            }
+            if (NOZZip64Sentinel32 == record->localFileHeaderOffsetFromStartOfDisk) {
+                if ((fieldPosition + 8) > fieldSize) {
+                    return NO;
+                }
+                record->localFileHeaderOffsetFromStartOfDisk = NOZReadLittleEndian64(field + fieldPosition);
+                fieldPosition += 8;
+            }
+            // disk start number (4 bytes) is irrelevant since multiple disks are not supported
+
+            return YES;
+        }
+
+        position += fieldSize;
     }
+
     return YES;
 }
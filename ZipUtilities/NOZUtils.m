@@ -91,6 +91,132 @@ void NOZFileEntryCleanFree(NOZFileEntryT* entry)
     }
 }
 
+NOZCompressionLevel NOZCompressionLevelForFileHeader(const NOZLocalFileHeaderT* header)
+{
+    switch (header->compressionMethod) {
+        case NOZCompressionMethodDeflate:
+        {
+            const NOZDeflateFlagBits deflateFlags = NOZExtractDeflateFlagBits(header->bitFlag);
+            if ((deflateFlags & NOZDeflateFlagBitsSuperFast) == NOZDeflateFlagBitsSuperFast) {
+                return NOZCompressionLevelMin;
+            } else if ((deflateFlags & NOZDeflateFlagBitsFast) == NOZDeflateFlagBitsFast) {
+                return (2.f / 9.f);
+            } else if ((deflateFlags & NOZDeflateFlagBitsMax) == NOZDeflateFlagBitsMax) {
+                return NOZCompressionLevelMax;
+            }
+            break;
+        }
+
+        // Insert any other customizations by the compression method here
+
+        // Default
+        default:
+            break;
+    }
+
+    return NOZCompressionLevelDefault;
+}
+
+const Byte* NOZFindLastSignature(const Byte* bytes, size_t length, UInt32 signature)
+{
+    // Scans backwards 8 bytes at a time for a word with the signature's first byte (SWAR),
+    // only then comparing the full signature at the positions of that word
+
+    if (!bytes || length < 4) {
+        return NULL;
+    }
+
+    static const UInt64 kLowBits = 0x0101010101010101ULL;
+    static const UInt64 kHighBits = 0x8080808080808080ULL;
+    const UInt64 pattern = kLowBits * (signature & 0xff);
+    size_t end = length - 3; // exclusive end of the positions a signature can start at
+
+    while (end >= 8) {
+        UInt64 word;
+        memcpy(&word, bytes + end - 8, sizeof(word));
+        word ^= pattern;
+        if (((word - kLowBits) & ~word & kHighBits) != 0) {
+            for (size_t i = end; i > end - 8; i--) {
+                if (signature == NOZReadLittleEndian32(bytes + i - 1)) {
+                    return bytes + i - 1;
+                }
+            }
+        }
+        end -= 8;
+    }
+
+    while (end > 0) {
+        end--;
+        if (signature == NOZReadLittleEndian32(bytes + end)) {
+            return bytes + end;
+        }
+    }
+
+    return NULL;
+}
+
+const Byte* NOZFindEndOfCentralDirectoryRecord(const Byte* tail, size_t tailLength)
+{
+    if (!tail || tailLength < NOZEndOfCentralDirectoryRecordFixedSize) {
+        return NULL;
+    }
+
+    // the signature must be followed by the rest of the EOCD record and its comment,
+    // a signature that is merely part of the global comment is skipped when its "comment" can't fit
+
+    size_t searchLength = tailLength - NOZEndOfCentralDirectoryRecordFixedSize + 4;
+    const Byte *signature;
+    while ((signature = NOZFindLastSignature(tail, searchLength, NOZMagicNumberEndOfCentralDirectoryRecord)) != NULL) {
+        const size_t offset = (size_t)(signature - tail);
+        const size_t commentSize = NOZReadLittleEndian16(signature + 20);
+        if (offset + NOZEndOfCentralDirectoryRecordFixedSize + commentSize <= tailLength) {
+            return signature;
+        }
+        searchLength = offset + 3; // positions before _offset_
+    }
+
+    return NULL;
+}
+
+void NOZReadEndOfCentralDirectoryRecord(const Byte* bytes, NOZEndOfCentralDirectoryRecordT* record)
+{
+    record->diskNumber = NOZReadLittleEndian16(bytes + 4);
+    record->startDiskNumber = NOZReadLittleEndian16(bytes + 6);
+    record->recordCountForDisk = NOZReadLittleEndian16(bytes + 8);
+    record->totalRecordCount = NOZReadLittleEndian16(bytes + 10);
+    record->centralDirectorySize = NOZReadLittleEndian32(bytes + 12);
+    record->archiveStartToCentralDirectoryStartOffset = NOZReadLittleEndian32(bytes + 16);
+    record->commentSize = NOZReadLittleEndian16(bytes + 20);
+}
+
+BOOL NOZReadZip64EndOfCentralDirectoryLocator(const Byte* bytes, NOZZip64EndOfCentralDirectoryLocatorT* locator)
+{
+    if (NOZMagicNumberZip64EndOfCentralDirectoryLocator != NOZReadLittleEndian32(bytes)) {
+        return NO;
+    }
+
+    locator->recordDiskNumber = NOZReadLittleEndian32(bytes + 4);
+    locator->recordOffset = NOZReadLittleEndian64(bytes + 8);
+    locator->totalDiskCount = NOZReadLittleEndian32(bytes + 16);
+    return YES;
+}
+
+BOOL NOZReadZip64EndOfCentralDirectoryRecord(const Byte* bytes, NOZEndOfCentralDirectoryRecordT* record)
+{
+    if (NOZMagicNumberZip64EndOfCentralDirectoryRecord != NOZReadLittleEndian32(bytes)) {
+        return NO;
+    }
+
+    // skip size of record (8 bytes), version made by (2 bytes) and version for extraction (2 bytes)
+    record->diskNumber = NOZReadLittleEndian32(bytes + 16);
+    record->startDiskNumber = NOZReadLittleEndian32(bytes + 20);
+    record->recordCountForDisk = NOZReadLittleEndian64(bytes + 24);
+    record->totalRecordCount = NOZReadLittleEndian64(bytes + 32);
+    record->centralDirectorySize = NOZReadLittleEndian64(bytes + 40);
+    record->archiveStartToCentralDirectoryStartOffset = NOZReadLittleEndian64(bytes + 48);
+    return YES;
+}
+
 static BOOL _NOZOpenInputOutputFiles(NSString * __nonnull sourceFilePath,
                                      FILE * __nullable * __nonnull sourceFile,
                                      NSString * __nonnull destinationFilePath,
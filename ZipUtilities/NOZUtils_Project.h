@@ -37,9 +37,24 @@ static const UInt32 NOZMagicNumberLocalFileHeader               = 0x04034b50;
 static const UInt32 NOZMagicNumberDataDescriptor                = 0x08074b50;
 static const UInt32 NOZMagicNumberCentralDirectoryFileRecord    = 0x02014b50;
 static const UInt32 NOZMagicNumberEndOfCentralDirectoryRecord   = 0x06054b50;
+static const UInt32 NOZMagicNumberZip64EndOfCentralDirectoryRecord  = 0x06064b50;
+static const UInt32 NOZMagicNumberZip64EndOfCentralDirectoryLocator = 0x07064b50;
+
+static const size_t NOZLocalFileHeaderFixedSize                 = 30; // including signature, excluding name and extra field
+static const size_t NOZCentralDirectoryFileRecordFixedSize      = 46; // including signature, excluding name, extra field and comment
+static const size_t NOZEndOfCentralDirectoryRecordFixedSize     = 22; // including signature, excluding comment
+static const size_t NOZZip64EndOfCentralDirectoryRecordFixedSize    = 56; // including signature, excluding extensible data
+static const size_t NOZZip64EndOfCentralDirectoryLocatorFixedSize   = 20; // including signature
+
+static const UInt16 NOZExtraFieldIDZip64 = 0x0001;
+
+// Values stored in the 16/32 bit fields when the actual value is stored in ZIP64 structures
+static const UInt16 NOZZip64Sentinel16 = UINT16_MAX;
+static const UInt32 NOZZip64Sentinel32 = UINT32_MAX;
 
 static const UInt32 NOZVersionForCreation   = 20; // Zip 2.0
 static const UInt32 NOZVersionForExtraction = 20; // Zip 2.0
+static const UInt32 NOZVersionForZip64Extraction = 45; // Zip 4.5, the newest version supported for unzipping
 
 typedef NS_OPTIONS(UInt16, NOZFlagBits)
 {
@@ -78,13 +93,52 @@ NS_INLINE NOZFlagBits NOZEmplaceDeflateFlagBits(NOZDeflateFlagBits deflateBits)
     return (NOZFlagBits)((deflateBits & 0b11) << 1);
 }
 
+#pragma mark Little Endian Loads and Stores
+
+// Zip archives are little endian.  These loads and stores are alignment and host endianness agnostic.
+
+NS_INLINE UInt16 NOZReadLittleEndian16(const Byte *bytes)
+{
+    return (UInt16)((UInt16)bytes[0] | ((UInt16)bytes[1] << 8));
+}
+
+NS_INLINE UInt32 NOZReadLittleEndian32(const Byte *bytes)
+{
+    return (UInt32)bytes[0] | ((UInt32)bytes[1] << 8) | ((UInt32)bytes[2] << 16) | ((UInt32)bytes[3] << 24);
+}
+
+NS_INLINE UInt64 NOZReadLittleEndian64(const Byte *bytes)
+{
+    return (UInt64)NOZReadLittleEndian32(bytes) | ((UInt64)NOZReadLittleEndian32(bytes + 4) << 32);
+}
+
+NS_INLINE void NOZWriteLittleEndian16(Byte *bytes, UInt16 value)
+{
+    bytes[0] = (Byte)(value & 0xff);
+    bytes[1] = (Byte)((value >> 8) & 0xff);
+}
+
+NS_INLINE void NOZWriteLittleEndian32(Byte *bytes, UInt32 value)
+{
+    NOZWriteLittleEndian16(bytes, (UInt16)(value & 0xffff));
+    NOZWriteLittleEndian16(bytes + 2, (UInt16)(value >> 16));
+}
+
+NS_INLINE void NOZWriteLittleEndian64(Byte *bytes, UInt64 value)
+{
+    NOZWriteLittleEndian32(bytes, (UInt32)(value & 0xffffffff));
+    NOZWriteLittleEndian32(bytes + 4, (UInt32)(value >> 32));
+}
+
+#pragma mark Structures
+
 typedef struct _NOZLocalFileDescriptorT
 {
     // Optionally starts with NOZMagicNumberDataDescriptor
 
     UInt32 crc32;
-    UInt32 compressedSize;
-    UInt32 uncompressedSize;
+    UInt64 compressedSize; // 32 bits unless ZIP64
+    UInt64 uncompressedSize; // 32 bits unless ZIP64
 } NOZLocalFileDescriptorT;
 
 typedef struct _NOZLocalFileHeaderT
@@ -115,7 +169,7 @@ typedef struct _NOZCentralDirectoryFileRecordT
     UInt16 fileStartDiskNumber;
     UInt16 internalFileAttributes;
     UInt32 externalFileAttributes;
-    UInt32 localFileHeaderOffsetFromStartOfDisk;
+    UInt64 localFileHeaderOffsetFromStartOfDisk; // 32 bits unless ZIP64
 
     // ends with:
     // const Byte* name;
@@ -126,13 +180,14 @@ typedef struct _NOZCentralDirectoryFileRecordT
 typedef struct _NOZEndOfCentralDirectoryRecordT
 {
     // starts with NOZMagicNumberEndOfCentralDirectoryRecord
+    // fields are widened to hold the values of the ZIP64 end of central directory record when present
 
-    UInt16 diskNumber;
-    UInt16 startDiskNumber;
-    UInt16 recordCountForDisk;
-    UInt16 totalRecordCount;
-    UInt32 centralDirectorySize;
-    UInt32 archiveStartToCentralDirectoryStartOffset;
+    UInt32 diskNumber; // 16 bits unless ZIP64
+    UInt32 startDiskNumber; // 16 bits unless ZIP64
+    UInt64 recordCountForDisk; // 16 bits unless ZIP64
+    UInt64 totalRecordCount; // 16 bits unless ZIP64
+    UInt64 centralDirectorySize; // 32 bits unless ZIP64
+    UInt64 archiveStartToCentralDirectoryStartOffset; // 32 bits unless ZIP64
     UInt16 commentSize;
 
     // ends with:
@@ -153,6 +208,7 @@ typedef struct _NOZFileEntryT
     BOOL ownsName:1;
     BOOL ownsExtraField:1;
     BOOL ownsComment:1;
+    BOOL hasZip64LocalExtraField:1; // the local file header reserved a ZIP64 extra field for its sizes
 } NOZFileEntryT;
 
 FOUNDATION_EXTERN NOZFileEntryT* NOZFileEntryAllocInit(void);
@@ -161,6 +217,37 @@ FOUNDATION_EXTERN void NOZFileEntryInit(NOZFileEntryT* entry);
 FOUNDATION_EXTERN void NOZFileEntryCleanFree(NOZFileEntryT* entry);
 FOUNDATION_EXTERN void NOZFileEntryClean(NOZFileEntryT* entry);
 
+//! Best guess of the compression level used for an entry, based on its bit flags
+FOUNDATION_EXTERN NOZCompressionLevel NOZCompressionLevelForFileHeader(const NOZLocalFileHeaderT* header);
+
+#pragma mark End of Central Directory Records
+
+// Shared by reading an archive (NOZUnzipper) and appending to one (NOZZipper)
+
+typedef struct _NOZZip64EndOfCentralDirectoryLocatorT
+{
+    // starts with NOZMagicNumberZip64EndOfCentralDirectoryLocator
+
+    UInt32 recordDiskNumber;
+    UInt64 recordOffset;
+    UInt32 totalDiskCount;
+} NOZZip64EndOfCentralDirectoryLocatorT;
+
+//! The last occurrence of the (little endian) _signature_ in _bytes_, `NULL` when there is none
+FOUNDATION_EXTERN const Byte* NOZFindLastSignature(const Byte* bytes, size_t length, UInt32 signature);
+
+//! The last end of central directory record in the _tail_ of an archive that is followed by its entire comment, `NULL` when there is none
+FOUNDATION_EXTERN const Byte* NOZFindEndOfCentralDirectoryRecord(const Byte* tail, size_t tailLength);
+
+//! Reads the fixed size end of central directory record at _bytes_ (the signature is expected to have been checked)
+FOUNDATION_EXTERN void NOZReadEndOfCentralDirectoryRecord(const Byte* bytes, NOZEndOfCentralDirectoryRecordT* record);
+
+//! Reads the ZIP64 end of central directory locator at _bytes_, `NO` when it isn't one (not a ZIP64 archive)
+FOUNDATION_EXTERN BOOL NOZReadZip64EndOfCentralDirectoryLocator(const Byte* bytes, NOZZip64EndOfCentralDirectoryLocatorT* locator);
+
+//! Reads the fixed size ZIP64 end of central directory record at _bytes_ over the widened fields of _record_, `NO` when it isn't one
+FOUNDATION_EXTERN BOOL NOZReadZip64EndOfCentralDirectoryRecord(const Byte* bytes, NOZEndOfCentralDirectoryRecordT* record);
+
 #import "NOZDecoder.h"
 #import "NOZEncoder.h"
 
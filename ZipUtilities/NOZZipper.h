@@ -31,17 +31,26 @@
 #import <ZipUtilities/NOZZipEntry.h>
 
 @class NOZEncrytion;
+@class NOZCentralDirectoryRecord;
+@class NOZUnzipper;
 
 /**
- Enum of possible modes to open an `NOZZipper` with.  Currently only creating a new archive is supported.
+ Enum of possible modes to open an `NOZZipper` with.
  */
 typedef NS_ENUM(NSInteger, NOZZipperMode)
 {
     /** Creat a new zip archive */
     NOZZipperModeCreate,
-// TODO: add support for adding to an existing file
-//    NOZZipperModeOpenExisting,
-//    NOZZipperModeOpenExistingOrCreate,
+    /**
+     Append to an existing zip archive.
+     New entries are written over the existing central directory, which is then rewritten (along with the
+     new entries' records) on close.  The entries already in the archive are not read or rewritten.
+     If the archive cannot be completed on close, its original central directory is restored and it is truncated back
+     to its original length.
+     */
+    NOZZipperModeOpenExisting,
+    /** Append to an existing zip archive (see `NOZZipperModeOpenExisting`), or create it when there is none */
+    NOZZipperModeOpenExistingOrCreate,
 };
 
 /**
@@ -52,6 +61,9 @@ typedef NS_ENUM(NSInteger, NOZZipperMode)
  By default, `NOZZipper` is optimized to compress in a single pass.
  If you need `NOZZipper` to output without this optimization, define `NOZ_SINGLE_PASS_ZIP` as `0`
  in your build settings.
+
+ Archives and entries of 4GB or more, and archives with 65,535 or more entries, are written
+ in ZIP64 format as needed.
  
  ### Example
 
@@ -106,7 +118,10 @@ typedef NS_ENUM(NSInteger, NOZZipperMode)
 /** The path to the zip file */
 @property (nonatomic, readonly, nonnull) NSString *zipFilePath;
 
-/** An optional global comment for the zip archive.  Must be set _before_ closing the Zipper. */
+/**
+ An optional global comment for the zip archive.  Must be set _before_ closing the Zipper.
+ When appending to an existing archive, it is populated with the archive's global comment on open (unless already set).
+ */
 @property (nonatomic, copy, nullable) NSString *globalComment;
 
 /** Designated initializer */
@@ -142,4 +157,36 @@ typedef NS_ENUM(NSInteger, NOZZipperMode)
    progressBlock:(__attribute__((noescape)) NOZProgressBlock __nullable)progressBlock
            error:(out NSError * __nullable * __nullable)error;
 
+/**
+ Add entries to the Zipper, compressing up to _maxConcurrentEntries_ of them concurrently.
+ Compressed entries are buffered (in memory, or in a temporary file once large) until their turn to be
+ written comes, so the archive is identical to one with the entries added one at a time in the order of _entries_.
+ Entries compressed ahead of their turn are bounded by _maxConcurrentEntries_.
+ @param entries The entries to zip.
+ @param maxConcurrentEntries The maximum number of entries to compress concurrently.  `0` will use the number of active processors, `1` is serial.
+ @param progressBlock The optional block for observing the progress of all the _entries_.  Calls are serialized, but can come from any thread.
+ @param error The error will be set if an error is encountered.  Pass `NULL` if you don't care.
+ @return `YES` on success, `NO` on failure.
+ */
+- (BOOL)addEntries:(nonnull NSArray<id<NOZZippableEntry>> *)entries
+maxConcurrentEntries:(NSUInteger)maxConcurrentEntries
+     progressBlock:(nullable NOZProgressBlock)progressBlock
+             error:(out NSError * __nullable * __nullable)error;
+
+/**
+ Add a record from another archive to the Zipper without decompressing or recompressing it.
+ The record's compressed bytes, CRC32, sizes, compression method, flags, date, attributes, name and comment are
+ copied verbatim (the bytes are copied by the kernel where possible, see `-[NOZUnzipper writeCompressedBytesOfRecord:toFileDescriptor:progressBlock:error:]`).
+ Extra fields are not copied (ZIP64 fields are written as needed) and the checksum is not validated.
+ @param record The record to copy.  Must belong to _unzipper_'s central directory.
+ @param unzipper The open `NOZUnzipper` with its central directory read.
+ @param progressBlock The optional block for observing progress.
+ @param error The error will be set if an error is encountered.  Pass `NULL` if you don't care.
+ @return `YES` on success, `NO` on failure.
+ */
+- (BOOL)addCompressedRecord:(nonnull NOZCentralDirectoryRecord *)record
+               fromUnzipper:(nonnull NOZUnzipper *)unzipper
+              progressBlock:(__attribute__((noescape)) NOZProgressBlock __nullable)progressBlock
+                      error:(out NSError * __nullable * __nullable)error;
+
 @end
@@ -28,9 +28,18 @@
 #import "NOZ_Project.h"
 #import "NOZCompressionLibrary.h"
 #import "NOZError.h"
+#import "NOZSpillBuffer.h"
+#import "NOZUnzipper_Project.h"
 #import "NOZUtils_Project.h"
 #import "NOZZipper.h"
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <stdio_ext.h>
+#endif
+
 #ifndef NOZ_SINGLE_PASS_ZIP
 #define NOZ_SINGLE_PASS_ZIP 1
 #endif
@@ -45,16 +54,66 @@
 #define kENCODING NSUTF8StringEncoding
 #endif
 
-static UInt8 noz_fwrite_value(UInt64 x,
-                              const UInt8 byteCount,
-                              FILE *file);
+typedef struct {
+    const void *bytes;
+    size_t length;
+} NOZWritePartT;
+
+static BOOL noz_fwrite_parts(const NOZWritePartT *parts,
+                             size_t partCount,
+                             FILE *file);
 static UInt8 noz_store_value(UInt64 x,
                              const UInt8 byteCount,
                              Byte *buffer,
                              const Byte *bufferEnd);
+static UInt16 noz_store_zip64_extra_field(const NOZCentralDirectoryFileRecordT *record,
+                                          Byte *buffer,
+                                          size_t bufferSize);
+
+// Records are serialized into a buffer (`cursor` up to `bufferEnd`) and then written all at once
+#define PRIVATE_STORE(v) \
+(cursor += noz_store_value((v), sizeof(v), cursor, bufferEnd))
+
+// For fields whose in memory width is wider than their width in the archive
+#define PRIVATE_STORE_SIZED(v, byteCount) \
+(cursor += noz_store_value((v), (byteCount), cursor, bufferEnd))
+
+// The archive is written through a staging buffer this large so that records and small entries coalesce into fewer writes
+static const size_t kNOZZipperWriteBufferSize = 256 * 1024;
+// Records (with their name, extra field and comment) that fit are written with a single fwrite
+static const size_t kNOZRecordStackBufferSize = 512;
+
+// Entries compressed concurrently are buffered in memory up to this size, then in a temporary file
+static const size_t kNOZEncodedEntryMemoryLimit = 4 * 1024 * 1024;
+
+// Entries expected to be this large reserve a ZIP64 extra field in their local file header (leaving room for encoding overhead)
+static const SInt64 kNOZZip64LocalFileHeaderThreshold = (SInt64)(NOZZip64Sentinel32 - (NOZZip64Sentinel32 >> 6));
+static const UInt16 kNOZZip64LocalExtraFieldSize = 4 + 8 + 8;
+
+NS_INLINE UInt64 noz_zip64_field_value(UInt64 value, UInt64 sentinel)
+{
+    return (value >= sentinel) ? sentinel : value;
+}
+
+NS_INLINE BOOL noz_entry_sizes_need_zip64(const NOZFileEntryT *entry)
+{
+    return entry->fileDescriptor.compressedSize >= NOZZip64Sentinel32 || entry->fileDescriptor.uncompressedSize >= NOZZip64Sentinel32;
+}
 
-#define PRIVATE_WRITE(v) \
-noz_fwrite_value((v), sizeof(v), _internal.file)
+/**
+ An entry compressed by `addEntries:maxConcurrentEntries:progressBlock:error:` ahead of being written to the archive
+ */
+NOZ_OBJC_DIRECT_MEMBERS
+@interface NOZEncodedZipEntry : NSObject
+@property (nonatomic, readonly) id<NOZZippableEntry> entry;
+@property (nonatomic, readonly) NOZSpillBuffer *buffer;
+@property (nonatomic, readonly) dispatch_semaphore_t finishedSemaphore;
+@property (nonatomic) UInt32 crc32;
+@property (nonatomic) UInt64 uncompressedSize;
+@property (nonatomic) BOOL encodedDataWasText;
+@property (nonatomic, nullable) NSError *error;
+- (instancetype)initWithEntry:(id<NOZZippableEntry>)entry;
+@end
 
 NOZ_OBJC_DIRECT_MEMBERS
 @implementation NOZZipper
@@ -65,6 +124,7 @@ NOZ_OBJC_DIRECT_MEMBERS
 
     struct {
         FILE *file;
+        void *writeBuffer;
 
         NOZFileEntryT *firstEntry;
         NOZFileEntryT *lastEntry;
@@ -76,7 +136,15 @@ NOZ_OBJC_DIRECT_MEMBERS
         NOZEndOfCentralDirectoryRecordT endOfCentralDirectoryRecord;
         Byte *comment;
 
+        // When appending, everything from the existing central directory to the end of the archive,
+        // restored if the archive cannot be completed
+        Byte *existingTail;
+        size_t existingTailLength;
+        size_t existingCentralDirectoryLength;
+        SInt64 existingTailPosition;
+
         BOOL ownsComment:1;
+        BOOL isAppending:1;
     } _internal;
 }
 
@@ -132,18 +200,20 @@ NOZ_OBJC_DIRECT_MEMBERS
     }
 
     const char *fopenMode = "w+";
+    BOOL appending = NO;
     switch (mode) {
-//        case NOZZipperModeOpenExistingOrCreate:
-//            break;
-//        case NOZZipperModeOpenExisting:
-//        {
-//            fopenMode = "r+";
-//            if (![fm fileExistsAtPath:_standardizedZipFilePath]) {
-//                stackError = NOZErrorCreate(NOZErrorCodeZipCannotOpenExistingZip, @{ @"zipFilePath" : _zipFilePath });
-//                return NO;
-//            }
-//            break;
-//        }
+        case NOZZipperModeOpenExistingOrCreate:
+        case NOZZipperModeOpenExisting:
+        {
+            if ([fm fileExistsAtPath:_standardizedZipFilePath]) {
+                fopenMode = "r+";
+                appending = YES;
+            } else if (NOZZipperModeOpenExisting == mode) {
+                stackError = NOZErrorCreate(NOZErrorCodeZipCannotOpenExistingZip, @{ @"zipFilePath" : _zipFilePath });
+                return NO;
+            }
+            break;
+        }
         case NOZZipperModeCreate:
         default:
         {
@@ -157,20 +227,41 @@ NOZ_OBJC_DIRECT_MEMBERS
 
     _internal.file = fopen(_standardizedZipFilePath.UTF8String, fopenMode);
     if (!_internal.file) {
-        // stackError = NOZErrorCreate((NOZZipperModeOpenExisting == mode) ? NOZErrorCodeZipCannotOpenExistingZip : NOZErrorCodeZipCannotCreateZip, @{ @"zipFilePath" : _zipFilePath });
-        stackError = NOZErrorCreate(NOZErrorCodeZipCannotCreateZip, @{ @"zipFilePath" : _zipFilePath });
+        stackError = NOZErrorCreate((appending) ? NOZErrorCodeZipCannotOpenExistingZip : NOZErrorCodeZipCannotCreateZip, @{ @"zipFilePath" : _zipFilePath });
         return NO;
     }
     noz_defer(^{
         if (stackError != nil) {
             fclose(self->_internal.file);
             self->_internal.file = NULL;
-            if (NOZZipperModeCreate == mode) {
+            free(self->_internal.writeBuffer);
+            self->_internal.writeBuffer = NULL;
+            [self private_freeExistingTail];
+            if (!appending) {
                 [[NSFileManager defaultManager] removeItemAtPath:self->_standardizedZipFilePath error:NULL];
             }
         }
     });
 
+    // must be set up before any other operation on the file, the default buffer would be tiny (BUFSIZ)
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    if (0 == posix_memalign(&_internal.writeBuffer, (pageSize > 0) ? (size_t)pageSize : 4096, kNOZZipperWriteBufferSize)) {
+        if (0 != setvbuf(_internal.file, _internal.writeBuffer, _IOFBF, kNOZZipperWriteBufferSize)) {
+            free(_internal.writeBuffer);
+            _internal.writeBuffer = NULL;
+        }
+    } else {
+        _internal.writeBuffer = NULL;
+    }
+
+    if (appending) {
+        if (![self private_readExistingArchive]) {
+            stackError = NOZErrorCreate(NOZErrorCodeZipCannotOpenExistingZip, @{ @"zipFilePath" : _zipFilePath });
+            return NO;
+        }
+        return YES;
+    }
+
     if (0 != fseeko(_internal.file, 0, SEEK_END)) {
         stackError = [NSError errorWithDomain:NSPOSIXErrorDomain
                                          code:errno
@@ -237,6 +328,194 @@ NOZ_OBJC_DIRECT_MEMBERS
     }
 }
 
+- (BOOL)addEntries:(NSArray<id<NOZZippableEntry>> *)entries
+maxConcurrentEntries:(NSUInteger)maxConcurrentEntries
+     progressBlock:(NOZProgressBlock)progressBlock
+             error:(out NSError * __autoreleasing *)error
+{
+    __block NSError *stackError = nil;
+    noz_defer(^{
+        if (stackError && error) {
+            *error = stackError;
+        }
+    });
+
+    if (!_internal.file) {
+        stackError = NOZErrorCreate(NOZErrorCodeZipCannotOpenNewEntry, nil);
+        return NO;
+    }
+
+    if (0 == maxConcurrentEntries) {
+        maxConcurrentEntries = [NSProcessInfo processInfo].activeProcessorCount;
+    }
+    maxConcurrentEntries = MIN(maxConcurrentEntries, entries.count);
+
+    SInt64 totalBytes = 0;
+    for (id<NOZZippableEntry> entry in entries) {
+        totalBytes += entry.sizeInBytes;
+    }
+
+    // Progress is reported for all the entries, serialized across the encoding threads
+    pthread_mutex_t progressMutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_mutex_t *progressMutexPtr = &progressMutex;
+    atomic_bool shouldStop;
+    atomic_init(&shouldStop, false);
+    atomic_bool *shouldStopPtr = &shouldStop;
+    __block SInt64 bytesComplete = 0;
+    void (^didEncodeBytes)(SInt64 bytesThisPass) = ^(SInt64 bytesThisPass) {
+        if (!progressBlock) {
+            return;
+        }
+        BOOL abort = NO;
+        pthread_mutex_lock(progressMutexPtr);
+        bytesComplete += bytesThisPass;
+        progressBlock(totalBytes, bytesComplete, bytesThisPass, &abort);
+        pthread_mutex_unlock(progressMutexPtr);
+        if (abort) {
+            atomic_store(shouldStopPtr, true);
+        }
+    };
+
+    if (maxConcurrentEntries <= 1) {
+        for (id<NOZZippableEntry> entry in entries) {
+            const BOOL success = [self addEntry:entry
+                                  progressBlock:^(int64_t entryTotalBytes, int64_t entryBytesComplete, int64_t bytesThisPass, BOOL *abort) {
+                didEncodeBytes(bytesThisPass);
+                *abort = atomic_load(shouldStopPtr);
+            }
+                                          error:&stackError];
+            if (!success) {
+                return NO;
+            }
+        }
+        return YES;
+    }
+
+    // Up to maxConcurrentEntries entries are encoding (or encoded and waiting for their turn) at once,
+    // the oldest is written as soon as it is encoded so that the archive keeps the order of the entries
+
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    NSMutableArray<NOZEncodedZipEntry *> *pendingEntries = [[NSMutableArray alloc] initWithCapacity:maxConcurrentEntries];
+    NSUInteger nextIndex = 0;
+    while (nextIndex < entries.count || pendingEntries.count > 0) {
+        while (nextIndex < entries.count && pendingEntries.count < maxConcurrentEntries && !atomic_load(shouldStopPtr)) {
+            NOZEncodedZipEntry *encodedEntry = [[NOZEncodedZipEntry alloc] initWithEntry:entries[nextIndex++]];
+            [pendingEntries addObject:encodedEntry];
+            dispatch_async(queue, ^{
+                @autoreleasepool {
+                    encodedEntry.error = [self private_encodeEntry:encodedEntry
+                                                        shouldStop:shouldStopPtr
+                                                    didEncodeBytes:didEncodeBytes];
+                }
+                dispatch_semaphore_signal(encodedEntry.finishedSemaphore);
+            });
+        }
+
+        if (0 == pendingEntries.count) {
+            break;
+        }
+
+        // Always wait for an entry being encoded, even once failed, since it references this stack frame
+        NOZEncodedZipEntry *encodedEntry = pendingEntries.firstObject;
+        [pendingEntries removeObjectAtIndex:0];
+        dispatch_semaphore_wait(encodedEntry.finishedSemaphore, DISPATCH_TIME_FOREVER);
+        if (stackError) {
+            continue;
+        }
+
+        @autoreleasepool {
+            if (encodedEntry.error) {
+                stackError = encodedEntry.error;
+            } else {
+                NSError *writeError = nil;
+                if (![self private_writeEncodedEntry:encodedEntry error:&writeError]) {
+                    stackError = writeError ?: NOZErrorCreate(NOZErrorCodeZipFailedToWriteEntry, nil);
+                }
+            }
+        }
+
+        if (stackError) {
+            atomic_store(shouldStopPtr, true);
+        }
+    }
+
+    if (!stackError && atomic_load(shouldStopPtr)) {
+        stackError = [NSError errorWithDomain:NSPOSIXErrorDomain
+                                         code:ECANCELED
+                                     userInfo:nil];
+    }
+
+    return !stackError;
+}
+
+- (BOOL)addCompressedRecord:(NOZCentralDirectoryRecord *)record
+               fromUnzipper:(NOZUnzipper *)unzipper
+              progressBlock:(__attribute__((noescape)) NOZProgressBlock)progressBlock
+                      error:(out NSError * __autoreleasing *)error
+{
+    __block NSError *stackError = nil;
+    noz_defer(^{
+        if (stackError && error) {
+            *error = stackError;
+        }
+    });
+
+    const NOZFileEntryT *copiedEntry = [record private_isOwnedByCentralDirectory:unzipper.centralDirectory] ? record.private_internalEntry : NULL;
+    if (!copiedEntry || 0 == copiedEntry->fileHeader.nameSize || !_internal.file) {
+        stackError = NOZErrorCreate(NOZErrorCodeZipCannotOpenNewEntry, nil);
+        return NO;
+    }
+
+    if (![self private_closeCurrentOpenEntryAndReturnError:&stackError]) {
+        return NO;
+    }
+
+    if (![self private_appendNewEntry]) {
+        stackError = NOZErrorCreate(NOZErrorCodeZipCannotOpenNewEntry, nil);
+        return NO;
+    }
+
+    NOZFileEntryT *fileEntry = _internal.currentEntry;
+    [self private_populateRecordsForCurrentOpenEntryWithCopiedEntry:copiedEntry];
+
+    // with a data descriptor, the local file header has no CRC or sizes (they follow the compressed bytes)
+    const NOZLocalFileDescriptorT fileDescriptor = fileEntry->fileDescriptor;
+    const BOOL hasDataDescriptor = (fileEntry->fileHeader.bitFlag & NOZFlagBitsFileMetadataInDescriptor) != 0;
+    if (hasDataDescriptor) {
+        fileEntry->fileDescriptor = (NOZLocalFileDescriptorT){ 0 };
+    }
+    const BOOL wroteHeader = [self private_writeLocalFileHeaderForCurrentEntryAndReturnError:&stackError];
+    fileEntry->fileDescriptor = fileDescriptor;
+    if (!wroteHeader) {
+        _internal.currentEntry = NULL;
+        return NO;
+    }
+
+    // the compressed bytes go straight to the file descriptor, past anything buffered by the FILE
+    BOOL writeSuccess = (0 == fflush(_internal.file));
+    const SInt64 position = (writeSuccess) ? (SInt64)ftello(_internal.file) : -1;
+    const int fileDescriptorNumber = fileno(_internal.file);
+    writeSuccess = position >= 0 && lseek(fileDescriptorNumber, (off_t)position, SEEK_SET) == (off_t)position;
+    if (writeSuccess) {
+        writeSuccess = [unzipper writeCompressedBytesOfRecord:record
+                                             toFileDescriptor:fileDescriptorNumber
+                                                progressBlock:progressBlock
+                                                        error:&stackError];
+    }
+    if (writeSuccess) {
+        writeSuccess = (0 == fseeko(_internal.file, (off_t)(position + (SInt64)fileDescriptor.compressedSize), SEEK_SET));
+    }
+
+    if (![self private_closeCurrentOpenEntryAndReturnError:(writeSuccess) ? (&stackError) : NULL] || !writeSuccess) {
+        if (!writeSuccess && !stackError) {
+            stackError = NOZErrorCreate(NOZErrorCodeZipFailedToWriteEntry, nil);
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
 - (BOOL)private_forciblyClose:(BOOL)forceClose
                         error:(out NSError * __autoreleasing *)error
 {
@@ -247,14 +526,34 @@ NOZ_OBJC_DIRECT_MEMBERS
     __block NSError *stackError = nil;
     noz_defer(^{ if (stackError != nil && error) { *error = stackError; } });
 
-    if (forceClose && ![self private_closeCurrentOpenEntryAndReturnError:&stackError]) {
-        [self private_freeLinkedList];
-        return NO;
-    } else if (!forceClose && NULL != _internal.currentEntry) {
+    if (!forceClose && NULL != _internal.currentEntry) {
         stackError = NOZErrorCreate(NOZErrorCodeZipFailedToCloseCurrentEntry, nil);
         return NO;
     }
 
+    // from here on the zipper is closed, and an archive being appended to is restored on failure
+    noz_defer(^{
+        if (self->_internal.file) {
+            if (stackError != nil && self->_internal.isAppending) {
+                [self private_restoreExistingTail];
+            }
+            fclose(self->_internal.file);
+            self->_internal.file = NULL;
+        }
+        free(self->_internal.writeBuffer);
+        self->_internal.writeBuffer = NULL;
+        [self private_freeExistingTail];
+        [self private_freeLinkedList];
+        if (self->_internal.ownsComment) {
+            free(self->_internal.comment);
+            self->_internal.comment = NULL;
+        }
+    });
+
+    if (forceClose && ![self private_closeCurrentOpenEntryAndReturnError:&stackError]) {
+        return NO;
+    }
+
     NSUInteger globalCommentSize = [self.globalComment lengthOfBytesUsingEncoding:kENCODING];
     if (globalCommentSize > UINT16_MAX) {
         globalCommentSize = 0;
@@ -266,16 +565,6 @@ NOZ_OBJC_DIRECT_MEMBERS
         _internal.ownsComment = YES;
     }
 
-    noz_defer(^{
-        fclose(self->_internal.file);
-        self->_internal.file = NULL;
-        [self private_freeLinkedList];
-        if (self->_internal.ownsComment) {
-            free(self->_internal.comment);
-            self->_internal.comment = NULL;
-        }
-    });
-
     if (![self private_writeCentralDirectoryRecords]) {
         stackError = NOZErrorCreate(NOZErrorCodeZipFailedToWriteZip, nil);
         return NO;
@@ -286,11 +575,197 @@ NOZ_OBJC_DIRECT_MEMBERS
         return NO;
     }
 
+    // most of the archive's tail is still in the write buffer, a failure to flush it is a failure to write the archive
+    if (0 != fflush(_internal.file)) {
+        stackError = NOZErrorCreate(NOZErrorCodeZipFailedToWriteZip, nil);
+        return NO;
+    }
+
+    if (_internal.isAppending && ![self private_truncateAtCurrentPosition]) {
+        stackError = NOZErrorCreate(NOZErrorCodeZipFailedToWriteZip, nil);
+        return NO;
+    }
+
+    const BOOL closed = (0 == fclose(_internal.file));
+    _internal.file = NULL;
+    if (!closed) {
+        stackError = NOZErrorCreate(NOZErrorCodeZipFailedToWriteZip, nil);
+        return NO;
+    }
+
     return YES;
 }
 
-- (BOOL)private_openEntry:(id<NOZZippableEntry>)entry
-                    error:(out NSError * __autoreleasing *)error
+- (BOOL)private_readExistingArchive
+{
+    FILE *file = _internal.file;
+    if (0 != fseeko(file, 0, SEEK_END)) {
+        return NO;
+    }
+
+    const SInt64 fileLength = ftello(file);
+    if (fileLength < (SInt64)NOZEndOfCentralDirectoryRecordFixedSize) {
+        return NO;
+    }
+
+    // One read of the tail covers the EOCD record with the max global comment size and the ZIP64 locator preceding it
+
+    const SInt64 maxTailLength = UINT16_MAX /* max global comment size */ + (SInt64)NOZEndOfCentralDirectoryRecordFixedSize + (SInt64)NOZZip64EndOfCentralDirectoryLocatorFixedSize;
+    const size_t tailLength = (size_t)MIN(fileLength, maxTailLength);
+    const SInt64 tailPosition = fileLength - (SInt64)tailLength;
+    Byte *tail = malloc(tailLength);
+    noz_defer(^{ free(tail); });
+    if (!tail || 0 != fseeko(file, tailPosition, SEEK_SET) || fread(tail, 1, tailLength, file) != tailLength) {
+        return NO;
+    }
+
+    const Byte *eocd = NOZFindEndOfCentralDirectoryRecord(tail, tailLength);
+    if (!eocd) {
+        return NO;
+    }
+
+    NOZEndOfCentralDirectoryRecordT existingRecord;
+    NOZReadEndOfCentralDirectoryRecord(eocd, &existingRecord);
+    if (0 != existingRecord.diskNumber || 0 != existingRecord.startDiskNumber) {
+        return NO; // multiple disks
+    }
+
+    const size_t eocdOffsetInTail = (size_t)(eocd - tail);
+    SInt64 centralDirectoryEndPosition = tailPosition + (SInt64)eocdOffsetInTail;
+
+    // A ZIP64 archive has a ZIP64 end of central directory locator immediately preceding the end of central directory record
+
+    NOZZip64EndOfCentralDirectoryLocatorT locator;
+    if (eocdOffsetInTail >= NOZZip64EndOfCentralDirectoryLocatorFixedSize &&
+        NOZReadZip64EndOfCentralDirectoryLocator(eocd - NOZZip64EndOfCentralDirectoryLocatorFixedSize, &locator)) {
+        if (0 != locator.recordDiskNumber || locator.totalDiskCount > 1) {
+            return NO; // multiple disks
+        }
+
+        const SInt64 locatorPosition = centralDirectoryEndPosition - (SInt64)NOZZip64EndOfCentralDirectoryLocatorFixedSize;
+        if (locator.recordOffset > (UInt64)locatorPosition || locator.recordOffset + NOZZip64EndOfCentralDirectoryRecordFixedSize > (UInt64)locatorPosition) {
+            return NO;
+        }
+
+        Byte record[NOZZip64EndOfCentralDirectoryRecordFixedSize];
+        if (0 != fseeko(file, (off_t)locator.recordOffset, SEEK_SET) || fread(record, 1, sizeof(record), file) != sizeof(record)) {
+            return NO;
+        }
+        if (!NOZReadZip64EndOfCentralDirectoryRecord(record, &existingRecord) ||
+            0 != existingRecord.diskNumber ||
+            0 != existingRecord.startDiskNumber) {
+            return NO;
+        }
+
+        centralDirectoryEndPosition = (SInt64)locator.recordOffset;
+    }
+
+    const UInt64 recordCount = existingRecord.totalRecordCount;
+    const UInt64 centralDirectorySize = existingRecord.centralDirectorySize;
+    const UInt64 centralDirectoryOffset = existingRecord.archiveStartToCentralDirectoryStartOffset;
+    const UInt16 commentSize = existingRecord.commentSize;
+
+    // New entries overwrite the central directory, which must end where the end of central directory records begin
+    if (centralDirectorySize > (UInt64)centralDirectoryEndPosition ||
+        centralDirectoryOffset + centralDirectorySize != (UInt64)centralDirectoryEndPosition) {
+        return NO;
+    }
+
+    const SInt64 existingTailPosition = (SInt64)centralDirectoryOffset;
+    const size_t existingTailLength = (size_t)(fileLength - existingTailPosition);
+    Byte *existingTail = malloc(MAX(existingTailLength, (size_t)1));
+    if (!existingTail) {
+        return NO;
+    }
+    _internal.existingTail = existingTail;
+    _internal.existingTailLength = existingTailLength;
+    _internal.existingTailPosition = existingTailPosition;
+    _internal.existingCentralDirectoryLength = (size_t)centralDirectorySize;
+    if (0 != fseeko(file, (off_t)existingTailPosition, SEEK_SET) || fread(existingTail, 1, existingTailLength, file) != existingTailLength) {
+        return NO;
+    }
+
+    // Validate the records before anything is written over them
+    UInt64 parsedRecordCount = 0;
+    size_t recordOffset = 0;
+    while (recordOffset < _internal.existingCentralDirectoryLength) {
+        const Byte *record = existingTail + recordOffset;
+        if (_internal.existingCentralDirectoryLength - recordOffset < NOZCentralDirectoryFileRecordFixedSize ||
+            NOZMagicNumberCentralDirectoryFileRecord != NOZReadLittleEndian32(record)) {
+            return NO;
+        }
+        recordOffset += NOZCentralDirectoryFileRecordFixedSize;
+        recordOffset += NOZReadLittleEndian16(record + 28) /* name */ + NOZReadLittleEndian16(record + 30) /* extra field */ + NOZReadLittleEndian16(record + 32) /* comment */;
+        parsedRecordCount++;
+    }
+    if (recordOffset != _internal.existingCentralDirectoryLength || parsedRecordCount != recordCount) {
+        return NO;
+    }
+
+    if (!self.globalComment && commentSize > 0) {
+        // There is no flag for the encoding of the global comment, decode as UTF8 and fall back to DOS Latin US
+        NSData *commentData = [NSData dataWithBytes:eocd + NOZEndOfCentralDirectoryRecordFixedSize length:commentSize];
+        self.globalComment = [[NSString alloc] initWithData:commentData encoding:NSUTF8StringEncoding] ?: [[NSString alloc] initWithData:commentData encoding:CFStringConvertEncodingToNSStringEncoding(kCFStringEncodingDOSLatinUS)];
+    }
+
+    _internal.endOfCentralDirectoryRecord.totalRecordCount = recordCount;
+    _internal.endOfCentralDirectoryRecord.recordCountForDisk = recordCount;
+    _internal.beginBytePosition = 0;
+    _internal.isAppending = YES;
+
+    // entries are written over the existing central directory
+    return 0 == fseeko(file, (off_t)existingTailPosition, SEEK_SET);
+}
+
+- (BOOL)private_truncateAtCurrentPosition
+{
+    // what remains of a longer existing tail (such as a longer global comment) follows the new end of central directory record
+    const SInt64 position = ftello(_internal.file);
+    return position >= 0 && 0 == fflush(_internal.file) && 0 == ftruncate(fileno(_internal.file), (off_t)position);
+}
+
+- (void)private_restoreExistingTail
+{
+    // Drops the added entries by putting back the original central directory and end of central directory records.
+    // Restoring is usually due to a failed write, so pending output is discarded (rather than flushed by a seek)
+    // and the tail is written straight to the file descriptor.
+    FILE *file = _internal.file;
+#if defined(__linux__)
+    __fpurge(file);
+#else
+    fpurge(file);
+#endif
+
+    const int fd = fileno(file);
+    const Byte *bytes = _internal.existingTail;
+    size_t remaining = _internal.existingTailLength;
+    off_t offset = (off_t)_internal.existingTailPosition;
+    while (remaining > 0) {
+        const ssize_t written = pwrite(fd, bytes, remaining, offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return;
+        }
+        bytes += written;
+        remaining -= (size_t)written;
+        offset += written;
+    }
+    (void)ftruncate(fd, offset);
+}
+
+- (void)private_freeExistingTail
+{
+    free(_internal.existingTail);
+    _internal.existingTail = NULL;
+    _internal.existingTailLength = 0;
+    _internal.existingCentralDirectoryLength = 0;
+    _internal.isAppending = NO;
+}
+
+- (BOOL)private_openEntryRecord:(id<NOZZippableEntry>)entry
+                          error:(out NSError * __autoreleasing *)error
 {
     __block BOOL errorEncountered = NO;
     noz_defer(^{ if (errorEncountered && error) { *error = NOZErrorCreate(NOZErrorCodeZipCannotOpenNewEntry, nil); } });
@@ -310,9 +785,28 @@ NOZ_OBJC_DIRECT_MEMBERS
         return NO;
     }
 
+    if (![self private_appendNewEntry]) {
+        errorEncountered = YES;
+        return NO;
+    }
+
+    if (![self private_populateRecordsForCurrentOpenEntryWithEntry:entry error:error]) {
+        _internal.currentEntry = NULL;
+        return NO;
+    }
+
+    if (![self private_writeLocalFileHeaderForCurrentEntryAndReturnError:error]) {
+        _internal.currentEntry = NULL;
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)private_appendNewEntry
+{
     NOZFileEntryT *newEntry = NOZFileEntryAllocInit();
     if (!newEntry) {
-        errorEncountered = YES;
         return NO;
     }
 
@@ -323,14 +817,13 @@ NOZ_OBJC_DIRECT_MEMBERS
         _internal.firstEntry = _internal.lastEntry = newEntry;
     }
     _internal.currentEntry = newEntry;
+    return YES;
+}
 
-    if (![self private_populateRecordsForCurrentOpenEntryWithEntry:entry error:error]) {
-        _internal.currentEntry = NULL;
-        return NO;
-    }
-
-    if (![self private_writeLocalFileHeaderForCurrentEntryAndReturnError:error]) {
-        _internal.currentEntry = NULL;
+- (BOOL)private_openEntry:(id<NOZZippableEntry>)entry
+                    error:(out NSError * __autoreleasing *)error
+{
+    if (![self private_openEntryRecord:entry error:error]) {
         return NO;
     }
 
@@ -432,9 +925,9 @@ NOZ_OBJC_DIRECT_MEMBERS
             }
 
             if (bytesRead != 0) {
-                _internal.currentEntry->fileDescriptor.uncompressedSize += (SInt64)bytesRead;
+                _internal.currentEntry->fileDescriptor.uncompressedSize += (UInt64)bytesRead;
                 if (progressBlock) {
-                    progressBlock(totalBytes, _internal.currentEntry->fileDescriptor.uncompressedSize, bytesRead, abort);
+                    progressBlock(totalBytes, (SInt64)_internal.currentEntry->fileDescriptor.uncompressedSize, bytesRead, abort);
                 }
             }
 
@@ -444,6 +937,111 @@ NOZ_OBJC_DIRECT_MEMBERS
     return success;
 }
 
+- (NSError *)private_encodeEntry:(NOZEncodedZipEntry *)encodedEntry
+                      shouldStop:(atomic_bool *)shouldStop
+                  didEncodeBytes:(void (^)(SInt64 bytesThisPass))didEncodeBytes
+{
+    // Runs concurrently with other entries, so only the encodedEntry is touched (never the state of the archive)
+
+    id<NOZZippableEntry> entry = encodedEntry.entry;
+    id<NOZEncoder> encoder = [[NOZCompressionLibrary sharedInstance] encoderForMethod:entry.compressionMethod];
+    NOZSpillBuffer *buffer = encodedEntry.buffer;
+    id<NOZEncoderContext> context = [encoder createContextWithBitFlags:[self private_bitFlagsForEntry:entry]
+                                                      compressionLevel:entry.compressionLevel
+                                                         flushCallback:^BOOL(id<NOZEncoder> flushEncoder,
+                                                                             id<NOZEncoderContext> flushContext,
+                                                                             const Byte* bytes,
+                                                                             size_t length) {
+        return [buffer appendBytes:bytes length:length];
+    }];
+    if (!encoder || !context) {
+        return NOZErrorCreate(NOZErrorCodeZipDoesNotSupportCompressionMethod, @{ @"method" : @(entry.compressionMethod) });
+    }
+
+    NSInputStream *inputStream = entry.inputStream;
+    if (!inputStream) {
+        return NOZErrorCreate(NOZErrorCodeZipFailedToWriteEntry, nil);
+    }
+
+    if (![encoder initializeEncoderContext:context]) {
+        return NOZErrorCreate(NOZErrorCodeZipFailedToCompressEntry, nil);
+    }
+
+    [inputStream open];
+    noz_defer(^{ [inputStream close]; });
+    NSInteger bytesRead;
+    const size_t pageSize = NOZBufferSize();
+    Byte readBuffer[pageSize];
+    UInt32 crc = 0;
+    UInt64 uncompressedSize = 0;
+
+    // Same reads as private_writeEntry:progressBlock:error:abortRef: for the encoder to produce identical output
+    do {
+        bytesRead = [inputStream read:readBuffer maxLength:pageSize];
+
+        if (bytesRead < 0) {
+            return NOZErrorCreate(NOZErrorCodeZipFailedToWriteEntry, nil);
+        }
+
+        if (bytesRead == 0) {
+            break;
+        }
+
+        crc = (UInt32)crc32(crc, readBuffer, (UInt32)bytesRead);
+
+        if (![encoder encodeBytes:readBuffer length:(size_t)bytesRead context:context]) {
+            return NOZErrorCreate(NOZErrorCodeZipFailedToCompressEntry, nil);
+        }
+
+        uncompressedSize += (UInt64)bytesRead;
+        didEncodeBytes(bytesRead);
+
+    } while ((size_t)bytesRead == pageSize && !atomic_load(shouldStop));
+
+    if (atomic_load(shouldStop)) {
+        return [NSError errorWithDomain:NSPOSIXErrorDomain
+                                   code:ECANCELED
+                               userInfo:nil];
+    }
+
+    if (![encoder finalizeEncoderContext:context]) {
+        return NOZErrorCreate(NOZErrorCodeZipFailedToCloseCurrentEntry, nil);
+    }
+
+    encodedEntry.crc32 = crc;
+    encodedEntry.uncompressedSize = uncompressedSize;
+    encodedEntry.encodedDataWasText = context.encodedDataWasText;
+    return nil;
+}
+
+- (BOOL)private_writeEncodedEntry:(NOZEncodedZipEntry *)encodedEntry
+                            error:(out NSError * __autoreleasing *)error
+{
+    if (![self private_openEntryRecord:encodedEntry.entry error:error]) {
+        return NO;
+    }
+
+    NOZFileEntryT *fileEntry = _internal.currentEntry;
+    const BOOL writeSuccess = [encodedEntry.buffer enumerateBytesUsingBlock:^BOOL(const Byte *bytes, size_t length) {
+        return [self private_flushWriteBuffer:bytes length:length];
+    }];
+
+    fileEntry->fileDescriptor.crc32 = encodedEntry.crc32;
+    fileEntry->fileDescriptor.uncompressedSize = encodedEntry.uncompressedSize;
+    if (encodedEntry.encodedDataWasText) {
+        fileEntry->centralDirectoryRecord.internalFileAttributes |= (1 << 0) /* text */;
+    }
+
+    if (![self private_closeCurrentOpenEntryAndReturnError:(writeSuccess) ? error : NULL] || !writeSuccess) {
+        if (!writeSuccess && error) {
+            *error = NOZErrorCreate(NOZErrorCodeZipFailedToWriteEntry, nil);
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
 - (BOOL)private_closeCurrentOpenEntryAndReturnError:(out NSError **)error
 {
     if (!_internal.currentEntry) {
@@ -452,14 +1050,24 @@ NOZ_OBJC_DIRECT_MEMBERS
 
     BOOL success = YES;
 
-    if (success) {
+    // entries that were encoded ahead of time (see addEntries:maxConcurrentEntries:progressBlock:error:) have no encoder
+    if (success && _currentEncoder) {
         success = [self private_finishEncoding];
     }
 
-#if NOZ_SINGLE_PASS_ZIP
-    if (success) {
+    NOZErrorCode errorCode = NOZErrorCodeZipFailedToCloseCurrentEntry;
+
+    // copied records keep their own flags, so whether there's a data descriptor is up to the entry
+    const BOOL hasDataDescriptor = (_internal.currentEntry->fileHeader.bitFlag & NOZFlagBitsFileMetadataInDescriptor) != 0;
+    if (success && hasDataDescriptor) {
         success = [self private_writeCurrentLocalFileDescriptor:YES];
     }
+#if !NOZ_SINGLE_PASS_ZIP
+    if (success && !hasDataDescriptor && !_internal.currentEntry->hasZip64LocalExtraField && noz_entry_sizes_need_zip64(_internal.currentEntry)) {
+        // the sizes are updated in place in the local file header, which has no room for them
+        errorCode = NOZErrorCodeZipDoesNotSupportZip64;
+        success = NO;
+    }
 #endif
 
     _internal.endOfCentralDirectoryRecord.totalRecordCount++;
@@ -467,7 +1075,7 @@ NOZ_OBJC_DIRECT_MEMBERS
     _internal.currentEntry = NULL;
 
     if (!success && error) {
-        *error = NOZErrorCreate(NOZErrorCodeZipFailedToCloseCurrentEntry, nil);
+        *error = NOZErrorCreate(errorCode, nil);
     }
     
     return success;
@@ -492,11 +1100,27 @@ NOZ_OBJC_DIRECT_MEMBERS
         success = NO;
     }
 
-    _internal.currentEntry->fileDescriptor.compressedSize += (UInt32)bytesWritten;
+    _internal.currentEntry->fileDescriptor.compressedSize += bytesWritten;
 
     return success;
 }
 
+- (UInt16)private_bitFlagsForEntry:(id<NOZZippableEntry>)entry
+{
+    UInt16 bitFlag = 0;
+#if !NOZ_CP437_STRINGS
+    bitFlag |= NOZFlagBitsUTF8EncodedStrings;
+#endif
+    id<NOZEncoder> encoder = [[NOZCompressionLibrary sharedInstance] encoderForMethod:entry.compressionMethod];
+    if (encoder) {
+        bitFlag |= [encoder bitFlagsForEntry:entry];
+    }
+#if NOZ_SINGLE_PASS_ZIP
+    bitFlag |= NOZFlagBitsFileMetadataInDescriptor;
+#endif
+    return bitFlag;
+}
+
 - (BOOL)private_populateRecordsForCurrentOpenEntryWithEntry:(id<NOZZippableEntry>)entry
                                                       error:(out NSError **)error
 {
@@ -505,10 +1129,10 @@ NOZ_OBJC_DIRECT_MEMBERS
         nameSize = 0;
     }
 
-    NSUInteger extraFieldSize = 0; // TODO: support extra field
-    if (extraFieldSize > UINT16_MAX) {
-        extraFieldSize = 0;
-    }
+    // Without a ZIP64 extra field in the local file header, single pass entries that grow
+    // beyond 4GB are still supported via a ZIP64 data descriptor and central directory record
+    const BOOL zip64 = (entry.sizeInBytes >= kNOZZip64LocalFileHeaderThreshold);
+    NSUInteger extraFieldSize = (zip64) ? kNOZZip64LocalExtraFieldSize : 0;
 
     NSUInteger commentSize = [entry.comment lengthOfBytesUsingEncoding:kENCODING];
     if (commentSize > UINT16_MAX) {
@@ -522,13 +1146,6 @@ NOZ_OBJC_DIRECT_MEMBERS
         return NO;
     }
 
-    if (entry.sizeInBytes > UINT32_MAX || (ftello(_internal.file) - _internal.beginBytePosition) > (UINT32_MAX - UINT8_MAX)) {
-        if (error) {
-            *error = NOZErrorCreate(NOZErrorCodeZipDoesNotSupportZip64, nil);
-        }
-        return NO;
-    }
-
     NOZCentralDirectoryFileRecordT *record = &_internal.currentEntry->centralDirectoryRecord;
 
     /* File Record info */
@@ -537,22 +1154,9 @@ NOZ_OBJC_DIRECT_MEMBERS
 
         /* File Header info */
         {
-            record->fileHeader->versionForExtraction = NOZVersionForExtraction;
+            record->fileHeader->versionForExtraction = (zip64) ? NOZVersionForZip64Extraction : NOZVersionForExtraction;
 
-            /* Bit Flag */
-            {
-                record->fileHeader->bitFlag = 0;
-#if !NOZ_CP437_STRINGS
-                record->fileHeader->bitFlag |= NOZFlagBitsUTF8EncodedStrings;
-#endif
-                id<NOZEncoder> encoder = [[NOZCompressionLibrary sharedInstance] encoderForMethod:entry.compressionMethod];
-                if (encoder) {
-                    record->fileHeader->bitFlag |= [encoder bitFlagsForEntry:entry];
-                }
-#if NOZ_SINGLE_PASS_ZIP
-                record->fileHeader->bitFlag |= NOZFlagBitsFileMetadataInDescriptor;
-#endif
-            }
+            record->fileHeader->bitFlag = [self private_bitFlagsForEntry:entry];
 
             record->fileHeader->compressionMethod = entry.compressionMethod;
             noz_dos_date_from_NSDate(entry.timestamp ?: [NSDate date],
@@ -575,11 +1179,8 @@ NOZ_OBJC_DIRECT_MEMBERS
         record->internalFileAttributes = 0;
         record->externalFileAttributes = 0;
 
-        SInt64 offset = ((SInt64)ftello(_internal.file) - _internal.beginBytePosition);
-        if (offset > UINT32_MAX) {
-            offset = UINT32_MAX;
-        }
-        record->localFileHeaderOffsetFromStartOfDisk = (UInt32)offset;
+        const SInt64 offset = ((SInt64)ftello(_internal.file) - _internal.beginBytePosition);
+        record->localFileHeaderOffsetFromStartOfDisk = (UInt64)offset;
     }
 
     if (nameSize > 0) {
@@ -588,59 +1189,139 @@ NOZ_OBJC_DIRECT_MEMBERS
         _internal.currentEntry->ownsName = YES;
     }
     _internal.currentEntry->extraField = NULL;
-    _internal.currentEntry->ownsName = NO;
+    _internal.currentEntry->ownsExtraField = NO;
+    if (zip64) {
+        // sizes stay zero when zipping in a single pass (the ZIP64 data descriptor has them), otherwise see private_updateLocalFileHeaderForEntry:
+        Byte *extraField = (Byte *)calloc(1, extraFieldSize);
+        extraField[0] = (Byte)(NOZExtraFieldIDZip64 & 0xff);
+        extraField[1] = (Byte)(NOZExtraFieldIDZip64 >> 8);
+        extraField[2] = (Byte)((extraFieldSize - 4) & 0xff);
+        _internal.currentEntry->extraField = extraField;
+        _internal.currentEntry->ownsExtraField = YES;
+        _internal.currentEntry->hasZip64LocalExtraField = YES;
+    }
     if (commentSize > 0) {
         _internal.currentEntry->comment = (const Byte*)malloc(commentSize);
         memcpy((void *)_internal.currentEntry->comment, [entry.comment cStringUsingEncoding:kENCODING], commentSize);
-        _internal.currentEntry->ownsName = YES;
+        _internal.currentEntry->ownsComment = YES;
     }
 
     return YES;
 }
 
-- (BOOL)private_writeLocalFileHeaderForEntry:(NOZFileEntryT *)entry signature:(BOOL)writeSig
+- (void)private_populateRecordsForCurrentOpenEntryWithCopiedEntry:(const NOZFileEntryT *)copiedEntry
 {
-    NOZLocalFileHeaderT* header = &entry->fileHeader;
-    const SInt64 oldPosition = ftello(_internal.file);
+    NOZFileEntryT *fileEntry = _internal.currentEntry;
+    const NOZCentralDirectoryFileRecordT *copiedRecord = &copiedEntry->centralDirectoryRecord;
+    NOZCentralDirectoryFileRecordT *record = &fileEntry->centralDirectoryRecord;
 
-    if (writeSig) {
-        PRIVATE_WRITE(NOZMagicNumberLocalFileHeader);
+    /* File Record info */
+    {
+        record->versionMadeBy = copiedRecord->versionMadeBy;
+
+        /* File Header info */
+        {
+            record->fileHeader->versionForExtraction = copiedEntry->fileHeader.versionForExtraction;
+            record->fileHeader->bitFlag = copiedEntry->fileHeader.bitFlag;
+            record->fileHeader->compressionMethod = copiedEntry->fileHeader.compressionMethod;
+            record->fileHeader->dosTime = copiedEntry->fileHeader.dosTime;
+            record->fileHeader->dosDate = copiedEntry->fileHeader.dosDate;
+
+            /* File Descriptor info */
+            *record->fileHeader->fileDescriptor = copiedEntry->fileDescriptor;
+
+            record->fileHeader->nameSize = copiedEntry->fileHeader.nameSize;
+            record->fileHeader->extraFieldSize = 0;
+        }
+
+        record->commentSize = copiedRecord->commentSize;
+        record->fileStartDiskNumber = 0;
+        record->internalFileAttributes = copiedRecord->internalFileAttributes;
+        record->externalFileAttributes = copiedRecord->externalFileAttributes;
+
+        const SInt64 offset = ((SInt64)ftello(_internal.file) - _internal.beginBytePosition);
+        record->localFileHeaderOffsetFromStartOfDisk = (UInt64)offset;
     }
-    PRIVATE_WRITE(header->versionForExtraction);
-    PRIVATE_WRITE(header->bitFlag);
-    PRIVATE_WRITE(header->compressionMethod);
-    PRIVATE_WRITE(header->dosTime);
-    PRIVATE_WRITE(header->dosDate);
 
-    [self private_writeLocalFileDescriptorForEntry:entry signature:NO];
+    if (record->fileHeader->nameSize > 0) {
+        fileEntry->name = (const Byte*)malloc(record->fileHeader->nameSize);
+        memcpy((void *)fileEntry->name, copiedEntry->name, record->fileHeader->nameSize);
+        fileEntry->ownsName = YES;
+    }
+    fileEntry->extraField = NULL;
+    fileEntry->ownsExtraField = NO;
+    if (noz_entry_sizes_need_zip64(fileEntry)) {
+        // the sizes are already known, so they go in the local file header (unless there's a data descriptor for them)
+        const UInt16 extraFieldSize = kNOZZip64LocalExtraFieldSize;
+        Byte *extraField = (Byte *)calloc(1, extraFieldSize);
+        extraField[0] = (Byte)(NOZExtraFieldIDZip64 & 0xff);
+        extraField[1] = (Byte)(NOZExtraFieldIDZip64 >> 8);
+        extraField[2] = (Byte)((extraFieldSize - 4) & 0xff);
+        if (!(record->fileHeader->bitFlag & NOZFlagBitsFileMetadataInDescriptor)) {
+            NOZWriteLittleEndian64(extraField + 4, fileEntry->fileDescriptor.uncompressedSize);
+            NOZWriteLittleEndian64(extraField + 12, fileEntry->fileDescriptor.compressedSize);
+        }
+        fileEntry->extraField = extraField;
+        fileEntry->ownsExtraField = YES;
+        fileEntry->hasZip64LocalExtraField = YES;
+        record->fileHeader->extraFieldSize = extraFieldSize;
+        record->fileHeader->versionForExtraction = MAX(record->fileHeader->versionForExtraction, (UInt16)NOZVersionForZip64Extraction);
+    }
+    if (record->commentSize > 0) {
+        fileEntry->comment = (const Byte*)malloc(record->commentSize);
+        memcpy((void *)fileEntry->comment, copiedEntry->comment, record->commentSize);
+        fileEntry->ownsComment = YES;
+    }
+}
 
-    PRIVATE_WRITE(header->nameSize);
-    PRIVATE_WRITE(header->extraFieldSize);
+- (size_t)private_storeLocalFileHeaderForEntry:(NOZFileEntryT *)entry
+                                     signature:(BOOL)writeSig
+                                        buffer:(Byte *)buffer
+                                     bufferEnd:(const Byte *)bufferEnd
+{
+    NOZLocalFileHeaderT* header = &entry->fileHeader;
+    Byte *cursor = buffer;
 
-    const SInt64 diff = ftello(_internal.file) - oldPosition;
-    const SInt64 expectedBytesWritten = 30;
-    return (diff == expectedBytesWritten);
+    if (writeSig) {
+        PRIVATE_STORE(NOZMagicNumberLocalFileHeader);
+    }
+    PRIVATE_STORE(header->versionForExtraction);
+    PRIVATE_STORE(header->bitFlag);
+    PRIVATE_STORE(header->compressionMethod);
+    PRIVATE_STORE(header->dosTime);
+    PRIVATE_STORE(header->dosDate);
+
+    // A local file header with a ZIP64 extra field always defers to it for its sizes,
+    // the central directory record only does so for the sizes that overflow
+    const BOOL useZip64Sentinels = writeSig && entry->hasZip64LocalExtraField;
+    PRIVATE_STORE(header->fileDescriptor->crc32);
+    PRIVATE_STORE_SIZED((useZip64Sentinels) ? NOZZip64Sentinel32 : noz_zip64_field_value(header->fileDescriptor->compressedSize, NOZZip64Sentinel32), 4);
+    PRIVATE_STORE_SIZED((useZip64Sentinels) ? NOZZip64Sentinel32 : noz_zip64_field_value(header->fileDescriptor->uncompressedSize, NOZZip64Sentinel32), 4);
+
+    PRIVATE_STORE(header->nameSize);
+    PRIVATE_STORE(header->extraFieldSize);
+
+    return (size_t)(cursor - buffer);
 }
 
 - (BOOL)private_writeLocalFileHeaderForCurrentEntryAndReturnError:(out NSError **)error
 {
-    BOOL success = YES;
     NOZFileEntryT *entry = _internal.currentEntry;
 
-    success = [self private_writeLocalFileHeaderForEntry:entry signature:YES];
+    Byte header[NOZLocalFileHeaderFixedSize];
+    const size_t headerSize = [self private_storeLocalFileHeaderForEntry:entry
+                                                               signature:YES
+                                                                  buffer:header
+                                                               bufferEnd:header + sizeof(header)];
+    BOOL success = (headerSize == sizeof(header));
 
     if (success) {
-        size_t bytesWritten = fwrite(entry->name, 1, (size_t)entry->fileHeader.nameSize, _internal.file);
-        if (bytesWritten != (size_t)entry->fileHeader.nameSize) {
-            success = NO;
-        }
-    }
-
-    if (success && entry->fileHeader.extraFieldSize > 0) {
-        const size_t bytesWritten = fwrite(entry->extraField, 1, (size_t)entry->fileHeader.extraFieldSize, _internal.file);
-        if (bytesWritten != (size_t)entry->fileHeader.extraFieldSize) {
-            success = NO;
-        }
+        const NOZWritePartT parts[] = {
+            { header, headerSize },
+            { entry->name, (size_t)entry->fileHeader.nameSize },
+            { entry->extraField, (size_t)entry->fileHeader.extraFieldSize },
+        };
+        success = noz_fwrite_parts(parts, sizeof(parts) / sizeof(parts[0]), _internal.file);
     }
 
     if (!success && error) {
@@ -670,23 +1351,63 @@ NOZ_OBJC_DIRECT_MEMBERS
 
 - (BOOL)private_writeLocalFileDescriptorForEntry:(NOZFileEntryT *)entry signature:(BOOL)writeSignature
 {
-    BOOL success = YES;
-
     NOZLocalFileDescriptorT *fileDescriptor = &entry->fileDescriptor;
-    const SInt64 oldPosition = ftello(_internal.file);
+    Byte buffer[4 + 4 + 8 + 8];
+    const Byte *bufferEnd = buffer + sizeof(buffer);
+    Byte *cursor = buffer;
+
+    // ZIP64 data descriptors have 8 byte sizes
+    const UInt8 sizeByteCount = (entry->hasZip64LocalExtraField || noz_entry_sizes_need_zip64(entry)) ? 8 : 4;
 
     if (writeSignature) {
-        PRIVATE_WRITE(NOZMagicNumberDataDescriptor);
+        PRIVATE_STORE(NOZMagicNumberDataDescriptor);
     }
-    PRIVATE_WRITE(fileDescriptor->crc32);
-    PRIVATE_WRITE(fileDescriptor->compressedSize);
-    PRIVATE_WRITE(fileDescriptor->uncompressedSize);
+    PRIVATE_STORE(fileDescriptor->crc32);
+    PRIVATE_STORE_SIZED(fileDescriptor->compressedSize, sizeByteCount);
+    PRIVATE_STORE_SIZED(fileDescriptor->uncompressedSize, sizeByteCount);
 
-    if ((ftello(_internal.file) - oldPosition) != (writeSignature ? 16 : 12)) {
-        success = NO;
+    const size_t length = (size_t)(cursor - buffer);
+    if (length != (size_t)((writeSignature ? 8 : 4) + (2 * sizeByteCount))) {
+        return NO;
     }
 
-    return success;
+    return fwrite(buffer, 1, length, _internal.file) == length;
+}
+
+- (BOOL)private_updateLocalFileHeaderForEntry:(NOZFileEntryT *)entry
+{
+    NOZLocalFileDescriptorT *fileDescriptor = &entry->fileDescriptor;
+    const SInt64 headerPosition = _internal.beginBytePosition + (SInt64)entry->centralDirectoryRecord.localFileHeaderOffsetFromStartOfDisk;
+
+    if (0 != fseeko(_internal.file, headerPosition + 14, SEEK_SET)) {
+        return NO;
+    }
+
+    Byte buffer[8 + 8];
+    const Byte *bufferEnd = buffer + sizeof(buffer);
+    Byte *cursor = buffer;
+
+    PRIVATE_STORE(fileDescriptor->crc32);
+    PRIVATE_STORE_SIZED((entry->hasZip64LocalExtraField) ? NOZZip64Sentinel32 : fileDescriptor->compressedSize, 4);
+    PRIVATE_STORE_SIZED((entry->hasZip64LocalExtraField) ? NOZZip64Sentinel32 : fileDescriptor->uncompressedSize, 4);
+    if ((cursor - buffer) != 12 || fwrite(buffer, 1, 12, _internal.file) != 12) {
+        return NO;
+    }
+
+    if (entry->hasZip64LocalExtraField) {
+        // skip the name and the extra field's id and size
+        if (0 != fseeko(_internal.file, headerPosition + 30 + entry->fileHeader.nameSize + 4, SEEK_SET)) {
+            return NO;
+        }
+        cursor = buffer;
+        PRIVATE_STORE_SIZED(fileDescriptor->uncompressedSize, 8);
+        PRIVATE_STORE_SIZED(fileDescriptor->compressedSize, 8);
+        if ((cursor - buffer) != 16 || fwrite(buffer, 1, 16, _internal.file) != 16) {
+            return NO;
+        }
+    }
+
+    return YES;
 }
 
 - (BOOL)private_writeCurrentLocalFileDescriptor:(BOOL)writeSignature
@@ -698,8 +1419,34 @@ NOZ_OBJC_DIRECT_MEMBERS
 - (BOOL)private_writeCentralDirectoryRecords
 {
     BOOL success = YES;
+    NOZFileEntryT *entry = NULL;
+
+#if !NOZ_SINGLE_PASS_ZIP
+    // Update all the local file headers before returning to the end of the archive just once,
+    // every seek flushes the write buffer
+    entry = _internal.firstEntry;
+    while (entry != NULL && success) {
+        success = [self private_updateLocalFileHeaderForEntry:entry];
+        entry = entry->nextEntry;
+    }
+    if (success && 0 != fseeko(_internal.file, 0, SEEK_END)) {
+        success = NO;
+    }
+#endif
+
+    const SInt64 position = ftello(_internal.file);
+    if (position < 0) {
+        return NO;
+    }
+    _internal.endOfCentralDirectoryRecord.archiveStartToCentralDirectoryStartOffset = (UInt64)(position - _internal.beginBytePosition);
+
+    // the records of the archive being appended to come first, unchanged
+    if (success && _internal.existingCentralDirectoryLength > 0) {
+        success = fwrite(_internal.existingTail, 1, _internal.existingCentralDirectoryLength, _internal.file) == _internal.existingCentralDirectoryLength;
+        _internal.endOfCentralDirectoryRecord.centralDirectorySize += _internal.existingCentralDirectoryLength;
+    }
 
-    NOZFileEntryT *entry = _internal.firstEntry;
+    entry = _internal.firstEntry;
     while (entry != NULL && success) {
 
         success = [self private_writeCentralDirectoryRecord:entry];
@@ -712,80 +1459,146 @@ NOZ_OBJC_DIRECT_MEMBERS
 
 - (BOOL)private_writeCentralDirectoryRecord:(NOZFileEntryT *)entry
 {
-    if (0 == _internal.endOfCentralDirectoryRecord.archiveStartToCentralDirectoryStartOffset) {
-        _internal.endOfCentralDirectoryRecord.archiveStartToCentralDirectoryStartOffset = (UInt32)(ftello(_internal.file) - _internal.beginBytePosition);
+    NOZCentralDirectoryFileRecordT *record = &entry->centralDirectoryRecord;
+
+    /* ZIP64 extended information extra field, replaces the local file header's extra field */
+    Byte zip64ExtraField[4 + 8 + 8 + 8];
+    const UInt16 zip64ExtraFieldSize = noz_store_zip64_extra_field(record, zip64ExtraField, sizeof(zip64ExtraField));
+    record->fileHeader->extraFieldSize = zip64ExtraFieldSize;
+    if (zip64ExtraFieldSize > 0 || entry->hasZip64LocalExtraField) {
+        record->versionMadeBy = NOZVersionForZip64Extraction;
+        record->fileHeader->versionForExtraction = NOZVersionForZip64Extraction;
     }
 
-    const SInt64 oldPosition = ftello(_internal.file);
-    SInt64 expectedBytesWritten = 46;
-    NOZCentralDirectoryFileRecordT *record = &entry->centralDirectoryRecord;
+    Byte buffer[NOZCentralDirectoryFileRecordFixedSize];
+    const Byte *bufferEnd = buffer + sizeof(buffer);
+    Byte *cursor = buffer;
 
     /* File Record info */
     {
-        PRIVATE_WRITE(NOZMagicNumberCentralDirectoryFileRecord);
-        PRIVATE_WRITE(record->versionMadeBy);
-
-        [self private_writeLocalFileHeaderForEntry:entry signature:NO];
-
-        PRIVATE_WRITE(record->commentSize);
-        PRIVATE_WRITE(record->fileStartDiskNumber);
-        PRIVATE_WRITE(record->internalFileAttributes);
-        PRIVATE_WRITE(record->externalFileAttributes);
-        PRIVATE_WRITE(record->localFileHeaderOffsetFromStartOfDisk);
+        PRIVATE_STORE(NOZMagicNumberCentralDirectoryFileRecord);
+        PRIVATE_STORE(record->versionMadeBy);
+
+        cursor += [self private_storeLocalFileHeaderForEntry:entry
+                                                   signature:NO
+                                                      buffer:cursor
+                                                   bufferEnd:bufferEnd];
+
+        PRIVATE_STORE(record->commentSize);
+        PRIVATE_STORE(record->fileStartDiskNumber);
+        PRIVATE_STORE(record->internalFileAttributes);
+        PRIVATE_STORE(record->externalFileAttributes);
+        PRIVATE_STORE_SIZED(noz_zip64_field_value(record->localFileHeaderOffsetFromStartOfDisk, NOZZip64Sentinel32), 4);
     }
 
-    if (entry->name) {
-        expectedBytesWritten += record->fileHeader->nameSize;
-        fwrite(entry->name, 1, (size_t)record->fileHeader->nameSize, _internal.file);
+    if ((size_t)(cursor - buffer) != sizeof(buffer)) {
+        return NO;
     }
 
-    if (entry->extraField) {
-        expectedBytesWritten += record->fileHeader->extraFieldSize;
-        fwrite(entry->extraField, 1, (size_t)record->fileHeader->extraFieldSize, _internal.file);
+    const NOZWritePartT parts[] = {
+        { buffer, sizeof(buffer) },
+        { entry->name, (entry->name) ? (size_t)record->fileHeader->nameSize : 0 },
+        { zip64ExtraField, (size_t)zip64ExtraFieldSize },
+        { entry->comment, (entry->comment) ? (size_t)record->commentSize : 0 },
+    };
+    const size_t partCount = sizeof(parts) / sizeof(parts[0]);
+    for (size_t i = 0; i < partCount; i++) {
+        _internal.endOfCentralDirectoryRecord.centralDirectorySize += parts[i].length;
     }
 
-    if (entry->comment) {
-        expectedBytesWritten += record->commentSize;
-        fwrite(entry->comment, 1, (size_t)record->commentSize, _internal.file);
-    }
+    return noz_fwrite_parts(parts, partCount, _internal.file);
+}
 
-    const SInt64 bytesWritten = (ftello(_internal.file) - oldPosition);
-    _internal.endOfCentralDirectoryRecord.centralDirectorySize += bytesWritten;
-    if (bytesWritten != expectedBytesWritten) {
+- (BOOL)private_writeZip64EndOfCentralDirectoryRecordAndLocator
+{
+    const NOZEndOfCentralDirectoryRecordT *eocd = &_internal.endOfCentralDirectoryRecord;
+    const SInt64 position = ftello(_internal.file);
+    if (position < 0) {
         return NO;
     }
-
-#if !NOZ_SINGLE_PASS_ZIP
-    if (0 == fseeko(_internal.file, _internal.beginBytePosition + record->localFileHeaderOffsetFromStartOfDisk + 14, SEEK_SET)) {
-        [self private_writeLocalFileDescriptorForEntry:entry signature:NO];
+    const UInt64 recordOffset = (UInt64)(position - _internal.beginBytePosition);
+
+    Byte buffer[NOZZip64EndOfCentralDirectoryRecordFixedSize + NOZZip64EndOfCentralDirectoryLocatorFixedSize];
+    const Byte *bufferEnd = buffer + sizeof(buffer);
+    Byte *cursor = buffer;
+
+    PRIVATE_STORE(NOZMagicNumberZip64EndOfCentralDirectoryRecord);
+    PRIVATE_STORE_SIZED(NOZZip64EndOfCentralDirectoryRecordFixedSize - 12, 8); // excludes the leading 12 bytes
+    PRIVATE_STORE_SIZED(NOZVersionForZip64Extraction, 2); // version made by
+    PRIVATE_STORE_SIZED(NOZVersionForZip64Extraction, 2);
+    PRIVATE_STORE(eocd->diskNumber);
+    PRIVATE_STORE(eocd->startDiskNumber);
+    PRIVATE_STORE(eocd->recordCountForDisk);
+    PRIVATE_STORE(eocd->totalRecordCount);
+    PRIVATE_STORE(eocd->centralDirectorySize);
+    PRIVATE_STORE(eocd->archiveStartToCentralDirectoryStartOffset);
+
+    PRIVATE_STORE(NOZMagicNumberZip64EndOfCentralDirectoryLocator);
+    PRIVATE_STORE_SIZED(eocd->diskNumber, 4);
+    PRIVATE_STORE_SIZED(recordOffset, 8);
+    PRIVATE_STORE_SIZED(1, 4); // total number of disks
+
+    if ((size_t)(cursor - buffer) != sizeof(buffer)) {
+        return NO;
     }
-    fseeko(_internal.file, 0, SEEK_END);
-#endif
 
-    return YES;
+    return fwrite(buffer, 1, sizeof(buffer), _internal.file) == sizeof(buffer);
 }
 
 - (BOOL)private_writeEndOfCentralDirectoryRecord
 {
-    const SInt64 oldPosition = ftello(_internal.file);
-    SInt64 expectedBytesWritten = 22;
+    const NOZEndOfCentralDirectoryRecordT *eocd = &_internal.endOfCentralDirectoryRecord;
+    const BOOL zip64 = eocd->totalRecordCount >= NOZZip64Sentinel16 ||
+                       eocd->centralDirectorySize >= NOZZip64Sentinel32 ||
+                       eocd->archiveStartToCentralDirectoryStartOffset >= NOZZip64Sentinel32;
+    if (zip64 && ![self private_writeZip64EndOfCentralDirectoryRecordAndLocator]) {
+        return NO;
+    }
 
-    PRIVATE_WRITE(NOZMagicNumberEndOfCentralDirectoryRecord);
-    PRIVATE_WRITE(_internal.endOfCentralDirectoryRecord.diskNumber);
-    PRIVATE_WRITE(_internal.endOfCentralDirectoryRecord.startDiskNumber);
-    PRIVATE_WRITE(_internal.endOfCentralDirectoryRecord.recordCountForDisk);
-    PRIVATE_WRITE(_internal.endOfCentralDirectoryRecord.totalRecordCount);
-    PRIVATE_WRITE(_internal.endOfCentralDirectoryRecord.centralDirectorySize);
-    PRIVATE_WRITE(_internal.endOfCentralDirectoryRecord.archiveStartToCentralDirectoryStartOffset);
-    PRIVATE_WRITE(_internal.endOfCentralDirectoryRecord.commentSize);
+    Byte buffer[NOZEndOfCentralDirectoryRecordFixedSize];
+    const Byte *bufferEnd = buffer + sizeof(buffer);
+    Byte *cursor = buffer;
 
-    if (_internal.comment) {
-        expectedBytesWritten += _internal.endOfCentralDirectoryRecord.commentSize;
-        fwrite(_internal.comment, 1, (size_t)_internal.endOfCentralDirectoryRecord.commentSize, _internal.file);
+    PRIVATE_STORE(NOZMagicNumberEndOfCentralDirectoryRecord);
+    PRIVATE_STORE_SIZED(noz_zip64_field_value(eocd->diskNumber, NOZZip64Sentinel16), 2);
+    PRIVATE_STORE_SIZED(noz_zip64_field_value(eocd->startDiskNumber, NOZZip64Sentinel16), 2);
+    PRIVATE_STORE_SIZED(noz_zip64_field_value(eocd->recordCountForDisk, NOZZip64Sentinel16), 2);
+    PRIVATE_STORE_SIZED(noz_zip64_field_value(eocd->totalRecordCount, NOZZip64Sentinel16), 2);
+    PRIVATE_STORE_SIZED(noz_zip64_field_value(eocd->centralDirectorySize, NOZZip64Sentinel32), 4);
+    PRIVATE_STORE_SIZED(noz_zip64_field_value(eocd->archiveStartToCentralDirectoryStartOffset, NOZZip64Sentinel32), 4);
+    PRIVATE_STORE(eocd->commentSize);
+
+    if ((size_t)(cursor - buffer) != sizeof(buffer)) {
+        return NO;
     }
 
-    const SInt64 bytesWritten = ftello(_internal.file) - oldPosition;
-    return bytesWritten == expectedBytesWritten;
+    const NOZWritePartT parts[] = {
+        { buffer, sizeof(buffer) },
+        { _internal.comment, (_internal.comment) ? (size_t)eocd->commentSize : 0 },
+    };
+    return noz_fwrite_parts(parts, sizeof(parts) / sizeof(parts[0]), _internal.file);
+}
+
+@end
+
+NOZ_OBJC_DIRECT_MEMBERS
+@implementation NOZEncodedZipEntry
+
+- (instancetype)init
+{
+    [self doesNotRecognizeSelector:_cmd];
+    abort();
+}
+
+- (instancetype)initWithEntry:(id<NOZZippableEntry>)entry
+{
+    if (self = [super init]) {
+        _entry = entry;
+        _buffer = [[NOZSpillBuffer alloc] initWithMemoryLimit:kNOZEncodedEntryMemoryLimit
+                                       temporaryDirectoryPath:NSTemporaryDirectory()];
+        _finishedSemaphore = dispatch_semaphore_create(0);
+    }
+    return self;
 }
 
 @end
@@ -812,18 +1625,57 @@ static UInt8 noz_store_value(UInt64 x, const UInt8 byteCount, Byte *buffer, cons
     return byteCount;
 }
 
-static UInt8 noz_fwrite_value(UInt64 x, const UInt8 byteCount, FILE *file)
+static BOOL noz_fwrite_parts(const NOZWritePartT *parts, size_t partCount, FILE *file)
 {
-    Byte buffer[8];
+    size_t totalLength = 0;
+    for (size_t i = 0; i < partCount; i++) {
+        totalLength += parts[i].length;
+    }
+
+    if (totalLength <= kNOZRecordStackBufferSize) {
+        Byte buffer[kNOZRecordStackBufferSize];
+        Byte *cursor = buffer;
+        for (size_t i = 0; i < partCount; i++) {
+            if (parts[i].length > 0) {
+                memcpy(cursor, parts[i].bytes, parts[i].length);
+                cursor += parts[i].length;
+            }
+        }
+        return fwrite(buffer, 1, totalLength, file) == totalLength;
+    }
 
-    UInt8 bytesWritten = noz_store_value(x, byteCount, buffer, buffer + 8);
-    if (bytesWritten != byteCount) {
+    // Long names and comments, the parts still coalesce in the write buffer
+    for (size_t i = 0; i < partCount; i++) {
+        if (parts[i].length > 0 && fwrite(parts[i].bytes, 1, parts[i].length, file) != parts[i].length) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+static UInt16 noz_store_zip64_extra_field(const NOZCentralDirectoryFileRecordT *record, Byte *buffer, size_t bufferSize)
+{
+    const NOZLocalFileDescriptorT *fileDescriptor = record->fileHeader->fileDescriptor;
+    Byte *bufferEnd = buffer + bufferSize;
+    Byte *field = buffer + 4;
+
+    // Only the values that overflow their record field are stored, and always in this order
+    if (fileDescriptor->uncompressedSize >= NOZZip64Sentinel32) {
+        field += noz_store_value(fileDescriptor->uncompressedSize, 8, field, bufferEnd);
+    }
+    if (fileDescriptor->compressedSize >= NOZZip64Sentinel32) {
+        field += noz_store_value(fileDescriptor->compressedSize, 8, field, bufferEnd);
+    }
+    if (record->localFileHeaderOffsetFromStartOfDisk >= NOZZip64Sentinel32) {
+        field += noz_store_value(record->localFileHeaderOffsetFromStartOfDisk, 8, field, bufferEnd);
+    }
+
+    const size_t dataSize = (size_t)(field - buffer) - 4;
+    if (0 == dataSize) {
         return 0;
     }
 
-    bytesWritten = (UInt8)fwrite((const char *)buffer, 1, (size_t)byteCount, file);
-#if DEBUG
-    fflush(file);
-#endif
-    return bytesWritten;
+    noz_store_value(NOZExtraFieldIDZip64, 2, buffer, bufferEnd);
+    noz_store_value(dataSize, 2, buffer + 2, bufferEnd);
+    return (UInt16)(dataSize + 4);
 }
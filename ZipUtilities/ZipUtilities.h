@@ -25,6 +25,7 @@
 //  SOFTWARE.
 //
 
+#import <ZipUtilities/NOZArchiveFileSystem.h>
 #import <ZipUtilities/NOZCompress.h>
 #import <ZipUtilities/NOZCompression.h>
 #import <ZipUtilities/NOZCompressionLibrary.h>
@@ -32,6 +33,8 @@
 #import <ZipUtilities/NOZDecompress.h>
 #import <ZipUtilities/NOZEncoder.h>
 #import <ZipUtilities/NOZError.h>
+#import <ZipUtilities/NOZRandomAccessSource.h>
+#import <ZipUtilities/NOZStreamUnzipper.h>
 #import <ZipUtilities/NOZSyncStepOperation.h>
 #import <ZipUtilities/NOZUnzipper.h>
 #import <ZipUtilities/NOZUtils.h>
@@ -403,6 +403,40 @@
     [library setEncoder:originalEncoder forMethod:NOZCompressionMethodDeflate];
 }
 
+- (void)testDeflate_ConcurrentBlocksDefault
+{
+    NOZCompressionLibrary *library = [NOZCompressionLibrary sharedInstance];
+
+    id<NOZEncoder> originalEncoder = [library encoderForMethod:NOZCompressionMethodDeflate];
+    id<NOZDecoder> originalDecoder = [library decoderForMethod:NOZCompressionMethodDeflate];
+    id<NOZEncoder> blocksEncoder = NOZDeflateEncoderWithConcurrentBlocks(64 * 1024, 4);
+
+    // Concurrent Blocks Encoder / Original Decoder
+
+    [library setEncoder:blocksEncoder forMethod:NOZCompressionMethodDeflate];
+
+    [self runCodingWithMethod:NOZCompressionMethodDeflate];
+    [self runCategoryCodingTest:NOZCompressionMethodDeflate];
+
+    // Reset encoder
+
+    [library setEncoder:originalEncoder forMethod:NOZCompressionMethodDeflate];
+
+    // Many more blocks than can be compressed at once
+
+    NSString *sourceFile = [[NSBundle bundleForClass:[self class]] pathForResource:@"Aesop" ofType:@"txt"];
+    NSData *aesopData = [NSData dataWithContentsOfFile:sourceFile];
+    NSMutableData *sourceData = [NSMutableData data];
+    for (NSUInteger i = 0; i < 16; i++) {
+        [sourceData appendData:aesopData];
+    }
+
+    NSData *compressedData = [sourceData noz_dataByCompressing:blocksEncoder compressionLevel:NOZCompressionLevelDefault];
+    XCTAssertNotNil(compressedData);
+    XCTAssertLessThan(compressedData.length, sourceData.length);
+    XCTAssertEqualObjects(sourceData, [compressedData noz_dataByDecompressing:originalDecoder]);
+}
+
 - (void)testLZMACoding
 {
     [self runCodingWithMethod:NOZCompressionMethodLZMA];
@@ -463,6 +497,34 @@
     [self runCategoryCodingTest:NOZCompressionMethodZStandard_DBOOK];
 }
 
+- (void)testZSTD_Workers
+{
+    // Large enough that zstd splits the input into several jobs for its workers (even at the fastest level, with the smallest jobs)
+
+    NSString *sourceFile = [[NSBundle bundleForClass:[self class]] pathForResource:@"Aesop" ofType:@"txt"];
+    NSData *aesopData = [NSData dataWithContentsOfFile:sourceFile];
+    NSMutableData *sourceData = [NSMutableData data];
+    for (NSUInteger i = 0; sourceData.length < 12 * 1024 * 1024; i++) {
+        [sourceData appendData:[[NSString stringWithFormat:@"%tu\n", i * 104723] dataUsingEncoding:NSUTF8StringEncoding]];
+        [sourceData appendData:aesopData];
+    }
+
+    NSString *dbookFile = [[NSBundle bundleForClass:[self class]] pathForResource:@"book" ofType:@"zstd_dict"];
+    NSData *dbookData = [NSData dataWithContentsOfFile:dbookFile];
+
+    for (NSData *dictionaryData in @[ [NSNull null], dbookData ]) {
+        NSData *dict = [dictionaryData isKindOfClass:[NSData class]] ? dictionaryData : nil;
+        id<NOZEncoder> encoder = [NOZXZStandardCompressionCoder encoderWithDictionaryData:dict workerCount:4];
+        id<NOZDecoder> decoder = [NOZXZStandardCompressionCoder decoderWithDictionaryData:dict];
+        for (NSNumber *level in @[ @(NOZCompressionLevelMin), @(NOZCompressionLevelDefault) ]) {
+            NSData *compressedData = [sourceData noz_dataByCompressing:encoder compressionLevel:level.floatValue];
+            XCTAssertNotNil(compressedData);
+            XCTAssertLessThan(compressedData.length, sourceData.length);
+            XCTAssertEqualObjects(sourceData, [compressedData noz_dataByDecompressing:decoder]);
+        }
+    }
+}
+
 - (void)testBrotli
 {
     [self runCodingWithMethod:NOZCompressionMethodBrotli];
@@ -30,6 +30,9 @@
 @import Foundation;
 @import XCTest;
 
+#include <signal.h>
+#include <sys/resource.h>
+
 //#define TESTLOG(...) NSLog(__VA_ARGS__)
 #define TESTLOG(...) ((void)0)
 
@@ -324,6 +327,316 @@ static NSOperationQueue *sQueue = nil;
     [self runInvalidRequest:request];
 }
 
+- (void)testZipperZip64RecordCount
+{
+    // More records than the end of central directory record can count requires ZIP64
+
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Zip64.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+
+    NSData *data = [@"zip64" dataUsingEncoding:NSUTF8StringEncoding];
+    const NSUInteger entryCount = UINT16_MAX + 2;
+    for (NSUInteger i = 0; i < entryCount; i++) {
+        NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:data name:[NSString stringWithFormat:@"%tu.txt", i]];
+        entry.compressionMethod = NOZCompressionMethodNone;
+        if (![zipper addEntry:entry progressBlock:NULL error:&error]) {
+            XCTFail(@"%@", error);
+            break;
+        }
+    }
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    NOZCentralDirectory *cd = [unzipper readCentralDirectoryAndReturnError:&error];
+    XCTAssertNotNil(cd, @"%@", error);
+    XCTAssertEqual(entryCount, cd.recordCount);
+    XCTAssertEqual((SInt64)(data.length * entryCount), cd.totalUncompressedSize);
+
+    NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:[unzipper indexForRecordWithName:@"65536.txt"] error:&error];
+    XCTAssertNotNil(record, @"%@", error);
+    XCTAssertEqualObjects(data, [unzipper readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testZipperRecordsWithLongNamesAndComments
+{
+    // Records are written in one piece when they are small and part by part when they are not
+
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"LongRecords.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSString *longName = [[@"" stringByPaddingToLength:600 withString:@"long/" startingAtIndex:0] stringByAppendingString:@"name.txt"];
+    NSString *longComment = [@"" stringByPaddingToLength:1000 withString:@"comment " startingAtIndex:0];
+    NSArray<NSString *> *names = @[ @"short.txt", longName, @"deflated.txt" ];
+    NSArray<NSString *> *comments = @[ @"short", longComment, @"deflated" ];
+    NSData *data = [[@"" stringByPaddingToLength:4096 withString:@"records " startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    zipper.globalComment = longComment;
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    for (NSUInteger i = 0; i < names.count; i++) {
+        NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:data name:names[i]];
+        entry.comment = comments[i];
+        entry.compressionMethod = (i == names.count - 1) ? NOZCompressionMethodDeflate : NOZCompressionMethodNone;
+        XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    }
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    NOZCentralDirectory *cd = [unzipper readCentralDirectoryAndReturnError:&error];
+    XCTAssertNotNil(cd, @"%@", error);
+    XCTAssertEqualObjects(longComment, cd.globalComment);
+    XCTAssertEqual(names.count, cd.recordCount);
+    for (NSUInteger i = 0; i < names.count; i++) {
+        NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:i error:&error];
+        XCTAssertNotNil(record, @"%@", error);
+        XCTAssertEqualObjects(names[i], record.name);
+        XCTAssertEqualObjects(comments[i], record.comment);
+        XCTAssertEqualObjects(data, [unzipper readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+    }
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testCompressionConcurrentEntries
+{
+    // Compressing entries concurrently must produce the same archive as compressing them serially
+
+    NSString *sourceFilePath = [[NSBundle bundleForClass:[self class]] pathForResource:@"Aesop" ofType:@"txt"];
+    NSString *sourceDirectoryPath = [[sourceFilePath stringByDeletingLastPathComponent] stringByAppendingPathComponent:@"maniac-mansion"];
+
+    // Large enough to be buffered in a temporary file while waiting for its turn
+    NSString *largeFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Concurrent.bin"];
+    NSMutableData *largeData = [NSMutableData dataWithLength:6 * 1024 * 1024];
+    UInt32 value = 1;
+    for (NSUInteger i = 0; i < largeData.length; i += 4) {
+        value = value * 1664525 + 1013904223;
+        memcpy((Byte *)largeData.mutableBytes + i, &value, 4);
+    }
+    XCTAssertTrue([largeData writeToFile:largeFilePath atomically:NO]);
+
+    NSArray<NSNumber *> *concurrencies = @[ @1, @4, @0 ];
+    NSMutableArray<NSData *> *archives = [NSMutableArray array];
+    for (NSNumber *concurrency in concurrencies) {
+        NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"Concurrent%@.zip", concurrency]];
+        [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+        NOZCompressRequest *request = [[NOZCompressRequest alloc] initWithDestinationPath:zipFilePath];
+        [request addEntriesInDirectory:sourceDirectoryPath filterBlock:^BOOL(NSString *filePath) {
+            return [filePath.lastPathComponent hasPrefix:@"."];
+        } compressionSelectionBlock:NULL];
+        NOZFileZipEntry *largeEntry = [[NOZFileZipEntry alloc] initWithFilePath:largeFilePath];
+        largeEntry.compressionMethod = NOZCompressionMethodNone;
+        [request addEntry:largeEntry];
+        [request addFileEntry:sourceFilePath];
+        request.maxConcurrentZipCount = concurrency.unsignedIntegerValue;
+
+        [self runValidCompressRequest:request withQueue:nil];
+        NSData *archive = [NSData dataWithContentsOfFile:zipFilePath];
+        XCTAssertNotNil(archive);
+        if (archive) {
+            [archives addObject:archive];
+        }
+        [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+    }
+
+    XCTAssertEqual(concurrencies.count, archives.count);
+    for (NSData *archive in archives) {
+        XCTAssertEqualObjects(archives.firstObject, archive);
+    }
+
+    [[NSFileManager defaultManager] removeItemAtPath:largeFilePath error:NULL];
+}
+
+- (void)testZipperAppendToExistingArchive
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Append.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSData *data = [[@"" stringByPaddingToLength:4096 withString:@"append " startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+    NSArray<NSString *> *names = @[ @"first.txt", @"second.txt", @"appended.txt" ];
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertFalse([zipper openWithMode:NOZZipperModeOpenExisting error:&error]);
+    XCTAssertEqual(error.code, NOZErrorCodeZipCannotOpenExistingZip);
+    error = nil;
+
+    // Create, append an entry, then append nothing (only rewriting the central directory)
+
+    for (NSUInteger pass = 0; pass < 3; pass++) {
+        zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+        XCTAssertTrue([zipper openWithMode:(pass == 0) ? NOZZipperModeOpenExistingOrCreate : NOZZipperModeOpenExisting error:&error], @"%@", error);
+        if (pass == 0) {
+            zipper.globalComment = @"original";
+        } else {
+            XCTAssertEqualObjects(zipper.globalComment, (pass == 1) ? @"original" : @"appended");
+            zipper.globalComment = @"appended";
+        }
+        const NSRange range = (pass == 0) ? NSMakeRange(0, 2) : NSMakeRange(2, (pass == 1) ? 1 : 0);
+        for (NSString *name in [names subarrayWithRange:range]) {
+            NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:data name:name];
+            entry.compressionMethod = (pass == 0) ? NOZCompressionMethodDeflate : NOZCompressionMethodNone;
+            XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+        }
+        XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+    }
+
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    NOZCentralDirectory *cd = [unzipper readCentralDirectoryAndReturnError:&error];
+    XCTAssertNotNil(cd, @"%@", error);
+    XCTAssertEqualObjects(@"appended", cd.globalComment);
+    XCTAssertEqual((NSUInteger)3, cd.recordCount);
+    for (NSUInteger i = 0; i < cd.recordCount; i++) {
+        NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:i error:&error];
+        XCTAssertEqualObjects(names[i], record.name);
+        XCTAssertEqualObjects(data, [unzipper readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+    }
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+
+    // Not an archive, left as it was
+
+    NSData *notAnArchive = [data subdataWithRange:NSMakeRange(0, 100)];
+    XCTAssertTrue([notAnArchive writeToFile:zipFilePath atomically:NO]);
+    zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertFalse([zipper openWithMode:NOZZipperModeOpenExistingOrCreate error:&error]);
+    XCTAssertEqual(error.code, NOZErrorCodeZipCannotOpenExistingZip);
+    XCTAssertEqualObjects(notAnArchive, [NSData dataWithContentsOfFile:zipFilePath]);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testZipperAppendFailureRestoresExistingArchive
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"AppendFailure.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    zipper.globalComment = @"original";
+    NSData *data = [[@"" stringByPaddingToLength:4096 withString:@"original " startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+    XCTAssertTrue([zipper addEntry:[[NOZDataZipEntry alloc] initWithData:data name:@"original.txt"] progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+    NSData *originalArchive = [NSData dataWithContentsOfFile:zipFilePath];
+    XCTAssertNotNil(originalArchive);
+
+    // Writes past a little more than the original archive fail (EFBIG instead of SIGXFSZ), so appending can't complete
+
+    struct rlimit originalLimit;
+    XCTAssertEqual(0, getrlimit(RLIMIT_FSIZE, &originalLimit));
+    void (*originalHandler)(int) = signal(SIGXFSZ, SIG_IGN);
+    struct rlimit limit = originalLimit;
+    limit.rlim_cur = (rlim_t)originalArchive.length + 1024;
+    XCTAssertEqual(0, setrlimit(RLIMIT_FSIZE, &limit));
+
+    zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeOpenExisting error:&error], @"%@", error);
+    zipper.globalComment = @"appended";
+    NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:[NSMutableData dataWithLength:1024 * 1024] name:@"too_big.bin"];
+    entry.compressionMethod = NOZCompressionMethodNone;
+    (void)[zipper addEntry:entry progressBlock:NULL error:NULL];
+    XCTAssertFalse([zipper closeAndReturnError:&error]);
+    XCTAssertEqual(error.code, NOZErrorCodeZipFailedToWriteZip);
+
+    XCTAssertEqual(0, setrlimit(RLIMIT_FSIZE, &originalLimit));
+    signal(SIGXFSZ, originalHandler);
+
+    XCTAssertEqualObjects(originalArchive, [NSData dataWithContentsOfFile:zipFilePath]);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testZipperAddCompressedRecord
+{
+    NSString *sourceZipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"CopySource.zip"];
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"CopyDestination.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:sourceZipFilePath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSData *data = [[@"" stringByPaddingToLength:64 * 1024 withString:@"copy me " startingAtIndex:0] dataUsingEncoding:NSUTF8StringEncoding];
+    NSArray<NSString *> *names = @[ @"deflated.txt", @"stored.txt" ];
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:sourceZipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    for (NSString *name in names) {
+        NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:data name:name];
+        entry.comment = name;
+        entry.compressionMethod = (name == names.firstObject) ? NOZCompressionMethodDeflate : NOZCompressionMethodNone;
+        XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    }
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    // Copy the records (in reverse) after a freshly compressed entry
+
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:sourceZipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:&error], @"%@", error);
+
+    zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    XCTAssertTrue([zipper addEntry:[[NOZDataZipEntry alloc] initWithData:data name:@"new.txt"] progressBlock:NULL error:&error], @"%@", error);
+    __block int64_t bytesCopied = 0;
+    for (NSUInteger i = names.count; i > 0; i--) {
+        NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:i - 1 error:&error];
+        XCTAssertNotNil(record, @"%@", error);
+        XCTAssertTrue([zipper addCompressedRecord:record
+                                     fromUnzipper:unzipper
+                                    progressBlock:^(int64_t totalBytes, int64_t bytesComplete, int64_t bytesCompletedThisPass, BOOL *abort) {
+            bytesCopied += bytesCompletedThisPass;
+        }
+                                            error:&error], @"%@", error);
+    }
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+    XCTAssertGreaterThan(bytesCopied, (int64_t)data.length);
+
+    // A record from another central directory is not copied
+
+    NOZUnzipper *otherUnzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([otherUnzipper openAndReturnError:&error], @"%@", error);
+    XCTAssertNotNil([otherUnzipper readCentralDirectoryAndReturnError:&error], @"%@", error);
+    zipper = [[NOZZipper alloc] initWithZipFile:sourceZipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeOpenExisting error:&error], @"%@", error);
+    XCTAssertFalse([zipper addCompressedRecord:[otherUnzipper readRecordAtIndex:0 error:NULL] fromUnzipper:unzipper progressBlock:NULL error:&error]);
+    XCTAssertEqual(error.code, NOZErrorCodeZipCannotOpenNewEntry);
+    error = nil;
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+    XCTAssertTrue([otherUnzipper closeAndReturnError:NULL]);
+
+    NSArray<NSString *> *expectedNames = @[ @"new.txt", names[1], names[0] ];
+    unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    NOZCentralDirectory *cd = [unzipper readCentralDirectoryAndReturnError:&error];
+    XCTAssertNotNil(cd, @"%@", error);
+    XCTAssertEqual(expectedNames.count, cd.recordCount);
+    for (NSUInteger i = 0; i < cd.recordCount; i++) {
+        NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:i error:&error];
+        XCTAssertEqualObjects(expectedNames[i], record.name);
+        if (i > 0) {
+            XCTAssertEqualObjects(expectedNames[i], record.comment);
+        }
+        XCTAssertTrue([unzipper validateRecord:record progressBlock:NULL error:&error], @"%@", error);
+        XCTAssertEqualObjects(data, [unzipper readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+    }
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+
+    [[NSFileManager defaultManager] removeItemAtPath:sourceZipFilePath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
 #pragma mark Compress Delegate
 
 - (dispatch_queue_t)completionQueue
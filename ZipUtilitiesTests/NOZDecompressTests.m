@@ -25,6 +25,10 @@
 //  SOFTWARE.
 //
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#import "NOZUtils_Project.h"
 #import "ZipUtilities.h"
 
 @import Foundation;
@@ -39,6 +43,82 @@ static NSOperationQueue *sQueue = nil;
 @interface NOZDecompressTests : XCTestCase <NOZDecompressDelegate>
 @end
 
+static void NOZTestAppendLittleEndian(NSMutableData *data, UInt64 value, size_t byteCount)
+{
+    for (size_t i = 0; i < byteCount; i++) {
+        const Byte byte = (Byte)((value >> (i * 8)) & 0xff);
+        [data appendBytes:&byte length:1];
+    }
+}
+
+static const Byte *NOZTestFindLastSignatureBytewise(const Byte *bytes, size_t length, UInt32 signature)
+{
+    for (size_t i = length; i >= 4; i--) {
+        if (signature == NOZReadLittleEndian32(bytes + i - 4)) {
+            return bytes + i - 4;
+        }
+    }
+    return NULL;
+}
+
+// A stand-in for a server of archives that honors HTTP range requests (only when sRangeServerHonorsRanges is set)
+static NSMutableDictionary<NSURL *, NSData *> *sRangeServerFiles = nil;
+static BOOL sRangeServerHonorsRanges = YES;
+
+@interface NOZTestRangeServerURLProtocol : NSURLProtocol
+@end
+
+@implementation NOZTestRangeServerURLProtocol
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request
+{
+    return [request.URL.host isEqualToString:@"range.server.test"];
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request
+{
+    return request;
+}
+
+- (void)startLoading
+{
+    NSData *file = nil;
+    @synchronized(sRangeServerFiles) {
+        file = sRangeServerFiles[self.request.URL];
+    }
+
+    NSInteger statusCode = (file) ? 200 : 404;
+    NSMutableDictionary<NSString *, NSString *> *headers = [NSMutableDictionary dictionary];
+    NSData *body = file ?: [NSData data];
+
+    NSString *range = [self.request valueForHTTPHeaderField:@"Range"];
+    if (file && range && sRangeServerHonorsRanges) {
+        unsigned long long first = 0, last = 0;
+        NSScanner *scanner = [NSScanner scannerWithString:range];
+        if ([scanner scanString:@"bytes=" intoString:NULL] && [scanner scanUnsignedLongLong:&first] && [scanner scanString:@"-" intoString:NULL] && [scanner scanUnsignedLongLong:&last] && first <= last && first < file.length) {
+            last = MIN(last, file.length - 1);
+            statusCode = 206;
+            body = [file subdataWithRange:NSMakeRange((NSUInteger)first, (NSUInteger)(last - first + 1))];
+            headers[@"Content-Range"] = [NSString stringWithFormat:@"bytes %llu-%llu/%tu", first, last, file.length];
+        } else {
+            statusCode = 416;
+            body = [NSData data];
+        }
+    }
+    headers[@"Content-Length"] = [NSString stringWithFormat:@"%tu", body.length];
+
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL statusCode:statusCode HTTPVersion:@"HTTP/1.1" headerFields:headers];
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    [self.client URLProtocol:self didLoadData:body];
+    [self.client URLProtocolDidFinishLoading:self];
+}
+
+- (void)stopLoading
+{
+}
+
+@end
+
 @implementation NOZDecompressTests
 
 + (void)setUp
@@ -242,6 +322,7 @@ static NSOperationQueue *sQueue = nil;
         NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:0 error:NULL];
         XCTAssertEqualObjects(record.comment, expectedString);
         XCTAssertEqualObjects(record.name, expectedString);
+        XCTAssertEqual(0, [unzipper indexForRecordWithName:expectedString]);
         XCTAssertTrue([unzipper closeAndReturnError:NULL]);
     }
 }
@@ -377,6 +458,73 @@ static NSOperationQueue *sQueue = nil;
                                                                                  ]]];
 }
 
+- (void)testDecompressMixedConcurrently
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Mixed.zip"];
+    NOZDecompressRequest *request = [[NOZDecompressRequest alloc] initWithSourceFilePath:zipFilePath];
+    request.maxConcurrentUnzipCount = 4;
+
+    [self runGambitWithRequest:request expectedOutputFiles:[NSSet setWithArray:@[
+                                                                                 @"Aesop.txt",
+                                                                                 @"Walkthrough/walkthrough.txt",
+                                                                                 @"ca1.jpeg",
+                                                                                 @"Game/MANIAC.EXE",
+                                                                                 @"Game/00.LFL",
+                                                                                 @"Game/01.LFL",
+                                                                                 @"Game/02.LFL",
+                                                                                 @"Game/03.LFL",
+                                                                                 @"Game/04.LFL",
+                                                                                 @"Game/05.LFL",
+                                                                                 @"Game/06.LFL",
+                                                                                 @"Game/07.LFL",
+                                                                                 @"Game/08.LFL",
+                                                                                 @"Game/09.LFL",
+                                                                                 @"Game/10.LFL",
+                                                                                 @"Game/11.LFL",
+                                                                                 @"Game/12.LFL",
+                                                                                 @"Game/13.LFL",
+                                                                                 @"Game/14.LFL",
+                                                                                 @"Game/15.LFL",
+                                                                                 @"Game/16.LFL",
+                                                                                 @"Game/17.LFL",
+                                                                                 @"Game/18.LFL",
+                                                                                 @"Game/19.LFL",
+                                                                                 @"Game/20.LFL",
+                                                                                 @"Game/21.LFL",
+                                                                                 @"Game/22.LFL",
+                                                                                 @"Game/23.LFL",
+                                                                                 @"Game/24.LFL",
+                                                                                 @"Game/25.LFL",
+                                                                                 @"Game/26.LFL",
+                                                                                 @"Game/27.LFL",
+                                                                                 @"Game/28.LFL",
+                                                                                 @"Game/29.LFL",
+                                                                                 @"Game/30.LFL",
+                                                                                 @"Game/31.LFL",
+                                                                                 @"Game/32.LFL",
+                                                                                 @"Game/33.LFL",
+                                                                                 @"Game/34.LFL",
+                                                                                 @"Game/35.LFL",
+                                                                                 @"Game/36.LFL",
+                                                                                 @"Game/37.LFL",
+                                                                                 @"Game/38.LFL",
+                                                                                 @"Game/39.LFL",
+                                                                                 @"Game/40.LFL",
+                                                                                 @"Game/41.LFL",
+                                                                                 @"Game/42.LFL",
+                                                                                 @"Game/43.LFL",
+                                                                                 @"Game/44.LFL",
+                                                                                 @"Game/45.LFL",
+                                                                                 @"Game/46.LFL",
+                                                                                 @"Game/47.LFL",
+                                                                                 @"Game/48.LFL",
+                                                                                 @"Game/49.LFL",
+                                                                                 @"Game/50.LFL",
+                                                                                 @"Game/51.LFL",
+                                                                                 @"Game/52.LFL",
+                                                                                 ]]];
+}
+
 - (void)testDecompressInvalid
 {
     NSString *zipFilePath = nil;
@@ -399,6 +547,1080 @@ static NSOperationQueue *sQueue = nil;
     [self runInvalidRequest:request];
 }
 
+- (void)testUnzipperRecordLookup
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Mixed.zip"];
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:NULL]);
+    XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:NULL]);
+
+    [unzipper enumerateManifestEntriesUsingBlock:^(NOZCentralDirectoryRecord *record, NSUInteger index, BOOL *stop) {
+        NSString *name = record.name;
+        XCTAssertEqual(index, [unzipper indexForRecordWithName:name], @"%@", name);
+        NSData *nameData = [name dataUsingEncoding:NSUTF8StringEncoding];
+        XCTAssertEqual(index, [unzipper indexForRecordWithNameBytes:nameData.bytes length:nameData.length], @"%@", name);
+    }];
+
+    XCTAssertEqual(NSNotFound, [unzipper indexForRecordWithName:@"Game/99.LFL"]);
+    XCTAssertEqual(NSNotFound, [unzipper indexForRecordWithNameBytes:"Aesop" length:5]);
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+}
+
+- (void)testUnzipperConcurrentReads
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Mixed.zip"];
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:NULL]);
+    NOZCentralDirectory *cd = [unzipper readCentralDirectoryAndReturnError:NULL];
+    XCTAssertNotNil(cd);
+
+    NSMutableArray *serialData = [NSMutableArray arrayWithCapacity:cd.recordCount];
+    [unzipper enumerateManifestEntriesUsingBlock:^(NOZCentralDirectoryRecord *record, NSUInteger index, BOOL *stop) {
+        NSData *data = [unzipper readDataFromRecord:record progressBlock:NULL error:NULL];
+        [serialData addObject:data ?: [NSData data]];
+    }];
+
+    NSMutableArray *concurrentData = [serialData mutableCopy];
+    NSLock *lock = [[NSLock alloc] init];
+    dispatch_apply(cd.recordCount * 4, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t iteration) {
+        const NSUInteger index = iteration % cd.recordCount;
+        NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:index error:NULL];
+        NSData *data = [unzipper readDataFromRecord:record progressBlock:NULL error:NULL] ?: [NSData data];
+        [lock lock];
+        if (![concurrentData[index] isEqualToData:data]) {
+            concurrentData[index] = [NSNull null];
+        }
+        [lock unlock];
+    });
+
+    XCTAssertEqualObjects(serialData, concurrentData);
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+}
+
+- (void)testUnzipperMemoryMapped
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Mixed.zip"];
+
+    NOZUnzipper *fileUnzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([fileUnzipper openAndReturnError:NULL]);
+    XCTAssertFalse(fileUnzipper.isMemoryMapped);
+    XCTAssertNotNil([fileUnzipper readCentralDirectoryAndReturnError:NULL]);
+
+    NOZUnzipper *mappedUnzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([mappedUnzipper openWithOptions:NOZUnzipperOpenOptionMemoryMap error:NULL]);
+    XCTAssertTrue(mappedUnzipper.isMemoryMapped);
+    NOZCentralDirectory *cd = [mappedUnzipper readCentralDirectoryAndReturnError:NULL];
+    XCTAssertNotNil(cd);
+    XCTAssertEqual(cd.recordCount, fileUnzipper.centralDirectory.recordCount);
+    XCTAssertEqual(cd.totalUncompressedSize, fileUnzipper.centralDirectory.totalUncompressedSize);
+
+    [mappedUnzipper enumerateManifestEntriesUsingBlock:^(NOZCentralDirectoryRecord *record, NSUInteger index, BOOL *stop) {
+        NOZCentralDirectoryRecord *fileRecord = [fileUnzipper readRecordAtIndex:index error:NULL];
+        XCTAssertEqualObjects(record.name, fileRecord.name);
+        if (record.isZeroLength) {
+            return;
+        }
+
+        NSError *error = nil;
+        NSData *mappedData = [mappedUnzipper readDataFromRecord:record progressBlock:NULL error:&error];
+        XCTAssertNotNil(mappedData, @"%@", error);
+        NSData *fileData = [fileUnzipper readDataFromRecord:fileRecord progressBlock:NULL error:NULL];
+        XCTAssertEqualObjects(mappedData, fileData, @"%@", record.name);
+    }];
+
+    XCTAssertTrue([mappedUnzipper closeAndReturnError:NULL]);
+    XCTAssertFalse(mappedUnzipper.isMemoryMapped);
+    XCTAssertTrue([fileUnzipper closeAndReturnError:NULL]);
+}
+
+- (void)testUnzipperRecordAttributes
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Attributes.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    NSData *data = [@"attributes" dataUsingEncoding:NSUTF8StringEncoding];
+    NSArray<NSString *> *names = @[ @"file.txt", @"__MACOSX/._file.txt", @"dir/.DS_Store", @"dir/.DS_Store.txt", @"dir/__MACOSX.txt" ];
+    for (NSString *name in names) {
+        NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:data name:name];
+        entry.comment = [name stringByAppendingString:@" comment"];
+        XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    }
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:&error], @"%@", error);
+
+    NSMutableArray<NOZCentralDirectoryRecord *> *records = [NSMutableArray array];
+    [unzipper enumerateManifestEntriesUsingBlock:^(NOZCentralDirectoryRecord *record, NSUInteger index, BOOL *stop) {
+        XCTAssertEqualObjects(names[index], record.name);
+        XCTAssertEqualObjects([names[index] stringByAppendingString:@" comment"], record.comment);
+        XCTAssertFalse(record.isZeroLength);
+        XCTAssertFalse(record.isDirectory);
+        XCTAssertEqual((BOOL)(1 == index), record.isMacOSXAttribute, @"%@", record.name);
+        XCTAssertEqual((BOOL)(2 == index), record.isMacOSXDSStore, @"%@", record.name);
+        [records addObject:record];
+    }];
+    XCTAssertEqual(names.count, records.count);
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+    unzipper = nil;
+
+    // records remain valid after their unzipper is gone
+    XCTAssertEqualObjects(names.lastObject, records.lastObject.name);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testUnzipperCheckpointIndex
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Checkpoints.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSMutableData *data = [NSMutableData data];
+    for (NSUInteger i = 0; data.length < 4 * 1024 * 1024; i++) {
+        [data appendData:[[NSString stringWithFormat:@"%tu: %tu %tu\n", i, i * 7919, (i * 104729) % 1000] dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    NOZDataZipEntry *deflatedEntry = [[NOZDataZipEntry alloc] initWithData:data name:@"deflated.log"];
+    XCTAssertTrue([zipper addEntry:deflatedEntry progressBlock:NULL error:&error], @"%@", error);
+    NOZDataZipEntry *storedEntry = [[NOZDataZipEntry alloc] initWithData:data name:@"stored.log"];
+    storedEntry.compressionMethod = NOZCompressionMethodNone;
+    XCTAssertTrue([zipper addEntry:storedEntry progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:&error], @"%@", error);
+    NOZCentralDirectoryRecord *deflatedRecord = [unzipper readRecordAtIndex:0 error:NULL];
+    NOZCentralDirectoryRecord *storedRecord = [unzipper readRecordAtIndex:1 error:NULL];
+
+    NOZCheckpointIndex *checkpointIndex = [unzipper buildCheckpointIndexForRecord:deflatedRecord
+                                                               checkpointInterval:256 * 1024
+                                                                    progressBlock:NULL
+                                                                            error:&error];
+    XCTAssertNotNil(checkpointIndex, @"%@", error);
+    XCTAssertGreaterThan(checkpointIndex.checkpointCount, (NSUInteger)4);
+
+    NOZCheckpointIndex *restoredIndex = [[NOZCheckpointIndex alloc] initWithDataRepresentation:checkpointIndex.dataRepresentation];
+    XCTAssertNotNil(restoredIndex);
+    XCTAssertEqual(checkpointIndex.checkpointCount, restoredIndex.checkpointCount);
+    XCTAssertEqualObjects(checkpointIndex.dataRepresentation, restoredIndex.dataRepresentation);
+    XCTAssertNil([[NOZCheckpointIndex alloc] initWithDataRepresentation:[checkpointIndex.dataRepresentation subdataWithRange:NSMakeRange(0, 100)]]);
+
+    const NSRange ranges[] = {
+        NSMakeRange(0, 10),
+        NSMakeRange(1024 * 1024 - 3, 64 * 1024),
+        NSMakeRange(data.length - 100, 100),
+        NSMakeRange(data.length - 100, 1000), // clamped
+        NSMakeRange(2 * 1024 * 1024, 0),
+    };
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        const NSRange range = ranges[i];
+        NSData *expected = [data subdataWithRange:NSIntersectionRange(range, NSMakeRange(0, data.length))];
+        XCTAssertEqualObjects(expected, [unzipper readDataFromRecord:deflatedRecord range:range checkpointIndex:checkpointIndex error:&error], @"%@ %@", NSStringFromRange(range), error);
+        XCTAssertEqualObjects(expected, [unzipper readDataFromRecord:deflatedRecord range:range checkpointIndex:restoredIndex error:&error], @"%@ %@", NSStringFromRange(range), error);
+        XCTAssertEqualObjects(expected, [unzipper readDataFromRecord:deflatedRecord range:range checkpointIndex:nil error:&error], @"%@ %@", NSStringFromRange(range), error);
+        XCTAssertEqualObjects(expected, [unzipper readDataFromRecord:storedRecord range:range checkpointIndex:nil error:&error], @"%@ %@", NSStringFromRange(range), error);
+    }
+
+    error = nil;
+    XCTAssertNil([unzipper readDataFromRecord:deflatedRecord range:NSMakeRange(data.length + 1, 1) checkpointIndex:checkpointIndex error:&error]);
+    XCTAssertEqual(NOZErrorCodeUnzipIndexOutOfBounds, error.code);
+
+    NOZCheckpointIndex *storedIndex = [unzipper buildCheckpointIndexForRecord:storedRecord checkpointInterval:0 progressBlock:NULL error:&error];
+    XCTAssertNotNil(storedIndex, @"%@", error);
+    XCTAssertEqual((NSUInteger)0, storedIndex.checkpointCount);
+    error = nil;
+    XCTAssertNil([unzipper readDataFromRecord:deflatedRecord range:NSMakeRange(0, 1) checkpointIndex:storedIndex error:&error]);
+    XCTAssertEqual(NOZErrorCodeUnzipCheckpointIndexDoesNotMatchRecord, error.code);
+
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testUnzipperCentralDirectoryIndex
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Indexed.zip"];
+    NSString *indexPath = [zipFilePath stringByAppendingPathExtension:@"index"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:indexPath error:NULL];
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    zipper.globalComment = @"indexed";
+    for (NSUInteger i = 0; i < 100; i++) {
+        NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:[[NSString stringWithFormat:@"entry %tu", i] dataUsingEncoding:NSUTF8StringEncoding]
+                                                                  name:[NSString stringWithFormat:@"dir/%tu.txt", i]];
+        entry.comment = (i % 2) ? [NSString stringWithFormat:@"comment %tu", i] : nil;
+        XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    }
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    NOZUnzipper *parsingUnzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([parsingUnzipper openAndReturnError:&error], @"%@", error);
+    NOZCentralDirectory *parsedCD = [parsingUnzipper readCentralDirectoryAndReturnError:&error];
+    XCTAssertNotNil(parsedCD, @"%@", error);
+
+    // first read writes the index, second read maps it
+
+    for (NSUInteger pass = 0; pass < 2; pass++) {
+        NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+        XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+        NOZCentralDirectory *cd = [unzipper readCentralDirectoryWithIndexAtPath:indexPath error:&error];
+        XCTAssertNotNil(cd, @"%@", error);
+        XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:indexPath]);
+        XCTAssertEqual(parsedCD.recordCount, cd.recordCount);
+        XCTAssertEqual(parsedCD.totalUncompressedSize, cd.totalUncompressedSize);
+        XCTAssertEqualObjects(parsedCD.globalComment, cd.globalComment);
+        for (NSUInteger i = 0; i < cd.recordCount; i++) {
+            NOZCentralDirectoryRecord *expectedRecord = [parsingUnzipper readRecordAtIndex:i error:NULL];
+            NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:i error:NULL];
+            XCTAssertEqualObjects(expectedRecord.name, record.name);
+            XCTAssertEqualObjects(expectedRecord.comment, record.comment);
+            XCTAssertEqual(expectedRecord.compressedSize, record.compressedSize);
+            XCTAssertEqual(expectedRecord.uncompressedSize, record.uncompressedSize);
+            XCTAssertEqual(i, [unzipper indexForRecordWithName:record.name]);
+        }
+        XCTAssertEqual(NSNotFound, [unzipper indexForRecordWithName:@"dir/100.txt"]);
+        NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:42 error:NULL];
+        XCTAssertEqualObjects([@"entry 42" dataUsingEncoding:NSUTF8StringEncoding], [unzipper readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+        XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+    }
+    XCTAssertTrue([parsingUnzipper closeAndReturnError:NULL]);
+
+    // a different archive at the same path doesn't use the stale index
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+    zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:[@"replaced" dataUsingEncoding:NSUTF8StringEncoding] name:@"replaced.txt"];
+    XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    NOZCentralDirectory *cd = [unzipper readCentralDirectoryWithIndexAtPath:indexPath error:&error];
+    XCTAssertNotNil(cd, @"%@", error);
+    XCTAssertEqual((NSUInteger)1, cd.recordCount);
+    XCTAssertEqual((NSUInteger)0, [unzipper indexForRecordWithName:@"replaced.txt"]);
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:indexPath error:NULL];
+}
+
+- (void)testUnzipperEndOfCentralDirectoryLookup
+{
+    // The end of central directory record is found by scanning backwards from the end of the archive,
+    // so a global comment that contains its signature or is as long as possible must not throw off the lookup
+
+    NSMutableString *maxComment = [NSMutableString stringWithCapacity:UINT16_MAX];
+    for (NSUInteger i = 0; i < UINT16_MAX; i++) {
+        [maxComment appendFormat:@"%c", (char)('a' + (i % 26))];
+    }
+    NSArray<NSString *> *comments = @[ @"before PK\x05\x06 and the rest of a bogus record that runs past the end", maxComment ];
+
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Commented.zip"];
+    NSData *data = [@"commented" dataUsingEncoding:NSUTF8StringEncoding];
+    for (NSString *comment in comments) {
+        [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+        NSError *error = nil;
+        NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+        XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+        zipper.globalComment = comment;
+        XCTAssertTrue([zipper addEntry:[[NOZDataZipEntry alloc] initWithData:data name:@"a.txt"] progressBlock:NULL error:&error], @"%@", error);
+        XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+        NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+        XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+        NOZCentralDirectory *cd = [unzipper readCentralDirectoryAndReturnError:&error];
+        XCTAssertNotNil(cd, @"%@", error);
+        XCTAssertEqualObjects(comment, cd.globalComment);
+        XCTAssertEqual((NSUInteger)1, cd.recordCount);
+        NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:0 error:&error];
+        XCTAssertNotNil(record, @"%@", error);
+        XCTAssertEqualObjects(data, [unzipper readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+        XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+    }
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testFindLastSignature
+{
+    // The word at a time scan must find the same signature as a byte at a time scan
+    // wherever the signature lands relative to the words (including straddling them and at the very start),
+    // for lengths that are not multiples of the word size, and among bytes that match the signature's first byte
+
+    const UInt32 signature = NOZMagicNumberEndOfCentralDirectoryRecord;
+    Byte bytes[67];
+    for (size_t length = 0; length <= sizeof(bytes); length++) {
+        for (size_t noise = 0; noise < 2; noise++) {
+            for (size_t position = 0; position + 4 <= length + 1; position++) {
+                for (size_t i = 0; i < length; i++) {
+                    bytes[i] = (noise) ? (Byte)(signature & 0xff) : (Byte)i;
+                }
+                if (position + 4 <= length) {
+                    NOZWriteLittleEndian32(bytes + position, signature);
+                } // else no signature at all
+
+                const Byte *expected = NOZTestFindLastSignatureBytewise(bytes, length, signature);
+                XCTAssertEqual(expected, NOZFindLastSignature(bytes, length, signature), @"length %zu, position %zu, noise %zu", length, position, noise);
+                if (position + 4 <= length) {
+                    XCTAssertEqual(bytes + position, expected);
+                }
+            }
+        }
+    }
+
+    // the last of several signatures
+    bzero(bytes, sizeof(bytes));
+    NOZWriteLittleEndian32(bytes, signature);
+    NOZWriteLittleEndian32(bytes + 29, signature);
+    XCTAssertEqual(bytes + 29, NOZFindLastSignature(bytes, sizeof(bytes), signature));
+    XCTAssertEqual(bytes, NOZFindLastSignature(bytes, 32, signature));
+}
+
+- (void)testUnzipperSharedCentralDirectoryCache
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Cached.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:[@"cached" dataUsingEncoding:NSUTF8StringEncoding] name:@"cached.txt"];
+    XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    NOZCentralDirectoryCache *cache = [NOZCentralDirectoryCache sharedCache];
+    [cache removeAllCentralDirectories];
+    XCTAssertEqual((NSUInteger)0, cache.count);
+
+    NOZUnzipper *unzipper1 = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper1 openWithOptions:NOZUnzipperOpenOptionSharedCentralDirectoryCache error:&error], @"%@", error);
+    XCTAssertNil(unzipper1.centralDirectory);
+    NOZCentralDirectory *cd1 = [unzipper1 readCentralDirectoryAndReturnError:&error];
+    XCTAssertNotNil(cd1, @"%@", error);
+    XCTAssertEqual((NSUInteger)1, cache.count);
+    XCTAssertGreaterThan(cache.totalCost, (NSUInteger)0);
+
+    // a cache hit is available as soon as the unzipper is opened
+
+    NOZUnzipper *unzipper2 = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper2 openWithOptions:NOZUnzipperOpenOptionSharedCentralDirectoryCache error:&error], @"%@", error);
+    XCTAssertEqual(cd1, unzipper2.centralDirectory);
+    XCTAssertEqual(cd1, [unzipper2 readCentralDirectoryAndReturnError:&error]);
+    NOZCentralDirectoryRecord *record = [unzipper2 readRecordAtIndex:[unzipper2 indexForRecordWithName:@"cached.txt"] error:&error];
+    XCTAssertEqualObjects([@"cached" dataUsingEncoding:NSUTF8StringEncoding], [unzipper2 readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([unzipper2 closeAndReturnError:NULL]);
+
+    // without the option, the central directory is parsed
+
+    NOZUnzipper *unzipper3 = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper3 openAndReturnError:&error], @"%@", error);
+    NOZCentralDirectory *cd3 = [unzipper3 readCentralDirectoryAndReturnError:&error];
+    XCTAssertNotNil(cd3, @"%@", error);
+    XCTAssertNotEqual(cd1, cd3);
+    XCTAssertTrue([unzipper3 closeAndReturnError:NULL]);
+
+    // over budget evicts
+
+    const NSUInteger totalCostLimit = cache.totalCostLimit;
+    cache.totalCostLimit = 0;
+    XCTAssertEqual((NSUInteger)0, cache.count);
+    XCTAssertEqual((NSUInteger)0, cache.totalCost);
+    cache.totalCostLimit = totalCostLimit;
+
+    // the evicted central directory is still usable by the unzipper that read it
+
+    record = [unzipper1 readRecordAtIndex:0 error:&error];
+    XCTAssertEqualObjects([@"cached" dataUsingEncoding:NSUTF8StringEncoding], [unzipper1 readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([unzipper1 closeAndReturnError:NULL]);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testUnzipperPlanSequentialRead
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Planned.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    for (NSUInteger i = 0; i < 20; i++) {
+        NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:[[NSString stringWithFormat:@"entry %tu", i] dataUsingEncoding:NSUTF8StringEncoding]
+                                                                  name:[NSString stringWithFormat:@"%02tu.txt", i]];
+        entry.compressionMethod = (i % 2) ? NOZCompressionMethodNone : NOZCompressionMethodDeflate;
+        XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    }
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    XCTAssertNil([unzipper planSequentialReadOfRecords:@[] error:&error]);
+    XCTAssertEqual(NOZErrorCodeUnzipMustOpenUnzipperBeforeManipulating, error.code);
+    XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:&error], @"%@", error);
+
+    NSMutableArray<NOZCentralDirectoryRecord *> *records = [NSMutableArray array];
+    [unzipper enumerateManifestEntriesUsingBlock:^(NOZCentralDirectoryRecord *record, NSUInteger index, BOOL *stop) {
+        [records insertObject:record atIndex:0]; // reversed
+    }];
+
+    NSArray<NOZCentralDirectoryRecord *> *plannedRecords = [unzipper planSequentialReadOfRecords:records error:&error];
+    XCTAssertEqual(records.count, plannedRecords.count, @"%@", error);
+    for (NSUInteger i = 0; i < plannedRecords.count; i++) {
+        NOZCentralDirectoryRecord *record = plannedRecords[i];
+        XCTAssertEqualObjects(([NSString stringWithFormat:@"%02tu.txt", i]), record.name);
+        XCTAssertEqualObjects([[NSString stringWithFormat:@"entry %tu", i] dataUsingEncoding:NSUTF8StringEncoding], [unzipper readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+    }
+
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testUnzipperAccessHints
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Hints.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSMutableData *data = [NSMutableData data];
+    for (NSUInteger i = 0; data.length < 3 * 1024 * 1024; i++) {
+        [data appendData:[[NSString stringWithFormat:@"%tu\n", i * 104729] dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:data name:@"data.txt"];
+    XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    // hints must not change what is read (with and without a memory mapping)
+
+    const NOZUnzipperOpenOptions hints = NOZUnzipperOpenOptionSequentialAccess | NOZUnzipperOpenOptionNoCacheRetention;
+    for (NSNumber *options in @[ @(hints), @(hints | NOZUnzipperOpenOptionMemoryMap) ]) {
+        NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+        XCTAssertTrue([unzipper openWithOptions:options.integerValue error:&error], @"%@", error);
+        XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:&error], @"%@", error);
+        NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:0 error:&error];
+        XCTAssertEqualObjects(data, [unzipper readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+        XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+    }
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testUnzipperSaveRecords
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Save.zip"];
+    NSString *outputDirectory = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Save"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:outputDirectory error:NULL];
+
+    NSMutableData *largeData = [NSMutableData data];
+    for (NSUInteger i = 0; largeData.length < 1024 * 1024; i++) {
+        [largeData appendData:[[NSString stringWithFormat:@"%tu\n", i * 7919] dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+    NSDictionary<NSString *, NSData *> *contents = @{
+                                                     @"top.txt" : [@"top" dataUsingEncoding:NSUTF8StringEncoding],
+                                                     @"a/b/small.txt" : [@"small" dataUsingEncoding:NSUTF8StringEncoding],
+                                                     @"a/c/large.txt" : largeData,
+                                                     @"a/empty.txt" : [NSData data],
+                                                     };
+    // far from now, so the modification date of a saved file can only come from the archive
+    // (zipped from files, the timestamp of an entry is the modification date of its file)
+    NSDate *timestamp = [NSDate dateWithTimeIntervalSinceReferenceDate:315360000.0];
+    NSString *sourceDirectory = [NSTemporaryDirectory() stringByAppendingPathComponent:@"SaveSources"];
+    [[NSFileManager defaultManager] removeItemAtPath:sourceDirectory error:NULL];
+    XCTAssertTrue([[NSFileManager defaultManager] createDirectoryAtPath:sourceDirectory withIntermediateDirectories:YES attributes:nil error:NULL]);
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    for (NSString *name in contents) {
+        NSString *sourceFilePath = [sourceDirectory stringByAppendingPathComponent:name.lastPathComponent];
+        XCTAssertTrue([contents[name] writeToFile:sourceFilePath atomically:NO]);
+        XCTAssertTrue([[NSFileManager defaultManager] setAttributes:@{ NSFileModificationDate : timestamp } ofItemAtPath:sourceFilePath error:&error], @"%@", error);
+        NOZFileZipEntry *entry = [[NOZFileZipEntry alloc] initWithFilePath:sourceFilePath name:name];
+        XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    }
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:&error], @"%@", error);
+
+    void (^saveAll)(NOZUnzipperSaveRecordOptions, BOOL) = ^(NOZUnzipperSaveRecordOptions options, BOOL expectSuccess) {
+        [unzipper enumerateManifestEntriesUsingBlock:^(NOZCentralDirectoryRecord *record, NSUInteger index, BOOL *stop) {
+            NSError *saveError = nil;
+            const BOOL saved = [unzipper saveRecord:record toDirectory:outputDirectory options:options progressBlock:NULL error:&saveError];
+            if (expectSuccess) {
+                XCTAssertTrue(saved, @"%@ %@", record.name, saveError);
+            } else if (record.uncompressedSize > 0) {
+                XCTAssertFalse(saved, @"%@", record.name);
+                XCTAssertEqual(EEXIST, saveError.code);
+            }
+        }];
+    };
+    void (^verifyAll)(void) = ^{
+        for (NSString *name in contents) {
+            NSString *filePath = [outputDirectory stringByAppendingPathComponent:name];
+            if (contents[name].length == 0) {
+                XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:filePath], @"%@", name);
+                continue;
+            }
+            XCTAssertEqualObjects(contents[name], [NSData dataWithContentsOfFile:filePath], @"%@", name);
+            NSDate *modificationDate = [[[NSFileManager defaultManager] attributesOfItemAtPath:filePath error:NULL] fileModificationDate];
+            XCTAssertLessThan(fabs([modificationDate timeIntervalSinceDate:timestamp]), 2.0, @"%@ %@", name, modificationDate); // DOS dates have 2 second precision
+        }
+    };
+
+    saveAll(NOZUnzipperSaveRecordOptionsNone, YES);
+    verifyAll();
+    saveAll(NOZUnzipperSaveRecordOptionsNone, NO);
+    saveAll(NOZUnzipperSaveRecordOptionOverwriteExisting, YES);
+    verifyAll();
+
+    // the destination being removed between saves must not lose anything
+    [[NSFileManager defaultManager] removeItemAtPath:outputDirectory error:NULL];
+    saveAll(NOZUnzipperSaveRecordOptionsNone, YES);
+    verifyAll();
+
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:outputDirectory error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:sourceDirectory error:NULL];
+}
+
+- (void)testUnzipperSaveStoredRecords
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"SaveStored.zip"];
+    NSString *outputDirectory = [NSTemporaryDirectory() stringByAppendingPathComponent:@"SaveStored"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:outputDirectory error:NULL];
+
+    NSMutableData *data = [NSMutableData data];
+    for (NSUInteger i = 0; data.length < 3 * 1024 * 1024; i++) {
+        [data appendData:[[NSString stringWithFormat:@"%tu\n", i * 15485863] dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:data name:@"media/stored.bin"];
+    entry.compressionMethod = NOZCompressionMethodNone;
+    XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    NSString *outputFile = [outputDirectory stringByAppendingPathComponent:@"media/stored.bin"];
+    const NOZUnzipperSaveRecordOptions saveOptions[] = {
+        NOZUnzipperSaveRecordOptionOverwriteExisting,
+        NOZUnzipperSaveRecordOptionOverwriteExisting | NOZUnzipperSaveRecordOptionSkipChecksumValidation,
+    };
+    for (NSNumber *openOptions in @[ @(NOZUnzipperOpenOptionsNone), @(NOZUnzipperOpenOptionMemoryMap) ]) {
+        for (size_t i = 0; i < sizeof(saveOptions) / sizeof(saveOptions[0]); i++) {
+            NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+            XCTAssertTrue([unzipper openWithOptions:openOptions.integerValue error:&error], @"%@", error);
+            XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:&error], @"%@", error);
+            NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:0 error:&error];
+            __block SInt64 progressBytes = 0;
+            XCTAssertTrue([unzipper saveRecord:record toDirectory:outputDirectory options:saveOptions[i] progressBlock:^(int64_t totalBytes, int64_t bytesComplete, int64_t bytesCompletedThisPass, BOOL *abort) {
+                progressBytes += bytesCompletedThisPass;
+            } error:&error], @"%@", error);
+            XCTAssertEqual((SInt64)data.length, progressBytes);
+            XCTAssertEqualObjects(data, [NSData dataWithContentsOfFile:outputFile]);
+            XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+            [[NSFileManager defaultManager] removeItemAtPath:outputDirectory error:NULL];
+        }
+    }
+
+    // corrupt the stored data, only a save that skips checksum validation succeeds
+
+    NSMutableData *archive = [NSMutableData dataWithContentsOfFile:zipFilePath];
+    const NSRange dataRange = [archive rangeOfData:[data subdataWithRange:NSMakeRange(1024, 64)] options:0 range:NSMakeRange(0, archive.length)];
+    XCTAssertNotEqual((NSUInteger)NSNotFound, dataRange.location);
+    ((Byte *)archive.mutableBytes)[dataRange.location] ^= 0xff;
+    XCTAssertTrue([archive writeToFile:zipFilePath atomically:YES]);
+
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:&error], @"%@", error);
+    NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:0 error:&error];
+    XCTAssertFalse([unzipper saveRecord:record toDirectory:outputDirectory options:NOZUnzipperSaveRecordOptionOverwriteExisting progressBlock:NULL error:&error]);
+    XCTAssertEqual(NOZErrorCodeUnzipChecksumMissmatch, error.code);
+    XCTAssertTrue([unzipper saveRecord:record toDirectory:outputDirectory options:NOZUnzipperSaveRecordOptionOverwriteExisting | NOZUnzipperSaveRecordOptionSkipChecksumValidation progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertEqual(data.length, [NSData dataWithContentsOfFile:outputFile].length);
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:outputDirectory error:NULL];
+}
+
+- (void)testUnzipperRandomAccessSources
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RandomAccess.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSMutableDictionary<NSString *, NSData *> *contents = [NSMutableDictionary dictionary];
+    NSMutableData *largeData = [NSMutableData data];
+    for (NSUInteger i = 0; largeData.length < 2 * 1024 * 1024; i++) {
+        [largeData appendData:[[NSString stringWithFormat:@"%tu\n", i * 104723] dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+    contents[@"large.txt"] = largeData;
+    for (NSUInteger i = 0; i < 40; i++) {
+        contents[[NSString stringWithFormat:@"small/%02tu.txt", i]] = [[NSString stringWithFormat:@"small entry %tu", i] dataUsingEncoding:NSUTF8StringEncoding];
+    }
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    for (NSString *name in [contents.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:contents[name] name:name];
+        entry.compressionMethod = [name hasPrefix:@"large"] ? NOZCompressionMethodNone : NOZCompressionMethodDeflate;
+        XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    }
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+    NSData *archive = [NSData dataWithContentsOfFile:zipFilePath];
+
+    void (^verifyUnzipper)(NOZUnzipper *, NOZUnzipperOpenOptions) = ^(NOZUnzipper *unzipper, NOZUnzipperOpenOptions options) {
+        NSError *unzipError = nil;
+        XCTAssertTrue([unzipper openWithOptions:options error:&unzipError], @"%@", unzipError);
+        XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:&unzipError], @"%@", unzipError);
+        XCTAssertEqual(contents.count, unzipper.centralDirectory.recordCount);
+        [unzipper enumerateManifestEntriesUsingBlock:^(NOZCentralDirectoryRecord *record, NSUInteger index, BOOL *stop) {
+            NSError *readError = nil;
+            XCTAssertEqualObjects(contents[record.name], [unzipper readDataFromRecord:record progressBlock:NULL error:&readError], @"%@ %@", record.name, readError);
+        }];
+        XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+    };
+
+    // in memory
+    verifyUnzipper([[NOZUnzipper alloc] initWithRandomAccessSource:[[NOZDataSource alloc] initWithData:archive]], NOZUnzipperOpenOptionsNone);
+
+    // file descriptor (open options apply)
+    const int fd = open(zipFilePath.fileSystemRepresentation, O_RDONLY);
+    XCTAssertGreaterThanOrEqual(fd, 0);
+    NOZUnzipper *fdUnzipper = [[NOZUnzipper alloc] initWithRandomAccessSource:[[NOZFileDescriptorSource alloc] initWithFileDescriptor:fd]];
+    XCTAssertTrue([fdUnzipper openWithOptions:NOZUnzipperOpenOptionMemoryMap error:&error], @"%@", error);
+    XCTAssertTrue(fdUnzipper.isMemoryMapped);
+    XCTAssertTrue([fdUnzipper closeAndReturnError:NULL]);
+    verifyUnzipper(fdUnzipper, NOZUnzipperOpenOptionMemoryMap);
+    verifyUnzipper(fdUnzipper, NOZUnzipperOpenOptionsNone);
+    close(fd);
+
+    // HTTP range requests against a stand-in server
+
+    NSURL *URL = [NSURL URLWithString:@"https://range.server.test/bucket/RandomAccess.zip"];
+    sRangeServerFiles = [NSMutableDictionary dictionary];
+    sRangeServerFiles[URL] = archive;
+    sRangeServerHonorsRanges = YES;
+    NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+    configuration.protocolClasses = @[ [NOZTestRangeServerURLProtocol class] ];
+    NSURLSession *session = [NSURLSession sessionWithConfiguration:configuration];
+
+    NOZHTTPRangeSource *source = [[NOZHTTPRangeSource alloc] initWithURL:URL session:session];
+    verifyUnzipper([[NOZUnzipper alloc] initWithRandomAccessSource:source], NOZUnzipperOpenOptionsNone);
+
+    // listing and pulling a single small entry takes a handful of requests (length, tail, entry), not one per read
+    source = [[NOZHTTPRangeSource alloc] initWithURL:URL session:session];
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithRandomAccessSource:source];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:&error], @"%@", error);
+    const NSUInteger listingRequestCount = source.requestCount;
+    XCTAssertLessThanOrEqual(listingRequestCount, (NSUInteger)3);
+    NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:[unzipper indexForRecordWithName:@"small/00.txt"] error:&error];
+    XCTAssertEqualObjects(contents[@"small/00.txt"], [unzipper readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertLessThanOrEqual(source.requestCount - listingRequestCount, (NSUInteger)1);
+
+    // the source's error for a failed read (a full response instead of a range) is the underlying error of the read
+    sRangeServerHonorsRanges = NO;
+    record = [unzipper readRecordAtIndex:[unzipper indexForRecordWithName:@"large.txt"] error:&error];
+    XCTAssertNil([unzipper readDataFromRecord:record progressBlock:NULL error:&error]);
+    XCTAssertEqual(NOZErrorCodeUnzipCannotReadFileEntry, error.code);
+    XCTAssertEqual(NOZErrorCodeUnzipCannotReadRandomAccessSource, [error.userInfo[NSUnderlyingErrorKey] code]);
+    sRangeServerHonorsRanges = YES;
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+
+    // a server that doesn't honor range requests can't be unzipped from
+    sRangeServerHonorsRanges = NO;
+    unzipper = [[NOZUnzipper alloc] initWithRandomAccessSource:[[NOZHTTPRangeSource alloc] initWithURL:URL session:session]];
+    XCTAssertFalse([unzipper openAndReturnError:&error]);
+    XCTAssertEqual(NOZErrorCodeUnzipCannotOpenZip, error.code);
+    sRangeServerHonorsRanges = YES;
+
+    [session invalidateAndCancel];
+    sRangeServerFiles = nil;
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testUnzipperReadDataWithUntrustedSizes
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"UntrustedSizes.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSMutableData *data = [NSMutableData data];
+    for (NSUInteger i = 0; data.length < 256 * 1024; i++) {
+        [data appendData:[[NSString stringWithFormat:@"{\"key\":%tu},", i * 31337] dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:data name:@"blob.json"];
+    XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+    NSData *archive = [NSData dataWithContentsOfFile:zipFilePath];
+
+    // the central directory record's uncompressed size is 24 bytes past its signature
+    const Byte signature[] = { 0x50, 0x4b, 0x01, 0x02 };
+    const NSRange signatureRange = [archive rangeOfData:[NSData dataWithBytes:signature length:sizeof(signature)] options:0 range:NSMakeRange(0, archive.length)];
+    XCTAssertNotEqual((NSUInteger)NSNotFound, signatureRange.location);
+
+    // exact, far too large and too small: the data is decoded regardless of the size it claims
+    for (NSNumber *claimedSize in @[ @(data.length), @(0x7ffffff0), @(16) ]) {
+        NSMutableData *patchedArchive = [archive mutableCopy];
+        const UInt32 size = CFSwapInt32HostToLittle(claimedSize.unsignedIntValue);
+        [patchedArchive replaceBytesInRange:NSMakeRange(signatureRange.location + 24, sizeof(size)) withBytes:&size];
+        XCTAssertTrue([patchedArchive writeToFile:zipFilePath atomically:YES]);
+
+        for (NSNumber *options in @[ @(NOZUnzipperOpenOptionsNone), @(NOZUnzipperOpenOptionMemoryMap) ]) {
+            NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+            XCTAssertTrue([unzipper openWithOptions:options.integerValue error:&error], @"%@", error);
+            XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:&error], @"%@", error);
+            NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:0 error:&error];
+            XCTAssertEqual(claimedSize.longLongValue, record.uncompressedSize);
+            XCTAssertEqualObjects(data, [unzipper readDataFromRecord:record progressBlock:NULL error:&error], @"%@ %@", claimedSize, error);
+            XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+        }
+    }
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testArchiveFileSystem
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"FileSystem.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+
+    NSMutableData *largeData = [NSMutableData data];
+    for (NSUInteger i = 0; largeData.length < 1024 * 1024; i++) {
+        [largeData appendData:[[NSString stringWithFormat:@"%tu: %tu\n", i, i * 7919] dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+    NSData *smallData = [@"small" dataUsingEncoding:NSUTF8StringEncoding];
+    // deflated files larger than NOZCheckpointIndexDefaultInterval are read through a checkpoint index
+    NSMutableData *hugeData = [NSMutableData data];
+    for (NSUInteger i = 0; hugeData.length <= (NSUInteger)NOZCheckpointIndexDefaultInterval + 1024 * 1024; i++) {
+        [hugeData appendData:[[NSString stringWithFormat:@"pass %tu\n", i] dataUsingEncoding:NSUTF8StringEncoding]];
+        [hugeData appendData:largeData];
+    }
+
+    NSError *error = nil;
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:&error], @"%@", error);
+    NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:largeData name:@"assets/large.log"];
+    XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    entry = [[NOZDataZipEntry alloc] initWithData:hugeData name:@"assets/huge.log"];
+    XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    entry = [[NOZDataZipEntry alloc] initWithData:largeData name:@"assets/stored/large.log"];
+    entry.compressionMethod = NOZCompressionMethodNone;
+    XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    entry = [[NOZDataZipEntry alloc] initWithData:smallData name:@"small.txt"];
+    XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([zipper closeAndReturnError:&error], @"%@", error);
+
+    NOZArchiveFileSystem *fileSystem = [[NOZArchiveFileSystem alloc] initWithZipFile:zipFilePath blockSize:4096 cacheByteLimit:256 * 1024];
+    XCTAssertNil([fileSystem itemAtPath:@"small.txt" error:&error]);
+    XCTAssertEqual(NOZErrorCodeUnzipMustOpenUnzipperBeforeManipulating, error.code);
+    XCTAssertTrue([fileSystem openAndReturnError:&error], @"%@", error);
+
+    // stat and directory listings (with inferred directories)
+
+    NOZArchiveFileSystemItem *item = [fileSystem itemAtPath:@"/assets/" error:&error];
+    XCTAssertNotNil(item, @"%@", error);
+    XCTAssertTrue(item.isDirectory);
+    XCTAssertNil(item.record);
+    item = [fileSystem itemAtPath:@"assets/large.log" error:&error];
+    XCTAssertFalse(item.isDirectory);
+    XCTAssertEqual((UInt64)largeData.length, item.size);
+    XCTAssertNil([fileSystem itemAtPath:@"missing" error:&error]);
+    XCTAssertEqual(NOZErrorCodeUnzipArchiveFileSystemNoSuchItem, error.code);
+
+    NSArray<NOZArchiveFileSystemItem *> *contents = [fileSystem contentsOfDirectoryAtPath:@"" error:&error];
+    XCTAssertEqualObjects((@[ @"assets", @"small.txt" ]), [contents valueForKey:@"name"]);
+    contents = [fileSystem contentsOfDirectoryAtPath:@"assets" error:&error];
+    XCTAssertEqualObjects((@[ @"huge.log", @"large.log", @"stored" ]), [contents valueForKey:@"name"]);
+    XCTAssertNil([fileSystem contentsOfDirectoryAtPath:@"small.txt" error:&error]);
+    XCTAssertEqual(NOZErrorCodeUnzipArchiveFileSystemItemIsNotDirectory, error.code);
+    XCTAssertNil([fileSystem openFileAtPath:@"assets" error:&error]);
+    XCTAssertEqual(NOZErrorCodeUnzipArchiveFileSystemItemIsDirectory, error.code);
+
+    // reads (spanning blocks, clamped at the end of the file and served from the cache once read)
+
+    XCTAssertEqualObjects(smallData, [fileSystem readDataAtPath:@"small.txt" offset:0 length:100 error:&error], @"%@", error);
+    for (NSString *path in @[ @"assets/large.log", @"assets/stored/large.log" ]) {
+        NOZArchiveFile *file = [fileSystem openFileAtPath:path error:&error];
+        XCTAssertNotNil(file, @"%@", error);
+        const NSRange ranges[] = {
+            NSMakeRange(0, 10),
+            NSMakeRange(4090, 10000),
+            NSMakeRange(500 * 1024 + 7, 3),
+            NSMakeRange(4090, 10000),
+            NSMakeRange(largeData.length - 100, 1000),
+        };
+        for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+            NSData *expected = [largeData subdataWithRange:NSIntersectionRange(ranges[i], NSMakeRange(0, largeData.length))];
+            XCTAssertEqualObjects(expected, [file readDataOfLength:ranges[i].length atOffset:ranges[i].location error:&error], @"%@ %@ %@", path, NSStringFromRange(ranges[i]), error);
+        }
+        XCTAssertEqual((NSUInteger)0, [file readDataOfLength:10 atOffset:largeData.length error:&error].length);
+    }
+    XCTAssertGreaterThan(fileSystem.cachedByteCount, (NSUInteger)0);
+    XCTAssertLessThanOrEqual(fileSystem.cachedByteCount, fileSystem.cacheByteLimit);
+
+    // reads in the middle of a huge file (from the start, then past the first checkpoint beyond it)
+
+    NOZArchiveFile *hugeFile = [fileSystem openFileAtPath:@"assets/huge.log" error:&error];
+    XCTAssertNotNil(hugeFile, @"%@", error);
+    const NSRange hugeRanges[] = {
+        NSMakeRange(hugeData.length / 2 + 13, 20000),
+        NSMakeRange((NSUInteger)NOZCheckpointIndexDefaultInterval + 4097, 20000),
+        NSMakeRange(hugeData.length / 2 + 13, 20000),
+    };
+    for (size_t i = 0; i < sizeof(hugeRanges) / sizeof(hugeRanges[0]); i++) {
+        XCTAssertEqualObjects([hugeData subdataWithRange:hugeRanges[i]], [hugeFile readDataOfLength:hugeRanges[i].length atOffset:hugeRanges[i].location error:&error], @"%@ %@", NSStringFromRange(hugeRanges[i]), error);
+    }
+
+    // reading everything in order evicts the least recently used blocks to stay within the budget
+
+    NOZArchiveFile *file = [fileSystem openFileAtPath:@"assets/large.log" error:&error];
+    NSMutableData *allData = [NSMutableData data];
+    for (UInt64 offset = 0; offset < largeData.length; offset += 10000) {
+        [allData appendData:[file readDataOfLength:10000 atOffset:offset error:&error]];
+    }
+    XCTAssertEqualObjects(largeData, allData);
+    XCTAssertLessThanOrEqual(fileSystem.cachedByteCount, fileSystem.cacheByteLimit);
+
+    [fileSystem purgeCache];
+    XCTAssertEqual((NSUInteger)0, fileSystem.cachedByteCount);
+    XCTAssertTrue([fileSystem closeAndReturnError:&error], @"%@", error);
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testUnzipperZip64
+{
+    // Hand built ZIP64 archive with every overflowable field set to its sentinel
+
+    NSData *content = [@"hello" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *name = [@"a.txt" dataUsingEncoding:NSUTF8StringEncoding];
+    const UInt32 crc32 = 0x3610a686;
+    NSMutableData *zip = [NSMutableData data];
+
+    // local file header
+    NOZTestAppendLittleEndian(zip, 0x04034b50, 4);
+    NOZTestAppendLittleEndian(zip, 45, 2); // version
+    NOZTestAppendLittleEndian(zip, 0, 2); // flags
+    NOZTestAppendLittleEndian(zip, 0, 2); // stored
+    NOZTestAppendLittleEndian(zip, 0, 2); // time
+    NOZTestAppendLittleEndian(zip, 0x21, 2); // date
+    NOZTestAppendLittleEndian(zip, crc32, 4);
+    NOZTestAppendLittleEndian(zip, UINT32_MAX, 4);
+    NOZTestAppendLittleEndian(zip, UINT32_MAX, 4);
+    NOZTestAppendLittleEndian(zip, name.length, 2);
+    NOZTestAppendLittleEndian(zip, 20, 2);
+    [zip appendData:name];
+    NOZTestAppendLittleEndian(zip, 0x0001, 2);
+    NOZTestAppendLittleEndian(zip, 16, 2);
+    NOZTestAppendLittleEndian(zip, content.length, 8);
+    NOZTestAppendLittleEndian(zip, content.length, 8);
+    [zip appendData:content];
+
+    // central directory
+    const NSUInteger centralDirectoryOffset = zip.length;
+    NOZTestAppendLittleEndian(zip, 0x02014b50, 4);
+    NOZTestAppendLittleEndian(zip, 45, 2); // version made by
+    NOZTestAppendLittleEndian(zip, 45, 2); // version for extraction
+    NOZTestAppendLittleEndian(zip, 0, 2); // flags
+    NOZTestAppendLittleEndian(zip, 0, 2); // stored
+    NOZTestAppendLittleEndian(zip, 0, 2); // time
+    NOZTestAppendLittleEndian(zip, 0x21, 2); // date
+    NOZTestAppendLittleEndian(zip, crc32, 4);
+    NOZTestAppendLittleEndian(zip, UINT32_MAX, 4);
+    NOZTestAppendLittleEndian(zip, UINT32_MAX, 4);
+    NOZTestAppendLittleEndian(zip, name.length, 2);
+    NOZTestAppendLittleEndian(zip, 28, 2);
+    NOZTestAppendLittleEndian(zip, 0, 2); // comment
+    NOZTestAppendLittleEndian(zip, 0, 2); // disk
+    NOZTestAppendLittleEndian(zip, 0, 2); // internal attributes
+    NOZTestAppendLittleEndian(zip, 0, 4); // external attributes
+    NOZTestAppendLittleEndian(zip, UINT32_MAX, 4);
+    [zip appendData:name];
+    NOZTestAppendLittleEndian(zip, 0x0001, 2);
+    NOZTestAppendLittleEndian(zip, 24, 2);
+    NOZTestAppendLittleEndian(zip, content.length, 8);
+    NOZTestAppendLittleEndian(zip, content.length, 8);
+    NOZTestAppendLittleEndian(zip, 0, 8);
+    const NSUInteger centralDirectorySize = zip.length - centralDirectoryOffset;
+
+    // zip64 end of central directory record
+    const NSUInteger zip64RecordOffset = zip.length;
+    NOZTestAppendLittleEndian(zip, 0x06064b50, 4);
+    NOZTestAppendLittleEndian(zip, 44, 8);
+    NOZTestAppendLittleEndian(zip, 45, 2);
+    NOZTestAppendLittleEndian(zip, 45, 2);
+    NOZTestAppendLittleEndian(zip, 0, 4);
+    NOZTestAppendLittleEndian(zip, 0, 4);
+    NOZTestAppendLittleEndian(zip, 1, 8);
+    NOZTestAppendLittleEndian(zip, 1, 8);
+    NOZTestAppendLittleEndian(zip, centralDirectorySize, 8);
+    NOZTestAppendLittleEndian(zip, centralDirectoryOffset, 8);
+
+    // zip64 end of central directory locator
+    NOZTestAppendLittleEndian(zip, 0x07064b50, 4);
+    NOZTestAppendLittleEndian(zip, 0, 4);
+    NOZTestAppendLittleEndian(zip, zip64RecordOffset, 8);
+    NOZTestAppendLittleEndian(zip, 1, 4);
+
+    // end of central directory record
+    NOZTestAppendLittleEndian(zip, 0x06054b50, 4);
+    NOZTestAppendLittleEndian(zip, UINT16_MAX, 2);
+    NOZTestAppendLittleEndian(zip, UINT16_MAX, 2);
+    NOZTestAppendLittleEndian(zip, UINT16_MAX, 2);
+    NOZTestAppendLittleEndian(zip, UINT16_MAX, 2);
+    NOZTestAppendLittleEndian(zip, UINT32_MAX, 4);
+    NOZTestAppendLittleEndian(zip, UINT32_MAX, 4);
+    NOZTestAppendLittleEndian(zip, 0, 2);
+
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Zip64.zip"];
+    XCTAssertTrue([zip writeToFile:zipFilePath atomically:YES]);
+
+    NSError *error = nil;
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:&error], @"%@", error);
+    NOZCentralDirectory *cd = [unzipper readCentralDirectoryAndReturnError:&error];
+    XCTAssertNotNil(cd, @"%@", error);
+    XCTAssertEqual((NSUInteger)1, cd.recordCount);
+    XCTAssertEqual((SInt64)content.length, cd.totalUncompressedSize);
+
+    NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:0 error:&error];
+    XCTAssertNotNil(record, @"%@", error);
+    XCTAssertEqualObjects(@"a.txt", record.name);
+    XCTAssertEqual((SInt64)content.length, record.compressedSize);
+    XCTAssertEqual((SInt64)content.length, record.uncompressedSize);
+    XCTAssertEqualObjects(content, [unzipper readDataFromRecord:record progressBlock:NULL error:&error], @"%@", error);
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testStreamUnzipper
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"Mixed.zip"];
+    NOZUnzipper *unzipper = [[NOZUnzipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([unzipper openAndReturnError:NULL]);
+    XCTAssertNotNil([unzipper readCentralDirectoryAndReturnError:NULL]);
+
+    NSError *error = nil;
+    NOZStreamUnzipper *streamUnzipper = [[NOZStreamUnzipper alloc] initWithInputStream:[NSInputStream inputStreamWithFileAtPath:zipFilePath]];
+    XCTAssertTrue([streamUnzipper openAndReturnError:&error], @"%@", error);
+
+    NSUInteger entryCount = 0;
+    NOZStreamUnzipperEntry *entry = nil;
+    while ((entry = [streamUnzipper readNextEntryAndReturnError:&error]) != nil) {
+        NOZCentralDirectoryRecord *record = [unzipper readRecordAtIndex:entryCount error:NULL];
+        XCTAssertEqualObjects(record.name, entry.name);
+        entryCount++;
+        if (entryCount % 3 == 0) {
+            continue; // skip some entries
+        }
+
+        NSData *data = [streamUnzipper readDataFromEntry:entry progressBlock:NULL error:&error];
+        XCTAssertNotNil(data, @"%@: %@", entry.name, error);
+        XCTAssertEqual(record.uncompressedSize, entry.uncompressedSize);
+        XCTAssertEqual(record.compressedSize, entry.compressedSize);
+        XCTAssertEqualObjects([unzipper readDataFromRecord:record progressBlock:NULL error:NULL] ?: [NSData data], data, @"%@", entry.name);
+    }
+    XCTAssertNil(error);
+    XCTAssertEqual(unzipper.centralDirectory.recordCount, entryCount);
+    XCTAssertTrue([streamUnzipper closeAndReturnError:NULL]);
+    XCTAssertTrue([unzipper closeAndReturnError:NULL]);
+}
+
+- (void)testStreamUnzipperDataDescriptors
+{
+    // NOZZipper writes data descriptors when zipping in a single pass
+
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"StreamUnzipper.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+    NSData *aesopData = [NSData dataWithContentsOfFile:[[NSBundle bundleForClass:[self class]] pathForResource:@"Aesop" ofType:@"txt"]];
+    NSArray<NSData *> *datas = @[ aesopData, [@"PK\x07\x08" dataUsingEncoding:NSUTF8StringEncoding], [NSData data], aesopData ];
+
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:NULL]);
+    [datas enumerateObjectsUsingBlock:^(NSData *data, NSUInteger index, BOOL *stop) {
+        NOZDataZipEntry *entry = [[NOZDataZipEntry alloc] initWithData:data name:[NSString stringWithFormat:@"%tu.txt", index]];
+        entry.compressionMethod = (index % 2) ? NOZCompressionMethodNone : NOZCompressionMethodDeflate;
+        XCTAssertTrue([zipper addEntry:entry progressBlock:NULL error:NULL]);
+    }];
+    XCTAssertTrue([zipper closeAndReturnError:NULL]);
+
+    NSError *error = nil;
+    NOZStreamUnzipper *streamUnzipper = [[NOZStreamUnzipper alloc] initWithInputStream:[NSInputStream inputStreamWithFileAtPath:zipFilePath]];
+    XCTAssertTrue([streamUnzipper openAndReturnError:&error], @"%@", error);
+    for (NSData *data in datas) {
+        NOZStreamUnzipperEntry *entry = [streamUnzipper readNextEntryAndReturnError:&error];
+        XCTAssertNotNil(entry, @"%@", error);
+        XCTAssertTrue(entry.hasDataDescriptor);
+        XCTAssertEqual((SInt64)-1, entry.uncompressedSize);
+        XCTAssertEqualObjects(data, [streamUnzipper readDataFromEntry:entry progressBlock:NULL error:&error], @"%@", error);
+        XCTAssertEqual((SInt64)data.length, entry.uncompressedSize);
+    }
+    XCTAssertNil([streamUnzipper readNextEntryAndReturnError:&error]);
+    XCTAssertNil(error);
+    XCTAssertTrue([streamUnzipper closeAndReturnError:NULL]);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+}
+
+- (void)testStreamUnzipperDataDescriptorWithoutSignature
+{
+    NSString *zipFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"StreamUnzipperUnsigned.zip"];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+    NSData *aesopData = [NSData dataWithContentsOfFile:[[NSBundle bundleForClass:[self class]] pathForResource:@"Aesop" ofType:@"txt"]];
+
+    NOZZipper *zipper = [[NOZZipper alloc] initWithZipFile:zipFilePath];
+    XCTAssertTrue([zipper openWithMode:NOZZipperModeCreate error:NULL]);
+    XCTAssertTrue([zipper addEntry:[[NOZDataZipEntry alloc] initWithData:aesopData name:@"Aesop.txt"] progressBlock:NULL error:NULL]);
+    XCTAssertTrue([zipper closeAndReturnError:NULL]);
+
+    // drop the signature of the data descriptor, which immediately precedes the (only) central directory record
+    NSMutableData *zip = [NSMutableData dataWithContentsOfFile:zipFilePath];
+    [[NSFileManager defaultManager] removeItemAtPath:zipFilePath error:NULL];
+    const NSRange recordRange = [zip rangeOfData:[NSData dataWithBytes:"PK\x01\x02" length:4] options:NSDataSearchBackwards range:NSMakeRange(0, zip.length)];
+    XCTAssertNotEqual((NSUInteger)NSNotFound, recordRange.location);
+    const NSRange signatureRange = NSMakeRange(recordRange.location - 16, 4);
+    XCTAssertEqualObjects([NSData dataWithBytes:"PK\x07\x08" length:4], [zip subdataWithRange:signatureRange]);
+    [zip replaceBytesInRange:signatureRange withBytes:NULL length:0];
+
+    NSError *error = nil;
+    NOZStreamUnzipper *streamUnzipper = [[NOZStreamUnzipper alloc] initWithInputStream:[NSInputStream inputStreamWithData:zip]];
+    XCTAssertTrue([streamUnzipper openAndReturnError:&error], @"%@", error);
+    NOZStreamUnzipperEntry *entry = [streamUnzipper readNextEntryAndReturnError:&error];
+    XCTAssertNotNil(entry, @"%@", error);
+    XCTAssertTrue(entry.hasDataDescriptor);
+    XCTAssertNil([streamUnzipper readDataFromEntry:entry progressBlock:NULL error:&error]);
+    XCTAssertEqual(NOZErrorCodeUnzipDataDescriptorWithoutSignatureNotSupported, error.code);
+    XCTAssertTrue([streamUnzipper closeAndReturnError:NULL]);
+}
+
 #pragma mark Decompress Delegate
 
 - (dispatch_queue_t)completionQueue